@@ -24,24 +24,9 @@
 -- your module needs to know the difference.
 --
 
-local Engine = require 'Engine'
-
-local pending = {}
-local callbacks = {}
-local do_callback = {}
-
-local do_callback_normal = function (cb, p)
-	cb(table.unpack(p.event))
-end
-local do_callback_timed = function (cb, p)
-	local d = debug.getinfo(cb)
-
-	local tstart = Engine.ticks
-	cb(table.unpack(p.event))
-	local tend = Engine.ticks
-
-	print(string.format("DEBUG: %s %dms %s:%d", p.name, tend-tstart, d.source, d.linedefined))
-end
+-- queued events and their handlers are kept by the engine, so events that
+-- nobody listens to cost next to nothing
+local EventQueue = require 'EventQueue'
 
 local Event
 Event = {
@@ -77,9 +62,7 @@ Event = {
 	--   stable
 	--
 	Register = function (name, cb)
-		if not callbacks[name] then callbacks[name] = {} end
-		callbacks[name][cb] = cb;
-        if not do_callback[name] then do_callback[name] = do_callback_normal end
+		EventQueue.Register(name, cb)
 	end,
 
 	--
@@ -108,8 +91,7 @@ Event = {
 	--   stable
 	--
 	Deregister = function (name, cb)
-		if not callbacks[name] then return end
-		callbacks[name][cb] = nil
+		EventQueue.Deregister(name, cb)
 	end,
 
 	--
@@ -139,7 +121,7 @@ Event = {
 	--   stable
 	--
 	Queue = function (name, ...)
-		table.insert(pending, { name = name, event = {...} })
+		EventQueue.Queue(name, ...)
 	end,
 
 	--
@@ -168,25 +150,8 @@ Event = {
     --
 
     DebugTimer = function (name, enabled)
-		do_callback[name] = enabled and do_callback_timed or do_callback_normal
-	end,
-
-	-- internal method, called from C++
-	_Clear = function ()
-		pending = {}
+		EventQueue.DebugTimer(name, enabled)
 	end,
-
-	-- internal method, called from C++
-	_Emit = function ()
-		while #pending > 0 do
-			local p = table.remove(pending, 1)
-			if callbacks[p.name] then
-				for cb,_ in pairs(callbacks[p.name]) do
-					do_callback[p.name](cb, p)
-				end
-			end
-		end
-	end
 }
 
 --
@@ -237,6 +202,27 @@ Event = {
 --   stable
 --
 
+--
+-- Event: onGameSaved
+--
+-- Triggered when a saved game has finished being written to disk.
+--
+-- > local onGameSaved = function (filename, ok) ... end
+-- > Event.Register("onGameSaved", onGameSaved)
+--
+-- <Game.SaveGame> returns as soon as the game state has been captured, the
+-- file is compressed and written in the background. ok is false if writing
+-- the file failed.
+--
+-- Availability:
+--
+--   2021
+--
+-- Status:
+--
+--   experimental
+--
+
 --
 -- Event: onEnterSystem
 --
@@ -325,6 +325,12 @@ Flow.calculateSystemParams = function()
 		params.time = params.landed / params.flow
 	end
 
+	-- ships of these types keep arriving for as long as the player is here,
+	-- read their models now so that spawning one doesn't stall the game
+	for _, id in ipairs(ship_names) do
+		Engine.PreloadModel(ShipDef[id].modelName)
+	end
+
 	Core.params = {
 		-- list of ship names that can actually trade in this system
 		ship_names = ship_names,
@@ -35,7 +35,12 @@ layout (location = 4) in vec4 a_uv1;
 layout (location = 5) in vec3 a_tangent;
 layout (location = 6) in mat4 a_transform;
 // a_transform @ 6 shadows (uses) 7, 8, and 9
-// next available is layout (location = 10)
+#ifdef INSTANCE_COLORS
+layout (location = 10) in vec4 a_instColor0;
+layout (location = 11) in vec4 a_instColor1;
+layout (location = 12) in vec4 a_instColor2;
+#endif
+// next available is layout (location = 13)
 
 // shorthand to abstract away instancing
 vec4 matrixTransform()
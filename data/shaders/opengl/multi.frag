@@ -18,6 +18,11 @@ in vec2 texCoord0;
 #ifdef VERTEXCOLOR
 in vec4 vertexColor;
 #endif
+#ifdef INSTANCE_COLORS
+flat in vec4 instColor0;
+flat in vec4 instColor1;
+flat in vec4 instColor2;
+#endif
 #if (NUM_LIGHTS > 0)
 in vec3 eyePos;
 in vec3 normal;
@@ -37,6 +42,34 @@ uniform Material material;
 
 out vec4 frag_color;
 
+#ifdef INSTANCE_COLORS
+// the color map texture of this instance: four texels each of white,
+// primary, secondary and trim
+vec3 mapTexel(int i)
+{
+	int c = clamp(i, 0, 15) / 4;
+	if (c == 0)
+		return vec3(1.0);
+	else if (c == 1)
+		return instColor0.rgb;
+	else if (c == 2)
+		return instColor1.rgb;
+	return instColor2.rgb;
+}
+
+// looked up like the texture would be, filtered for smooth patterns
+vec4 instanceMapColor(float u)
+{
+	float x = u * 16.0;
+	if (instColor0.a > 0.5) {
+		x -= 0.5;
+		int i = int(floor(x));
+		return vec4(mix(mapTexel(i), mapTexel(i + 1), x - floor(x)), 1.0);
+	}
+	return vec4(mapTexel(int(floor(x))), 1.0);
+}
+#endif
+
 #if (NUM_LIGHTS > 0)
 //ambient, diffuse, specular
 //would be a good idea to make specular optional
@@ -69,7 +102,11 @@ void main(void)
 //patterns - simple lookup
 #ifdef MAP_COLOR
 	vec4 pat = texture(texture4, texCoord0);
+#ifdef INSTANCE_COLORS
+	vec4 mapColor = instanceMapColor(pat.r);
+#else
 	vec4 mapColor = texture(texture5, vec2(pat.r, 0.0));
+#endif
 	vec4 tint = mix(vec4(1.0),mapColor,pat.a);
 	color *= tint;
 #endif
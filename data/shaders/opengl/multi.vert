@@ -12,6 +12,11 @@ out vec2 texCoord0;
 #ifdef VERTEXCOLOR
 out vec4 vertexColor;
 #endif
+#ifdef INSTANCE_COLORS
+flat out vec4 instColor0;
+flat out vec4 instColor1;
+flat out vec4 instColor2;
+#endif
 #if (NUM_LIGHTS > 0)
 out vec3 eyePos;
 out vec3 normal;
@@ -35,6 +40,11 @@ void main(void)
 #ifdef TEXTURE0
 	texCoord0 = a_uv0.xy;
 #endif
+#ifdef INSTANCE_COLORS
+	instColor0 = a_instColor0;
+	instColor1 = a_instColor1;
+	instColor2 = a_instColor2;
+#endif
 #if (NUM_LIGHTS > 0)
 #ifdef USE_INSTANCING
 	eyePos = vec3(uViewMatrix * (a_transform * a_vertex));
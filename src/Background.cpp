@@ -11,6 +11,8 @@
 #include "Player.h"
 #include "Space.h"
 #include "StringF.h"
+#include "galaxy/Galaxy.h"
+#include "galaxy/Sector.h"
 #include "galaxy/StarSystem.h"
 #include "graphics/Graphics.h"
 #include "graphics/RenderState.h"
@@ -20,7 +22,9 @@
 #include "profiler/Profiler.h"
 
 #include <SDL_stdinc.h>
+#include <deque>
 #include <iostream>
+#include <map>
 #include <sstream>
 
 using namespace Graphics;
@@ -192,7 +196,327 @@ namespace Background {
 		}
 	}
 
-	Starfield::Starfield(Graphics::Renderer *renderer, Random &rand, const Space *space, RefCountedPtr<Galaxy> galaxy)
+	// stars picked from a single sector, independent of where they're seen from
+	struct SectorStars {
+		std::vector<vector3f> position; // full position in ly
+		std::vector<float> luminosity;
+		std::vector<Color> colour;
+	};
+	typedef std::shared_ptr<const SectorStars> SectorStarsPtr;
+
+	// the galaxy part of a starfield, as seen from one origin sector
+	struct GalaxyStars {
+		std::vector<vector3f> stars;
+		std::vector<Color> colors;
+		std::vector<float> sizes;
+		std::vector<Color> hyperCol;
+	};
+	typedef std::shared_ptr<const GalaxyStars> GalaxyStarsPtr;
+
+	// only ever touched from the main thread, shared between the Starfields of
+	// successive systems so jumps reuse most of the work
+	static std::map<SystemPath, SectorStarsPtr, SystemPath::LessSectorOnly> s_sectorStars;
+	struct OriginCacheEntry {
+		SystemPath origin;
+		Uint32 numStars;
+		Sint32 visibleRadius;
+		GalaxyStarsPtr stars;
+	};
+	static std::deque<OriginCacheEntry> s_originCache;
+	static const size_t ORIGIN_CACHE_SIZE = 4;
+	static const size_t SECTORS_PER_EXTRACT_JOB = 32;
+
+	static GalaxyStarsPtr FindOriginCache(const SystemPath &origin, Uint32 numStars, Sint32 visibleRadius)
+	{
+		for (const OriginCacheEntry &e : s_originCache)
+			if (e.origin.IsSameSector(origin) && e.numStars == numStars && e.visibleRadius == visibleRadius)
+				return e.stars;
+		return GalaxyStarsPtr();
+	}
+
+	// picks the stars out of a batch of sectors
+	class Starfield::ExtractJob : public Job {
+	public:
+		ExtractJob(Starfield *starfield, std::vector<RefCountedPtr<Sector>> &&sectors, std::vector<size_t> &&slots) :
+			m_starfield(starfield),
+			m_sectors(std::move(sectors)),
+			m_slots(std::move(slots))
+		{}
+
+		virtual void OnRun() override // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+		{
+			PROFILE_SCOPED()
+			m_results.reserve(m_sectors.size());
+			for (const RefCountedPtr<Sector> &sec : m_sectors) {
+				std::shared_ptr<SectorStars> out(new SectorStars);
+				out->position.reserve(sec->m_systems.size());
+				out->luminosity.reserve(sec->m_systems.size());
+				out->colour.reserve(sec->m_systems.size());
+				for (const Sector::System &ss : sec->m_systems) {
+					// add the colors and luminosities of all stars in a system together
+					float luminositySystemSum = 0.0f;
+					vector3f colorSystemSum(0.0f, 0.0f, 0.0f);
+					for (size_t i = 0; i < ss.GetNumStars(); ++i) {
+						luminositySystemSum += StarSystem::starLuminosities[ss.GetStarType(i)];
+						Color col = StarSystem::starRealColors[ss.GetStarType(i)];
+						colorSystemSum += vector3f(col.r, col.g, col.b) * luminositySystemSum;
+					}
+					colorSystemSum /= luminositySystemSum;
+
+					out->position.push_back(ss.GetFullPosition());
+					out->luminosity.push_back(luminositySystemSum);
+					out->colour.push_back(Color(colorSystemSum.x, colorSystemSum.y, colorSystemSum.z));
+				}
+				m_results.push_back(std::move(out));
+			}
+		}
+
+		virtual void OnFinish() override // runs in primary thread of the context
+		{
+			for (size_t i = 0; i < m_sectors.size(); i++) {
+				s_sectorStars[m_sectors[i]->GetPath()] = m_results[i];
+				m_starfield->m_sectorStars[m_slots[i]] = m_results[i];
+			}
+			if (--m_starfield->m_pendingExtractJobs == 0)
+				m_starfield->OrderBuild();
+		}
+
+	private:
+		Starfield *m_starfield;
+		std::vector<RefCountedPtr<Sector>> m_sectors;
+		std::vector<size_t> m_slots; // where in m_sectorStars the results go
+		std::vector<SectorStarsPtr> m_results;
+	};
+
+	// assembles the starfield seen from the origin, filling up with random stars
+	class Starfield::BuildJob : public Job {
+	public:
+		BuildJob(Starfield *starfield, std::vector<SectorStarsPtr> &&sectors, GalaxyStarsPtr galaxyStars) :
+			m_starfield(starfield),
+			m_sf(*starfield),
+			m_sectors(std::move(sectors)),
+			m_galaxyStars(galaxyStars),
+			m_builtGalaxyStars(false)
+		{}
+
+		virtual void OnRun() override // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+		{
+			PROFILE_SCOPED()
+			if (!m_galaxyStars && !m_sectors.empty()) {
+				m_galaxyStars = PickGalaxyStars();
+				m_builtGalaxyStars = true;
+			}
+
+			const Uint32 NUM_BG_STARS = m_sf.m_numStars;
+			m_stars.reset(new vector3f[NUM_BG_STARS]);
+			m_colors.reset(new Color[NUM_BG_STARS]);
+			m_sizes.reset(new float[NUM_BG_STARS]);
+			m_hyperVtx.reset(new vector3f[NUM_BG_STARS * 3]);
+			m_hyperCol.reset(new Color[NUM_BG_STARS * 3]);
+
+			Uint32 num = 0;
+			if (m_galaxyStars) {
+				num = m_galaxyStars->stars.size();
+				for (Uint32 i = 0; i < num; i++) {
+					m_stars[i] = m_galaxyStars->stars[i];
+					m_colors[i] = m_galaxyStars->colors[i];
+					m_sizes[i] = m_galaxyStars->sizes[i];
+					//need to keep data around for HS anim - this is stupid
+					m_hyperVtx[NUM_BG_STARS * 2 + i] = m_stars[i];
+					m_hyperCol[NUM_BG_STARS * 2 + i] = m_galaxyStars->hyperCol[i];
+				}
+			}
+			m_numGalaxyStars = num;
+
+			// fill out the remaining target count with generated points
+			Random rand(m_sf.m_seed);
+			for (Uint32 i = num; i < NUM_BG_STARS; i++) {
+				const double size = rand.Double(0.2, 0.9);
+				const Uint8 colScale = size * 255;
+
+				const Color col(
+					rand.Double(m_sf.m_rMin, m_sf.m_rMax) * colScale,
+					rand.Double(m_sf.m_gMin, m_sf.m_gMax) * colScale,
+					rand.Double(m_sf.m_bMin, m_sf.m_bMax) * colScale,
+					255);
+
+				// this is proper random distribution on a sphere's surface
+				const float theta = float(rand.Double(0.0, 2.0 * M_PI));
+				const float u = float(rand.Double(-1.0, 1.0));
+
+				m_sizes[i] = size;
+				// squeeze the starfield a bit to get more density near horizon using matrix3x3f::Scale
+				m_stars[i] = matrix3x3f::Scale(1.0, 0.4, 1.0) * (vector3f(sqrt(1.0f - u * u) * cos(theta), u, sqrt(1.0f - u * u) * sin(theta)).Normalized() * 1000.0f);
+				m_colors[i] = col;
+
+				//need to keep data around for HS anim - this is stupid
+				m_hyperVtx[NUM_BG_STARS * 2 + i] = m_stars[i];
+				m_hyperCol[NUM_BG_STARS * 2 + i] = col;
+			}
+		}
+
+		virtual void OnFinish() override // runs in primary thread of the context
+		{
+			PROFILE_SCOPED()
+			Output("Stars picked from galaxy: %d\n", m_numGalaxyStars);
+			if (m_builtGalaxyStars) {
+				s_originCache.push_front({ m_sf.m_origin, m_sf.m_numStars, m_sf.m_visibleRadius, m_galaxyStars });
+				if (s_originCache.size() > ORIGIN_CACHE_SIZE)
+					s_originCache.pop_back();
+			}
+
+			Starfield *sf = m_starfield;
+			sf->m_hyperVtx = std::move(m_hyperVtx);
+			sf->m_hyperCol = std::move(m_hyperCol);
+			sf->m_pointSprites->SetData(sf->m_numStars, m_stars.get(), m_colors.get(), m_sizes.get(), sf->m_material.Get());
+			sf->m_sectorCache.Reset();
+			sf->m_ready = true;
+		}
+
+	private:
+		GalaxyStarsPtr PickGalaxyStars() const
+		{
+			PROFILE_SCOPED()
+			const Uint32 NUM_BG_STARS = m_sf.m_numStars;
+			const SystemPath &current = m_sf.m_origin;
+			const Sint32 visibleRadiusSqr = (m_sf.m_visibleRadius * m_sf.m_visibleRadius);
+			const double size = 1.0;
+
+			std::shared_ptr<GalaxyStars> out(new GalaxyStars);
+			std::vector<vector3f> &stars = out->stars;
+			std::vector<Color> &colors = out->colors;
+			std::vector<float> &sizes = out->sizes;
+			std::vector<float> brightness;
+
+			// the sectors come in the order they are visited, so the same stars
+			// get picked whenever the target count is reached
+			Uint32 num = 0;
+			for (const SectorStarsPtr &sec : m_sectors) {
+				// add as many systems as we can
+				const size_t numSystems = std::min(sec->position.size(), (size_t)(NUM_BG_STARS - num));
+				for (size_t systemIndex = 0; systemIndex < numSystems; systemIndex++) {
+					const vector3f distance = Sector::SIZE * vector3f(current.sectorX, current.sectorY, current.sectorZ) - sec->position[systemIndex];
+					if (distance.LengthSqr() >= visibleRadiusSqr)
+						continue; // too far
+
+					Color col = sec->colour[systemIndex];
+					col.r = Clamp(col.r, (Uint8)(m_sf.m_rMin * 255), (Uint8)(m_sf.m_rMax * 255));
+					col.g = Clamp(col.g, (Uint8)(m_sf.m_gMin * 255), (Uint8)(m_sf.m_gMax * 255));
+					col.b = Clamp(col.b, (Uint8)(m_sf.m_bMin * 255), (Uint8)(m_sf.m_bMax * 255));
+
+					// copy the data
+					sizes.push_back(size);
+					stars.push_back(distance.Normalized() * 1000.0f);
+					colors.push_back(col);
+					brightness.push_back(sec->luminosity[systemIndex] / (4 * M_PI * distance.Length() * distance.Length()));
+					out->hyperCol.push_back(col * 0.8f);
+					num++;
+				}
+				if (num >= NUM_BG_STARS)
+					break;
+			}
+
+			// use a logarithmic scala for brightness since this looks more natural to the human eye
+			for (uint32_t i = 0; i < num; ++i) {
+				brightness[i] = log(brightness[i]);
+			}
+
+			// find the median brightness of all visible stars
+			std::vector<int> sortedBrightnessIndex;
+			for (Uint32 i = 0; i < num; ++i) {
+				sortedBrightnessIndex.push_back(i);
+			}
+			std::sort(sortedBrightnessIndex.begin(), sortedBrightnessIndex.end(), [&](const int a, const int b) {
+				return brightness[a] > brightness[b];
+			});
+			double medianBrightness = 0.0;
+			if (num > 0) {
+				medianBrightness = brightness[sortedBrightnessIndex[Clamp<int>(m_sf.m_medianPosition * num, 0, num - 1)]];
+			}
+
+			for (size_t j = 0; j < num; ++j) {
+				size_t i = sortedBrightnessIndex[j]; // just for debugging purposes
+
+				// dividing through the median helps bringing the logarithmic brightnesses to a scala that is easier to work with
+				brightness[i] /= medianBrightness;
+				// the exponentiation helps to emphasize very bright stars
+				brightness[i] = std::pow(Clamp(brightness[i], 0.0f, 4.0f), m_sf.m_brightnessPower);
+
+				sizes[i] = std::max(m_sf.m_brightnessApparentSizeFactor * (brightness[i] + m_sf.m_brightnessApparentSizeOffset), 0.0f);
+
+				float colorFactor = std::max(m_sf.m_brightnessColorFactor * (brightness[i] + m_sf.m_brightnessColorOffset), 0.0f);
+				// convert temporarily to floats to prevent narrowing errors
+				float colorR = colors[i].r;
+				float colorG = colors[i].g;
+				float colorB = colors[i].b;
+
+				// find a color scaling factor that doesn't make a colored star look white
+				float colorMax = std::max({ colorR, colorG, colorB });
+				float scaledColorMax = colorMax * colorFactor;
+				colorFactor = std::min(scaledColorMax, 255.0f) / colorMax;
+
+				colorR *= colorFactor;
+				colorG *= colorFactor;
+				colorB *= colorFactor;
+				colors[i].r = Clamp<int>(colorR, 0, 255);
+				colors[i].g = Clamp<int>(colorG, 0, 255);
+				colors[i].b = Clamp<int>(colorB, 0, 255);
+			}
+			return out;
+		}
+
+		Starfield *m_starfield;
+		// copy of the starfield parameters, so the worker never reads the live object
+		struct Params {
+			Params(const Starfield &sf) :
+				m_rMin(sf.m_rMin),
+				m_rMax(sf.m_rMax),
+				m_gMin(sf.m_gMin),
+				m_gMax(sf.m_gMax),
+				m_bMin(sf.m_bMin),
+				m_bMax(sf.m_bMax),
+				m_medianPosition(sf.m_medianPosition),
+				m_brightnessPower(sf.m_brightnessPower),
+				m_brightnessApparentSizeOffset(sf.m_brightnessApparentSizeOffset),
+				m_brightnessApparentSizeFactor(sf.m_brightnessApparentSizeFactor),
+				m_brightnessColorFactor(sf.m_brightnessColorFactor),
+				m_brightnessColorOffset(sf.m_brightnessColorOffset),
+				m_origin(sf.m_origin),
+				m_visibleRadius(sf.m_visibleRadius),
+				m_numStars(sf.m_numStars),
+				m_seed(sf.m_seed)
+			{}
+			float m_rMin, m_rMax, m_gMin, m_gMax, m_bMin, m_bMax;
+			float m_medianPosition;
+			float m_brightnessPower;
+			float m_brightnessApparentSizeOffset;
+			float m_brightnessApparentSizeFactor;
+			float m_brightnessColorFactor;
+			float m_brightnessColorOffset;
+			SystemPath m_origin;
+			Sint32 m_visibleRadius;
+			Uint32 m_numStars;
+			Uint32 m_seed;
+		} m_sf;
+		std::vector<SectorStarsPtr> m_sectors;
+		GalaxyStarsPtr m_galaxyStars;
+		bool m_builtGalaxyStars;
+		Uint32 m_numGalaxyStars;
+
+		std::unique_ptr<vector3f[]> m_stars;
+		std::unique_ptr<Color[]> m_colors;
+		std::unique_ptr<float[]> m_sizes;
+		std::unique_ptr<vector3f[]> m_hyperVtx;
+		std::unique_ptr<Color[]> m_hyperCol;
+	};
+
+	Starfield::Starfield(Graphics::Renderer *renderer, Random &rand, const Space *space, RefCountedPtr<Galaxy> galaxy) :
+		m_jobs(Pi::GetAsyncJobQueue()),
+		m_visibleRadius(0),
+		m_numStars(0),
+		m_seed(0),
+		m_pendingExtractJobs(0),
+		m_ready(false)
 	{
 		m_renderer = renderer;
 		Init();
@@ -237,9 +561,16 @@ namespace Background {
 	void Starfield::Fill(Random &rand, const Space *space, RefCountedPtr<Galaxy> galaxy)
 	{
 		PROFILE_SCOPED()
-		const Uint32 NUM_BG_STARS = MathUtil::mix(BG_STAR_MIN, BG_STAR_MAX, Pi::GetAmountBackgroundStars());
-		m_hyperVtx.reset(new vector3f[BG_STAR_MAX * 3]);
-		m_hyperCol.reset(new Color[BG_STAR_MAX * 3]);
+		// drop whatever an earlier fill still had in flight
+		m_jobs = JobSet(Pi::GetAsyncJobQueue());
+		m_sectorCache.Reset();
+		m_sectorPaths.clear();
+		m_sectorStars.clear();
+		m_pendingExtractJobs = 0;
+		m_ready = false;
+
+		m_numStars = MathUtil::mix(BG_STAR_MIN, BG_STAR_MAX, Pi::GetAmountBackgroundStars());
+		m_seed = rand.Int32();
 
 		// setup the animated stars buffer (streaks in Hyperspace)
 		{
@@ -249,173 +580,120 @@ namespace Background {
 			vbd.attrib[1].semantic = Graphics::ATTRIB_DIFFUSE;
 			vbd.attrib[1].format = Graphics::ATTRIB_FORMAT_UBYTE4;
 			vbd.usage = Graphics::BUFFER_USAGE_DYNAMIC;
-			vbd.numVertices = NUM_BG_STARS * 2;
+			vbd.numVertices = m_numStars * 2;
 			m_animBuffer.reset(m_renderer->CreateVertexBuffer(vbd));
 		}
 
 		m_pointSprites.reset(new Graphics::Drawables::PointSprites);
 
-		assert(sizeof(StarVert) == 16);
-		std::unique_ptr<vector3f[]> stars(new vector3f[NUM_BG_STARS]);
-		std::unique_ptr<Color[]> colors(new Color[NUM_BG_STARS]);
-		std::unique_ptr<float[]> sizes(new float[NUM_BG_STARS]);
-		std::unique_ptr<float[]> brightness(new float[NUM_BG_STARS]);
-		//fill the array
-		Uint32 num = 0;
-		if (space != nullptr && galaxy.Valid() && space->GetStarSystem() != nullptr) {
-			PROFILE_SCOPED_DESC("Pick Stars from Galaxy")
-			const SystemPath current = space->GetStarSystem()->GetPath();
+		Graphics::RenderStateDesc rsd;
+		rsd.depthTest = false;
+		rsd.depthWrite = false;
+		rsd.blendMode = Graphics::BLEND_ALPHA;
+		m_renderState = m_renderer->CreateRenderState(rsd);
 
-			const double size = 1.0;
-			const Sint32 visibleRadius = MathUtil::mix(BG_STAR_RADIUS_MIN, Clamp(m_visibleRadiusLy, BG_STAR_RADIUS_MIN, BG_STAR_RADIUS_MAX), Pi::GetAmountBackgroundStars()); // lyrs
-			const Sint32 visibleRadiusSqr = (visibleRadius * visibleRadius);
-			const Sint32 sectorMin = -(visibleRadius / Sector::SIZE); // lyrs_radius / sector_size_in_lyrs
-			const Sint32 sectorMax = visibleRadius / Sector::SIZE;	  // lyrs_radius / sector_size_in_lyrs
-			for (Sint32 x = sectorMin; x < sectorMax; x++) {
-				for (Sint32 y = sectorMin; y < sectorMax; y++) {
-					for (Sint32 z = sectorMin; z < sectorMax; z++) {
-						SystemPath sys(current.sectorX + x, current.sectorY + y, current.sectorZ + z);
-						if (SystemPath::SectorDistanceSqr(sys, current) * Sector::SIZE >= visibleRadiusSqr)
-							continue; // early out
-
-						// this is fairly expensive
-						RefCountedPtr<const Sector> sec = galaxy->GetSector(sys);
-
-						// add as many systems as we can
-						const size_t numSystems = std::min(sec->m_systems.size(), (size_t)(NUM_BG_STARS - num));
-						for (size_t systemIndex = 0; systemIndex < numSystems; systemIndex++) {
-							const Sector::System *ss = &(sec->m_systems[systemIndex]);
-							const vector3f distance = Sector::SIZE * vector3f(current.sectorX, current.sectorY, current.sectorZ) - ss->GetFullPosition();
-							if (distance.LengthSqr() >= visibleRadiusSqr)
-								continue; // too far
-
-							// add the colors and luminosities of all stars in a system together
-							float luminositySystemSum = 0.0f;
-							vector3f colorSystemSum(0.0f, 0.0f, 0.0f);
-							for (size_t i = 0; i < ss->GetNumStars(); ++i) {
-								luminositySystemSum += StarSystem::starLuminosities[ss->GetStarType(i)];
-								Color col = StarSystem::starRealColors[ss->GetStarType(i)];
-								colorSystemSum += vector3f(col.r, col.g, col.b) * luminositySystemSum;
-							}
-							colorSystemSum /= luminositySystemSum;
-
-							Color col(colorSystemSum.x, colorSystemSum.y, colorSystemSum.z);
-							col.r = Clamp(col.r, (Uint8)(m_rMin * 255), (Uint8)(m_rMax * 255));
-							col.g = Clamp(col.g, (Uint8)(m_gMin * 255), (Uint8)(m_gMax * 255));
-							col.b = Clamp(col.b, (Uint8)(m_bMin * 255), (Uint8)(m_bMax * 255));
-							//const Color col(Color::PINK); // debug pink
-
-							// copy the data
-							sizes[num] = size;
-							stars[num] = distance.Normalized() * 1000.0f;
-							colors[num] = col;
-							brightness[num] = luminositySystemSum / (4 * M_PI * distance.Length() * distance.Length());
-
-							//need to keep data around for HS anim - this is stupid
-							m_hyperVtx[NUM_BG_STARS * 2 + num] = stars[num];
-							m_hyperCol[NUM_BG_STARS * 2 + num] = col * 0.8f;
-							num++;
-						}
-						if (num >= NUM_BG_STARS) {
-							x = sectorMax;
-							y = sectorMax;
-							z = sectorMax;
-							break;
-						}
-					}
-				}
-			}
-		}
-		Output("Stars picked from galaxy: %d\n", num);
-		// use a logarithmic scala for brightness since this looks more natural to the human eye
-		for (uint32_t i = 0; i < num; ++i) {
-			brightness[i] = log(brightness[i]);
+		if (space == nullptr || !galaxy.Valid() || space->GetStarSystem() == nullptr) {
+			OrderBuild();
+			return;
 		}
 
-		// find the median brightness of all visible stars
-		std::vector<int> sortedBrightnessIndex;
-		for (Uint32 i = 0; i < num; ++i) {
-			sortedBrightnessIndex.push_back(i);
-		}
-		std::sort(sortedBrightnessIndex.begin(), sortedBrightnessIndex.end(), [&](const int a, const int b) {
-			return brightness[a] > brightness[b];
-		});
-		double medianBrightness = 0.0;
-		if (num > 0) {
-			medianBrightness = brightness[sortedBrightnessIndex[Clamp<int>(m_medianPosition * num, 0, num - 1)]];
-		}
+		const SystemPath current = space->GetStarSystem()->GetPath();
+		m_origin = current.SectorOnly();
+		m_visibleRadius = MathUtil::mix(BG_STAR_RADIUS_MIN, Clamp(m_visibleRadiusLy, BG_STAR_RADIUS_MIN, BG_STAR_RADIUS_MAX), Pi::GetAmountBackgroundStars()); // lyrs
 
-		for (size_t j = 0; j < num; ++j) {
-			size_t i = sortedBrightnessIndex[j]; // just for debugging purposes
-
-			// dividing through the median helps bringing the logarithmic brightnesses to a scala that is easier to work with
-			brightness[i] /= medianBrightness;
-			// the exponentiation helps to emphasize very bright stars
-			brightness[i] = std::pow(Clamp(brightness[i], 0.0f, 4.0f), m_brightnessPower);
-
-			sizes[i] = std::max(m_brightnessApparentSizeFactor * (brightness[i] + m_brightnessApparentSizeOffset), 0.0f);
-
-			float colorFactor = std::max(m_brightnessColorFactor * (brightness[i] + m_brightnessColorOffset), 0.0f);
-			// convert temporarily to floats to prevent narrowing errors
-			float colorR = colors[i].r;
-			float colorG = colors[i].g;
-			float colorB = colors[i].b;
-
-			// find a color scaling factor that doesn't make a colored star look white
-			float colorMax = std::max({ colorR, colorG, colorB });
-			float scaledColorMax = colorMax * colorFactor;
-			colorFactor = std::min(scaledColorMax, 255.0f) / colorMax;
-
-			colorR *= colorFactor;
-			colorG *= colorFactor;
-			colorB *= colorFactor;
-			colors[i].r = Clamp<int>(colorR, 0, 255);
-			colors[i].g = Clamp<int>(colorG, 0, 255);
-			colors[i].b = Clamp<int>(colorB, 0, 255);
+		if (FindOriginCache(m_origin, m_numStars, m_visibleRadius)) {
+			OrderBuild();
+			return;
 		}
 
-		// fill out the remaining target count with generated points
-		if (num < NUM_BG_STARS) {
-			for (Uint32 i = num; i < NUM_BG_STARS; i++) {
-				const double size = rand.Double(0.2, 0.9);
-				const Uint8 colScale = size * 255;
-
-				const Color col(
-					rand.Double(m_rMin, m_rMax) * colScale,
-					rand.Double(m_gMin, m_gMax) * colScale,
-					rand.Double(m_bMin, m_bMax) * colScale,
-					255);
+		const Sint32 visibleRadiusSqr = (m_visibleRadius * m_visibleRadius);
+		const Sint32 sectorMin = -(m_visibleRadius / Sector::SIZE); // lyrs_radius / sector_size_in_lyrs
+		const Sint32 sectorMax = m_visibleRadius / Sector::SIZE;	   // lyrs_radius / sector_size_in_lyrs
+		SectorCache::PathVector missing;
+		for (Sint32 x = sectorMin; x < sectorMax; x++) {
+			for (Sint32 y = sectorMin; y < sectorMax; y++) {
+				for (Sint32 z = sectorMin; z < sectorMax; z++) {
+					SystemPath sys(current.sectorX + x, current.sectorY + y, current.sectorZ + z);
+					if (SystemPath::SectorDistanceSqr(sys, current) * Sector::SIZE >= visibleRadiusSqr)
+						continue; // early out
+
+					// hold on to what's there already, another starfield's
+					// OrderBuild may forget it before this one gets to build
+					auto it = s_sectorStars.find(sys);
+					m_sectorPaths.push_back(sys);
+					m_sectorStars.push_back(it != s_sectorStars.end() ? it->second : SectorStarsPtr());
+					if (!m_sectorStars.back())
+						missing.push_back(sys);
+				}
+			}
+		}
 
-				// this is proper random distribution on a sphere's surface
-				const float theta = float(rand.Double(0.0, 2.0 * M_PI));
-				const float u = float(rand.Double(-1.0, 1.0));
+		// generating the sectors is fairly expensive, so it's done by the cache's
+		// jobs and anything already in the galaxy's cache is simply picked up
+		m_sectorCache = galaxy->NewSectorSlaveCache();
+		m_sectorCache->FillCache(missing, [this]() { OnSectorsCached(); });
+	}
 
-				sizes[i] = size;
-				// squeeze the starfield a bit to get more density near horizon using matrix3x3f::Scale
-				stars[i] = matrix3x3f::Scale(1.0, 0.4, 1.0) * (vector3f(sqrt(1.0f - u * u) * cos(theta), u, sqrt(1.0f - u * u) * sin(theta)).Normalized() * 1000.0f);
-				colors[i] = col;
+	void Starfield::OnSectorsCached()
+	{
+		PROFILE_SCOPED()
+		std::vector<RefCountedPtr<Sector>> batch;
+		std::vector<size_t> slots;
+		for (size_t i = 0; i < m_sectorPaths.size(); i++) {
+			if (m_sectorStars[i])
+				continue;
+			// the slave cache holds on to everything it was asked to fill
+			RefCountedPtr<Sector> sec = m_sectorCache->GetIfCached(m_sectorPaths[i]);
+			assert(sec);
+			batch.push_back(sec);
+			slots.push_back(i);
+			if (batch.size() >= SECTORS_PER_EXTRACT_JOB) {
+				++m_pendingExtractJobs;
+				m_jobs.Order(new ExtractJob(this, std::move(batch), std::move(slots)));
+				batch.clear();
+				slots.clear();
+			}
+		}
+		if (!batch.empty()) {
+			++m_pendingExtractJobs;
+			m_jobs.Order(new ExtractJob(this, std::move(batch), std::move(slots)));
+		}
 
-				//need to keep data around for HS anim - this is stupid
-				m_hyperVtx[NUM_BG_STARS * 2 + i] = stars[i];
-				m_hyperCol[NUM_BG_STARS * 2 + i] = col;
+		if (!m_pendingExtractJobs)
+			OrderBuild();
+	}
 
-				num++;
+	void Starfield::OrderBuild()
+	{
+		PROFILE_SCOPED()
+		GalaxyStarsPtr galaxyStars = FindOriginCache(m_origin, m_numStars, m_visibleRadius);
+		std::vector<SectorStarsPtr> sectors;
+		if (!galaxyStars)
+			sectors = m_sectorStars;
+		m_sectorStars.clear();
+
+		// forget the sectors that are too far away to be useful for nearby jumps
+		if (!m_sectorPaths.empty()) {
+			const Sint32 keep = 2 * (m_visibleRadius / Sector::SIZE + 1);
+			for (auto it = s_sectorStars.begin(); it != s_sectorStars.end();) {
+				if (std::abs(it->first.sectorX - m_origin.sectorX) > keep ||
+					std::abs(it->first.sectorY - m_origin.sectorY) > keep ||
+					std::abs(it->first.sectorZ - m_origin.sectorZ) > keep)
+					it = s_sectorStars.erase(it);
+				else
+					++it;
 			}
 		}
-		Output("Final stars number: %d\n", num);
-
-		m_pointSprites->SetData(NUM_BG_STARS, stars.get(), colors.get(), sizes.get(), m_material.Get());
 
-		Graphics::RenderStateDesc rsd;
-		rsd.depthTest = false;
-		rsd.depthWrite = false;
-		rsd.blendMode = Graphics::BLEND_ALPHA;
-		m_renderState = m_renderer->CreateRenderState(rsd);
+		m_jobs.Order(new BuildJob(this, std::move(sectors), galaxyStars));
 	}
 
 	void Starfield::Draw(Graphics::RenderState *rs)
 	{
 		PROFILE_SCOPED()
+		if (!m_ready)
+			return;
+
 		// XXX would be nice to get rid of the Pi:: stuff here
 		if (!Pi::game || Pi::player->GetFlightState() != Ship::HYPERSPACE) {
 			m_pointSprites->Draw(m_renderer, m_renderState);
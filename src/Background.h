@@ -4,6 +4,9 @@
 #ifndef _BACKGROUND_H
 #define _BACKGROUND_H
 
+#include "JobQueue.h"
+#include "galaxy/GalaxyCache.h"
+#include "galaxy/SystemPath.h"
 #include "graphics/Drawables.h"
 
 class Random;
@@ -57,23 +60,30 @@ namespace Background {
 		Uint32 m_numCubemaps;
 	};
 
+	struct SectorStars;
+
 	class Starfield : public BackgroundElement {
 	public:
 		//does not Fill the starfield
 		Starfield(Graphics::Renderer *r, Random &rand, const Space *space, RefCountedPtr<Galaxy> galaxy);
 		void Draw(Graphics::RenderState *);
-		//create or recreate the starfield
+		//create or recreate the starfield, the stars appear once the jobs building them have finished
 		void Fill(Random &rand, const Space *space, RefCountedPtr<Galaxy> galaxy);
 
 	private:
+		class ExtractJob;
+		class BuildJob;
+
 		void Init();
+		void OnSectorsCached();
+		void OrderBuild();
 
 		std::unique_ptr<Graphics::Drawables::PointSprites> m_pointSprites;
 		Graphics::RenderState *m_renderState; // NB: we don't own RenderState pointers, just borrow them
 
 		//hyperspace animation vertex data
-		std::unique_ptr<vector3f[]> m_hyperVtx; // BG_STAR_MAX * 3
-		std::unique_ptr<Color[]> m_hyperCol;	// BG_STAR_MAX * 3
+		std::unique_ptr<vector3f[]> m_hyperVtx; // numStars * 3
+		std::unique_ptr<Color[]> m_hyperCol;	// numStars * 3
 		std::unique_ptr<Graphics::VertexBuffer> m_animBuffer;
 
 		float m_visibleRadiusLy;
@@ -83,6 +93,18 @@ namespace Background {
 		float m_brightnessApparentSizeFactor;
 		float m_brightnessColorFactor;
 		float m_brightnessColorOffset;
+
+		// state of the fill in progress
+		JobSet m_jobs;
+		RefCountedPtr<SectorCache::Slave> m_sectorCache;
+		std::vector<SystemPath> m_sectorPaths; // sectors to pick stars from, in order
+		std::vector<std::shared_ptr<const SectorStars>> m_sectorStars; // their stars, once extracted
+		SystemPath m_origin;
+		Sint32 m_visibleRadius;
+		Uint32 m_numStars;
+		Uint32 m_seed;
+		Uint32 m_pendingExtractJobs;
+		bool m_ready;
 	};
 
 	class MilkyWay : public BackgroundElement {
@@ -11,6 +11,7 @@
 #include "Planet.h"
 #include "Player.h"
 #include "Projectile.h"
+#include "StateSerializer.h"
 #include "Ship.h"
 #include "Space.h"
 #include "SpaceStation.h"
@@ -40,18 +41,31 @@ Body::Body(const Json &jsonObj, Space *space) :
 	m_frame(FrameId::Invalid)
 {
 	try {
-		Json bodyObj = jsonObj["body"];
+		const Json &bodyObj = jsonObj["body"];
 
 		Properties().LoadFromJson(bodyObj);
-		m_frame = bodyObj["index_for_frame"];
-		m_label = bodyObj["label"].get<std::string>();
-		Properties().Set("label", m_label);
-		m_dead = bodyObj["dead"];
 
-		m_pos = bodyObj["pos"];
-		m_orient = bodyObj["orient"];
-		m_physRadius = bodyObj["phys_radius"];
-		m_clipRadius = bodyObj["clip_radius"];
+		if (StateSerializer::Reader *in = space ? space->GetStateReader() : nullptr) {
+			in->BeginSection("Body");
+			m_frame = in->Int32();
+			m_label = in->String();
+			m_dead = in->Bool();
+			m_pos = in->Vector();
+			m_orient = in->Matrix();
+			m_physRadius = in->Double();
+			m_clipRadius = in->Double();
+			in->EndSection();
+		} else {
+			m_frame = bodyObj["index_for_frame"];
+			m_label = bodyObj["label"].get<std::string>();
+			m_dead = bodyObj["dead"];
+
+			m_pos = bodyObj["pos"];
+			m_orient = bodyObj["orient"];
+			m_physRadius = bodyObj["phys_radius"];
+			m_clipRadius = bodyObj["clip_radius"];
+		}
+		Properties().Set("label", m_label);
 	} catch (Json::type_error &) {
 		throw SavedGameCorruptException();
 	}
@@ -66,14 +80,27 @@ void Body::SaveToJson(Json &jsonObj, Space *space)
 	Json bodyObj = Json::object(); // Create JSON object to contain body data.
 
 	Properties().SaveToJson(bodyObj);
-	bodyObj["index_for_frame"] = m_frame.id();
-	bodyObj["label"] = m_label;
-	bodyObj["dead"] = m_dead;
-
-	bodyObj["pos"] = m_pos;
-	bodyObj["orient"] = m_orient;
-	bodyObj["phys_radius"] = m_physRadius;
-	bodyObj["clip_radius"] = m_clipRadius;
+
+	if (StateSerializer::Writer *out = space ? space->GetStateWriter() : nullptr) {
+		out->BeginSection("Body");
+		out->Int32(m_frame.id());
+		out->String(m_label);
+		out->Bool(m_dead);
+		out->Vector(m_pos);
+		out->Matrix(m_orient);
+		out->Double(m_physRadius);
+		out->Double(m_clipRadius);
+		out->EndSection();
+	} else {
+		bodyObj["index_for_frame"] = m_frame.id();
+		bodyObj["label"] = m_label;
+		bodyObj["dead"] = m_dead;
+
+		bodyObj["pos"] = m_pos;
+		bodyObj["orient"] = m_orient;
+		bodyObj["phys_radius"] = m_physRadius;
+		bodyObj["clip_radius"] = m_clipRadius;
+	}
 
 	jsonObj["body"] = bodyObj; // Add body object to supplied object.
 }
@@ -6,13 +6,19 @@
 #include "Body.h"
 #include "Frame.h"
 #include "Game.h"
+#include "JobQueue.h"
+#include "ModelBody.h"
 #include "Pi.h"
 #include "Planet.h"
 #include "Player.h"
 #include "Sfx.h"
 #include "Space.h"
+#include "core/OS.h"
 #include "galaxy/StarSystem.h"
 #include "graphics/TextureBuilder.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
 
 using namespace Graphics;
 
@@ -22,6 +28,11 @@ static const float OBJECT_HIDDEN_PIXEL_THRESHOLD = 2.0f;
 // if a terrain object would render smaller than this many pixels, draw a billboard instead
 static const float BILLBOARD_PIXEL_THRESHOLD = 8.0f;
 
+// bodies are evaluated in chunks of this many. with enough of them the
+// chunks are shared between the main thread and the workers
+static const size_t EVALUATE_CHUNK_SIZE = 256;
+static const size_t PARALLEL_EVALUATE_THRESHOLD = 1024;
+
 CameraContext::CameraContext(float width, float height, float fovAng, float zNear, float zFar) :
 	m_width(width),
 	m_height(height),
@@ -76,27 +87,53 @@ void CameraContext::ApplyDrawTransforms(Graphics::Renderer *r)
 	r->SetTransform(matrix4x4f::Identity());
 }
 
-bool Camera::BodyAttrs::sort_BodyAttrs(const BodyAttrs &a, const BodyAttrs &b)
-{
-	// both drawing last; distance order
-	if (a.bodyFlags & Body::FLAG_DRAW_LAST && b.bodyFlags & Body::FLAG_DRAW_LAST)
-		return a.camDist > b.camDist;
-
-	// a drawing last; draw b first
-	if (a.bodyFlags & Body::FLAG_DRAW_LAST)
-		return false;
+// chunks are handed out to whoever asks first, so the main thread never waits
+// for a job that is stuck behind others in the queue. a job that starts after
+// all the chunks are taken does nothing
+class Camera::EvaluateJob : public Job {
+public:
+	struct Work {
+		Work(Camera *_camera, size_t _numBodies) :
+			camera(_camera),
+			numBodies(_numBodies),
+			numChunks((_numBodies + EVALUATE_CHUNK_SIZE - 1) / EVALUATE_CHUNK_SIZE),
+			nextChunk(0),
+			doneChunks(0) {}
+
+		Camera *camera;
+		size_t numBodies;
+		size_t numChunks;
+		std::atomic<size_t> nextChunk;
+		std::atomic<size_t> doneChunks;
+	};
+
+	EvaluateJob(const std::shared_ptr<Work> &work) :
+		m_work(work) {}
+
+	static void RunChunks(Work &work)
+	{
+		for (;;) {
+			const size_t chunk = work.nextChunk++;
+			if (chunk >= work.numChunks)
+				return;
+			const size_t begin = chunk * EVALUATE_CHUNK_SIZE;
+			work.camera->EvaluateBodies(begin, std::min(begin + EVALUATE_CHUNK_SIZE, work.numBodies));
+			++work.doneChunks;
+		}
+	}
 
-	// b drawing last; draw a first
-	if (b.bodyFlags & Body::FLAG_DRAW_LAST)
-		return true;
+	virtual void OnRun() override { RunChunks(*m_work); } // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+	virtual void OnFinish() override {}
 
-	// both in normal draw; distance order
-	return a.camDist > b.camDist;
-}
+private:
+	std::shared_ptr<Work> m_work;
+};
 
 Camera::Camera(RefCountedPtr<CameraContext> context, Graphics::Renderer *renderer) :
 	m_context(context),
-	m_renderer(renderer)
+	m_renderer(renderer),
+	m_updateStamp(0),
+	m_numInstanceGroups(0)
 {
 	Graphics::MaterialDescriptor desc;
 	desc.effect = Graphics::EFFECT_BILLBOARD;
@@ -132,31 +169,42 @@ static void position_system_lights(Frame *camFrame, Frame *frame, std::vector<Ca
 	}
 }
 
-void Camera::Update()
+const matrix4x4d &Camera::GetFrameTransform(FrameId frameId)
 {
-	FrameId camFrame = m_context->GetTempFrame();
+	const size_t id = frameId.id();
+	if (id >= m_frameTransforms.size()) {
+		m_frameTransforms.resize(id + 1);
+		m_frameTransformStamps.resize(id + 1, 0);
+	}
 
-	// evaluate each body and determine if/where/how to draw it
-	m_sortedBodies.clear();
-	for (Body *b : Pi::game->GetSpace()->GetBodies()) {
-		BodyAttrs attrs;
-		attrs.body = b;
-		attrs.billboard = false; // false by default
+	matrix4x4d &transform = m_frameTransforms[id];
+	if (m_frameTransformStamps[id] != m_updateStamp) {
+		//		Frame::GetFrameTransform(frameId, camFrame, transform);		// doesn't use interp coords, so breaks in some cases
+		const FrameId camFrame = m_context->GetTempFrame();
+		const Frame *f = Frame::GetFrame(frameId);
+		transform = f->GetInterpOrientRelTo(camFrame);
+		transform.SetTranslate(f->GetInterpPositionRelTo(camFrame));
+		m_frameTransformStamps[id] = m_updateStamp;
+	}
+	return transform;
+}
 
-		// If the body wishes to be excluded from the draw, skip it.
-		if (b->GetFlags() & Body::FLAG_DRAW_EXCLUDE)
-			continue;
+void Camera::EvaluateBodies(size_t begin, size_t end)
+{
+	const Graphics::Frustum &frustum = m_context->GetFrustum();
 
-		// determine position and transform for draw
-		//		Frame::GetFrameTransform(b->GetFrame(), camFrame, attrs.viewTransform);		// doesn't use interp coords, so breaks in some cases
-		Frame *f = Frame::GetFrame(b->GetFrame());
-		attrs.viewTransform = f->GetInterpOrientRelTo(camFrame);
-		attrs.viewTransform.SetTranslate(f->GetInterpPositionRelTo(camFrame));
+	for (size_t i = begin; i < end; i++) {
+		BodyAttrs &attrs = m_drawList[i];
+		const Body *b = attrs.body;
+		attrs.visible = false;
+		attrs.billboard = false; // false by default
+
+		// determine position for draw, the transform is the body's frame's
 		attrs.viewCoords = attrs.viewTransform * b->GetInterpPosition();
 
 		// cull off-screen objects
 		double rad = b->GetClipRadius();
-		if (!m_context->GetFrustum().TestPointInfinite(attrs.viewCoords, rad))
+		if (!frustum.TestPointInfinite(attrs.viewCoords, rad))
 			continue;
 
 		attrs.camDist = attrs.viewCoords.Length();
@@ -172,7 +220,7 @@ void Camera::Update()
 
 				// project the position
 				vector3d pos;
-				m_context->GetFrustum().TranslatePoint(attrs.viewCoords, pos);
+				frustum.TranslatePoint(attrs.viewCoords, pos);
 				attrs.billboardPos = vector3f(pos);
 
 				// limit the minimum billboard size for planets so they're always a little visible
@@ -199,11 +247,67 @@ void Camera::Update()
 			continue;
 		}
 
-		m_sortedBodies.push_back(attrs);
+		attrs.visible = true;
+	}
+}
+
+void Camera::Update()
+{
+	PROFILE_SCOPED()
+
+	// invalidates the frame transforms from the last update
+	++m_updateStamp;
+
+	// gather the bodies to draw with the transforms of their frames. many
+	// bodies share a frame, so each transform is only worked out once
+	m_drawList.clear();
+	for (Body *b : Pi::game->GetSpace()->GetBodies()) {
+		// If the body wishes to be excluded from the draw, skip it.
+		if (b->GetFlags() & Body::FLAG_DRAW_EXCLUDE)
+			continue;
+
+		m_drawList.emplace_back();
+		BodyAttrs &attrs = m_drawList.back();
+		attrs.body = b;
+		attrs.viewTransform = GetFrameTransform(b->GetFrame());
 	}
 
-	// depth sort
-	m_sortedBodies.sort();
+	// evaluate each body and determine if/where/how to draw it
+	const size_t numBodies = m_drawList.size();
+	if (numBodies < PARALLEL_EVALUATE_THRESHOLD) {
+		EvaluateBodies(0, numBodies);
+	} else {
+		auto work = std::make_shared<EvaluateJob::Work>(this, numBodies);
+		const size_t numJobs = std::min<size_t>(work->numChunks - 1, std::max(OS::GetNumCores(), 2U) - 1);
+		std::vector<Job::Handle> jobs;
+		jobs.reserve(numJobs);
+		for (size_t i = 0; i < numJobs; i++)
+			jobs.push_back(Pi::GetAsyncJobQueue()->Queue(new EvaluateJob(work)));
+
+		EvaluateJob::RunChunks(*work);
+		// wait for the chunks the workers took. the jobs that never got to
+		// run are cancelled when their handles go
+		while (work->doneChunks < work->numChunks)
+			std::this_thread::yield();
+	}
+
+	// depth sort. bodies drawing last go after the others, and each group is
+	// drawn furthest first. the distance is positive, so its bits sort like
+	// an unsigned integer
+	m_drawOrder.clear();
+	for (Uint32 i = 0; i < numBodies; i++) {
+		const BodyAttrs &attrs = m_drawList[i];
+		if (!attrs.visible)
+			continue;
+
+		Uint64 distBits;
+		memcpy(&distBits, &attrs.camDist, sizeof(distBits));
+		Uint64 key = 0x7fffffffffffffffULL - (distBits & 0x7fffffffffffffffULL);
+		if (attrs.bodyFlags & Body::FLAG_DRAW_LAST)
+			key |= 0x8000000000000000ULL;
+		m_drawOrder.push_back({ key, i });
+	}
+	std::sort(m_drawOrder.begin(), m_drawOrder.end());
 }
 
 void Camera::Draw(const Body *excludeBody)
@@ -274,8 +378,12 @@ void Camera::Draw(const Body *excludeBody)
 		m_renderer->SetLights(rendererLights.size(), &rendererLights[0]);
 	}
 
-	for (std::list<BodyAttrs>::iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
-		BodyAttrs *attrs = &(*i);
+	// solid geometry doesn't depend on draw order, so it goes first, sorted
+	// by state. the bodies only draw their transparent parts below
+	DrawSolidModels(excludeBody);
+
+	for (const DrawKey &drawKey : m_drawOrder) {
+		const BodyAttrs *attrs = &m_drawList[drawKey.index];
 
 		// explicitly exclude a single body if specified (eg player)
 		if (attrs->body == excludeBody)
@@ -290,9 +398,90 @@ void Camera::Draw(const Body *excludeBody)
 			attrs->body->Render(m_renderer, this, attrs->viewCoords, attrs->viewTransform);
 	}
 
+	// leave the bodies drawing whole models outside of the camera
+	for (size_t i = 0; i < m_numInstanceGroups; i++) {
+		for (ModelBody *body : m_instanceGroups[i].bodies)
+			body->SetSolidRendered(false);
+	}
+
 	SfxManager::RenderAll(m_renderer, rootFrameId, camFrameId);
 }
 
+static bool SameLighting(const std::vector<Graphics::Light> &a, const std::vector<Graphics::Light> &b)
+{
+	if (a.size() != b.size())
+		return false;
+	// the lights only differ in how much each body's eclipses dim them
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].GetDiffuse() != b[i].GetDiffuse() || a[i].GetSpecular() != b[i].GetSpecular())
+			return false;
+	}
+	return true;
+}
+
+void Camera::DrawSolidModels(const Body *excludeBody)
+{
+	PROFILE_SCOPED()
+
+	m_numInstanceGroups = 0;
+
+	std::vector<Graphics::Light> lights;
+	Color ambient;
+	for (const DrawKey &drawKey : m_drawOrder) {
+		const BodyAttrs &attrs = m_drawList[drawKey.index];
+		if (attrs.body == excludeBody || attrs.billboard || !attrs.body->IsType(ObjectType::MODELBODY))
+			continue;
+
+		ModelBody *body = static_cast<ModelBody *>(attrs.body);
+		if (!body->CanRenderInstanced())
+			continue;
+
+		lights.clear();
+		body->CalcLights(this, lights, ambient);
+
+		InstanceGroup *group = nullptr;
+		for (size_t i = 0; i < m_numInstanceGroups; i++) {
+			InstanceGroup &g = m_instanceGroups[i];
+			if (g.ambient == ambient && SameLighting(g.lights, lights) &&
+				g.leader->GetModel()->CanRenderInstancedWith(*body->GetModel())) {
+				group = &g;
+				break;
+			}
+		}
+
+		if (!group) {
+			if (m_numInstanceGroups == m_instanceGroups.size())
+				m_instanceGroups.emplace_back();
+			group = &m_instanceGroups[m_numInstanceGroups++];
+			group->leader = body;
+			group->lights = lights;
+			group->ambient = ambient;
+			group->bodies.clear();
+			group->transforms.clear();
+			group->colors.clear();
+		}
+
+		group->bodies.push_back(body);
+		group->transforms.push_back(body->GetModelTransform(attrs.viewCoords, attrs.viewTransform));
+		group->colors.emplace_back();
+		body->GetModel()->GetInstanceColors(group->colors.back());
+	}
+
+	for (size_t i = 0; i < m_numInstanceGroups; i++) {
+		InstanceGroup &group = m_instanceGroups[i];
+		if (group.bodies.size() < MIN_INSTANCES)
+			group.leader->RecordSolid(&m_solidQueue, group.lights, group.ambient, group.transforms[0]);
+		else
+			group.leader->RenderInstancedSolid(m_renderer, this, group.lights, group.ambient, group.transforms, group.colors);
+		for (ModelBody *body : group.bodies)
+			body->SetSolidRendered(true);
+	}
+
+	m_solidQueue.Sort();
+	m_solidQueue.Submit(m_renderer);
+	m_solidQueue.Clear();
+}
+
 void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow> &shadowsOut) const
 {
 	// Set up data for eclipses. All bodies are assumed to be spheres.
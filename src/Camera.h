@@ -8,11 +8,14 @@
 #include "FrameId.h"
 #include "graphics/Frustum.h"
 #include "graphics/Light.h"
+#include "graphics/RenderQueue.h"
+#include "graphics/VertexBuffer.h"
 #include "matrix4x4.h"
 #include "vector3.h"
 
 class Body;
 class Frame;
+class ModelBody;
 
 namespace Graphics {
 	class Material;
@@ -133,23 +136,64 @@ private:
 		// body flags. DRAW_LAST is the interesting one
 		Uint32 bodyFlags;
 
+		// false if the body was culled
+		bool visible;
+
 		// if true, draw object as billboard of billboardSize at billboardPos
 		bool billboard;
 		vector3f billboardPos;
 		float billboardSize;
 		Color billboardColor;
+	};
+
+	// draw order entry. sorting the keys is a lot cheaper than moving the attrs
+	struct DrawKey {
+		Uint64 key;
+		Uint32 index;
+
+		bool operator<(const DrawKey &other) const { return key < other.key || (key == other.key && index < other.index); }
+	};
 
-		// for sorting. "should a be drawn before b?"
-		// NOTE: Add below function (thus an indirection) in order
-		// to decouple Camera from Body.h
-		static bool sort_BodyAttrs(const BodyAttrs &a, const BodyAttrs &b);
-		friend bool operator<(const BodyAttrs &a, const BodyAttrs &b)
-		{
-			return sort_BodyAttrs(a, b);
-		};
+	// fills in the attrs of m_drawList[begin, end). only reads the bodies and
+	// the frame transforms, so the list can be split between threads
+	void EvaluateBodies(size_t begin, size_t end);
+	class EvaluateJob;
+	const matrix4x4d &GetFrameTransform(FrameId frame);
+
+	std::vector<BodyAttrs> m_drawList;
+	std::vector<DrawKey> m_drawOrder;
+
+	// model bodies that look the same and are lit the same. the first one
+	// draws the solid geometry of all of them in one instanced pass
+	struct InstanceGroup {
+		ModelBody *leader;
+		std::vector<Graphics::Light> lights;
+		Color ambient;
+		std::vector<ModelBody *> bodies;
+		std::vector<matrix4x4f> transforms;
+		// each body's pattern colors
+		std::vector<Graphics::InstanceColors> colors;
 	};
 
-	std::list<BodyAttrs> m_sortedBodies;
+	// groups smaller than this are recorded into m_solidQueue instead
+	static const size_t MIN_INSTANCES = 2;
+
+	// draws the solid geometry of the model bodies that can have it drawn
+	// apart from the rest of them
+	void DrawSolidModels(const Body *excludeBody);
+
+	// reused between frames, only the first m_numInstanceGroups are valid
+	std::vector<InstanceGroup> m_instanceGroups;
+	size_t m_numInstanceGroups;
+
+	Graphics::RenderQueue m_solidQueue;
+
+	// frame to camera transforms, computed once per frame for every frame
+	// with a body in it. indexed by frame id
+	std::vector<matrix4x4d> m_frameTransforms;
+	std::vector<Uint32> m_frameTransformStamps;
+	Uint32 m_updateStamp;
+
 	std::vector<LightSource> m_lightSources;
 };
 
@@ -8,6 +8,7 @@
 #include "GameSaveError.h"
 #include "Json.h"
 #include "Planet.h"
+#include "StateSerializer.h"
 #include "Space.h"
 #include "collider/CollisionContact.h"
 #include "ship/Propulsion.h"
@@ -59,16 +60,29 @@ DynamicBody::DynamicBody(const Json &jsonObj, Space *space) :
 	m_oldAngDisplacement = vector3d(0.0);
 
 	try {
-		Json dynamicBodyObj = jsonObj["dynamic_body"];
-
-		m_force = dynamicBodyObj["force"];
-		m_torque = dynamicBodyObj["torque"];
-		m_vel = dynamicBodyObj["vel"];
-		m_angVel = dynamicBodyObj["ang_vel"];
-		m_mass = dynamicBodyObj["mass"];
-		m_massRadius = dynamicBodyObj["mass_radius"];
-		m_angInertia = dynamicBodyObj["ang_inertia"];
-		m_isMoving = dynamicBodyObj["is_moving"];
+		if (StateSerializer::Reader *in = space ? space->GetStateReader() : nullptr) {
+			in->BeginSection("DynamicBody");
+			m_force = in->Vector();
+			m_torque = in->Vector();
+			m_vel = in->Vector();
+			m_angVel = in->Vector();
+			m_mass = in->Double();
+			m_massRadius = in->Double();
+			m_angInertia = in->Double();
+			m_isMoving = in->Bool();
+			in->EndSection();
+		} else {
+			Json dynamicBodyObj = jsonObj["dynamic_body"];
+
+			m_force = dynamicBodyObj["force"];
+			m_torque = dynamicBodyObj["torque"];
+			m_vel = dynamicBodyObj["vel"];
+			m_angVel = dynamicBodyObj["ang_vel"];
+			m_mass = dynamicBodyObj["mass"];
+			m_massRadius = dynamicBodyObj["mass_radius"];
+			m_angInertia = dynamicBodyObj["ang_inertia"];
+			m_isMoving = dynamicBodyObj["is_moving"];
+		}
 	} catch (Json::type_error &) {
 		throw SavedGameCorruptException();
 	}
@@ -83,6 +97,20 @@ void DynamicBody::SaveToJson(Json &jsonObj, Space *space)
 {
 	ModelBody::SaveToJson(jsonObj, space);
 
+	if (StateSerializer::Writer *out = space ? space->GetStateWriter() : nullptr) {
+		out->BeginSection("DynamicBody");
+		out->Vector(m_force);
+		out->Vector(m_torque);
+		out->Vector(m_vel);
+		out->Vector(m_angVel);
+		out->Double(m_mass);
+		out->Double(m_massRadius);
+		out->Double(m_angInertia);
+		out->Bool(m_isMoving);
+		out->EndSection();
+		return;
+	}
+
 	Json dynamicBodyObj = Json::object(); // Create JSON object to contain dynamic body data.
 
 	dynamicBodyObj["force"] = m_force;
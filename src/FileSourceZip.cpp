@@ -125,6 +125,7 @@ namespace FileSystem {
 		const FileStat &st = (*i).second;
 
 		char *data = static_cast<char *>(std::malloc(st.size));
+		std::lock_guard<std::mutex> lock(m_archiveLock);
 		if (!mz_zip_reader_extract_to_mem(zip, st.index, data, st.size, 0)) {
 			Output("FileSourceZip::ReadFile: couldn't extract '%s'\n", path.c_str());
 			return RefCountedPtr<FileData>();
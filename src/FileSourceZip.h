@@ -7,6 +7,7 @@
 #include "FileSystem.h"
 #include <SDL_stdinc.h>
 #include <map>
+#include <mutex>
 #include <string>
 
 namespace FileSystem {
@@ -24,6 +25,9 @@ namespace FileSystem {
 
 	private:
 		void *m_archive;
+		// the archive reads through one FILE stream, so only one thread at
+		// a time can extract from it. the directory tree doesn't change
+		std::mutex m_archiveLock;
 
 		struct FileStat {
 			FileStat(Uint32 _index, Uint64 _size, const FileInfo &_info) :
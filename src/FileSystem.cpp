@@ -283,6 +283,19 @@ namespace FileSystem {
 		return RefCountedPtr<FileData>();
 	}
 
+	RefCountedPtr<FileData> FileSourceUnion::MapFile(const std::string &path)
+	{
+		for (std::vector<FileSource *>::const_iterator
+				 it = m_sources.begin();
+			 it != m_sources.end(); ++it) {
+			RefCountedPtr<FileData> data = (*it)->MapFile(path);
+			if (data) {
+				return data;
+			}
+		}
+		return RefCountedPtr<FileData>();
+	}
+
 	// Merge two sets of FileInfo's, by path.
 	// Input vectors must be sorted. Output will be sorted.
 	// Where a path is present in both inputs, directories are selected
@@ -110,6 +110,8 @@ namespace FileSystem {
 		const FileSource &GetSource() const { return *m_source; }
 
 		RefCountedPtr<FileData> Read() const;
+		// like Read, but maps the file instead where the source can
+		RefCountedPtr<FileData> Map() const;
 
 		friend bool operator==(const FileInfo &a, const FileInfo &b)
 		{
@@ -202,8 +204,14 @@ namespace FileSystem {
 
 		const std::string &GetRoot() const { return m_root; }
 
+		// these are called from worker threads (loading steps, model
+		// preloading) while the main thread reads too, so they must be
+		// safe to call concurrently
 		virtual FileInfo Lookup(const std::string &path) = 0;
 		virtual RefCountedPtr<FileData> ReadFile(const std::string &path) = 0;
+		// maps the file read-only, so pages that are never touched are never
+		// read. sources that can't map files read them instead
+		virtual RefCountedPtr<FileData> MapFile(const std::string &path) { return ReadFile(path); }
 		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output) = 0;
 
 		bool IsTrusted() const { return m_trusted; }
@@ -224,6 +232,7 @@ namespace FileSystem {
 
 		virtual FileInfo Lookup(const std::string &path);
 		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
+		virtual RefCountedPtr<FileData> MapFile(const std::string &path);
 		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
 
 		bool MakeDirectory(const std::string &path);
@@ -236,6 +245,10 @@ namespace FileSystem {
 		FILE *OpenReadStream(const std::string &path);
 		// similar to fopen(path, "wb")
 		FILE *OpenWriteStream(const std::string &path, int flags = 0);
+
+		// replaces the file at 'to', if there is one
+		bool RenameFile(const std::string &from, const std::string &to);
+		bool RemoveFile(const std::string &path);
 	};
 
 	class FileSourceUnion : public FileSource {
@@ -253,6 +266,7 @@ namespace FileSystem {
 		virtual FileInfo Lookup(const std::string &path);
 		std::vector<FileInfo> LookupAll(const std::string &path);
 		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
+		virtual RefCountedPtr<FileData> MapFile(const std::string &path);
 		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
 
 	private:
@@ -305,4 +319,9 @@ inline RefCountedPtr<FileSystem::FileData> FileSystem::FileInfo::Read() const
 	return m_source->ReadFile(m_path);
 }
 
+inline RefCountedPtr<FileSystem::FileData> FileSystem::FileInfo::Map() const
+{
+	return m_source->MapFile(m_path);
+}
+
 #endif
@@ -4,7 +4,7 @@
 #include "Frame.h"
 
 #include "GameSaveError.h"
-#include "JsonUtils.h"
+#include "StateSerializer.h"
 #include "Sfx.h"
 #include "Space.h"
 #include "collider/CollisionSpace.h"
@@ -129,33 +129,29 @@ Frame &Frame::operator=(Frame &&other)
 	return *this;
 }
 
-void Frame::ToJson(Json &frameObj, FrameId fId, Space *space)
+void Frame::ToBinary(StateSerializer::Writer &out, FrameId fId, Space *space)
 {
 	Frame *f = Frame::GetFrame(fId);
 
 	assert(f != nullptr);
 
-	frameObj["frameId"] = f->m_thisId;
-	frameObj["flags"] = f->m_flags;
-	frameObj["radius"] = f->m_radius;
-	frameObj["label"] = f->m_label;
-	frameObj["pos"] = f->m_pos;
-	frameObj["ang_speed"] = f->m_angSpeed;
-	frameObj["init_orient"] = f->m_initialOrient;
-	frameObj["index_for_system_body"] = space->GetIndexForSystemBody(f->m_sbody);
-	frameObj["index_for_astro_body"] = space->GetIndexForBody(f->m_astroBody);
-
-	Json childFrameArray = Json::array(); // Create JSON array to contain child frame data.
-	for (FrameId kid : f->GetChildren()) {
-		Json childFrameArrayEl = Json::object(); // Create JSON object to contain child frame.
-		Frame::ToJson(childFrameArrayEl, kid, space);
-		childFrameArray.push_back(childFrameArrayEl); // Append child frame object to array.
-	}
-	if (!childFrameArray.empty())
-		frameObj["child_frames"] = childFrameArray; // Add child frame array to frame object.
+	out.BeginSection("Frame");
+	out.Int32(f->m_thisId.id());
+	out.Int32(f->m_flags);
+	out.Double(f->m_radius);
+	out.String(f->m_label);
+	out.Vector(f->m_pos);
+	out.Double(f->m_angSpeed);
+	out.Matrix(f->m_initialOrient);
+	out.Int32(space->GetIndexForSystemBody(f->m_sbody));
+	out.Int32(space->GetIndexForBody(f->m_astroBody));
+
+	SfxManager::ToBinary(out, f->m_thisId);
 
-	// Add sfx array to supplied object.
-	SfxManager::ToJson(frameObj, f->m_thisId);
+	out.Int32(f->m_children.size());
+	for (FrameId kid : f->GetChildren())
+		Frame::ToBinary(out, kid, space);
+	out.EndSection();
 }
 
 Frame::~Frame()
@@ -174,7 +170,7 @@ FrameId Frame::CreateFrame(FrameId parent, const char *label, unsigned int flags
 	return (s_frames.size() - 1);
 }
 
-FrameId Frame::FromJson(const Json &frameObj, Space *space, FrameId parent, double at_time)
+FrameId Frame::FromBinary(StateSerializer::Reader &in, Space *space, FrameId parent, double at_time)
 {
 	Dummy dummy;
 	dummy.madeWithFactory = true;
@@ -189,44 +185,43 @@ FrameId Frame::FromJson(const Json &frameObj, Space *space, FrameId parent, doub
 	f->d.madeWithFactory = false;
 
 	try {
-		f->m_thisId = frameObj["frameId"];
+		in.BeginSection("Frame");
+		f->m_thisId = in.Int32();
 
 		// Check if frames order in load and save are the same
 		assert(s_frames.size() == 0 || (s_frames.size() - 1) == f->m_thisId.id());
 
-		f->m_flags = frameObj["flags"];
-		f->m_radius = frameObj["radius"];
-		f->m_label = frameObj["label"].get<std::string>();
+		f->m_flags = in.Int32();
+		f->m_radius = in.Double();
+		f->m_label = in.String();
 
-		f->m_pos = frameObj["pos"];
-		f->m_angSpeed = frameObj["ang_speed"];
-		f->SetInitialOrient(frameObj["init_orient"], at_time);
-		f->m_sbody = space->GetSystemBodyByIndex(frameObj["index_for_system_body"]);
-		f->m_astroBodyIndex = frameObj["index_for_astro_body"];
+		f->m_pos = in.Vector();
+		f->m_angSpeed = in.Double();
+		f->SetInitialOrient(in.Matrix(), at_time);
+		f->m_sbody = space->GetSystemBodyByIndex(in.Int32());
+		f->m_astroBodyIndex = in.Int32();
 		f->m_vel = vector3d(0.0); // m_vel is set to zero.
 
-		if (frameObj.count("child_frames") && frameObj["child_frames"].is_array()) {
-			Json childFrameArray = frameObj["child_frames"];
-			f->m_children.reserve(childFrameArray.size());
-			for (unsigned int i = 0; i < childFrameArray.size(); ++i) {
-				// During 'FromJson' a reallocation may happens, invalidating 'f',
-				// thus store his FrameId and renew it
-				FrameId temp = f->m_thisId;
-				FrameId kidId = FromJson(childFrameArray[i], space, f->m_thisId, at_time);
-				f = &s_frames[temp];
-				f->m_children.push_back(kidId);
-			}
-		} else {
-			f->m_children.clear();
+		SfxManager::FromBinary(in, f->m_thisId);
+
+		const Sint32 numChildren = in.Int32();
+		f->m_children.clear();
+		f->m_children.reserve(std::max(numChildren, 0));
+		for (Sint32 i = 0; i < numChildren; ++i) {
+			// During 'FromBinary' a reallocation may happens, invalidating 'f',
+			// thus store his FrameId and renew it
+			FrameId temp = f->m_thisId;
+			FrameId kidId = FromBinary(in, space, f->m_thisId, at_time);
+			f = &s_frames[temp];
+			f->m_children.push_back(kidId);
 		}
-	} catch (Json::type_error &) {
+		in.EndSection();
+	} catch (SavedGameCorruptException &) {
 		Output("Loading error in '%s'\n", typeid(f).name());
 		f->d.madeWithFactory = true;
-		throw SavedGameCorruptException();
+		throw;
 	}
 
-	SfxManager::FromJson(frameObj, f->m_thisId);
-
 	f->ClearMovement();
 	return f->GetId();
 }
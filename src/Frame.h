@@ -23,6 +23,11 @@ class Space;
 
 struct CollisionContact;
 
+namespace StateSerializer {
+	class Reader;
+	class Writer;
+} // namespace StateSerializer
+
 // Frame of reference.
 
 class Frame {
@@ -48,13 +53,13 @@ public:
 		FLAG_HAS_ROT = (1 << 2) };
 
 	static FrameId CreateFrame(FrameId parent, const char *label, unsigned int flags = FLAG_DEFAULT, double radius = 0.0);
-	static FrameId FromJson(const Json &jsonObj, Space *space, FrameId parent, double at_time);
+	static FrameId FromBinary(StateSerializer::Reader &in, Space *space, FrameId parent, double at_time);
 
 	// Used to speed up creation/deletion of Frame for camera
 	static FrameId CreateCameraFrame(FrameId parent);
 	static void DeleteCameraFrame(FrameId camera);
 
-	static void ToJson(Json &jsonObj, FrameId fId, Space *space);
+	static void ToBinary(StateSerializer::Writer &out, FrameId fId, Space *space);
 	static void PostUnserializeFixup(FrameId fId, Space *space);
 
 	static void DeleteFrames();
@@ -8,12 +8,13 @@
 #include "Body.h"
 #include "DeathView.h"
 #include "FileSystem.h"
+#include "GameConfig.h"
 #include "GameLog.h"
 #include "GameSaveError.h"
+#include "JobQueue.h"
 #include "HyperspaceCloud.h"
 #include "MathUtil.h"
 #include "collider/CollisionSpace.h"
-#include "core/GZipFormat.h"
 #include "galaxy/Economy.h"
 #include "lua/LuaEvent.h"
 #include "lua/LuaSerializer.h"
@@ -22,6 +23,8 @@
 #endif
 #include "Pi.h"
 #include "Player.h"
+#include "SaveGameFormat.h"
+#include "SaveGameWriter.h"
 #include "SectorView.h"
 #include "Sfx.h"
 #include "Space.h"
@@ -30,10 +33,70 @@
 #include "SystemView.h"
 #include "WorldView.h"
 #include "galaxy/GalaxyGenerator.h"
+#include "galaxy/SectorPrefetcher.h"
 #include "pigui/PiGuiView.h"
 #include "ship/PlayerShipController.h"
+#include <atomic>
+
+static const int s_saveVersion = 90;
+
+namespace {
+	// decodes one section of a saved game into its slot in the result
+	class DecodeSectionJob : public Job {
+	public:
+		DecodeSectionJob(const SaveGameFormat::Section &section, Json &result, std::atomic<bool> &failed) :
+			m_section(section),
+			m_result(result),
+			m_failed(failed)
+		{}
+
+		virtual void OnRun() override // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+		{
+			try {
+				m_result = SaveGameFormat::DecodeSection(m_section);
+			} catch (SavedGameCorruptException &) {
+				m_failed = true;
+			}
+		}
+		virtual void OnFinish() override {}
+		virtual void OnCancel() override { m_failed = true; }
+
+	private:
+		const SaveGameFormat::Section &m_section;
+		Json &m_result;
+		std::atomic<bool> &m_failed;
+	};
+} // namespace
+
+// decode every section of a saved game at once, rather than one after another
+static Json DecodeSectionedSave(const char *data, size_t size)
+{
+	PROFILE_SCOPED()
+	const std::vector<SaveGameFormat::Section> sections = SaveGameFormat::ReadIndex(data, size);
+	std::vector<Json> results(sections.size());
+	std::atomic<bool> failed(false);
+	{
+		JobSet jobs(Pi::GetAsyncJobQueue());
+		for (size_t i = 0; i < sections.size(); i++)
+			jobs.Order(new DecodeSectionJob(sections[i], results[i], failed));
+		while (!jobs.IsEmpty()) {
+			if (!Pi::GetAsyncJobQueue()->FinishJobs())
+				SDL_Delay(1);
+		}
+	}
+	if (failed)
+		throw SavedGameCorruptException();
 
-static const int s_saveVersion = 87;
+	Json rootNode = Json::object();
+	for (size_t i = 0; i < sections.size(); i++)
+		rootNode[sections[i].name] = std::move(results[i]);
+	return rootNode;
+}
+
+static size_t GetGalaxyCacheBudget()
+{
+	return size_t(std::max(Pi::config->Int("GalaxyCacheMemoryMB"), 0)) * 1024 * 1024;
+}
 
 Game::Game(const SystemPath &path, const double startDateTime) :
 	m_galaxy(GalaxyGenerator::Create()),
@@ -63,6 +126,7 @@ Game::Game(const SystemPath &path, const double startDateTime) :
 		throw InvalidGameStartLocation(std::string(buf));
 	}
 
+	m_sectorPrefetcher.reset(new SectorPrefetcher(m_galaxy, GetGalaxyCacheBudget()));
 	m_space.reset(new Space(this, m_galaxy, path));
 
 	Body *b = m_space->FindBodyForPath(&path);
@@ -84,6 +148,8 @@ Game::Game(const SystemPath &path, const double startDateTime) :
 
 	CreateViews();
 
+	UpdateSectorPrefetch();
+
 	EmitPauseState(IsPaused());
 
 	Pi::GetApp()->RequestProfileFrame("NewGame");
@@ -151,6 +217,7 @@ Game::Game(const Json &jsonObj) :
 		m_hyperspaceEndTime = jsonObj["hyperspace_end_time"];
 
 		// space, all the bodies and things
+		m_sectorPrefetcher.reset(new SectorPrefetcher(m_galaxy, GetGalaxyCacheBudget()));
 		m_space.reset(new Space(this, m_galaxy, jsonObj, m_time));
 
 		unsigned int player = jsonObj["player"];
@@ -159,7 +226,8 @@ Game::Game(const Json &jsonObj) :
 		assert(!m_player->IsDead()); // Pioneer does not support necromancy
 
 		// hyperspace clouds being brought over from the previous system
-		Json hyperspaceCloudArray = jsonObj["hyperspace_clouds"].get<Json::array_t>();
+		const Json &hyperspaceCloudArray = jsonObj["hyperspace_clouds"];
+		if (!hyperspaceCloudArray.is_array()) throw SavedGameCorruptException();
 		for (Uint32 i = 0; i < hyperspaceCloudArray.size(); i++) {
 			m_hyperspaceClouds.push_back(static_cast<HyperspaceCloud *>(Body::FromJson(hyperspaceCloudArray[i], 0)));
 		}
@@ -170,6 +238,8 @@ Game::Game(const Json &jsonObj) :
 	// views
 	LoadViewsFromJson(jsonObj);
 
+	UpdateSectorPrefetch();
+
 	// lua
 	Pi::luaSerializer->FromJson(jsonObj);
 
@@ -300,6 +370,8 @@ void Game::TimeStep(float step)
 		SwitchToHyperspace();
 		return;
 	}
+
+	UpdateSectorPrefetch();
 }
 
 bool Game::UpdateTimeAccel()
@@ -454,7 +526,8 @@ void Game::SwitchToHyperspace()
 
 	// create hyperspace :)
 	m_space.reset(); // HACK: Here because next line will create Frames *before* deleting existing ones
-	m_space.reset(new Space(this, m_galaxy, m_space.get()));
+	m_space.reset(new Space(this, m_galaxy));
+	UpdateSectorPrefetch();
 
 	m_space->GetBackground()->SetDrawFlags(Background::Container::DRAW_STARS);
 
@@ -483,6 +556,28 @@ void Game::SwitchToHyperspace()
 	Output("Started hyperspacing...\n");
 }
 
+void Game::UpdateSectorPrefetch()
+{
+	PROFILE_SCOPED()
+	static const std::vector<SystemPath> s_noRoute;
+
+	// runs every step, so only build new hints when something changed
+	const SystemPath &here = (m_state == State::HYPERSPACE) ? m_hyperspaceDest : m_space->GetStarSystem()->GetPath();
+	const SystemPath target = m_gameViews ? GetSectorView()->GetHyperspaceTarget() : SystemPath();
+	const std::vector<SystemPath> &route = m_gameViews ? GetSectorView()->GetRoute() : s_noRoute;
+
+	const SectorPrefetcher::Hints &current = m_sectorPrefetcher->GetHints();
+	if (here == current.here && m_hyperspaceSource == current.previous && target == current.target && route == current.route)
+		return;
+
+	SectorPrefetcher::Hints hints;
+	hints.here = here;
+	hints.previous = m_hyperspaceSource;
+	hints.target = target;
+	hints.route = route;
+	m_sectorPrefetcher->Prefetch(hints);
+}
+
 void Game::SwitchToNormalSpace()
 {
 	PROFILE_SCOPED()
@@ -491,7 +586,8 @@ void Game::SwitchToNormalSpace()
 
 	// create a new space for the system
 	m_space.reset(); // HACK: Here because next line will create Frames *before* deleting existing ones
-	m_space.reset(new Space(this, m_galaxy, m_hyperspaceDest, m_space.get()));
+	m_space.reset(new Space(this, m_galaxy, m_hyperspaceDest));
+	UpdateSectorPrefetch();
 
 	// put the player in it
 	m_player->SetFrame(m_space->GetRootFrame());
@@ -864,7 +960,18 @@ void Game::EmitPauseState(bool paused)
 
 Json Game::LoadGameToJson(const std::string &filename)
 {
-	Json rootNode = JsonUtils::LoadJsonSaveFile(FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename), FileSystem::userFiles);
+	SaveGameWriter::WaitForPending(); // it might be the one being written
+
+	const std::string path = FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename);
+	Json rootNode;
+	{
+		auto file = FileSystem::userFiles.ReadFile(path);
+		if (file && SaveGameFormat::IsSectioned(file->GetData(), file->GetSize()))
+			rootNode = DecodeSectionedSave(file->GetData(), file->GetSize());
+		else
+			rootNode = JsonUtils::LoadJsonSaveFile(path, FileSystem::userFiles);
+		// file data is freed here
+	}
 	if (!rootNode.is_object()) {
 		Output("Loading saved game '%s' failed.\n", filename.c_str());
 		throw SavedGameCorruptException();
@@ -916,30 +1023,14 @@ void Game::SaveGame(const std::string &filename, Game *game)
 		throw CouldNotOpenFileException();
 	}
 
+	// only the snapshot is taken here, the rest happens on a worker. if it
+	// throws, the previous save hasn't been touched
 	Json rootNode;
 	game->ToJson(rootNode); // Encode the game data as JSON and give to the root value.
-	std::vector<uint8_t> jsonData;
-	{
-		PROFILE_SCOPED_DESC("json.to_cbor");
-		jsonData = Json::to_cbor(rootNode); // Convert the JSON data to CBOR.
-	}
 
-	FileSystem::userFiles.MakeDirectory(Pi::SAVE_DIR_NAME);
-	FILE *f = FileSystem::userFiles.OpenWriteStream(FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename));
-	if (!f) throw CouldNotOpenFileException();
-
-	try {
-		// Compress the CBOR data.
-		const std::string comressed_data = gzip::CompressGZip(
-			std::string(reinterpret_cast<const char *>(jsonData.data()), jsonData.size()),
-			filename + ".json");
-		size_t nwritten = fwrite(comressed_data.data(), comressed_data.size(), 1, f);
-		fclose(f);
-		if (nwritten != 1) throw CouldNotWriteToFileException();
-	} catch (gzip::CompressionFailedException) {
-		fclose(f);
-		throw CouldNotWriteToFileException();
-	}
+	const std::string path = FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename);
+	if (!SaveGameWriter::Write(filename, path, std::move(rootNode), SaveGameWriter::GetConfiguredCompression()))
+		throw CouldNotOpenFileException();
 
 	Pi::GetApp()->RequestProfileFrame("SaveGame");
 }
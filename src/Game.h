@@ -13,6 +13,7 @@
 class GameLog;
 class HyperspaceCloud;
 class Player;
+class SectorPrefetcher;
 class Space;
 
 namespace Graphics {
@@ -63,6 +64,7 @@ public:
 
 	RefCountedPtr<Galaxy> GetGalaxy() const { return m_galaxy; }
 	Space *GetSpace() const { return m_space.get(); }
+	SectorPrefetcher *GetSectorPrefetcher() const { return m_sectorPrefetcher.get(); }
 	double GetTime() const { return m_time; }
 	Player *GetPlayer() const { return m_player.get(); }
 
@@ -158,7 +160,11 @@ private:
 	void SwitchToHyperspace();
 	void SwitchToNormalSpace();
 
+	// refill the galaxy caches if where we are or where we're headed changed
+	void UpdateSectorPrefetch();
+
 	RefCountedPtr<Galaxy> m_galaxy;
+	std::unique_ptr<SectorPrefetcher> m_sectorPrefetcher;
 	std::unique_ptr<Views> m_gameViews;
 	std::unique_ptr<Space> m_space;
 	double m_time;
@@ -39,6 +39,14 @@ GameConfig::GameConfig(const map_string &override_)
 	map["VSync"] = "1";
 	map["UseTextureCompression"] = "1";
 	map["WorkerThreads"] = "0";
+	map["GalaxyCacheMemoryMB"] = "256";
+	map["SaveCompression"] = "gzip"; // or "lz4", faster but larger
+	map["LuaPooledAllocator"] = "1";
+	map["LuaGCMode"] = "incremental"; // or "generational"
+	map["LuaGCPause"] = "200";
+	map["LuaGCStepMul"] = "200";
+	map["LuaGCStepKB"] = "16";
+	map["LuaGCFrameBudgetMs"] = "1.0"; // 0 lets Lua collect whenever it allocates
 	map["SpeedLines"] = "0";
 	map["EnableCockpit"] = "0";
 	map["HudTrails"] = "0";
@@ -7,8 +7,11 @@
 
 #include "JsonUtils.h"
 #include "FileSystem.h"
+#include "GameSaveError.h"
+#include "SaveGameFormat.h"
 #include "base64/base64.hpp"
 #include "core/GZipFormat.h"
+#include "core/LZ4Format.h"
 #include "utils.h"
 #include <cmath>
 
@@ -79,12 +82,22 @@ namespace JsonUtils {
 	{
 		auto file = source.ReadFile(filename);
 		if (!file) return nullptr;
+		if (SaveGameFormat::IsSectioned(file->GetData(), file->GetSize())) {
+			try {
+				return SaveGameFormat::Decode(file->GetData(), file->GetSize());
+			} catch (SavedGameCorruptException &) {
+				Output("error in sectioned save file '%s'\n", file->GetInfo().GetPath().c_str());
+				return nullptr;
+			}
+		}
 		const auto file_data = std::string(file->GetData(), file->GetSize());
 		const unsigned char *dataPtr = reinterpret_cast<const unsigned char *>(&file_data[0]);
 		try {
 			std::string plain_data;
 			if (gzip::IsGZipFormat(dataPtr, file_data.size())) {
 				plain_data = gzip::DecompressDeflateOrGZip(dataPtr, file_data.size());
+			} else if (lz4::IsLZ4Format(file_data.data(), file_data.size())) {
+				plain_data = lz4::DecompressLZ4(file_data);
 			} else {
 				plain_data = file_data;
 			}
@@ -102,6 +115,8 @@ namespace JsonUtils {
 			}
 		} catch (gzip::DecompressionFailedException) {
 			return nullptr;
+		} catch (lz4::DecompressionFailedException &) {
+			return nullptr;
 		}
 	}
 } // namespace JsonUtils
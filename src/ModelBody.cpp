@@ -12,6 +12,7 @@
 #include "Shields.h"
 #include "collider/CollisionSpace.h"
 #include "collider/Geom.h"
+#include "graphics/RenderQueue.h"
 #include "galaxy/SystemBody.h"
 #include "scenegraph/Animation.h"
 #include "scenegraph/CollisionGeometry.h"
@@ -66,6 +67,7 @@ public:
 ModelBody::ModelBody() :
 	m_isStatic(false),
 	m_colliding(true),
+	m_solidRendered(false),
 	m_geom(nullptr),
 	m_model(nullptr)
 {
@@ -73,6 +75,7 @@ ModelBody::ModelBody() :
 
 ModelBody::ModelBody(const Json &jsonObj, Space *space) :
 	Body(jsonObj, space),
+	m_solidRendered(false),
 	m_geom(nullptr),
 	m_model(nullptr)
 {
@@ -388,22 +391,16 @@ void ModelBody::CalcLighting(double &ambient, double &direct, const Camera *came
 	ambient = std::max(minAmbient, ambient);
 }
 
-// setLighting: set renderer lights according to current position and sun
-// positions. Original lighting is passed back in oldLights, oldAmbient, and
-// should be reset after rendering with ModelBody::ResetLighting.
-void ModelBody::SetLighting(Graphics::Renderer *r, const Camera *camera, std::vector<Graphics::Light> &oldLights, Color &oldAmbient)
+// lights as seen by this body, dimmed by eclipses and atmosphere
+void ModelBody::CalcLights(const Camera *camera, std::vector<Graphics::Light> &lights, Color &ambientColor)
 {
-	std::vector<Graphics::Light> newLights;
 	double ambient, direct;
 	CalcLighting(ambient, direct, camera);
 	const std::vector<Camera::LightSource> &lightSources = camera->GetLightSources();
-	newLights.reserve(lightSources.size());
-	oldLights.reserve(lightSources.size());
+	lights.reserve(lightSources.size());
 	for (size_t i = 0; i < lightSources.size(); i++) {
 		Graphics::Light light(lightSources[i].GetLight());
 
-		oldLights.push_back(light);
-
 		const float intensity = direct * camera->ShadowedIntensity(i, this);
 
 		Color c = light.GetDiffuse();
@@ -417,16 +414,33 @@ void ModelBody::SetLighting(Graphics::Renderer *r, const Camera *camera, std::ve
 		light.SetDiffuse(c);
 		light.SetSpecular(cs);
 
-		newLights.push_back(light);
+		lights.push_back(light);
 	}
 
-	if (newLights.empty()) {
+	if (lights.empty()) {
 		// no lights means we're somewhere weird (eg hyperspace, ObjectViewer). fake one
-		newLights.push_back(Graphics::Light(Graphics::Light::LIGHT_DIRECTIONAL, vector3f(0.f), Color::WHITE, Color::WHITE));
+		lights.push_back(Graphics::Light(Graphics::Light::LIGHT_DIRECTIONAL, vector3f(0.f), Color::WHITE, Color::WHITE));
 	}
 
+	ambientColor = Color(ambient * 255, ambient * 255, ambient * 255);
+}
+
+// setLighting: set renderer lights according to current position and sun
+// positions. Original lighting is passed back in oldLights, oldAmbient, and
+// should be reset after rendering with ModelBody::ResetLighting.
+void ModelBody::SetLighting(Graphics::Renderer *r, const Camera *camera, std::vector<Graphics::Light> &oldLights, Color &oldAmbient)
+{
+	std::vector<Graphics::Light> newLights;
+	Color ambient;
+	CalcLights(camera, newLights, ambient);
+
+	const std::vector<Camera::LightSource> &lightSources = camera->GetLightSources();
+	oldLights.reserve(lightSources.size());
+	for (size_t i = 0; i < lightSources.size(); i++)
+		oldLights.push_back(lightSources[i].GetLight());
+
 	oldAmbient = r->GetAmbientColor();
-	r->SetAmbientColor(Color(ambient * 255, ambient * 255, ambient * 255));
+	r->SetAmbientColor(ambient);
 	r->SetLights(newLights.size(), &newLights[0]);
 }
 
@@ -438,13 +452,8 @@ void ModelBody::ResetLighting(Graphics::Renderer *r, const std::vector<Graphics:
 	r->SetAmbientColor(oldAmbient);
 }
 
-void ModelBody::RenderModel(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform, const bool setLighting)
+matrix4x4f ModelBody::GetModelTransform(const vector3d &viewCoords, const matrix4x4d &viewTransform) const
 {
-	std::vector<Graphics::Light> oldLights;
-	Color oldAmbient;
-	if (setLighting)
-		SetLighting(r, camera, oldLights, oldAmbient);
-
 	matrix4x4d m2 = GetInterpOrient();
 	m2.SetTranslate(GetInterpPosition());
 	matrix4x4d t = viewTransform * m2;
@@ -457,13 +466,58 @@ void ModelBody::RenderModel(Graphics::Renderer *r, const Camera *camera, const v
 	trans[13] = viewCoords.y;
 	trans[14] = viewCoords.z;
 	trans[15] = 1.0f;
+	return trans;
+}
 
-	m_model->Render(trans);
+void ModelBody::RenderModel(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform, const bool setLighting)
+{
+	std::vector<Graphics::Light> oldLights;
+	Color oldAmbient;
+	if (setLighting)
+		SetLighting(r, camera, oldLights, oldAmbient);
+
+	const matrix4x4f trans = GetModelTransform(viewCoords, viewTransform);
+
+	if (m_solidRendered)
+		m_model->RenderPass(trans, SceneGraph::NODE_TRANSPARENT);
+	else
+		m_model->Render(trans);
 
 	if (setLighting)
 		ResetLighting(r, oldLights, oldAmbient);
 }
 
+// dead bodies aren't drawn in the frames before they are removed, and the
+// debug drawing only happens in Model::Render
+bool ModelBody::CanRenderInstanced() const
+{
+	return m_model != nullptr && !IsDead() && m_model->GetDebugFlags() == 0;
+}
+
+void ModelBody::RenderInstancedSolid(Graphics::Renderer *r, const Camera *camera, const std::vector<Graphics::Light> &lights, const Color &ambient, const std::vector<matrix4x4f> &trans, const std::vector<Graphics::InstanceColors> &colors)
+{
+	std::vector<Graphics::Light> oldLights;
+	const std::vector<Camera::LightSource> &lightSources = camera->GetLightSources();
+	oldLights.reserve(lightSources.size());
+	for (size_t i = 0; i < lightSources.size(); i++)
+		oldLights.push_back(lightSources[i].GetLight());
+	const Color oldAmbient = r->GetAmbientColor();
+
+	r->SetAmbientColor(ambient);
+	r->SetLights(lights.size(), &lights[0]);
+
+	m_model->RenderPass(trans, SceneGraph::NODE_SOLID, &colors);
+
+	ResetLighting(r, oldLights, oldAmbient);
+}
+
+void ModelBody::RecordSolid(Graphics::RenderQueue *queue, const std::vector<Graphics::Light> &lights, const Color &ambient, const matrix4x4f &trans)
+{
+	queue->SetLights(lights.size(), &lights[0]);
+	queue->SetAmbientColor(ambient);
+	m_model->RenderPass(trans, SceneGraph::NODE_SOLID, queue);
+}
+
 void ModelBody::TimeStepUpdate(const float timestep)
 {
 	if (m_idleAnimation)
@@ -6,7 +6,9 @@
 
 #include "Body.h"
 #include "CollMesh.h"
+#include "Color.h"
 #include "FrameId.h"
+#include "matrix4x4.h"
 
 class Shields;
 class Geom;
@@ -14,7 +16,9 @@ class Camera;
 
 namespace Graphics {
 	class Renderer;
+	class RenderQueue;
 	class Light;
+	struct InstanceColors;
 } // namespace Graphics
 
 namespace SceneGraph {
@@ -46,6 +50,19 @@ public:
 
 	void RenderModel(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform, const bool setLighting = true);
 
+	// Camera draws the solid geometry of bodies before anything else: bodies
+	// of one model and pattern in one instanced pass, each with its own
+	// colours, the others through a sorted render queue. each body's
+	// RenderModel then draws only the rest
+	virtual bool CanRenderInstanced() const;
+	virtual void RenderInstancedSolid(Graphics::Renderer *r, const Camera *camera, const std::vector<Graphics::Light> &lights, const Color &ambient, const std::vector<matrix4x4f> &trans, const std::vector<Graphics::InstanceColors> &colors);
+	virtual void RecordSolid(Graphics::RenderQueue *queue, const std::vector<Graphics::Light> &lights, const Color &ambient, const matrix4x4f &trans);
+	void SetSolidRendered(bool rendered) { m_solidRendered = rendered; }
+
+	// lights and ambient colour as seen by this body
+	void CalcLights(const Camera *camera, std::vector<Graphics::Light> &lights, Color &ambient);
+	matrix4x4f GetModelTransform(const vector3d &viewCoords, const matrix4x4d &viewTransform) const;
+
 	virtual void TimeStepUpdate(const float timeStep) override;
 
 protected:
@@ -67,6 +84,7 @@ private:
 
 	bool m_isStatic;
 	bool m_colliding;
+	bool m_solidRendered;
 	RefCountedPtr<CollMesh> m_collMesh;
 	Geom *m_geom; //static geom
 	std::string m_modelName;
@@ -2,9 +2,48 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "ModelCache.h"
+#include "Pi.h"
 #include "Shields.h"
+#include "profiler/Profiler.h"
+#include "scenegraph/BinaryConverter.h"
 #include "scenegraph/SceneGraph.h"
 
+struct ModelCache::PendingModel {
+	Job::Handle job;
+	std::unique_ptr<SceneGraph::BinaryConverter::PreparedModel> prepared;
+};
+
+class ModelCache::LoadJob : public Job {
+public:
+	LoadJob(ModelCache *cache, const std::string &name) :
+		m_cache(cache),
+		m_name(name) {}
+
+	virtual void OnRun() override // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+	{
+		// reads gameDataFiles while the main thread does too. zip mods
+		// serialise their reads, see FileSourceZip
+		std::unique_ptr<SceneGraph::BinaryConverter::PreparedModel> prepared(new SceneGraph::BinaryConverter::PreparedModel());
+		try {
+			if (SceneGraph::BinaryConverter::Prepare(m_name, "models", *prepared))
+				m_prepared = std::move(prepared);
+		} catch (SceneGraph::LoadingError &) {
+			// no .sgm, the main thread loads the .model
+		}
+	}
+
+	virtual void OnFinish() override { m_cache->OnModelPrepared(this); }
+
+	const std::string &GetName() const { return m_name; }
+	// empty if there was no usable .sgm
+	std::unique_ptr<SceneGraph::BinaryConverter::PreparedModel> &GetPrepared() { return m_prepared; }
+
+private:
+	ModelCache *m_cache;
+	std::string m_name;
+	std::unique_ptr<SceneGraph::BinaryConverter::PreparedModel> m_prepared;
+};
+
 ModelCache::ModelCache(Graphics::Renderer *r) :
 	m_renderer(r)
 {
@@ -20,23 +59,147 @@ SceneGraph::Model *ModelCache::FindModel(const std::string &name)
 	ModelMap::iterator it = m_models.find(name);
 
 	if (it == m_models.end()) {
-		try {
-			SceneGraph::Loader loader(m_renderer);
-			SceneGraph::Model *m = loader.LoadModel(name);
-			Shields::ReparentShieldNodes(m);
-			m_models[name] = m;
-			return m;
-		} catch (SceneGraph::LoadingError &) {
-			throw ModelNotFoundException();
+		auto pending = m_pending.find(name);
+		if (pending != m_pending.end()) {
+			// use what the worker has read, or drop the request and load it here
+			std::unique_ptr<PendingModel> p = std::move(pending->second);
+			m_pending.erase(pending);
+			return FinishModel(name, *p);
 		}
+		return LoadModel(name);
 	}
 	return it->second;
 }
 
+void ModelCache::RequestModel(const std::string &name)
+{
+	if (m_models.count(name) || m_pending.count(name) || m_missing.count(name))
+		return;
+
+	std::unique_ptr<PendingModel> p(new PendingModel());
+	p->job = Pi::GetAsyncJobQueue()->Queue(new LoadJob(this, name));
+	m_pending[name] = std::move(p);
+}
+
+SceneGraph::Model *ModelCache::GetModelIfReady(const std::string &name)
+{
+	ModelMap::iterator it = m_models.find(name);
+	if (it != m_models.end())
+		return it->second;
+
+	if (m_missing.count(name))
+		throw ModelNotFoundException();
+
+	RequestModel(name);
+	return nullptr;
+}
+
+SceneGraph::Model *ModelCache::GetPlaceholder(const std::string &name)
+{
+	ModelMap::iterator it = m_placeholders.find(name);
+	if (it != m_placeholders.end())
+		return it->second;
+
+	auto pending = m_pending.find(name);
+	if (pending == m_pending.end() || !pending->second->prepared)
+		return nullptr;
+
+	const SceneGraph::BinaryConverter::PreparedModel &prepared = *pending->second->prepared;
+	SceneGraph::Model *m = new SceneGraph::Model(m_renderer, name);
+	m->SetCollisionMesh(prepared.collMesh);
+	m->SetDrawClipRadius(prepared.drawClipRadius);
+	m->SetDebugFlags(SceneGraph::Model::DEBUG_BBOX);
+	m_placeholders[name] = m;
+	return m;
+}
+
+void ModelCache::Update(double budgetMs)
+{
+	PROFILE_SCOPED()
+	if (m_pending.empty())
+		return;
+
+	// the results are only handed over here
+	Pi::GetAsyncJobQueue()->FinishJobs();
+
+	Profiler::Clock timer;
+	timer.Start();
+	while (!m_prepared.empty()) {
+		const std::string name = m_prepared.front();
+		m_prepared.pop_front();
+
+		// may have been loaded by FindModel since
+		auto pending = m_pending.find(name);
+		if (pending == m_pending.end())
+			continue;
+		std::unique_ptr<PendingModel> p = std::move(pending->second);
+		m_pending.erase(pending);
+
+		try {
+			FinishModel(name, *p);
+		} catch (ModelNotFoundException &) {
+			Output("Could not find model: %s\n", name.c_str());
+		}
+
+		if (timer.currentmilliseconds() >= budgetMs)
+			break;
+	}
+}
+
+void ModelCache::OnModelPrepared(LoadJob *job)
+{
+	auto pending = m_pending.find(job->GetName());
+	if (pending == m_pending.end())
+		return;
+	pending->second->prepared = std::move(job->GetPrepared());
+	m_prepared.push_back(job->GetName());
+}
+
+SceneGraph::Model *ModelCache::LoadModel(const std::string &name)
+{
+	PROFILE_SCOPED()
+	try {
+		SceneGraph::Loader loader(m_renderer);
+		SceneGraph::Model *m = loader.LoadModel(name);
+		Shields::ReparentShieldNodes(m);
+		m_models[name] = m;
+		return m;
+	} catch (SceneGraph::LoadingError &) {
+		m_missing.insert(name);
+		throw ModelNotFoundException();
+	}
+}
+
+SceneGraph::Model *ModelCache::FinishModel(const std::string &name, PendingModel &p)
+{
+	PROFILE_SCOPED()
+	if (!p.prepared)
+		return LoadModel(name);
+
+	SceneGraph::BinaryConverter bc(m_renderer);
+	SceneGraph::Model *m = bc.Load(*p.prepared);
+	if (!m)
+		return LoadModel(name);
+
+	Shields::ReparentShieldNodes(m);
+	m_models[name] = m;
+	return m;
+}
+
 void ModelCache::Flush()
 {
+	// cancels the jobs
+	m_pending.clear();
+	m_prepared.clear();
+	m_missing.clear();
+
 	for (ModelMap::iterator it = m_models.begin(); it != m_models.end(); ++it) {
 		delete it->second;
 	}
 	m_models.clear();
+
+	for (ModelMap::iterator it = m_placeholders.begin(); it != m_placeholders.end(); ++it) {
+		delete it->second;
+	}
+	m_placeholders.clear();
 }
@@ -6,8 +6,15 @@
 /*
  * This class is a quick thoughtless hack
  * Also it only deals in New Models
+ *
+ * Models can be requested ahead of time: a worker reads the .sgm and its
+ * collision mesh, and Update creates the materials and buffers on the main
+ * thread, a few per frame. .model sources are only loaded on the main thread.
  */
+#include "JobQueue.h"
 #include "libs.h"
+#include <deque>
+#include <set>
 #include <stdexcept>
 
 namespace Graphics {
@@ -25,12 +32,35 @@ public:
 	};
 	ModelCache(Graphics::Renderer *);
 	~ModelCache();
+	// loads the model right away if it isn't loaded yet
 	SceneGraph::Model *FindModel(const std::string &);
+	// starts loading the model in the background, if it isn't already
+	void RequestModel(const std::string &);
+	// the model if it is loaded, otherwise requests it and returns nullptr.
+	// throws ModelNotFoundException once the model is known to be missing
+	SceneGraph::Model *GetModelIfReady(const std::string &);
+	// a model that is only the bounding box of a requested model, once its
+	// collision mesh has been read. nullptr until then
+	SceneGraph::Model *GetPlaceholder(const std::string &);
+	// finishes requested models, for about budgetMs but at least one
+	void Update(double budgetMs);
 	void Flush();
 
 private:
+	class LoadJob;
+	struct PendingModel;
+
+	SceneGraph::Model *LoadModel(const std::string &);
+	SceneGraph::Model *FinishModel(const std::string &, PendingModel &);
+	void OnModelPrepared(LoadJob *job);
+
 	typedef std::map<std::string, SceneGraph::Model *> ModelMap;
 	ModelMap m_models;
+	ModelMap m_placeholders;
+	std::map<std::string, std::unique_ptr<PendingModel>> m_pending;
+	// prepared on a worker, waiting for Update
+	std::deque<std::string> m_prepared;
+	std::set<std::string> m_missing;
 	Graphics::Renderer *m_renderer;
 };
 
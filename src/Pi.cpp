@@ -41,6 +41,7 @@
 #include "Player.h"
 #include "PngWriter.h"
 #include "Projectile.h"
+#include "SaveGameWriter.h"
 #include "SectorView.h"
 #include "Sfx.h"
 #include "Shields.h"
@@ -74,6 +75,10 @@
 #include "scenegraph/Lua.h"
 #include "versioningInfo.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 #ifdef PROFILE_LUA_TIME
 #include <time.h>
 #endif
@@ -152,18 +157,57 @@ protected:
 		// TODO: use a lighter-weight wrapper over lambdas instead of std::function
 		std::function<void()> fn;
 		std::string name;
+		// steps that must have finished before this one starts
+		std::vector<size_t> after;
+		// main thread steps run one per frame in the order they were added,
+		// the others run on the async job queue as soon as they can
+		bool mainThread;
+
+		bool started;
+		bool finished;
+		// relative to the start of loading, for the timeline
+		double startMs;
+		double endMs;
 	};
 
+	class LoaderJob;
+
 	std::vector<LoaderStep> m_loaders;
-	size_t m_currentLoader = 0;
+	size_t m_nextMainLoader = 0;
+	size_t m_finishedLoaders = 0;
+	std::unique_ptr<JobSet> m_loaderJobs;
+
+	// worker steps that have run and the ones that have been collected, so
+	// the main thread can sleep until there is one to collect
+	std::mutex m_workerLock;
+	std::condition_variable m_workerDone;
+	size_t m_workerRuns = 0;
+	size_t m_workerFinishes = 0;
+
+	// adds a step that runs on the main thread, after the given steps
+	template <typename T>
+	size_t AddStep(std::string name, T fn, std::vector<size_t> after = {})
+	{
+		m_loaders.push_back(LoaderStep{ fn, name, after, true, false, false, 0.0, 0.0 });
+		return m_loaders.size() - 1;
+	}
 
+	// adds a step that doesn't need the renderer or the Lua state, to run
+	// on a worker thread after the given steps. it must be thread safe
 	template <typename T>
-	void AddStep(std::string name, T fn)
+	size_t AddAsyncStep(std::string name, T fn, std::vector<size_t> after = {})
 	{
-		m_loaders.push_back(LoaderStep{ fn, name });
+		m_loaders.push_back(LoaderStep{ fn, name, after, false, false, false, 0.0, 0.0 });
+		return m_loaders.size() - 1;
 	}
 
+	bool IsReady(const LoaderStep &step) const;
+	void StartAsyncSteps();
+	void RunMainStep(LoaderStep &step);
+	void OutputTimeline();
+
 	Profiler::Clock m_loadTimer;
+	Uint64 m_loadStartTicks;
 
 	void Start() override;
 	void Update(float) override;
@@ -408,6 +452,9 @@ void Pi::App::Shutdown()
 
 	perfInfoDisplay.reset();
 
+	// make sure a save still being written in the background makes it to disk
+	SaveGameWriter::Uninit();
+
 	// TODO: connect initializers and deinitializers in a single Module interface
 	// Will need to think about dependency injection for e.g. modules which need a
 	// reference to the renderer
@@ -459,7 +506,44 @@ void Pi::App::Shutdown()
 ===============================================================================
 */
 
-// TODO: investigate constructing a DAG out of Init functions and dependencies
+class LoadStep::LoaderJob : public Job {
+public:
+	LoaderJob(LoadStep *loader, size_t index) :
+		m_loader(loader),
+		m_index(index),
+		m_startTicks(0),
+		m_endTicks(0)
+	{}
+
+	virtual void OnRun() override // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+	{
+		m_startTicks = Profiler::Clock::getticks();
+		m_loader->m_loaders[m_index].fn();
+		m_endTicks = Profiler::Clock::getticks();
+
+		std::lock_guard<std::mutex> lock(m_loader->m_workerLock);
+		++m_loader->m_workerRuns;
+		m_loader->m_workerDone.notify_one();
+	}
+
+	virtual void OnFinish() override
+	{
+		LoaderStep &step = m_loader->m_loaders[m_index];
+		step.startMs = Profiler::Clock::ms(m_startTicks - m_loader->m_loadStartTicks);
+		step.endMs = Profiler::Clock::ms(m_endTicks - m_loader->m_loadStartTicks);
+		step.finished = true;
+		++m_loader->m_finishedLoaders;
+		++m_loader->m_workerFinishes;
+		Output("Loading: %s took %.2fms on a worker\n", step.name.c_str(), step.endMs - step.startMs);
+	}
+
+private:
+	LoadStep *m_loader;
+	size_t m_index;
+	Uint64 m_startTicks;
+	Uint64 m_endTicks;
+};
+
 void LoadStep::Start()
 {
 	PROFILE_SCOPED()
@@ -467,6 +551,7 @@ void LoadStep::Start()
 	Output("LoadStep::Start()\n");
 	m_loadTimer.Reset();
 	m_loadTimer.Start();
+	m_loadStartTicks = Profiler::Clock::getticks();
 
 	Output("ShipType::Init()\n");
 	// XXX early, Lua init needs it
@@ -477,6 +562,11 @@ void LoadStep::Start()
 	Output("Lua::Init()\n");
 	Lua::Init();
 
+	// PostUpdate steps the collector, so it can be held to a budget per frame
+	LuaManager::GCSettings gc = Lua::manager->GetGCSettings();
+	gc.frameBudgetMs = Pi::config->Float("LuaGCFrameBudgetMs", gc.frameBudgetMs);
+	Lua::manager->SetGCSettings(gc);
+
 	// TODO: Get the lua state responsible for drawing the init progress up as fast as possible
 	// Investigate using a pigui-only Lua state that we can initialize without depending on
 	// normal init flow, or drawing the init screen in C++ instead?
@@ -515,7 +605,8 @@ void LoadStep::Start()
 		Gui::Init(Pi::renderer, Graphics::GetScreenWidth(), Graphics::GetScreenHeight(), 800, 600);
 	});
 
-	AddStep("GalaxyGenerator::Init()", []() {
+	// parses the custom systems and factions, each in a Lua state of its own
+	AddAsyncStep("GalaxyGenerator::Init()", []() {
 		if (Pi::config->HasEntry("GalaxyGenerator"))
 			GalaxyGenerator::Init(Pi::config->String("GalaxyGenerator"),
 				Pi::config->Int("GalaxyGeneratorVersion", GalaxyGenerator::LAST_VERSION));
@@ -523,7 +614,7 @@ void LoadStep::Start()
 			GalaxyGenerator::Init();
 	});
 
-	AddStep("FaceParts::Init()", &FaceParts::Init);
+	AddAsyncStep("FaceParts::Init()", &FaceParts::Init);
 
 	AddStep("new ModelCache", []() {
 		Pi::modelCache = new ModelCache(Pi::renderer);
@@ -547,49 +638,124 @@ void LoadStep::Start()
 		SfxManager::Init(Pi::renderer);
 	});
 
-	AddStep("Sound::Init", []() {
-		if (Pi::GetApp()->HeadlessMode() || Pi::config->Int("DisableSound"))
-			return;
+	const bool soundEnabled = !Pi::GetApp()->HeadlessMode() && !Pi::config->Int("DisableSound");
+	std::vector<size_t> soundAfter;
+	if (soundEnabled)
+		soundAfter.push_back(AddAsyncStep("Sound::LoadSamples", &Sound::LoadSamples));
+
+	AddStep(
+		"Sound::Init", [soundEnabled]() {
+			if (!soundEnabled)
+				return;
+
+			Sound::Init();
+			Sound::SetMasterVolume(Pi::config->Float("MasterVolume"));
+			Sound::SetSfxVolume(Pi::config->Float("SfxVolume"));
+			Pi::GetMusicPlayer().SetVolume(Pi::config->Float("MusicVolume"));
+
+			Sound::Pause(0);
+			if (Pi::config->Int("MasterMuted")) Sound::Pause(1);
+			if (Pi::config->Int("SfxMuted")) Sound::SetSfxVolume(0.f);
+			if (Pi::config->Int("MusicMuted")) Pi::GetMusicPlayer().SetEnabled(false);
+		},
+		soundAfter);
+
+	// everything else has to be done before the game can start
+	std::vector<size_t> everything(m_loaders.size());
+	for (size_t i = 0; i < everything.size(); i++)
+		everything[i] = i;
+
+	AddStep(
+		"PostLoad", []() {
+			Pi::luaConsole.reset(new LuaConsole());
+			Pi::luaConsole->SetupBindings();
+
+			Pi::planner = new TransferPlanner();
+
+			perfInfoDisplay.reset(new PiGui::PerfInfo());
+		},
+		everything);
+
+	m_loaderJobs.reset(new JobSet(Pi::GetAsyncJobQueue()));
+	StartAsyncSteps();
+}
+
+bool LoadStep::IsReady(const LoaderStep &step) const
+{
+	for (size_t dep : step.after) {
+		if (!m_loaders[dep].finished)
+			return false;
+	}
+	return true;
+}
 
-		Sound::Init();
-		Sound::SetMasterVolume(Pi::config->Float("MasterVolume"));
-		Sound::SetSfxVolume(Pi::config->Float("SfxVolume"));
-		Pi::GetMusicPlayer().SetVolume(Pi::config->Float("MusicVolume"));
+void LoadStep::StartAsyncSteps()
+{
+	for (size_t i = 0; i < m_loaders.size(); i++) {
+		LoaderStep &step = m_loaders[i];
+		if (step.mainThread || step.started || !IsReady(step))
+			continue;
+
+		Output("Loading: %s started on a worker\n", step.name.c_str());
+		step.started = true;
+		m_loaderJobs->Order(new LoaderJob(this, i));
+	}
+}
 
-		Sound::Pause(0);
-		if (Pi::config->Int("MasterMuted")) Sound::Pause(1);
-		if (Pi::config->Int("SfxMuted")) Sound::SetSfxVolume(0.f);
-		if (Pi::config->Int("MusicMuted")) Pi::GetMusicPlayer().SetEnabled(false);
-	});
+void LoadStep::RunMainStep(LoaderStep &step)
+{
+	const float progress = (m_finishedLoaders + 1) / float(m_loaders.size());
+	Output("Loading [%02.f%%]: %s started\n", progress * 100., step.name.c_str());
 
-	AddStep("PostLoad", []() {
-		Pi::luaConsole.reset(new LuaConsole());
-		Pi::luaConsole->SetupBindings();
+	const Uint64 start = Profiler::Clock::getticks();
+	step.started = true;
 
-		Pi::planner = new TransferPlanner();
+	step.fn();
 
-		perfInfoDisplay.reset(new PiGui::PerfInfo());
-	});
+	const Uint64 end = Profiler::Clock::getticks();
+	step.startMs = Profiler::Clock::ms(start - m_loadStartTicks);
+	step.endMs = Profiler::Clock::ms(end - m_loadStartTicks);
+	step.finished = true;
+	++m_finishedLoaders;
+
+	Output("Loading [%02.f%%]: %s took %.2fms\n", progress * 100.,
+		step.name.c_str(), step.endMs - step.startMs);
+}
+
+void LoadStep::OutputTimeline()
+{
+	Output("\nStartup timeline (ms since loading started):\n");
+	Output("%-32s %-7s %10s %10s %10s\n", "step", "thread", "start", "end", "took");
+	for (const LoaderStep &step : m_loaders) {
+		Output("%-32s %-7s %10.2f %10.2f %10.2f\n", step.name.c_str(), step.mainThread ? "main" : "worker",
+			step.startMs, step.endMs, step.endMs - step.startMs);
+	}
 }
 
 void LoadStep::Update(float deltaTime)
 {
 	PROFILE_SCOPED()
 
-	if (m_currentLoader < m_loaders.size()) {
-		LoaderStep &loader = m_loaders[m_currentLoader++];
-		float progress = (m_currentLoader) / float(m_loaders.size());
-		Output("Loading [%02.f%%]: %s started\n", progress * 100., loader.name.c_str());
-
-		Profiler::Clock timer;
-		timer.Start();
-
-		loader.fn();
-
-		timer.Stop();
-		Output("Loading [%02.f%%]: %s took %.2fms\n", progress * 100.,
-			loader.name.c_str(), timer.milliseconds());
+	// collect the worker steps that are done and start the ones they held up
+	Pi::GetAsyncJobQueue()->FinishJobs();
+	StartAsyncSteps();
+
+	if (m_finishedLoaders < m_loaders.size()) {
+		// skip over the worker steps, they are started above
+		while (m_nextMainLoader < m_loaders.size() && !m_loaders[m_nextMainLoader].mainThread)
+			++m_nextMainLoader;
+
+		if (m_nextMainLoader < m_loaders.size() && IsReady(m_loaders[m_nextMainLoader])) {
+			RunMainStep(m_loaders[m_nextMainLoader++]);
+			StartAsyncSteps();
+		} else {
+			// waiting for a worker, sleep until it is done. still redraw the
+			// loading screen every so often
+			std::unique_lock<std::mutex> lock(m_workerLock);
+			m_workerDone.wait_for(lock, std::chrono::milliseconds(16), [this]() { return m_workerRuns > m_workerFinishes; });
+		}
 
+		const float progress = m_finishedLoaders / float(m_loaders.size());
 		Pi::pigui->NewFrame();
 		PiGui::RunHandler(progress, "init");
 		Pi::pigui->Render();
@@ -597,8 +763,10 @@ void LoadStep::Update(float deltaTime)
 	} else {
 		OS::NotifyLoadEnd();
 		RequestEndLifecycle();
+		m_loaderJobs.reset();
 
 		m_loadTimer.Stop();
+		OutputTimeline();
 		Output("\n\nPioneer loading took %.2fms\n", m_loadTimer.milliseconds());
 
 		Pi::GetApp()->RequestProfileFrame();
@@ -829,6 +997,14 @@ void Pi::App::PostUpdate()
 	GuiApplication::PostUpdate();
 
 	HandleRequests();
+
+	// finish the models that were loaded in the background
+	if (Pi::modelCache)
+		Pi::modelCache->Update(MODEL_FINISH_MS);
+
+	// the frame has been submitted, spend some of the time the GPU needs on the garbage
+	if (Lua::manager)
+		Lua::manager->StepGarbageCollector();
 }
 
 void Pi::App::RunJobs()
@@ -221,6 +221,8 @@ private:
 
 	// private members
 	static const Uint32 SYNC_JOBS_PER_LOOP = 1;
+	// main thread time per frame for creating the buffers of requested models
+	static const Uint32 MODEL_FINISH_MS = 4;
 	static std::unique_ptr<AsyncJobQueue> asyncJobQueue;
 	static std::unique_ptr<SyncJobQueue> syncJobQueue;
 
@@ -0,0 +1,141 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SaveGameFormat.h"
+
+#include "GameSaveError.h"
+#include "core/GZipFormat.h"
+#include "core/LZ4Format.h"
+#include "profiler/Profiler.h"
+#include <SDL_endian.h>
+#include <cstring>
+
+namespace SaveGameFormat {
+	static const char MAGIC[4] = { 'P', 'S', 'A', 'V' };
+	static const Uint32 FORMAT_VERSION = 1;
+
+	static Uint32 ReadU32(const char *&pos, const char *end)
+	{
+		Uint32 v;
+		if (size_t(end - pos) < sizeof(v))
+			throw SavedGameCorruptException();
+		memcpy(&v, pos, sizeof(v));
+		pos += sizeof(v);
+		return SDL_SwapLE32(v);
+	}
+
+	static void AppendU32(std::string &out, Uint32 v)
+	{
+		v = SDL_SwapLE32(v);
+		out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+	}
+
+	bool IsSectioned(const char *data, size_t size)
+	{
+		return size >= sizeof(MAGIC) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+	}
+
+	std::vector<Section> ReadIndex(const char *data, size_t size)
+	{
+		if (!IsSectioned(data, size))
+			throw SavedGameCorruptException();
+		const char *end = data + size;
+		const char *pos = data + sizeof(MAGIC);
+		if (ReadU32(pos, end) != FORMAT_VERSION)
+			throw SavedGameCorruptException();
+
+		const Uint32 count = ReadU32(pos, end);
+		std::vector<Section> sections;
+		sections.reserve(std::min<Uint32>(count, size / sizeof(Uint32)));
+		for (Uint32 i = 0; i < count; i++) {
+			Section section;
+			const Uint32 nameLen = ReadU32(pos, end);
+			if (size_t(end - pos) < nameLen + 1)
+				throw SavedGameCorruptException();
+			section.name.assign(pos, nameLen);
+			pos += nameLen;
+			section.compression = Compression(*pos++);
+			const Uint32 offset = ReadU32(pos, end);
+			const Uint32 length = ReadU32(pos, end);
+			if (offset > size || length > size - offset)
+				throw SavedGameCorruptException();
+			section.data = data + offset;
+			section.size = length;
+			sections.push_back(std::move(section));
+		}
+		return sections;
+	}
+
+	Json DecodeSection(const Section &section)
+	{
+		PROFILE_SCOPED()
+		std::string plain;
+		try {
+			switch (section.compression) {
+			case COMPRESSION_GZIP:
+				plain = gzip::DecompressGZip(reinterpret_cast<const unsigned char *>(section.data), section.size);
+				break;
+			case COMPRESSION_LZ4:
+				plain = lz4::DecompressLZ4(std::string_view(section.data, section.size));
+				break;
+			default:
+				throw SavedGameCorruptException();
+			}
+			return Json::from_cbor(plain);
+		} catch (gzip::DecompressionFailedException &) {
+			throw SavedGameCorruptException();
+		} catch (lz4::DecompressionFailedException &) {
+			throw SavedGameCorruptException();
+		} catch (Json::parse_error &) {
+			throw SavedGameCorruptException();
+		}
+	}
+
+	Json Decode(const char *data, size_t size)
+	{
+		PROFILE_SCOPED()
+		Json rootNode = Json::object();
+		for (const Section &section : ReadIndex(data, size))
+			rootNode[section.name] = DecodeSection(section);
+		return rootNode;
+	}
+
+	EncodedSection EncodeSection(const std::string &name, const Json &value, Compression compression)
+	{
+		PROFILE_SCOPED()
+		std::string cbor;
+		Json::to_cbor(value, cbor);
+
+		EncodedSection section{ name, compression, std::string() };
+		// let the caller deal with CompressionFailedException
+		if (compression == COMPRESSION_LZ4)
+			section.data = lz4::CompressLZ4(cbor, 0);
+		else
+			section.data = gzip::CompressGZip(cbor, name + ".cbor");
+		return section;
+	}
+
+	std::string BuildIndex(const std::vector<EncodedSection> &sections)
+	{
+		size_t indexSize = sizeof(MAGIC) + 2 * sizeof(Uint32);
+		for (const EncodedSection &section : sections)
+			indexSize += section.name.size() + 1 + 3 * sizeof(Uint32);
+
+		std::string out;
+		out.reserve(indexSize);
+		out.append(MAGIC, sizeof(MAGIC));
+		AppendU32(out, FORMAT_VERSION);
+		AppendU32(out, sections.size());
+		size_t offset = indexSize;
+		for (const EncodedSection &section : sections) {
+			AppendU32(out, section.name.size());
+			out.append(section.name);
+			out.push_back(char(section.compression));
+			AppendU32(out, offset);
+			AppendU32(out, section.data.size());
+			offset += section.data.size();
+		}
+		assert(out.size() == indexSize);
+		return out;
+	}
+} // namespace SaveGameFormat
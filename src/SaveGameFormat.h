@@ -0,0 +1,58 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SAVEGAMEFORMAT_H
+#define _SAVEGAMEFORMAT_H
+
+#include "Json.h"
+#include <SDL_stdinc.h>
+#include <string>
+#include <vector>
+
+/*
+	Saved games are a container of independently compressed sections, one for
+	each member of the game's root Json object, behind an index:
+
+		"PSAV", Uint32 format version, Uint32 section count
+		for each section: Uint32 name length, the name, Uint8 compression,
+		                  Uint32 offset from the start of the file, Uint32 size
+		then the sections, each CBOR encoded and compressed
+
+	This means sections can be decoded in any order and in parallel, and the
+	small ones don't have to wait for the big ones. Older saves that are a
+	single (compressed) document can still be read by
+	JsonUtils::LoadJsonSaveFile.
+*/
+namespace SaveGameFormat {
+	enum Compression : Uint8 {
+		COMPRESSION_GZIP,
+		COMPRESSION_LZ4,
+	};
+
+	struct Section {
+		std::string name;
+		Compression compression;
+		const char *data; // points into the file data
+		size_t size;
+	};
+
+	struct EncodedSection {
+		std::string name;
+		Compression compression;
+		std::string data;
+	};
+
+	bool IsSectioned(const char *data, size_t size);
+
+	// all of these throw SavedGameCorruptException on bad data
+	std::vector<Section> ReadIndex(const char *data, size_t size);
+	Json DecodeSection(const Section &section);
+	// decodes every section in turn into a single Json object
+	Json Decode(const char *data, size_t size);
+
+	EncodedSection EncodeSection(const std::string &name, const Json &value, Compression compression);
+	// the header and index for the sections, which follow it in the same order
+	std::string BuildIndex(const std::vector<EncodedSection> &sections);
+} // namespace SaveGameFormat
+
+#endif /* _SAVEGAMEFORMAT_H */
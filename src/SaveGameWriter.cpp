@@ -0,0 +1,174 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SaveGameWriter.h"
+
+#include "FileSystem.h"
+#include "GameConfig.h"
+#include "JobQueue.h"
+#include "Pi.h"
+#include "core/GZipFormat.h"
+#include "core/LZ4Format.h"
+#include "lua/LuaEvent.h"
+#include "profiler/Profiler.h"
+#include "utils.h"
+
+namespace {
+	SaveGameWriter::Status s_status;
+	Job::Handle s_job;
+
+	class WriteJob : public Job {
+	public:
+		WriteJob(const std::string &filename, const std::string &path, const std::string &tempPath, FILE *file, Json &&rootNode, SaveGameWriter::Compression compression) :
+			m_filename(filename),
+			m_path(path),
+			m_tempPath(tempPath),
+			m_file(file),
+			m_rootNode(std::move(rootNode)),
+			m_compression(compression),
+			m_bytesWritten(0),
+			m_milliseconds(0.0),
+			m_ok(false)
+		{}
+
+		~WriteJob()
+		{
+			// never ran
+			if (m_file) {
+				fclose(m_file);
+				FileSystem::userFiles.RemoveFile(m_tempPath);
+			}
+		}
+
+		virtual void OnRun() override // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+		{
+			PROFILE_SCOPED()
+			Profiler::Clock timer;
+			timer.Start();
+
+			// each member of the root object becomes a section of its own,
+			// dropped from the snapshot as soon as it has been encoded
+			std::vector<SaveGameFormat::EncodedSection> sections;
+			bool encoded = true;
+			try {
+				for (auto it = m_rootNode.begin(); it != m_rootNode.end(); ++it) {
+					sections.push_back(SaveGameFormat::EncodeSection(it.key(), it.value(), m_compression));
+					it.value() = Json();
+				}
+			} catch (gzip::CompressionFailedException) {
+				encoded = false;
+			} catch (lz4::CompressionFailedException &) {
+				encoded = false;
+			}
+			m_rootNode = Json();
+
+			bool written = encoded;
+			size_t size = 0;
+			if (encoded) {
+				const std::string index = SaveGameFormat::BuildIndex(sections);
+				written = fwrite(index.data(), index.size(), 1, m_file) == 1;
+				size = index.size();
+				for (const SaveGameFormat::EncodedSection &section : sections) {
+					written = written && fwrite(section.data.data(), section.data.size(), 1, m_file) == 1;
+					size += section.data.size();
+				}
+			}
+			const bool closed = fclose(m_file) == 0;
+			m_file = nullptr;
+
+			// the previous save is only replaced by a complete one
+			m_ok = written && closed && FileSystem::userFiles.RenameFile(m_tempPath, m_path);
+			if (!m_ok)
+				FileSystem::userFiles.RemoveFile(m_tempPath);
+			m_bytesWritten = size;
+			timer.Stop();
+			m_milliseconds = timer.milliseconds();
+		}
+
+		virtual void OnFinish() override // runs in primary thread of the context
+		{
+			s_status.state = m_ok ? SaveGameWriter::STATE_DONE : SaveGameWriter::STATE_FAILED;
+			s_status.bytesWritten = m_bytesWritten;
+			s_status.milliseconds = m_milliseconds;
+			if (m_ok)
+				Output("SaveGameWriter: wrote '%s', " SIZET_FMT " bytes in %.1fms\n", m_filename.c_str(), m_bytesWritten, m_milliseconds);
+			else
+				Output("SaveGameWriter: failed to write '%s'\n", m_filename.c_str());
+			if (Pi::game)
+				LuaEvent::Queue("onGameSaved", m_filename, m_ok);
+		}
+
+		virtual void OnCancel() override // runs in primary thread of the context
+		{
+			s_status.state = SaveGameWriter::STATE_FAILED;
+		}
+
+	private:
+		std::string m_filename;
+		std::string m_path;
+		std::string m_tempPath;
+		FILE *m_file;
+		Json m_rootNode;
+		SaveGameWriter::Compression m_compression;
+		size_t m_bytesWritten;
+		double m_milliseconds;
+		bool m_ok;
+	};
+} // namespace
+
+namespace SaveGameWriter {
+	Compression GetConfiguredCompression()
+	{
+		return Pi::config->String("SaveCompression") == "lz4" ? SaveGameFormat::COMPRESSION_LZ4 : SaveGameFormat::COMPRESSION_GZIP;
+	}
+
+	bool Write(const std::string &filename, const std::string &path, Json &&rootNode, Compression compression)
+	{
+		PROFILE_SCOPED()
+		WaitForPending();
+
+		const std::string tempPath = path + ".tmp";
+		FILE *file = FileSystem::userFiles.OpenWriteStream(tempPath);
+		if (!file)
+			return false;
+
+		s_status.state = STATE_WRITING;
+		s_status.filename = filename;
+		s_status.bytesWritten = 0;
+		s_status.milliseconds = 0.0;
+		s_job = Pi::GetAsyncJobQueue()->Queue(new WriteJob(filename, path, tempPath, file, std::move(rootNode), compression));
+		return true;
+	}
+
+	void WaitForPending()
+	{
+		PROFILE_SCOPED()
+		if (s_status.state != STATE_WRITING)
+			return;
+
+		// this also finishes other jobs, which is fine from the main thread
+		while (s_job.HasJob()) {
+			if (!Pi::GetAsyncJobQueue()->FinishJobs())
+				SDL_Delay(1);
+		}
+		if (s_status.state == STATE_WRITING)
+			s_status.state = STATE_FAILED;
+	}
+
+	bool IsWriting()
+	{
+		return s_status.state == STATE_WRITING;
+	}
+
+	const Status &GetStatus()
+	{
+		return s_status;
+	}
+
+	void Uninit()
+	{
+		// don't lose a save that is still being written on quitting
+		WaitForPending();
+		s_job = Job::Handle();
+	}
+} // namespace SaveGameWriter
@@ -0,0 +1,50 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SAVEGAMEWRITER_H
+#define _SAVEGAMEWRITER_H
+
+#include "Json.h"
+#include "SaveGameFormat.h"
+#include <cstdio>
+#include <string>
+
+// Writes saved games in the background. The game is snapshotted to Json on
+// the main thread by the caller, the encoding, compression and writing all
+// happen on a worker, in the sectioned SaveGameFormat. Only one save is
+// written at a time.
+namespace SaveGameWriter {
+	using Compression = SaveGameFormat::Compression;
+
+	enum State {
+		STATE_IDLE,
+		STATE_WRITING,
+		STATE_DONE,
+		STATE_FAILED,
+	};
+
+	struct Status {
+		State state = STATE_IDLE;
+		std::string filename;
+		size_t bytesWritten = 0;
+		double milliseconds = 0.0; // time spent on the worker
+	};
+
+	// the compression chosen by the SaveCompression config option
+	Compression GetConfiguredCompression();
+
+	// takes the snapshot and writes it to a temporary file next to 'path'
+	// (relative to the user files), which replaces the one at 'path' once
+	// complete. waits for any save still being written first, false if the
+	// temporary file couldn't be created
+	bool Write(const std::string &filename, const std::string &path, Json &&rootNode, Compression compression);
+
+	// blocks until the save in progress, if any, is on disk
+	void WaitForPending();
+	bool IsWriting();
+	const Status &GetStatus();
+
+	void Uninit();
+} // namespace SaveGameWriter
+
+#endif
@@ -677,11 +677,6 @@ void SectorView::ClearRoute()
 	m_setupRouteLines = true;
 }
 
-std::vector<SystemPath> SectorView::GetRoute()
-{
-	return m_route;
-}
-
 const std::string SectorView::AutoRoute(const SystemPath &start, const SystemPath &target, std::vector<SystemPath> &outRoute) const
 {
 	const RefCountedPtr<const Sector> start_sec = m_galaxy->GetSector(start);
@@ -7,10 +7,9 @@
 #include "FileSystem.h"
 #include "Frame.h"
 #include "GameSaveError.h"
-#include "Json.h"
-#include "JsonUtils.h"
 #include "ModelBody.h"
 #include "Pi.h"
+#include "StateSerializer.h"
 #include "StringF.h"
 #include "core/IniConfig.h"
 #include "graphics/Drawables.h"
@@ -50,30 +49,26 @@ Sfx::Sfx(const vector3d &pos, const vector3d &vel, const float speed, const SFX_
 {
 }
 
-Sfx::Sfx(const Json &jsonObj)
+Sfx::Sfx(StateSerializer::Reader &in)
 {
-	try {
-		Json sfxObj = jsonObj["sfx"];
-
-		m_pos = jsonObj["pos"];
-		m_vel = jsonObj["vel"];
-		m_age = sfxObj["age"];
-		m_type = sfxObj["type"];
-	} catch (Json::type_error &) {
-		throw SavedGameCorruptException();
-	}
+	in.BeginSection("Sfx");
+	m_pos = in.Vector();
+	m_vel = in.Vector();
+	m_age = in.Double();
+	m_speed = in.Double();
+	m_type = SFX_TYPE(in.Int32());
+	in.EndSection();
 }
 
-void Sfx::SaveToJson(Json &jsonObj)
+void Sfx::SaveToBinary(StateSerializer::Writer &out)
 {
-	Json sfxObj({}); // Create JSON object to contain sfx data.
-
-	sfxObj["pos"] = m_pos;
-	sfxObj["vel"] = m_vel;
-	sfxObj["age"] = m_age;
-	sfxObj["type"] = m_type;
-
-	jsonObj["sfx"] = sfxObj; // Add sfx object to supplied object.
+	out.BeginSection("Sfx");
+	out.Vector(m_pos);
+	out.Vector(m_vel);
+	out.Double(m_age);
+	out.Double(m_speed);
+	out.Int32(m_type);
+	out.EndSection();
 }
 
 void Sfx::SetPosition(const vector3d &p)
@@ -119,38 +114,34 @@ SfxManager::SfxManager()
 	}
 }
 
-void SfxManager::ToJson(Json &jsonObj, const FrameId fId)
+void SfxManager::ToBinary(StateSerializer::Writer &out, const FrameId fId)
 {
 	Frame *f = Frame::GetFrame(fId);
-	Json sfxArray = Json::array(); // Create JSON array to contain sfx data.
 
+	out.BeginSection("SfxManager");
 	if (f->m_sfx) {
 		for (size_t t = TYPE_EXPLOSION; t < TYPE_NONE; t++) {
 			for (size_t i = 0; i < f->m_sfx->GetNumberInstances(SFX_TYPE(t)); i++) {
 				Sfx &inst(f->m_sfx->GetInstanceByIndex(SFX_TYPE(t), i));
-				if (inst.m_type != TYPE_NONE) {
-					Json sfxArrayEl({}); // Create JSON object to contain sfx element.
-					inst.SaveToJson(sfxArrayEl);
-					sfxArray.push_back(sfxArrayEl); // Append sfx object to array.
-				}
+				if (inst.m_type != TYPE_NONE)
+					inst.SaveToBinary(out);
 			}
 		}
 	}
-
-	jsonObj["sfx_array"] = sfxArray; // Add sfx array to supplied object.
+	out.EndSection();
 }
 
-void SfxManager::FromJson(const Json &jsonObj, FrameId fId)
+void SfxManager::FromBinary(StateSerializer::Reader &in, FrameId fId)
 {
-	Json sfxArray = jsonObj["sfx_array"].get<Json::array_t>();
-
 	Frame *f = Frame::GetFrame(fId);
 
-	if (sfxArray.size()) f->m_sfx.reset(new SfxManager);
-	for (unsigned int i = 0; i < sfxArray.size(); ++i) {
-		Sfx inst(sfxArray[i]);
+	in.BeginSection("SfxManager");
+	while (!in.AtEnd()) {
+		Sfx inst(in);
+		if (!f->m_sfx) f->m_sfx.reset(new SfxManager);
 		f->m_sfx->AddInstance(inst);
 	}
+	in.EndSection();
 }
 
 SfxManager *SfxManager::AllocSfxInFrame(FrameId fId)
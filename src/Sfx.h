@@ -13,6 +13,11 @@
 class Body;
 class Frame;
 
+namespace StateSerializer {
+	class Reader;
+	class Writer;
+} // namespace StateSerializer
+
 namespace Graphics {
 	class Renderer;
 	class RenderState;
@@ -30,7 +35,7 @@ public:
 	friend class SfxManager;
 	Sfx() = delete;
 	Sfx(const vector3d &pos, const vector3d &vel, const float speed, const SFX_TYPE type);
-	Sfx(const Json &jsonObj);
+	Sfx(StateSerializer::Reader &in);
 	void SetPosition(const vector3d &p);
 	const vector3d &GetPosition() const { return m_pos; }
 
@@ -38,7 +43,7 @@ public:
 
 private:
 	void TimeStepUpdate(const float timeStep);
-	void SaveToJson(Json &jsonObj);
+	void SaveToBinary(StateSerializer::Writer &out);
 
 	vector3d m_pos;
 	vector3d m_vel;
@@ -56,8 +61,8 @@ public:
 	static void AddThrustSmoke(const Body *b, float speed, const vector3d &adjustpos);
 	static void TimeStepAll(const float timeStep, FrameId f);
 	static void RenderAll(Graphics::Renderer *r, FrameId f, const FrameId camFrame);
-	static void ToJson(Json &jsonObj, const FrameId f);
-	static void FromJson(const Json &jsonObj, FrameId f);
+	static void ToBinary(StateSerializer::Writer &out, const FrameId f);
+	static void FromBinary(StateSerializer::Reader &in, FrameId f);
 
 	//create shared models
 	static void Init(Graphics::Renderer *r);
@@ -1527,6 +1527,26 @@ void Ship::Render(Graphics::Renderer *renderer, const Camera *camera, const vect
 	}
 }
 
+// the hull heating is per ship, so only cold ships share a draw
+bool Ship::CanRenderInstanced() const
+{
+	return GetHullTemperature() <= 0.0 && ModelBody::CanRenderInstanced();
+}
+
+void Ship::RenderInstancedSolid(Graphics::Renderer *r, const Camera *camera, const std::vector<Graphics::Light> &lights, const Color &ambient, const std::vector<matrix4x4f> &trans, const std::vector<Graphics::InstanceColors> &colors)
+{
+	s_heatGradientParams.heatingAmount = 0.0f;
+	ModelBody::RenderInstancedSolid(r, camera, lights, ambient, trans, colors);
+}
+
+// the heating parameters are read when the queue is submitted, which is
+// before any ship draws the rest of its model and sets them again
+void Ship::RecordSolid(Graphics::RenderQueue *queue, const std::vector<Graphics::Light> &lights, const Color &ambient, const matrix4x4f &trans)
+{
+	s_heatGradientParams.heatingAmount = 0.0f;
+	ModelBody::RecordSolid(queue, lights, ambient, trans);
+}
+
 bool Ship::SpawnCargo(CargoBody *c_body) const
 {
 	if (m_flightState != FLYING) return false;
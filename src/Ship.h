@@ -87,6 +87,9 @@ public:
 	virtual void SetLandedOn(Planet *p, float latitude, float longitude);
 
 	virtual void Render(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform) override;
+	virtual bool CanRenderInstanced() const override;
+	virtual void RenderInstancedSolid(Graphics::Renderer *r, const Camera *camera, const std::vector<Graphics::Light> &lights, const Color &ambient, const std::vector<matrix4x4f> &trans, const std::vector<Graphics::InstanceColors> &colors) override;
+	virtual void RecordSolid(Graphics::RenderQueue *queue, const std::vector<Graphics::Light> &lights, const Color &ambient, const matrix4x4f &trans) override;
 
 	inline void ClearThrusterState()
 	{
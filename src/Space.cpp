@@ -16,18 +16,19 @@
 #include "Player.h"
 #include "SpaceStation.h"
 #include "Star.h"
+#include "StateSerializer.h"
 #include "SystemView.h"
 #include "collider/CollisionContact.h"
 #include "collider/CollisionSpace.h"
 #include "galaxy/Galaxy.h"
+#include "galaxy/SectorPrefetcher.h"
 #include "graphics/Graphics.h"
 #include "lua/LuaEvent.h"
 #include "lua/LuaTimer.h"
+#include "base64/base64.hpp"
 #include <algorithm>
 #include <functional>
 
-//#define DEBUG_CACHE
-
 static void RelocateStarportIfNecessary(SystemBody *sbody, Planet *planet, vector3d &pos, matrix3x3d &rot, const std::vector<vector3d> &prevPositions)
 {
 	const double radius = planet->GetSystemBody()->GetRadius();
@@ -189,12 +190,13 @@ Space::BodyNearList Space::BodyNearFinder::GetBodiesMaybeNear(const vector3d &po
 	return std::move(m_nearBodies);
 }
 
-Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, Space *oldSpace) :
-	m_starSystemCache(oldSpace ? oldSpace->m_starSystemCache : galaxy->NewStarSystemSlaveCache()),
+Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy) :
 	m_game(game),
 	m_bodyIndexValid(false),
 	m_sbodyIndexValid(false),
-	m_bodyNearFinder(this)
+	m_bodyNearFinder(this),
+	m_stateWriter(nullptr),
+	m_stateReader(nullptr)
 #ifndef NDEBUG
 	,
 	m_processingFinalizationQueue(false)
@@ -203,17 +205,16 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, Space *oldSpace) :
 	m_background.reset(new Background::Container(Pi::renderer, Pi::rng, this, m_game->GetGalaxy()));
 
 	m_rootFrameId = Frame::CreateFrame(FrameId::Invalid, Lang::SYSTEM, Frame::FLAG_DEFAULT, FLT_MAX);
-
-	GenSectorCache(galaxy, &game->GetHyperspaceDest());
 }
 
-Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path, Space *oldSpace) :
-	m_starSystemCache(oldSpace ? oldSpace->m_starSystemCache : galaxy->NewStarSystemSlaveCache()),
+Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path) :
 	m_starSystem(galaxy->GetStarSystem(path)),
 	m_game(game),
 	m_bodyIndexValid(false),
 	m_sbodyIndexValid(false),
-	m_bodyNearFinder(this)
+	m_bodyNearFinder(this),
+	m_stateWriter(nullptr),
+	m_stateReader(nullptr)
 #ifndef NDEBUG
 	,
 	m_processingFinalizationQueue(false)
@@ -231,23 +232,25 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path, S
 	std::vector<vector3d> positionAccumulator;
 	GenBody(m_game->GetTime(), m_starSystem->GetRootBody().Get(), m_rootFrameId, positionAccumulator);
 	Frame::UpdateOrbitRails(m_game->GetTime(), m_game->GetTimeStep());
-
-	GenSectorCache(galaxy, &path);
 }
 
 Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const Json &jsonObj, double at_time) :
-	m_starSystemCache(galaxy->NewStarSystemSlaveCache()),
 	m_game(game),
 	m_bodyIndexValid(false),
 	m_sbodyIndexValid(false),
-	m_bodyNearFinder(this)
+	m_bodyNearFinder(this),
+	m_stateWriter(nullptr),
+	m_stateReader(nullptr)
 #ifndef NDEBUG
 	,
 	m_processingFinalizationQueue(false)
 #endif
 {
 	PROFILE_SCOPED()
-	Json spaceObj = jsonObj["space"];
+	// const lookups of missing keys are undefined, check for them first
+	if (!jsonObj.count("space")) throw SavedGameCorruptException();
+	const Json &spaceObj = jsonObj["space"];
+	if (!spaceObj.count("state") || !spaceObj.count("bodies")) throw SavedGameCorruptException();
 
 	m_starSystem = StarSystem::FromJson(galaxy, spaceObj);
 
@@ -260,16 +263,27 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const Json &jsonObj, doub
 
 	CityOnPlanet::SetCityModelPatterns(m_starSystem->GetPath());
 
-	if (!spaceObj.count("frame")) throw SavedGameCorruptException();
-	m_rootFrameId = Frame::FromJson(spaceObj["frame"], this, FrameId::Invalid, at_time);
+	if (!spaceObj["state"].is_string()) throw SavedGameCorruptException();
+	std::string state;
+	if (!Base64::Decode(spaceObj["state"].get<std::string>(), &state)) throw SavedGameCorruptException();
+	StateSerializer::Reader reader(state);
+	m_stateReader = &reader;
+
+	reader.BeginSection("Frames");
+	m_rootFrameId = Frame::FromBinary(reader, this, FrameId::Invalid, at_time);
+	reader.EndSection();
 
 	try {
-		Json bodyArray = spaceObj["bodies"].get<Json::array_t>();
+		const Json &bodyArray = spaceObj["bodies"];
+		if (!bodyArray.is_array()) throw SavedGameCorruptException();
+		reader.BeginSection("Bodies");
 		for (Uint32 i = 0; i < bodyArray.size(); i++)
 			m_bodies.push_back(Body::FromJson(bodyArray[i], this));
+		reader.EndSection();
 	} catch (Json::type_error &) {
 		throw SavedGameCorruptException();
 	}
+	m_stateReader = nullptr;
 
 	RebuildBodyIndex();
 
@@ -301,8 +315,6 @@ Space::Space(Game *game, RefCountedPtr<Galaxy> galaxy, const Json &jsonObj, doub
 		}
 	}
 
-	GenSectorCache(galaxy, &path);
-
 	//DebugDumpFrames();
 }
 
@@ -334,17 +346,31 @@ void Space::ToJson(Json &jsonObj)
 
 	StarSystem::ToJson(spaceObj, m_starSystem.Get());
 
-	Json frameObj({});
-	Frame::ToJson(frameObj, m_rootFrameId, this);
-	spaceObj["frame"] = frameObj;
+	// frames and the bulk of the bodies' state go into a binary blob,
+	// everything else stays in Json
+	StateSerializer::Writer writer;
+	m_stateWriter = &writer;
+
+	writer.BeginSection("Frames");
+	Frame::ToBinary(writer, m_rootFrameId, this);
+	writer.EndSection();
 
+	writer.BeginSection("Bodies");
 	Json bodyArray = Json::array(); // Create JSON array to contain body data.
 	for (Body *b : m_bodies) {
 		Json bodyArrayEl({}); // Create JSON object to contain body.
 		b->ToJson(bodyArrayEl, this);
-		bodyArray.push_back(bodyArrayEl); // Append body object to array.
+		bodyArray.push_back(std::move(bodyArrayEl)); // Append body object to array.
 	}
-	spaceObj["bodies"] = bodyArray; // Add body array to space object.
+	spaceObj["bodies"] = std::move(bodyArray); // Add body array to space object.
+	writer.EndSection();
+
+	m_stateWriter = nullptr;
+
+	// base64 so the save stays valid Json when dumped
+	std::string state;
+	Base64::Encode(writer.GetData(), &state);
+	spaceObj["state"] = std::move(state);
 
 	jsonObj["space"] = spaceObj; // Add space object to supplied object.
 }
@@ -466,8 +492,9 @@ void Space::GetHyperspaceExitParams(const SystemPath &source, const SystemPath &
 
 	assert(dest.IsSameSystem(m_starSystem->GetPath()));
 
-	RefCountedPtr<const Sector> source_sec = m_sectorCache->GetCached(source);
-	RefCountedPtr<const Sector> dest_sec = m_sectorCache->GetCached(dest);
+	RefCountedPtr<SectorCache::Slave> sectorCache = m_game->GetSectorPrefetcher()->GetSectorCache();
+	RefCountedPtr<const Sector> source_sec = sectorCache->GetCached(source);
+	RefCountedPtr<const Sector> dest_sec = sectorCache->GetCached(dest);
 
 	Sector::System source_sys = source_sec->m_systems[source.systemIndex];
 	Sector::System dest_sys = dest_sec->m_systems[dest.systemIndex];
@@ -571,130 +598,6 @@ FrameId Space::GetFrameWithSystemBody(const SystemBody *b) const
 	return find_frame_with_sbody(m_rootFrameId, b);
 }
 
-// used to define a cube centred on your current location
-static const int sectorRadius = 5;
-
-// sort using a custom function object
-class SectorDistanceSort {
-public:
-	bool operator()(const SystemPath &a, const SystemPath &b)
-	{
-		const float dist_a = vector3f(here.sectorX - a.sectorX, here.sectorY - a.sectorY, here.sectorZ - a.sectorZ).LengthSqr();
-		const float dist_b = vector3f(here.sectorX - b.sectorX, here.sectorY - b.sectorY, here.sectorZ - b.sectorZ).LengthSqr();
-		return dist_a < dist_b;
-	}
-	SectorDistanceSort(const SystemPath *centre) :
-		here(centre)
-	{}
-
-private:
-	SectorDistanceSort() {}
-	SystemPath here;
-};
-
-void Space::GenSectorCache(RefCountedPtr<Galaxy> galaxy, const SystemPath *here)
-{
-	PROFILE_SCOPED()
-
-	// current location
-	if (!here) {
-		if (!m_starSystem.Valid())
-			return;
-		here = &m_starSystem->GetPath();
-	}
-	const int here_x = here->sectorX;
-	const int here_y = here->sectorY;
-	const int here_z = here->sectorZ;
-
-	SectorCache::PathVector paths;
-	// build all of the possible paths we'll need to build sectors for
-	for (int x = here_x - sectorRadius; x <= here_x + sectorRadius; x++) {
-		for (int y = here_y - sectorRadius; y <= here_y + sectorRadius; y++) {
-			for (int z = here_z - sectorRadius; z <= here_z + sectorRadius; z++) {
-				SystemPath path(x, y, z);
-				paths.push_back(path);
-			}
-		}
-	}
-	// sort them so that those closest to the "here" path are processed first
-	SectorDistanceSort SDS(here);
-	std::sort(paths.begin(), paths.end(), SDS);
-	m_sectorCache = galaxy->NewSectorSlaveCache();
-	const SystemPath &center(*here);
-	m_sectorCache->FillCache(paths, [this, center]() { UpdateStarSystemCache(&center); });
-}
-
-static bool WithinBox(const SystemPath &here, const int Xmin, const int Xmax, const int Ymin, const int Ymax, const int Zmin, const int Zmax)
-{
-	PROFILE_SCOPED()
-	if (here.sectorX >= Xmin && here.sectorX <= Xmax) {
-		if (here.sectorY >= Ymin && here.sectorY <= Ymax) {
-			if (here.sectorZ >= Zmin && here.sectorZ <= Zmax) {
-				return true;
-			}
-		}
-	}
-	return false;
-}
-
-void Space::UpdateStarSystemCache(const SystemPath *here)
-{
-	PROFILE_SCOPED()
-
-	// current location
-	if (!here) {
-		if (!m_starSystem.Valid())
-			return;
-		here = &m_starSystem->GetPath();
-	}
-	const int here_x = here->sectorX;
-	const int here_y = here->sectorY;
-	const int here_z = here->sectorZ;
-
-	// we're going to use these to determine if our StarSystems are within a range that we'll keep for later use
-	static const int survivorRadius = sectorRadius * 3;
-
-	// min/max box limits
-	const int xmin = here->sectorX - survivorRadius;
-	const int xmax = here->sectorX + survivorRadius;
-	const int ymin = here->sectorY - survivorRadius;
-	const int ymax = here->sectorY + survivorRadius;
-	const int zmin = here->sectorZ - survivorRadius;
-	const int zmax = here->sectorZ + survivorRadius;
-
-#ifdef DEBUG_CACHE
-	unsigned removed = 0;
-#endif
-	StarSystemCache::CacheMap::const_iterator i = m_starSystemCache->Begin();
-	while (i != m_starSystemCache->End()) {
-		if (!WithinBox(i->second->GetPath(), xmin, xmax, ymin, ymax, zmin, zmax)) {
-			m_starSystemCache->Erase(i++);
-#ifdef DEBUG_CACHE
-			++removed;
-#endif
-		} else
-			++i;
-	}
-#ifdef DEBUG_CACHE
-	Output("%s: Erased %u entries.\n", StarSystemCache::CACHE_NAME.c_str(), removed);
-#endif
-
-	SectorCache::PathVector paths;
-	// build all of the possible paths we'll need to build star systems for
-	for (int x = here_x - sectorRadius; x <= here_x + sectorRadius; x++) {
-		for (int y = here_y - sectorRadius; y <= here_y + sectorRadius; y++) {
-			for (int z = here_z - sectorRadius; z <= here_z + sectorRadius; z++) {
-				SystemPath path(x, y, z);
-				RefCountedPtr<Sector> sec(m_sectorCache->GetIfCached(path));
-				assert(sec);
-				for (const Sector::System &ss : sec->m_systems)
-					paths.push_back(SystemPath(ss.sx, ss.sy, ss.sz, ss.idx));
-			}
-		}
-	}
-	m_starSystemCache->FillCache(paths);
-}
-
 static FrameId MakeFramesFor(const double at_time, SystemBody *sbody, Body *b, FrameId fId, std::vector<vector3d> &prevPositions)
 {
 	PROFILE_SCOPED()
@@ -16,13 +16,18 @@ class Frame;
 class Game;
 enum class ObjectType;
 
+namespace StateSerializer {
+	class Reader;
+	class Writer;
+} // namespace StateSerializer
+
 class Space {
 public:
 	// empty space (eg for hyperspace)
-	Space(Game *game, RefCountedPtr<Galaxy> galaxy, Space *oldSpace = nullptr);
+	Space(Game *game, RefCountedPtr<Galaxy> galaxy);
 
 	// initalise with system bodies
-	Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path, Space *oldSpace = nullptr);
+	Space(Game *game, RefCountedPtr<Galaxy> galaxy, const SystemPath &path);
 
 	// initialise from save file
 	Space(Game *game, RefCountedPtr<Galaxy> galaxy, const Json &jsonObj, double at_time);
@@ -39,6 +44,11 @@ public:
 	Uint32 GetIndexForBody(const Body *body) const;
 	Uint32 GetIndexForSystemBody(const SystemBody *sbody) const;
 
+	// frames and the physical state of bodies are stored in binary, these
+	// are only set while ToJson() or the loading constructor are running
+	StateSerializer::Writer *GetStateWriter() const { return m_stateWriter; }
+	StateSerializer::Reader *GetStateReader() const { return m_stateReader; }
+
 	RefCountedPtr<StarSystem> GetStarSystem() const { return m_starSystem; }
 
 	FrameId GetRootFrame() const { return m_rootFrameId; }
@@ -86,8 +96,6 @@ public:
 	void DebugDumpFrames(bool details);
 
 private:
-	void GenSectorCache(RefCountedPtr<Galaxy> galaxy, const SystemPath *here);
-	void UpdateStarSystemCache(const SystemPath *here);
 	void GenBody(const double at_time, SystemBody *b, FrameId fId, std::vector<vector3d> &posAccum);
 	// make sure SystemBody* is in Pi::currentSystem
 	FrameId GetFrameWithSystemBody(const SystemBody *b) const;
@@ -98,9 +106,6 @@ private:
 
 	FrameId m_rootFrameId;
 
-	RefCountedPtr<SectorCache::Slave> m_sectorCache;
-	RefCountedPtr<StarSystemCache::Slave> m_starSystemCache;
-
 	RefCountedPtr<StarSystem> m_starSystem;
 
 	Game *m_game;
@@ -159,6 +164,9 @@ private:
 
 	BodyNearFinder m_bodyNearFinder;
 
+	StateSerializer::Writer *m_stateWriter;
+	StateSerializer::Reader *m_stateReader;
+
 #ifndef NDEBUG
 	//to check RemoveBody and KillBody are not called from within
 	//the NotifyRemoved callback (#735)
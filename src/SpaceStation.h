@@ -48,6 +48,8 @@ public:
 	virtual bool OnCollision(Body *b, Uint32 flags, double relVel) override;
 	bool DoShipDamage(Ship *s, Uint32 flags, double relVel);
 	virtual void Render(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform) override;
+	// stations are few and ground ones are lit with their city
+	virtual bool CanRenderInstanced() const override { return false; }
 	virtual void StaticUpdate(const float timeStep) override;
 	virtual void TimeStepUpdate(const float timeStep) override;
 
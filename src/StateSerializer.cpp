@@ -0,0 +1,356 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "StateSerializer.h"
+
+#include "GameSaveError.h"
+#include "profiler/Profiler.h"
+#include <SDL_endian.h>
+#include <cstring>
+
+namespace StateSerializer {
+	static const char MAGIC[4] = { 'P', 'B', 'I', 'N' };
+
+	enum Tag : Uint8 {
+		TAG_BOOL = 1,
+		TAG_INT32,
+		TAG_INT64,
+		TAG_DOUBLE,
+		TAG_STRING, // index into the string table
+		TAG_VECTOR, // 3 doubles
+		TAG_MATRIX, // 9 doubles
+		TAG_SECTION // name index, payload length
+	};
+
+	static inline void AppendU32(std::string &out, Uint32 v)
+	{
+		v = SDL_SwapLE32(v);
+		out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+	}
+
+	static inline Uint64 DoubleBits(double d)
+	{
+		Uint64 v;
+		memcpy(&v, &d, sizeof(v));
+		return SDL_SwapLE64(v);
+	}
+
+	static inline double BitsDouble(Uint64 v)
+	{
+		v = SDL_SwapLE64(v);
+		double d;
+		memcpy(&d, &v, sizeof(d));
+		return d;
+	}
+
+	// ------ Writer ------
+
+	Writer::Writer()
+	{
+		m_payload.reserve(64 * 1024);
+	}
+
+	void Writer::Tag(Uint8 tag)
+	{
+		m_payload.push_back(char(tag));
+	}
+
+	void Writer::Raw(const void *data, size_t size)
+	{
+		m_payload.append(static_cast<const char *>(data), size);
+	}
+
+	Uint32 Writer::StringIndex(const std::string &s)
+	{
+		auto it = m_stringIndex.find(s);
+		if (it != m_stringIndex.end())
+			return it->second;
+		const Uint32 idx = m_strings.size();
+		m_strings.push_back(s);
+		m_stringIndex.emplace(s, idx);
+		return idx;
+	}
+
+	void Writer::Bool(bool v)
+	{
+		Tag(TAG_BOOL);
+		m_payload.push_back(v ? 1 : 0);
+	}
+
+	void Writer::Int32(Sint32 v)
+	{
+		Tag(TAG_INT32);
+		AppendU32(m_payload, Uint32(v));
+	}
+
+	void Writer::Int64(Sint64 v)
+	{
+		Tag(TAG_INT64);
+		const Uint64 le = SDL_SwapLE64(Uint64(v));
+		Raw(&le, sizeof(le));
+	}
+
+	void Writer::Double(double v)
+	{
+		Tag(TAG_DOUBLE);
+		const Uint64 bits = DoubleBits(v);
+		Raw(&bits, sizeof(bits));
+	}
+
+	void Writer::String(const std::string &v)
+	{
+		Tag(TAG_STRING);
+		AppendU32(m_payload, StringIndex(v));
+	}
+
+	void Writer::Vector(const vector3d &v)
+	{
+		Tag(TAG_VECTOR);
+		const Uint64 bits[3] = { DoubleBits(v.x), DoubleBits(v.y), DoubleBits(v.z) };
+		Raw(bits, sizeof(bits));
+	}
+
+	void Writer::Matrix(const matrix3x3d &m)
+	{
+		Tag(TAG_MATRIX);
+		Uint64 bits[9];
+		for (int i = 0; i < 9; i++)
+			bits[i] = DoubleBits(m[i]);
+		Raw(bits, sizeof(bits));
+	}
+
+	void Writer::BeginSection(const char *name)
+	{
+		Tag(TAG_SECTION);
+		AppendU32(m_payload, StringIndex(name));
+		m_openSections.push_back(m_payload.size());
+		AppendU32(m_payload, 0); // patched by EndSection
+	}
+
+	void Writer::EndSection()
+	{
+		assert(!m_openSections.empty());
+		const size_t lengthPos = m_openSections.back();
+		m_openSections.pop_back();
+		const Uint32 length = SDL_SwapLE32(Uint32(m_payload.size() - lengthPos - sizeof(Uint32)));
+		memcpy(&m_payload[lengthPos], &length, sizeof(length));
+	}
+
+	std::string Writer::GetData() const
+	{
+		PROFILE_SCOPED()
+		assert(m_openSections.empty());
+
+		size_t size = sizeof(MAGIC) + 3 * sizeof(Uint32) + m_payload.size();
+		for (const std::string &s : m_strings)
+			size += sizeof(Uint32) + s.size();
+
+		std::string out;
+		out.reserve(size);
+		out.append(MAGIC, sizeof(MAGIC));
+		AppendU32(out, FORMAT_VERSION);
+		AppendU32(out, m_strings.size());
+		for (const std::string &s : m_strings) {
+			AppendU32(out, s.size());
+			out.append(s);
+		}
+		AppendU32(out, m_payload.size());
+		out.append(m_payload);
+		return out;
+	}
+
+	// ------ Reader ------
+
+	Reader::Reader(const std::string &data) :
+		m_pos(data.data()),
+		m_end(data.data() + data.size()),
+		m_version(0)
+	{
+		PROFILE_SCOPED()
+		char magic[sizeof(MAGIC)];
+		Raw(magic, sizeof(magic));
+		if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+			throw SavedGameCorruptException();
+
+		Uint32 numStrings;
+		Raw(&m_version, sizeof(m_version));
+		Raw(&numStrings, sizeof(numStrings));
+		m_version = SDL_SwapLE32(m_version);
+		numStrings = SDL_SwapLE32(numStrings);
+		if (m_version > FORMAT_VERSION || numStrings > size_t(m_end - m_pos) / sizeof(Uint32))
+			throw SavedGameCorruptException();
+
+		m_strings.reserve(numStrings);
+		for (Uint32 i = 0; i < numStrings; i++) {
+			Uint32 len;
+			Raw(&len, sizeof(len));
+			len = SDL_SwapLE32(len);
+			if (len > size_t(m_end - m_pos))
+				throw SavedGameCorruptException();
+			m_strings.emplace_back(m_pos, len);
+			m_pos += len;
+		}
+
+		Uint32 payloadSize;
+		Raw(&payloadSize, sizeof(payloadSize));
+		payloadSize = SDL_SwapLE32(payloadSize);
+		if (payloadSize != size_t(m_end - m_pos))
+			throw SavedGameCorruptException();
+	}
+
+	void Reader::Raw(void *out, size_t size)
+	{
+		const char *end = m_sectionEnds.empty() ? m_end : m_sectionEnds.back();
+		if (size > size_t(end - m_pos))
+			throw SavedGameCorruptException();
+		memcpy(out, m_pos, size);
+		m_pos += size;
+	}
+
+	Uint8 Reader::PeekTag() const
+	{
+		return AtEnd() ? 0 : Uint8(*m_pos);
+	}
+
+	void Reader::Expect(Uint8 tag)
+	{
+		if (PeekTag() != tag)
+			throw SavedGameCorruptException();
+		++m_pos;
+	}
+
+	bool Reader::AtEnd() const
+	{
+		return m_pos >= (m_sectionEnds.empty() ? m_end : m_sectionEnds.back());
+	}
+
+	bool Reader::Bool()
+	{
+		Expect(TAG_BOOL);
+		Uint8 v;
+		Raw(&v, sizeof(v));
+		return v != 0;
+	}
+
+	Sint32 Reader::Int32()
+	{
+		Expect(TAG_INT32);
+		Uint32 v;
+		Raw(&v, sizeof(v));
+		return Sint32(SDL_SwapLE32(v));
+	}
+
+	Sint64 Reader::Int64()
+	{
+		Expect(TAG_INT64);
+		Uint64 v;
+		Raw(&v, sizeof(v));
+		return Sint64(SDL_SwapLE64(v));
+	}
+
+	double Reader::Double()
+	{
+		Expect(TAG_DOUBLE);
+		Uint64 v;
+		Raw(&v, sizeof(v));
+		return BitsDouble(v);
+	}
+
+	const std::string &Reader::String()
+	{
+		Expect(TAG_STRING);
+		Uint32 idx;
+		Raw(&idx, sizeof(idx));
+		idx = SDL_SwapLE32(idx);
+		if (idx >= m_strings.size())
+			throw SavedGameCorruptException();
+		return m_strings[idx];
+	}
+
+	vector3d Reader::Vector()
+	{
+		Expect(TAG_VECTOR);
+		Uint64 bits[3];
+		Raw(bits, sizeof(bits));
+		return vector3d(BitsDouble(bits[0]), BitsDouble(bits[1]), BitsDouble(bits[2]));
+	}
+
+	matrix3x3d Reader::Matrix()
+	{
+		Expect(TAG_MATRIX);
+		Uint64 bits[9];
+		Raw(bits, sizeof(bits));
+		matrix3x3d m;
+		for (int i = 0; i < 9; i++)
+			m[i] = BitsDouble(bits[i]);
+		return m;
+	}
+
+	void Reader::BeginSection(const char *name)
+	{
+		Expect(TAG_SECTION);
+		Uint32 idx, length;
+		Raw(&idx, sizeof(idx));
+		Raw(&length, sizeof(length));
+		idx = SDL_SwapLE32(idx);
+		length = SDL_SwapLE32(length);
+		const char *end = m_sectionEnds.empty() ? m_end : m_sectionEnds.back();
+		if (idx >= m_strings.size() || m_strings[idx] != name || length > size_t(end - m_pos))
+			throw SavedGameCorruptException();
+		m_sectionEnds.push_back(m_pos + length);
+	}
+
+	void Reader::EndSection()
+	{
+		assert(!m_sectionEnds.empty());
+		m_pos = m_sectionEnds.back();
+		m_sectionEnds.pop_back();
+	}
+
+	Json Reader::ValueToJson()
+	{
+		switch (PeekTag()) {
+		case TAG_BOOL: return Bool();
+		case TAG_INT32: return Int32();
+		case TAG_INT64: return Int64();
+		case TAG_DOUBLE: return Double();
+		case TAG_STRING: return String();
+		case TAG_VECTOR: {
+			const vector3d v = Vector();
+			return Json::array({ v.x, v.y, v.z });
+		}
+		case TAG_MATRIX: {
+			const matrix3x3d m = Matrix();
+			return Json::array({ m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8] });
+		}
+		case TAG_SECTION: {
+			// peek at the name without knowing it in advance
+			const char *end = m_sectionEnds.empty() ? m_end : m_sectionEnds.back();
+			Uint32 idx;
+			if (size_t(end - m_pos) < 1 + sizeof(idx))
+				throw SavedGameCorruptException();
+			memcpy(&idx, m_pos + 1, sizeof(idx));
+			idx = SDL_SwapLE32(idx);
+			if (idx >= m_strings.size())
+				throw SavedGameCorruptException();
+			BeginSection(m_strings[idx].c_str());
+			Json values = Json::array();
+			while (!AtEnd())
+				values.push_back(ValueToJson());
+			EndSection();
+			return Json::object({ { "section", m_strings[idx] }, { "values", values } });
+		}
+		default:
+			throw SavedGameCorruptException();
+		}
+	}
+
+	Json ToJson(const std::string &data)
+	{
+		Reader reader(data);
+		Json values = Json::array();
+		while (!reader.AtEnd())
+			values.push_back(reader.ValueToJson());
+		return Json::object({ { "version", reader.GetVersion() }, { "values", values } });
+	}
+} // namespace StateSerializer
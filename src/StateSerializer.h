@@ -0,0 +1,112 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _STATESERIALIZER_H
+#define _STATESERIALIZER_H
+
+#include "Json.h"
+#include "matrix3x3.h"
+#include "vector3.h"
+#include <SDL_stdinc.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Compact binary serialization for bulk game state (frames and the physical
+	state of bodies), which would otherwise cost several heap allocations and a
+	round trip through text for every vector and matrix in the Json DOM.
+
+	A blob is laid out as:
+
+		"PBIN" magic, Uint32 format version
+		Uint32 string count, then each string as Uint32 length + bytes
+		Uint32 payload size, then the payload
+
+	The payload is a sequence of values, each a one byte tag followed by the
+	value in little endian order. Strings are written once into the string
+	table and referred to by index. Sections are named (through the string
+	table) and length prefixed so a reader can check it is where it expects to
+	be, skip what it doesn't understand, and ToJson() can dump a blob without
+	knowing what is in it.
+
+	Unlike the model Serializer (scenegraph/Serializer.h) every read is bounds
+	checked and the byte order is fixed, as saved games are passed around.
+*/
+namespace StateSerializer {
+	static const Uint32 FORMAT_VERSION = 1;
+
+	class Writer {
+	public:
+		Writer();
+
+		void Bool(bool v);
+		void Int32(Sint32 v);
+		void Int64(Sint64 v);
+		void Double(double v);
+		void String(const std::string &v);
+		void Vector(const vector3d &v);
+		void Matrix(const matrix3x3d &m);
+
+		// sections nest; every BeginSection needs a matching EndSection
+		void BeginSection(const char *name);
+		void EndSection();
+
+		// the finished blob, header and string table included
+		std::string GetData() const;
+
+	private:
+		void Tag(Uint8 tag);
+		void Raw(const void *data, size_t size);
+		Uint32 StringIndex(const std::string &s);
+
+		std::string m_payload;
+		std::vector<std::string> m_strings;
+		std::unordered_map<std::string, Uint32> m_stringIndex;
+		std::vector<size_t> m_openSections; // offsets of the length fields to patch
+	};
+
+	// Reads back what a Writer wrote, in the same order. Throws
+	// SavedGameCorruptException if the data doesn't match what is asked for.
+	// The reader doesn't copy the blob, which must outlive it.
+	class Reader {
+	public:
+		explicit Reader(const std::string &data);
+
+		Uint32 GetVersion() const { return m_version; }
+
+		bool Bool();
+		Sint32 Int32();
+		Sint64 Int64();
+		double Double();
+		const std::string &String();
+		vector3d Vector();
+		matrix3x3d Matrix();
+
+		// enters the next section, which must be called name
+		void BeginSection(const char *name);
+		// leaves the current section, skipping anything left unread in it
+		void EndSection();
+		// true when the current section (or the payload) has been read completely
+		bool AtEnd() const;
+
+	private:
+		friend Json ToJson(const std::string &data);
+
+		Uint8 PeekTag() const;
+		void Expect(Uint8 tag);
+		void Raw(void *out, size_t size);
+		Json ValueToJson();
+
+		const char *m_pos;
+		const char *m_end;
+		Uint32 m_version;
+		std::vector<std::string> m_strings;
+		std::vector<const char *> m_sectionEnds;
+	};
+
+	// decodes a blob into Json, for inspection with savegamedump
+	Json ToJson(const std::string &data);
+} // namespace StateSerializer
+
+#endif /* _STATESERIALIZER_H */
@@ -3,149 +3,325 @@
 
 #include "BVHTree.h"
 #include "buildopts.h"
+#include "scenegraph/Serializer.h"
+#include <algorithm>
+#include <cmath>
 #include <float.h>
 #include <stdio.h>
 
-const int MAX_SPLITPOS_RETRIES = 15;
+// relative costs for the surface area heuristic
+static const float TRAVERSAL_COST = 1.0f;
+static const float INTERSECT_COST = 2.0f;
+// the heuristic decides between a leaf and a split below this
+static const Uint32 MAX_LEAF_OBJS = 8;
+static const int NUM_BINS = 16;
+// below this depth splits are balanced, so the tree can't get deeper than
+// MAX_DEPTH with fewer than 2^32 objects
+static const int MAX_UNBALANCED_DEPTH = BVHTree::MAX_DEPTH - 32;
+// for the midpoint builder
+static const int MAX_SPLITPOS_RETRIES = 15;
 
-BVHTree::BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs)
+struct BVHTree::BuildObj {
+	vector3f min;
+	vector3f max;
+	vector3f centroid;
+	objPtr_t objPtr;
+};
+
+// float bounds that still contain the double ones
+static float RoundDown(double d)
 {
-	PROFILE_SCOPED()
-	Profiler::Timer timer;
-	timer.Start();
+	float f = float(d);
+	if (double(f) > d) f = std::nextafter(f, -FLT_MAX);
+	return f;
+}
 
-	std::vector<int> activeObjIdxs(numObjs);
-	for (int i = 0; i < numObjs; i++)
-		activeObjIdxs[i] = i;
+static float RoundUp(double d)
+{
+	float f = float(d);
+	if (double(f) < d) f = std::nextafter(f, FLT_MAX);
+	return f;
+}
 
-	m_objPtrAlloc = new objPtr_t[numObjs];
-	m_objPtrAllocPos = 0;
-	m_objPtrAllocMax = numObjs;
+// half the surface area, only ever compared
+static float Area(const vector3f &min, const vector3f &max)
+{
+	const vector3f d = max - min;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
 
-	m_bvhNodes = new BVHNode[numObjs * 2 + 1];
-	m_nodeAllocPos = 0;
-	m_nodeAllocMax = numObjs * 2 + 1;
+static int LongestAxis(const vector3f &min, const vector3f &max)
+{
+	const vector3f size = max - min;
+	int axis = 0;
+	if (size.y > size.x) axis = 1;
+	if ((size.z > size.y) && (size.z > size.x)) axis = 2;
+	return axis;
+}
+
+BVHTree::BVHTree(const int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs, SplitMethod method)
+{
+	PROFILE_SCOPED()
+	if (numObjs <= 0) Error("BVHTree built with no objects.");
 
-	m_root = AllocNode();
-	BuildNode(m_root, objPtrs, objAabbs, activeObjIdxs);
+	std::vector<BuildObj> objs(numObjs);
+	for (int i = 0; i < numObjs; i++) {
+		const Aabb &aabb = objAabbs[i];
+		BuildObj &obj = objs[i];
+		obj.min = vector3f(RoundDown(aabb.min.x), RoundDown(aabb.min.y), RoundDown(aabb.min.z));
+		obj.max = vector3f(RoundUp(aabb.max.x), RoundUp(aabb.max.y), RoundUp(aabb.max.z));
+		obj.centroid = 0.5f * (obj.min + obj.max);
+		obj.objPtr = objPtrs[i];
+	}
 
-	timer.Stop();
-	//Output(" - - - BVHTree::BVHTree took: %lf milliseconds\n", timer.millicycles());
+	// a binary tree with numObjs leaves at most
+	m_nodes.reserve(2 * numObjs - 1);
+	m_objPtrs.reserve(numObjs);
+	BuildNode(&objs[0], numObjs, 0, method);
+	//Output(" - - - BVHTree::BVHTree %d objects, %d nodes, depth %d, cost %f\n", numObjs, int(m_nodes.size()), GetDepth(), GetCost());
 }
 
-void BVHTree::MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPtr_t> &objs)
+void BVHTree::BuildNode(BuildObj *objs, Uint32 count, int depth, SplitMethod method)
 {
-	const size_t numTris = objs.size();
-	if (numTris <= 0) Error("MakeLeaf called with no elements in objs.");
+	const Uint32 index = m_nodes.size();
+	m_nodes.emplace_back();
 
-	if (numTris > m_objPtrAllocMax - m_objPtrAllocPos) {
-		Error("Out of space in m_objPtrAlloc. Left: " SIZET_FMT "; required: " SIZET_FMT ".", m_objPtrAllocMax - m_objPtrAllocPos, numTris);
+	vector3f min(FLT_MAX), max(-FLT_MAX);
+	for (Uint32 i = 0; i < count; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			min[axis] = std::min(min[axis], objs[i].min[axis]);
+			max[axis] = std::max(max[axis], objs[i].max[axis]);
+		}
 	}
+	m_nodes[index].min = min;
+	m_nodes[index].max = max;
 
-	node->numTris = numTris;
-	node->triIndicesStart = &m_objPtrAlloc[m_objPtrAllocPos];
-	//if (objs.size()>3) Output("fat node %d\n", objs.size());
+	Uint32 split = 0;
+	if (count > 1) {
+		if (depth >= MAX_UNBALANCED_DEPTH)
+			split = MedianSplit(objs, count, min, max);
+		else if (method == SPLIT_SAH)
+			split = FindSAHSplit(objs, count, min, max);
+		else
+			split = FindMidpointSplit(objs, count, min, max);
+	}
 
-	// copy tri indices to the stinking flat array
-	for (int i = numTris - 1; i >= 0; i--) {
-		m_objPtrAlloc[m_objPtrAllocPos++] = objPtrs[objs[i]];
+	if (split == 0) {
+		m_nodes[index].offset = m_objPtrs.size();
+		m_nodes[index].numObjs = count;
+		for (Uint32 i = 0; i < count; i++)
+			m_objPtrs.push_back(objs[i].objPtr);
+		return;
 	}
+
+	// the left child comes next, and the right one after the left subtree
+	m_nodes[index].numObjs = 0;
+	BuildNode(objs, split, depth + 1, method);
+	m_nodes[index].offset = m_nodes.size() - index;
+	BuildNode(objs + split, count - split, depth + 1, method);
 }
 
-void BVHTree::BuildNode(BVHNode *node,
-	const objPtr_t *objPtrs,
-	const Aabb *objAabbs,
-	std::vector<objPtr_t> &activeObjIdx)
+// splits in half by centroid along the longest axis
+Uint32 BVHTree::MedianSplit(BuildObj *objs, Uint32 count, const vector3f &min, const vector3f &max)
 {
-	const int numTris = activeObjIdx.size();
-	if (numTris <= 0) Error("BuildNode called with no elements in activeObjIndex.");
+	const int axis = LongestAxis(min, max);
+	std::nth_element(objs, objs + count / 2, objs + count, [axis](const BuildObj &a, const BuildObj &b) {
+		return a.centroid[axis] < b.centroid[axis];
+	});
+	return count / 2;
+}
 
-	if (numTris == 1) {
-		MakeLeaf(node, objPtrs, activeObjIdx);
-		return;
+// returns how many objects go to the left, having moved them to the front,
+// or 0 for a leaf
+Uint32 BVHTree::FindSAHSplit(BuildObj *objs, Uint32 count, const vector3f &min, const vector3f &max)
+{
+	vector3f cmin(FLT_MAX), cmax(-FLT_MAX);
+	for (Uint32 i = 0; i < count; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			cmin[axis] = std::min(cmin[axis], objs[i].centroid[axis]);
+			cmax[axis] = std::max(cmax[axis], objs[i].centroid[axis]);
+		}
 	}
 
-	std::vector<int> splitSides(numTris);
+	struct Bin {
+		vector3f min, max;
+		Uint32 count;
+	};
 
-	Aabb aabb;
-	aabb.min = vector3d(FLT_MAX, FLT_MAX, FLT_MAX);
-	aabb.max = vector3d(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		const float extent = cmax[axis] - cmin[axis];
+		if (!(extent > 0.0f)) continue;
+		const float scale = NUM_BINS / extent;
 
-	for (int i = 0; i < numTris; i++) {
-		const int idx = activeObjIdx[i];
-		aabb.Update(objAabbs[idx].min);
-		aabb.Update(objAabbs[idx].max);
-	}
-	node->numTris = numTris;
-	node->aabb = aabb;
-
-	Aabb splitBox = aabb;
-	double splitPos;
-	int splitAxis;
-	int s1count, s2count;
-	int attempt = 0;
-
-	for (;;) {
-		splitAxis = 0;
-
-		const vector3d boxSize = splitBox.max - splitBox.min;
-
-		if (boxSize[1] > boxSize[0]) splitAxis = 1;
-		if ((boxSize[2] > boxSize[1]) && (boxSize[2] > boxSize[0])) splitAxis = 2;
-
-		// split pos in middle of splitBox
-		splitPos = 0.5f * (splitBox.min[splitAxis] + splitBox.max[splitAxis]);
-		s1count = 0, s2count = 0;
-
-		for (int i = 0; i < numTris; i++) {
-			const int idx = activeObjIdx[i];
-			const double mid = 0.5 * (objAabbs[idx].min[splitAxis] + objAabbs[idx].max[splitAxis]);
-			if (mid < splitPos) {
-				splitSides[i] = 0;
-				s1count++;
-			} else {
-				splitSides[i] = 1;
-				s2count++;
+		Bin bins[NUM_BINS];
+		for (Bin &bin : bins) {
+			bin.min = vector3f(FLT_MAX);
+			bin.max = vector3f(-FLT_MAX);
+			bin.count = 0;
+		}
+		for (Uint32 i = 0; i < count; i++) {
+			const int b = std::min(int((objs[i].centroid[axis] - cmin[axis]) * scale), NUM_BINS - 1);
+			Bin &bin = bins[b];
+			for (int k = 0; k < 3; k++) {
+				bin.min[k] = std::min(bin.min[k], objs[i].min[k]);
+				bin.max[k] = std::max(bin.max[k], objs[i].max[k]);
 			}
+			bin.count++;
 		}
 
-		if (s1count == numTris) {
-			if (attempt < MAX_SPLITPOS_RETRIES) {
-				// try splitting at average point
-				splitBox.max[splitAxis] = splitPos;
-				attempt++;
-				continue;
-			} else {
-				MakeLeaf(node, objPtrs, activeObjIdx);
-				return;
+		// sweep from the left, then score every plane sweeping from the right
+		float leftArea[NUM_BINS - 1];
+		Uint32 leftCount[NUM_BINS - 1];
+		vector3f bmin(FLT_MAX), bmax(-FLT_MAX);
+		Uint32 n = 0;
+		for (int b = 0; b < NUM_BINS - 1; b++) {
+			for (int k = 0; k < 3; k++) {
+				bmin[k] = std::min(bmin[k], bins[b].min[k]);
+				bmax[k] = std::max(bmax[k], bins[b].max[k]);
+			}
+			n += bins[b].count;
+			leftArea[b] = n ? Area(bmin, bmax) : 0.0f;
+			leftCount[b] = n;
+		}
+		bmin = vector3f(FLT_MAX);
+		bmax = vector3f(-FLT_MAX);
+		n = 0;
+		for (int b = NUM_BINS - 1; b > 0; b--) {
+			for (int k = 0; k < 3; k++) {
+				bmin[k] = std::min(bmin[k], bins[b].min[k]);
+				bmax[k] = std::max(bmax[k], bins[b].max[k]);
 			}
-		} else if (s2count == numTris) {
-			if (attempt < MAX_SPLITPOS_RETRIES) {
-				// try splitting at average point
-				splitBox.min[splitAxis] = splitPos;
-				attempt++;
-				continue;
-			} else {
-				MakeLeaf(node, objPtrs, activeObjIdx);
-				return;
+			n += bins[b].count;
+			if (n == 0 || leftCount[b - 1] == 0) continue;
+			const float cost = leftArea[b - 1] * leftCount[b - 1] + Area(bmin, bmax) * n;
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b - 1;
 			}
 		}
-		break;
 	}
 
-	std::vector<int> side[2];
-	side[0].reserve(numTris);
-	side[1].reserve(numTris);
+	if (bestAxis < 0) {
+		// every centroid is in the same place, no plane separates them
+		return count <= MAX_LEAF_OBJS ? 0 : MedianSplit(objs, count, min, max);
+	}
+
+	const float leafCost = count * INTERSECT_COST;
+	const float splitCost = TRAVERSAL_COST + INTERSECT_COST * bestCost / std::max(Area(min, max), FLT_MIN);
+	if (splitCost >= leafCost && count <= MAX_LEAF_OBJS)
+		return 0;
+
+	const float scale = NUM_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+	const float base = cmin[bestAxis];
+	BuildObj *mid = std::partition(objs, objs + count, [=](const BuildObj &obj) {
+		return std::min(int((obj.centroid[bestAxis] - base) * scale), NUM_BINS - 1) <= bestBin;
+	});
+	return Uint32(mid - objs);
+}
+
+// splits in the middle of the longest axis, moving the plane towards the
+// objects if they are all on one side
+Uint32 BVHTree::FindMidpointSplit(BuildObj *objs, Uint32 count, const vector3f &min, const vector3f &max)
+{
+	vector3f splitMin = min, splitMax = max;
+	for (int attempt = 0; attempt <= MAX_SPLITPOS_RETRIES; attempt++) {
+		const int axis = LongestAxis(splitMin, splitMax);
+		const float splitPos = 0.5f * (splitMin[axis] + splitMax[axis]);
+		BuildObj *mid = std::partition(objs, objs + count, [=](const BuildObj &obj) {
+			return obj.centroid[axis] < splitPos;
+		});
+		const Uint32 left = Uint32(mid - objs);
+		if (left == count)
+			splitMax[axis] = splitPos;
+		else if (left == 0)
+			splitMin[axis] = splitPos;
+		else
+			return left;
+	}
+	return 0;
+}
+
+int BVHTree::GetDepth() const
+{
+	struct Entry {
+		const BVHNode *node;
+		int depth;
+	} stack[MAX_DEPTH + 1];
+	int stackpos = 0;
+	stack[0] = { GetRoot(), 0 };
+	int depth = 0;
+	while (stackpos >= 0) {
+		const Entry e = stack[stackpos--];
+		depth = std::max(depth, e.depth);
+		if (!e.node->IsLeaf()) {
+			stack[++stackpos] = { e.node->GetLeft(), e.depth + 1 };
+			stack[++stackpos] = { e.node->GetRight(), e.depth + 1 };
+		}
+	}
+	return depth;
+}
 
-	for (int i = 0; i < numTris; i++) {
-		side[splitSides[i]].push_back(activeObjIdx[i]);
+double BVHTree::GetCost() const
+{
+	const double rootArea = std::max(Area(m_nodes[0].min, m_nodes[0].max), FLT_MIN);
+	double cost = 0.0;
+	for (const BVHNode &node : m_nodes) {
+		const double p = Area(node.min, node.max) / rootArea;
+		cost += p * (node.IsLeaf() ? node.numObjs * INTERSECT_COST : TRAVERSAL_COST);
 	}
+	return cost / INTERSECT_COST;
+}
+
+BVHTree::BVHTree(Serializer::Reader &rd)
+{
+	PROFILE_SCOPED()
+	const Uint32 numNodes = rd.Int32();
+	const Uint32 numObjs = rd.Int32();
 
-	// recurse!
-	node->triIndicesStart = 0;
-	node->kids[0] = AllocNode();
-	node->kids[1] = AllocNode();
+	// the node array is in its final layout, so it's copied as it is
+	ByteRange nodes = rd.Blob();
+	if (numNodes == 0 || nodes.Size() != numNodes * sizeof(BVHNode))
+		throw std::out_of_range("BVHTree node array has the wrong size.");
+	m_nodes.resize(numNodes);
+	memcpy(m_nodes.data(), nodes.begin, nodes.Size());
 
-	BuildNode(node->kids[0], objPtrs, objAabbs, side[0]);
-	BuildNode(node->kids[1], objPtrs, objAabbs, side[1]);
+	ByteRange objPtrs = rd.Blob();
+	if (objPtrs.Size() != numObjs * sizeof(objPtr_t))
+		throw std::out_of_range("BVHTree object array has the wrong size.");
+	m_objPtrs.resize(numObjs);
+	if (numObjs)
+		memcpy(m_objPtrs.data(), objPtrs.begin, objPtrs.Size());
+
+	// the offsets are followed without checks when querying, and the
+	// queries keep their stacks in arrays sized for MAX_DEPTH. children
+	// always come after their parent, so the depths are found in one pass
+	std::vector<int> depths(numNodes, 0);
+	for (Uint32 i = 0; i < numNodes; i++) {
+		const BVHNode &node = m_nodes[i];
+		const bool valid = node.IsLeaf() ?
+			(node.offset <= numObjs && node.numObjs <= numObjs - node.offset) :
+			(node.offset > 1 && node.offset < numNodes - i);
+		if (!valid)
+			throw std::out_of_range("BVHTree node is out of range.");
+		if (node.IsLeaf())
+			continue;
+		const int depth = depths[i] + 1;
+		if (depth > MAX_DEPTH)
+			throw std::out_of_range("BVHTree is too deep.");
+		depths[i + 1] = std::max(depths[i + 1], depth);
+		depths[i + node.offset] = std::max(depths[i + node.offset], depth);
+	}
+}
+
+void BVHTree::Save(Serializer::Writer &wr) const
+{
+	PROFILE_SCOPED()
+	wr.Int32(m_nodes.size());
+	wr.Int32(m_objPtrs.size());
+	wr.Blob(ByteRange(reinterpret_cast<const char *>(m_nodes.data()), m_nodes.size() * sizeof(BVHNode)));
+	wr.Blob(ByteRange(reinterpret_cast<const char *>(m_objPtrs.data()), m_objPtrs.size() * sizeof(objPtr_t)));
 }
@@ -10,59 +10,76 @@
 #include <assert.h>
 #include <vector>
 
-struct BVHNode {
-	Aabb aabb;
+namespace Serializer {
+	class Reader;
+	class Writer;
+} // namespace Serializer
 
-	/* if triIndicesStart == 0 then not leaf,
-	 * kids[] valid */
-	int numTris;
-	int *triIndicesStart;
+/*
+ * Nodes are stored depth first in one array, so the left child of an inner
+ * node is always the next node and only the right child needs an offset.
+ * Two of them fit in a cache line.
+ */
+struct alignas(32) BVHNode {
+	// rounded outwards from the objects' double precision boxes
+	vector3f min;
+	vector3f max;
+	// leaf: index of the first object in the tree's object array
+	// inner: distance to the right child, in nodes
+	Uint32 offset;
+	// 0 for inner nodes
+	Uint32 numObjs;
 
-	BVHNode *kids[2];
-
-	BVHNode() :
-		numTris(0),
-		triIndicesStart(nullptr)
-	{
-		kids[0] = nullptr;
-		kids[1] = nullptr;
-	}
-	bool IsLeaf() const
-	{
-		return triIndicesStart != nullptr;
-	}
+	bool IsLeaf() const { return numObjs != 0; }
+	const BVHNode *GetLeft() const { return this + 1; }
+	const BVHNode *GetRight() const { return this + offset; }
 };
+static_assert(sizeof(BVHNode) == 32, "BVHNode should be 32 bytes");
 
 class BVHTree {
 public:
 	typedef int objPtr_t;
-	BVHTree(const int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs);
-	~BVHTree()
+
+	enum SplitMethod {
+		SPLIT_SAH, // binned surface area heuristic
+		SPLIT_MIDPOINT, // middle of the longest axis, the old builder, for comparison
+	};
+
+	// the deepest a tree gets, traversal stacks can be this big
+	static const int MAX_DEPTH = 64;
+
+	BVHTree(const int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs, SplitMethod method = SPLIT_SAH);
+	// loads a tree written by Save, without rebuilding it
+	BVHTree(Serializer::Reader &rd);
+	void Save(Serializer::Writer &wr) const;
+
+	const BVHNode *GetRoot() const { return &m_nodes[0]; }
+	// the objects below a leaf
+	const objPtr_t *GetObjPtrs(const BVHNode *leaf) const
 	{
-		delete[] m_objPtrAlloc;
-		delete[] m_bvhNodes;
+		assert(leaf->IsLeaf());
+		return &m_objPtrs[leaf->offset];
 	}
-	BVHNode *GetRoot() { return m_root; }
+	// all of them, in the order the leaves refer to them
+	const objPtr_t *GetObjPtrs() const { return m_objPtrs.data(); }
+	size_t GetNumObjs() const { return m_objPtrs.size(); }
+
+	size_t GetNumNodes() const { return m_nodes.size(); }
+	int GetDepth() const;
+	// expected cost of a query by the surface area heuristic, relative to
+	// intersecting one object
+	double GetCost() const;
 
 private:
-	void BuildNode(BVHNode *node,
-		const objPtr_t *objPtrs,
-		const Aabb *objAabbs,
-		std::vector<objPtr_t> &activeObjIdxs);
-	void MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPtr_t> &objs);
-	BVHNode *AllocNode()
-	{
-		if (m_nodeAllocPos >= m_nodeAllocMax) Error("Out of space in m_bvhNodes.");
-		return &m_bvhNodes[m_nodeAllocPos++];
-	}
-	BVHNode *m_root;
-	objPtr_t *m_objPtrAlloc;
-	size_t m_objPtrAllocPos;
-	size_t m_objPtrAllocMax;
+	struct BuildObj;
+
+	void BuildNode(BuildObj *objs, Uint32 count, int depth, SplitMethod method);
+	static Uint32 MedianSplit(BuildObj *objs, Uint32 count, const vector3f &min, const vector3f &max);
+	Uint32 FindSAHSplit(BuildObj *objs, Uint32 count, const vector3f &min, const vector3f &max);
+	Uint32 FindMidpointSplit(BuildObj *objs, Uint32 count, const vector3f &min, const vector3f &max);
 
-	BVHNode *m_bvhNodes;
-	size_t m_nodeAllocPos;
-	size_t m_nodeAllocMax;
+	std::vector<BVHNode> m_nodes;
+	std::vector<objPtr_t> m_objPtrs;
 };
 
 #endif /* _BVHTREE_H */
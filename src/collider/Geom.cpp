@@ -96,22 +96,24 @@ void Geom::Collide(Geom *b, void (*callback)(CollisionContact *)) const
 	//	Output("%d 'rays' in %dms (%f rps)\n", numEdges, t, 1000.0*numEdges / (double)t);
 }
 
-static bool rotatedAabbIsectsNormalOne(Aabb &a, const matrix4x4d &transA, Aabb &b)
+static bool rotatedAabbIsectsNormalOne(const BVHNode *a, const matrix4x4d &transA, const BVHNode *b)
 {
 	Aabb arot;
 	vector3d p[8];
-	p[0] = transA * vector3d(a.min.x, a.min.y, a.min.z);
-	p[1] = transA * vector3d(a.min.x, a.min.y, a.max.z);
-	p[2] = transA * vector3d(a.min.x, a.max.y, a.min.z);
-	p[3] = transA * vector3d(a.min.x, a.max.y, a.max.z);
-	p[4] = transA * vector3d(a.max.x, a.min.y, a.min.z);
-	p[5] = transA * vector3d(a.max.x, a.min.y, a.max.z);
-	p[6] = transA * vector3d(a.max.x, a.max.y, a.min.z);
-	p[7] = transA * vector3d(a.max.x, a.max.y, a.max.z);
+	p[0] = transA * vector3d(a->min.x, a->min.y, a->min.z);
+	p[1] = transA * vector3d(a->min.x, a->min.y, a->max.z);
+	p[2] = transA * vector3d(a->min.x, a->max.y, a->min.z);
+	p[3] = transA * vector3d(a->min.x, a->max.y, a->max.z);
+	p[4] = transA * vector3d(a->max.x, a->min.y, a->min.z);
+	p[5] = transA * vector3d(a->max.x, a->min.y, a->max.z);
+	p[6] = transA * vector3d(a->max.x, a->max.y, a->min.z);
+	p[7] = transA * vector3d(a->max.x, a->max.y, a->max.z);
 	arot.min = arot.max = p[0];
 	for (int i = 1; i < 8; i++)
 		arot.Update(p[i]);
-	return b.Intersects(arot);
+	return (arot.min.x < b->max.x) && (arot.max.x > b->min.x) &&
+		(arot.min.y < b->max.y) && (arot.max.y > b->min.y) &&
+		(arot.min.z < b->max.z) && (arot.max.z > b->min.z);
 }
 
 /*
@@ -122,52 +124,52 @@ void Geom::CollideEdgesWithTrisOf(int &maxContacts, const Geom *b, const matrix4
 {
 	PROFILE_SCOPED()
 	struct stackobj {
-		BVHNode *edgeNode;
-		BVHNode *triNode;
-	} stack[32];
+		const BVHNode *edgeNode;
+		const BVHNode *triNode;
+	} stack[2 * BVHTree::MAX_DEPTH];
 	int stackpos = 0;
 
 	stack[0].edgeNode = GetGeomTree()->GetEdgeTree()->GetRoot();
 	stack[0].triNode = b->GetGeomTree()->GetTriTree()->GetRoot();
 
 	while ((stackpos >= 0) && (maxContacts > 0)) {
-		BVHNode *edgeNode = stack[stackpos].edgeNode;
-		BVHNode *triNode = stack[stackpos].triNode;
+		const BVHNode *edgeNode = stack[stackpos].edgeNode;
+		const BVHNode *triNode = stack[stackpos].triNode;
 		stackpos--;
 
 		// does the edgeNode (with its aabb described in 6 planes transformed and rotated to
 		// b's coordinates) intersect with one or other of b's child nodes?
-		if (triNode->triIndicesStart || edgeNode->triIndicesStart) {
+		if (triNode->IsLeaf() || edgeNode->IsLeaf()) {
 			// reached triangle leaf node or edge leaf node.
 			// Intersect all edges under edgeNode with this leaf
 			CollideEdgesTris(maxContacts, edgeNode, transTo, b, triNode, callback);
 		} else {
-			BVHNode *left = triNode->kids[0];
-			BVHNode *right = triNode->kids[1];
-			bool edgeNodeIsectsLeftChild = rotatedAabbIsectsNormalOne(edgeNode->aabb, transTo, left->aabb);
-			bool edgeNodeIsectsRightChild = rotatedAabbIsectsNormalOne(edgeNode->aabb, transTo, right->aabb);
+			const BVHNode *left = triNode->GetLeft();
+			const BVHNode *right = triNode->GetRight();
+			bool edgeNodeIsectsLeftChild = rotatedAabbIsectsNormalOne(edgeNode, transTo, left);
+			bool edgeNodeIsectsRightChild = rotatedAabbIsectsNormalOne(edgeNode, transTo, right);
 			//edgeNodeIsectsRightChild = edgeNodeIsectsLeftChild = true;
 			if (edgeNodeIsectsRightChild) {
 				if (edgeNodeIsectsLeftChild) {
 					// isects both. split edgeNode and try again
 					++stackpos;
-					stack[stackpos].edgeNode = edgeNode->kids[0];
+					stack[stackpos].edgeNode = edgeNode->GetLeft();
 					stack[stackpos].triNode = triNode;
 					++stackpos;
-					stack[stackpos].edgeNode = edgeNode->kids[1];
+					stack[stackpos].edgeNode = edgeNode->GetRight();
 					stack[stackpos].triNode = triNode;
 				} else {
 					// hits only right child. go down into that
 					// side with same edge node
 					++stackpos;
 					stack[stackpos].edgeNode = edgeNode;
-					stack[stackpos].triNode = triNode->kids[1];
+					stack[stackpos].triNode = right;
 				}
 			} else if (edgeNodeIsectsLeftChild) {
 				// hits only left child
 				++stackpos;
 				stack[stackpos].edgeNode = edgeNode;
-				stack[stackpos].triNode = triNode->kids[0];
+				stack[stackpos].triNode = left;
 			} else {
 				// hits none
 			}
@@ -184,31 +186,32 @@ void Geom::CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const mat
 {
 	PROFILE_SCOPED()
 	if (maxContacts <= 0) return;
-	if (edgeNode->triIndicesStart) {
+	if (edgeNode->IsLeaf()) {
 		const GeomTree::Edge *edges = this->GetGeomTree()->GetEdges();
+		const BVHTree::objPtr_t *edgeIdxs = GetGeomTree()->GetEdgeTree()->GetObjPtrs(edgeNode);
 		int numContacts = 0;
 		vector3f dir;
 		isect_t isect;
 		const std::vector<vector3f> &rVertices = GetGeomTree()->GetVertices();
-		for (int i = 0; i < edgeNode->numTris; i++) {
-			const int vtxNum = edges[edgeNode->triIndicesStart[i]].v1i;
+		for (Uint32 i = 0; i < edgeNode->numObjs; i++) {
+			const int vtxNum = edges[edgeIdxs[i]].v1i;
 			const vector3d v1 = transToB * vector3d(rVertices[vtxNum]);
 			const vector3f _from(float(v1.x), float(v1.y), float(v1.z));
 
 			vector3d _dir(
-				double(edges[edgeNode->triIndicesStart[i]].dir.x),
-				double(edges[edgeNode->triIndicesStart[i]].dir.y),
-				double(edges[edgeNode->triIndicesStart[i]].dir.z));
+				double(edges[edgeIdxs[i]].dir.x),
+				double(edges[edgeIdxs[i]].dir.y),
+				double(edges[edgeIdxs[i]].dir.z));
 			_dir = transToB.ApplyRotationOnly(_dir);
 			dir = vector3f(&_dir.x);
-			isect.dist = edges[edgeNode->triIndicesStart[i]].len;
+			isect.dist = edges[edgeIdxs[i]].len;
 			isect.triIdx = -1;
 
 			b->GetGeomTree()->TraceRay(btriNode, _from, dir, &isect);
 
 			if (isect.triIdx == -1) continue;
 			numContacts++;
-			const double depth = edges[edgeNode->triIndicesStart[i]].len - isect.dist;
+			const double depth = edges[edgeIdxs[i]].len - isect.dist;
 			// in world coords
 			CollisionContact contact;
 			contact.pos = b->GetTransform() * (v1 + vector3d(&dir.x) * double(isect.dist));
@@ -223,12 +226,12 @@ void Geom::CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const mat
 			contact.userData2 = b->m_data;
 			// contact geomFlag is bitwise OR of triangle's and edge's flags
 			contact.geomFlag = b->m_geomtree->GetTriFlag(isect.triIdx) |
-				edges[edgeNode->triIndicesStart[i]].triFlag;
+				edges[edgeIdxs[i]].triFlag;
 			callback(&contact);
 			if (--maxContacts <= 0) return;
 		}
 	} else {
-		CollideEdgesTris(maxContacts, edgeNode->kids[0], transToB, b, btriNode, callback);
-		CollideEdgesTris(maxContacts, edgeNode->kids[1], transToB, b, btriNode, callback);
+		CollideEdgesTris(maxContacts, edgeNode->GetLeft(), transToB, b, btriNode, callback);
+		CollideEdgesTris(maxContacts, edgeNode->GetRight(), transToB, b, btriNode, callback);
 	}
 }
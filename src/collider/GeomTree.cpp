@@ -6,6 +6,13 @@
 #include "BVHTree.h"
 #include "Weld.h"
 #include "scenegraph/Serializer.h"
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GEOMTREE_SSE2
+#endif
 
 #pragma GCC optimize("O3")
 
@@ -13,7 +20,7 @@ GeomTree::~GeomTree()
 {
 }
 
-GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vector3f> &vertices, const Uint32 *indices, const Uint32 *triflags) :
+GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vector3f> &vertices, const Uint32 *indices, const Uint32 *triflags, BVHTree::SplitMethod splitMethod) :
 	m_numVertices(numVerts),
 	m_numTris(numTris),
 	m_vertices(vertices)
@@ -109,7 +116,7 @@ GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vect
 		}
 
 		//int t = SDL_GetTicks();
-		m_triTree.reset(new BVHTree(activeTris.size(), &activeTris[0], aabbs));
+		m_triTree.reset(new BVHTree(activeTris.size(), &activeTris[0], aabbs, splitMethod));
 		delete[] aabbs;
 	}
 	//Output("Tri tree of %d tris build in %dms\n", activeTris.size(), SDL_GetTicks() - t);
@@ -117,7 +124,7 @@ GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vect
 	m_numEdges = edges.size();
 	m_edges.resize(m_numEdges);
 	// to build Edge bvh tree with.
-	m_aabbs.resize(m_numEdges);
+	std::vector<Aabb> edgeAabbs(m_numEdges);
 	int *edgeIdxs = new int[m_numEdges];
 
 	int pos = 0;
@@ -139,19 +146,50 @@ GeomTree::GeomTree(const int numVerts, const int numTris, const std::vector<vect
 		m_edges[pos].dir = dir;
 
 		edgeIdxs[pos] = pos;
-		m_aabbs[pos].min = m_aabbs[pos].max = vector3d(v1);
-		m_aabbs[pos].Update(vector3d(v2));
+		edgeAabbs[pos].min = edgeAabbs[pos].max = vector3d(v1);
+		edgeAabbs[pos].Update(vector3d(v2));
 	}
 
 	//t = SDL_GetTicks();
-	m_edgeTree.reset(new BVHTree(m_numEdges, edgeIdxs, &m_aabbs[0]));
+	m_edgeTree.reset(new BVHTree(m_numEdges, edgeIdxs, &edgeAabbs[0], splitMethod));
 	delete[] edgeIdxs;
 	//Output("Edge tree of %d edges build in %dms\n", m_numEdges, SDL_GetTicks() - t);
 
+	BuildTriangleSoA();
+
 	timer.Stop();
 	//Output(" - - GeomTree::GeomTree took: %lf milliseconds\n", timer.millicycles());
 }
 
+// the arrays are stored as blobs, so loading is a copy into the final array.
+// that makes the layout of Edge part of the .sgm format: changing it needs
+// a new SGM_VERSION
+static_assert(std::is_trivially_copyable<GeomTree::Edge>::value, "GeomTree::Edge is saved as raw bytes");
+static_assert(sizeof(GeomTree::Edge) == 28, "GeomTree::Edge layout is part of the .sgm format");
+static_assert(offsetof(GeomTree::Edge, dir) == 12 && offsetof(GeomTree::Edge, triFlag) == 24, "GeomTree::Edge layout is part of the .sgm format");
+
+template <typename T>
+static void WriteArray(Serializer::Writer &wr, const std::vector<T> &array)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "only arrays of plain data can be saved as blobs");
+	if (array.empty())
+		wr.Int32(0);
+	else
+		wr.Blob(ByteRange(reinterpret_cast<const char *>(array.data()), array.size() * sizeof(T)));
+}
+
+template <typename T>
+static void ReadArray(Serializer::Reader &rd, std::vector<T> &array, size_t count)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "only arrays of plain data can be loaded from blobs");
+	const ByteRange range = rd.Blob();
+	if (range.Size() != count * sizeof(T))
+		throw std::out_of_range("GeomTree array has the wrong size.");
+	array.resize(count);
+	if (count)
+		memcpy(array.data(), range.begin, range.Size());
+}
+
 GeomTree::GeomTree(Serializer::Reader &rd)
 {
 	PROFILE_SCOPED()
@@ -164,85 +202,62 @@ GeomTree::GeomTree(Serializer::Reader &rd)
 	m_aabb.min = rd.Vector3d();
 	m_aabb.radius = rd.Double();
 
-	const Uint32 numAabbs = rd.Int32();
-	m_aabbs.resize(numAabbs);
-	for (Uint32 iAabb = 0; iAabb < numAabbs; ++iAabb) {
-		rd >> m_aabbs[iAabb];
-	}
+	ReadArray(rd, m_edges, m_numEdges);
+	ReadArray(rd, m_vertices, m_numVertices);
+	ReadArray(rd, m_indices, m_numTris * 3);
+	ReadArray(rd, m_triFlags, m_numTris);
 
-	{
-		PROFILE_SCOPED_DESC("GeomTree::LoadEdges")
-		m_edges.resize(m_numEdges);
-		for (Sint32 iEdge = 0; iEdge < m_numEdges; ++iEdge) {
-			auto &ed = m_edges[iEdge];
-			rd >> ed.v1i >> ed.v2i >> ed.len >> ed.dir >> ed.triFlag;
-		}
-	}
-
-	m_vertices.resize(m_numVertices);
-	for (Sint32 iVert = 0; iVert < m_numVertices; ++iVert) {
-		m_vertices[iVert] = rd.Vector3f();
-	}
+	// built by the model compiler
+	m_triTree.reset(new BVHTree(rd));
+	m_edgeTree.reset(new BVHTree(rd));
 
-	const int numIndicies(m_numTris * 3);
-	m_indices.resize(numIndicies);
-	for (Sint32 iIndi = 0; iIndi < numIndicies; ++iIndi) {
-		m_indices[iIndi] = rd.Int32();
-	}
-
-	m_triFlags.resize(m_numTris);
-	for (Sint32 iTri = 0; iTri < m_numTris; ++iTri) {
-		m_triFlags[iTri] = rd.Int32();
-	}
-
-	// activeTris = tris we are still trying to put into leaves
-	std::vector<int> activeTris;
-	activeTris.reserve(m_numTris);
-	for (int i = 0; i < m_numTris; i++) {
-		activeTris.push_back(i * 3);
-	}
-
-	// regenerate the aabb data
-	Aabb *aabbs = new Aabb[activeTris.size()];
-	for (Uint32 i = 0; i < activeTris.size(); i++) {
-		const vector3d v1 = vector3d(m_vertices[m_indices[activeTris[i] + 0]]);
-		const vector3d v2 = vector3d(m_vertices[m_indices[activeTris[i] + 1]]);
-		const vector3d v3 = vector3d(m_vertices[m_indices[activeTris[i] + 2]]);
-		aabbs[i].min = aabbs[i].max = v1;
-		aabbs[i].Update(v2);
-		aabbs[i].Update(v3);
-	}
-	m_triTree.reset(new BVHTree(activeTris.size(), &activeTris[0], aabbs));
-	delete[] aabbs;
+	BuildTriangleSoA();
+}
 
-	//
-	int *edgeIdxs = new int[m_numEdges];
-	memset(edgeIdxs, 0, sizeof(int) * m_numEdges);
-	for (int i = 0; i < m_numEdges; i++) {
-		edgeIdxs[i] = i;
+void GeomTree::BuildTriangleSoA()
+{
+	PROFILE_SCOPED()
+	const size_t count = m_triTree->GetNumObjs();
+	const BVHTree::objPtr_t *tris = m_triTree->GetObjPtrs();
+	// the padding is zeros, which never hit anything. IntersectTris loads
+	// four triangles from wherever a leaf starts, which needn't be a
+	// multiple of four, so the last leaf's loads of the last component can
+	// run up to three floats past its stride: those are allocated too
+	m_triSoAStride = (count + 3) & ~size_t(3);
+	m_triSoA.assign(SOA_COMPONENTS * m_triSoAStride + 3, 0.0f);
+	for (size_t i = 0; i < count; i++) {
+		const vector3f a(m_vertices[m_indices[tris[i] + 0]]);
+		const vector3f b(m_vertices[m_indices[tris[i] + 1]]);
+		const vector3f c(m_vertices[m_indices[tris[i] + 2]]);
+		// the same expression as RayTriIntersect, so it rounds the same
+		const vector3f n = (c - a).Cross(b - a);
+		const float values[SOA_COMPONENTS] = { a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z, n.x, n.y, n.z };
+		for (int k = 0; k < SOA_COMPONENTS; k++)
+			m_triSoA[k * m_triSoAStride + i] = values[k];
 	}
-	m_edgeTree.reset(new BVHTree(m_numEdges, edgeIdxs, &m_aabbs[0]));
 }
 
-static bool SlabsRayAabbTest(const BVHNode *n, const vector3f &start, const vector3f &invDir, isect_t *isect)
+// tmin is where the ray enters the box
+static inline bool SlabsRayAabbTest(const BVHNode *n, const vector3f &start, const vector3f &invDir, const isect_t *isect, float &tmin)
 {
 	// PROFILE_SCOPED()
 	float
-		l1 = (n->aabb.min.x - start.x) * invDir.x,
-		l2 = (n->aabb.max.x - start.x) * invDir.x,
+		l1 = (n->min.x - start.x) * invDir.x,
+		l2 = (n->max.x - start.x) * invDir.x,
 		lmin = std::min(l1, l2),
 		lmax = std::max(l1, l2);
 
-	l1 = (n->aabb.min.y - start.y) * invDir.y;
-	l2 = (n->aabb.max.y - start.y) * invDir.y;
+	l1 = (n->min.y - start.y) * invDir.y;
+	l2 = (n->max.y - start.y) * invDir.y;
 	lmin = std::max(std::min(l1, l2), lmin);
 	lmax = std::min(std::max(l1, l2), lmax);
 
-	l1 = (n->aabb.min.z - start.z) * invDir.z;
-	l2 = (n->aabb.max.z - start.z) * invDir.z;
+	l1 = (n->min.z - start.z) * invDir.z;
+	l2 = (n->max.z - start.z) * invDir.z;
 	lmin = std::max(std::min(l1, l2), lmin);
 	lmax = std::min(std::max(l1, l2), lmax);
 
+	tmin = lmin;
 	return ((lmax >= 0.f) & (lmax >= lmin) & (lmin < isect->dist));
 }
 
@@ -252,32 +267,60 @@ void GeomTree::TraceRay(const vector3f &start, const vector3f &dir, isect_t *ise
 	TraceRay(m_triTree->GetRoot(), start, dir, isect);
 }
 
+// visits the nearer child first, and skips whatever the ray enters beyond
+// the closest hit so far
 void GeomTree::TraceRay(const BVHNode *currnode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const
 {
 	PROFILE_SCOPED()
-	BVHNode *stack[32];
+	struct {
+		const BVHNode *node;
+		float tmin;
+	} stack[BVHTree::MAX_DEPTH];
 	int stackpos = -1;
 	const vector3f invDir( // avoid division by zero please
 		is_zero_exact(a_dir.x) ? 0.0f : (1.0f / a_dir.x),
 		is_zero_exact(a_dir.y) ? 0.0f : (1.0f / a_dir.y),
 		is_zero_exact(a_dir.z) ? 0.0f : (1.0f / a_dir.z));
 
-	for (;;) {
-		while (!currnode->IsLeaf()) {
-			if (!SlabsRayAabbTest(currnode, a_origin, invDir, isect)) goto pop_bstack;
+	float tmin;
+	if (!SlabsRayAabbTest(currnode, a_origin, invDir, isect, tmin)) return;
 
-			stackpos++;
-			stack[stackpos] = currnode->kids[1];
-			currnode = currnode->kids[0];
-		}
-		// triangle intersection jizz
-		for (int i = 0; i < currnode->numTris; i++) {
-			RayTriIntersect(1, a_origin, &a_dir, currnode->triIndicesStart[i], isect);
+	for (;;) {
+		if (currnode->IsLeaf()) {
+			// triangle intersection jizz
+			IntersectTris(a_origin, a_dir, currnode->offset, currnode->numObjs, isect);
+		} else {
+			const BVHNode *nearNode = currnode->GetLeft();
+			const BVHNode *farNode = currnode->GetRight();
+			float tNear, tFar;
+			const bool hitNear = SlabsRayAabbTest(nearNode, a_origin, invDir, isect, tNear);
+			const bool hitFar = SlabsRayAabbTest(farNode, a_origin, invDir, isect, tFar);
+			if (hitNear && hitFar) {
+				if (tFar < tNear) {
+					std::swap(nearNode, farNode);
+					std::swap(tNear, tFar);
+				}
+				stackpos++;
+				stack[stackpos].node = farNode;
+				stack[stackpos].tmin = tFar;
+				currnode = nearNode;
+				continue;
+			} else if (hitNear) {
+				currnode = nearNode;
+				continue;
+			} else if (hitFar) {
+				currnode = farNode;
+				continue;
+			}
 		}
-	pop_bstack:
-		if (stackpos < 0) break;
-		currnode = stack[stackpos];
-		stackpos--;
+
+		// pop, unless a closer hit has been found since it was pushed
+		do {
+			if (stackpos < 0) return;
+			currnode = stack[stackpos].node;
+			tmin = stack[stackpos].tmin;
+			stackpos--;
+		} while (tmin >= isect->dist);
 	}
 }
 
@@ -311,6 +354,91 @@ void GeomTree::RayTriIntersect(int numRays, const vector3f &origin, const vector
 	}
 }
 
+void GeomTree::IntersectTrisScalar(const vector3f &origin, const vector3f &dir, Uint32 first, Uint32 count, isect_t *isect) const
+{
+	const BVHTree::objPtr_t *tris = m_triTree->GetObjPtrs() + first;
+	for (Uint32 i = 0; i < count; i++)
+		RayTriIntersect(1, origin, &dir, tris[i], isect);
+}
+
+#ifdef GEOMTREE_SSE2
+// a.Cross(b) . d for four pairs, in the same order of operations as
+// vector3::Cross and vector3::Dot
+static inline __m128 CrossDot4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz, __m128 dx, __m128 dy, __m128 dz)
+{
+	const __m128 cx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+	const __m128 cy = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+	const __m128 cz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, dx), _mm_mul_ps(cy, dy)), _mm_mul_ps(cz, dz));
+}
+
+void GeomTree::IntersectTris(const vector3f &origin, const vector3f &dir, Uint32 first, Uint32 count, isect_t *isect) const
+{
+	// PROFILE_SCOPED()
+	const BVHTree::objPtr_t *tris = m_triTree->GetObjPtrs();
+	const float *soa = &m_triSoA[0];
+	const size_t stride = m_triSoAStride;
+
+	const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+	const __m128 dx = _mm_set1_ps(dir.x), dy = _mm_set1_ps(dir.y), dz = _mm_set1_ps(dir.z);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+
+	for (Uint32 j = 0; j < count; j += 4) {
+		const float *p = soa + first + j;
+		// corners relative to the origin
+		const __m128 ax = _mm_sub_ps(_mm_loadu_ps(p + SOA_AX * stride), ox);
+		const __m128 ay = _mm_sub_ps(_mm_loadu_ps(p + SOA_AY * stride), oy);
+		const __m128 az = _mm_sub_ps(_mm_loadu_ps(p + SOA_AZ * stride), oz);
+		const __m128 bx = _mm_sub_ps(_mm_loadu_ps(p + SOA_BX * stride), ox);
+		const __m128 by = _mm_sub_ps(_mm_loadu_ps(p + SOA_BY * stride), oy);
+		const __m128 bz = _mm_sub_ps(_mm_loadu_ps(p + SOA_BZ * stride), oz);
+		const __m128 cx = _mm_sub_ps(_mm_loadu_ps(p + SOA_CX * stride), ox);
+		const __m128 cy = _mm_sub_ps(_mm_loadu_ps(p + SOA_CY * stride), oy);
+		const __m128 cz = _mm_sub_ps(_mm_loadu_ps(p + SOA_CZ * stride), oz);
+		const __m128 nx = _mm_loadu_ps(p + SOA_NX * stride);
+		const __m128 ny = _mm_loadu_ps(p + SOA_NY * stride);
+		const __m128 nz = _mm_loadu_ps(p + SOA_NZ * stride);
+
+		const __m128 v0d = CrossDot4(cx, cy, cz, bx, by, bz, dx, dy, dz);
+		const __m128 v1d = CrossDot4(bx, by, bz, ax, ay, az, dx, dy, dz);
+		const __m128 v2d = CrossDot4(ax, ay, az, cx, cy, cz, dx, dy, dz);
+
+		// the ray passes inside all three edges, from either side
+		const __m128 inside = _mm_or_ps(
+			_mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(v0d, zero), _mm_cmpgt_ps(v1d, zero)), _mm_cmpgt_ps(v2d, zero)),
+			_mm_and_ps(_mm_and_ps(_mm_cmplt_ps(v0d, zero), _mm_cmplt_ps(v1d, zero)), _mm_cmplt_ps(v2d, zero)));
+		int mask = _mm_movemask_ps(inside);
+		if (count - j < 4) mask &= (1 << (count - j)) - 1;
+		if (!mask) continue;
+
+		const __m128 nominator = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, ax), _mm_mul_ps(ny, ay)), _mm_mul_ps(nz, az));
+		const __m128 denominator = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, nx), _mm_mul_ps(dy, ny)), _mm_mul_ps(dz, nz));
+		// like the scalar version, only divide for the triangles that are
+		// hit. the others, padding and the next leaf's triangles included,
+		// can have a zero denominator and would trap with FPEs enabled
+		const __m128 hit = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_and_si128(_mm_set1_epi32(mask), laneBits), _mm_setzero_si128()));
+		const __m128 safeDenominator = _mm_or_ps(_mm_and_ps(hit, denominator), _mm_andnot_ps(hit, one));
+		alignas(16) float dist[4];
+		_mm_store_ps(dist, _mm_div_ps(nominator, safeDenominator));
+
+		// in triangle order, so ties go the same way as in the scalar version
+		for (int k = 0; k < 4; k++) {
+			if ((mask & (1 << k)) && (dist[k] > 0) && (dist[k] < isect->dist)) {
+				isect->dist = dist[k];
+				isect->triIdx = tris[first + j + k] / 3;
+			}
+		}
+	}
+}
+#else
+void GeomTree::IntersectTris(const vector3f &origin, const vector3f &dir, Uint32 first, Uint32 count, isect_t *isect) const
+{
+	IntersectTrisScalar(origin, dir, first, count, isect);
+}
+#endif
+
 vector3f GeomTree::GetTriNormal(int triIdx) const
 {
 	PROFILE_SCOPED()
@@ -333,25 +461,11 @@ void GeomTree::Save(Serializer::Writer &wr) const
 	wr.Vector3d(m_aabb.min);
 	wr.Double(m_aabb.radius);
 
-	wr.Int32(m_numEdges);
-	for (Sint32 iAabb = 0; iAabb < m_numEdges; ++iAabb) {
-		wr << m_aabbs[iAabb];
-	}
-
-	for (Sint32 iEdge = 0; iEdge < m_numEdges; ++iEdge) {
-		auto &ed = m_edges[iEdge];
-		wr << ed.v1i << ed.v2i << ed.len << ed.dir << ed.triFlag;
-	}
-
-	for (Sint32 iVert = 0; iVert < m_numVertices; ++iVert) {
-		wr.Vector3f(m_vertices[iVert]);
-	}
+	WriteArray(wr, m_edges);
+	WriteArray(wr, m_vertices);
+	WriteArray(wr, m_indices);
+	WriteArray(wr, m_triFlags);
 
-	for (Sint32 iIndi = 0; iIndi < (m_numTris * 3); ++iIndi) {
-		wr.Int32(m_indices[iIndi]);
-	}
-
-	for (Sint32 iTri = 0; iTri < m_numTris; ++iTri) {
-		wr.Int32(m_triFlags[iTri]);
-	}
+	m_triTree->Save(wr);
+	m_edgeTree->Save(wr);
 }
@@ -4,6 +4,7 @@
 #ifndef _GEOMTREE_H
 #define _GEOMTREE_H
 
+#include "BVHTree.h"
 #include "libs.h"
 
 namespace Serializer {
@@ -17,12 +18,9 @@ struct isect_t {
 	float dist;
 };
 
-class BVHTree;
-struct BVHNode;
-
 class GeomTree {
 public:
-	GeomTree(const int numVerts, const int numTris, const std::vector<vector3f> &vertices, const Uint32 *indices, const Uint32 *triflags);
+	GeomTree(const int numVerts, const int numTris, const std::vector<vector3f> &vertices, const Uint32 *indices, const Uint32 *triflags, BVHTree::SplitMethod splitMethod = BVHTree::SPLIT_SAH);
 	GeomTree(Serializer::Reader &rd);
 	void Save(Serializer::Writer &wr) const;
 
@@ -34,6 +32,11 @@ public:
 	// isect.triIdx should be -1 unless repeat calls with same isect_t
 	void TraceRay(const vector3f &start, const vector3f &dir, isect_t *isect) const;
 	void TraceRay(const BVHNode *startNode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const;
+	// intersects the ray with count triangles of the triangle tree's object
+	// array from first, the way TraceRay does in its leaves. four at a time
+	// where SSE2 is available, with the same results as the scalar version
+	void IntersectTris(const vector3f &origin, const vector3f &dir, Uint32 first, Uint32 count, isect_t *isect) const;
+	void IntersectTrisScalar(const vector3f &origin, const vector3f &dir, Uint32 first, Uint32 count, isect_t *isect) const;
 	vector3f GetTriNormal(int triIdx) const;
 	Uint32 GetTriFlag(int triIdx) const { return m_triFlags[triIdx]; }
 	double GetRadius() const { return m_radius; }
@@ -66,6 +69,7 @@ public:
 
 private:
 	void RayTriIntersect(int numRays, const vector3f &origin, const vector3f *dirs, int triIdx, isect_t *isects) const;
+	void BuildTriangleSoA();
 
 	int m_numVertices;
 	int m_numEdges;
@@ -73,7 +77,6 @@ private:
 
 	double m_radius;
 	Aabb m_aabb;
-	std::vector<Aabb> m_aabbs;
 
 	std::unique_ptr<BVHTree> m_triTree;
 	std::unique_ptr<BVHTree> m_edgeTree;
@@ -83,6 +86,13 @@ private:
 	std::vector<vector3f> m_vertices;
 	std::vector<Uint32> m_indices;
 	std::vector<Uint32> m_triFlags;
+
+	// corners a, b, c and the normal (c - a) x (b - a) of the triangles in
+	// the triangle tree's object order, one array of m_triSoAStride floats
+	// per component, padded so four can always be loaded
+	enum { SOA_AX, SOA_AY, SOA_AZ, SOA_BX, SOA_BY, SOA_BZ, SOA_CX, SOA_CY, SOA_CZ, SOA_NX, SOA_NY, SOA_NZ, SOA_COMPONENTS };
+	std::vector<float> m_triSoA;
+	size_t m_triSoAStride;
 };
 
 #endif /* _GEOMTREE_H */
@@ -0,0 +1,314 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// Standalone benchmark for the collision BVHs. Loads the shipped models,
+// builds their collision trees with each split method and times ray and
+// mesh contact queries against them. The hit counts of the ray queries
+// should match between methods, as they must find the same triangles.
+// The narrowphase is timed on its own too, testing rays against every
+// triangle of a model with the SIMD and the scalar versions, which must
+// give exactly the same results.
+
+#include "buildopts.h"
+#include "core/Log.h"
+#include "libs.h"
+#include "utils.h"
+
+#include "CollMesh.h"
+#include "FileSystem.h"
+#include "GameConfig.h"
+#include "ModManager.h"
+#include "Random.h"
+#include "collider/CollisionContact.h"
+#include "collider/Geom.h"
+#include "collider/GeomTree.h"
+#include "core/OS.h"
+#include "graphics/Graphics.h"
+#include "graphics/Renderer.h"
+#include "graphics/dummy/RendererDummy.h"
+#include "profiler/Profiler.h"
+#include "scenegraph/SceneGraph.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+struct Ray {
+	vector3f start;
+	vector3f dir;
+	float length;
+};
+
+struct Pose {
+	matrix4x4d orient;
+	vector3d pos;
+};
+
+struct QueryStats {
+	QueryStats() :
+		buildTicks(0),
+		rayTicks(0),
+		contactTicks(0),
+		hits(0),
+		contacts(0) {}
+
+	Uint64 buildTicks;
+	Uint64 rayTicks;
+	Uint64 contactTicks;
+	Uint64 hits;
+	Uint64 contacts;
+};
+
+static const char *s_methodNames[] = { "sah", "midpoint" };
+static const int NUM_METHODS = 2;
+
+static Uint64 s_contacts;
+static void CountContact(CollisionContact *) { ++s_contacts; }
+
+// rays from a sphere around the model towards points inside its box, most of
+// which hit something
+static void MakeRays(Random &rng, const GeomTree &tree, int count, std::vector<Ray> &rays)
+{
+	const Aabb &aabb = tree.GetAabb();
+	const double radius = tree.GetRadius();
+	rays.resize(count);
+	for (Ray &ray : rays) {
+		vector3d start(rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0));
+		start = start.NormalizedSafe() * (radius * 2.0);
+		const vector3d target(
+			rng.Double(aabb.min.x, aabb.max.x),
+			rng.Double(aabb.min.y, aabb.max.y),
+			rng.Double(aabb.min.z, aabb.max.z));
+		ray.start = vector3f(start);
+		ray.dir = vector3f((target - start).NormalizedSafe());
+		ray.length = float(radius * 4.0);
+	}
+}
+
+// a second copy of the model, turned and moved so the two overlap
+static void MakePoses(Random &rng, const GeomTree &tree, int count, std::vector<Pose> &poses)
+{
+	const double radius = tree.GetRadius();
+	poses.resize(count);
+	for (Pose &pose : poses) {
+		const vector3d axis = vector3d(rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0)).NormalizedSafe();
+		pose.orient = matrix4x4d::RotateMatrix(rng.Double(0.0, 2.0 * M_PI), axis.x, axis.y, axis.z);
+		pose.pos = vector3d(rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0)) * radius;
+	}
+}
+
+static void RunQueries(const GeomTree &tree, const std::vector<Ray> &rays, const std::vector<Pose> &poses, QueryStats &stats)
+{
+	Uint64 start = Profiler::Clock::getticks();
+	for (const Ray &ray : rays) {
+		isect_t isect;
+		isect.dist = ray.length;
+		isect.triIdx = -1;
+		tree.TraceRay(ray.start, ray.dir, &isect);
+		if (isect.triIdx >= 0)
+			++stats.hits;
+	}
+	stats.rayTicks += Profiler::Clock::getticks() - start;
+
+	Geom a(&tree, matrix4x4d::Identity(), vector3d(0.0), nullptr);
+	Geom b(&tree, matrix4x4d::Identity(), vector3d(0.0), nullptr);
+	s_contacts = 0;
+	start = Profiler::Clock::getticks();
+	for (const Pose &pose : poses) {
+		b.MoveTo(pose.orient, pose.pos);
+		a.Collide(&b, CountContact);
+	}
+	stats.contactTicks += Profiler::Clock::getticks() - start;
+	stats.contacts += s_contacts;
+}
+
+struct NarrowStats {
+	NarrowStats() :
+		ticks{ 0, 0 },
+		tests(0),
+		mismatches(0) {}
+
+	Uint64 ticks[2]; // IntersectTris, IntersectTrisScalar
+	Uint64 tests;
+	Uint64 mismatches;
+};
+
+static void RunNarrowphase(const GeomTree &tree, const std::vector<Ray> &rays, size_t numRays, NarrowStats &stats)
+{
+	const Uint32 numTris = tree.GetTriTree()->GetNumObjs();
+	numRays = std::min(numRays, rays.size());
+	std::vector<isect_t> results[2];
+	for (int version = 0; version < 2; version++) {
+		results[version].resize(numRays);
+		const Uint64 start = Profiler::Clock::getticks();
+		for (size_t i = 0; i < numRays; i++) {
+			isect_t &isect = results[version][i];
+			isect.dist = rays[i].length;
+			isect.triIdx = -1;
+			if (version == 0)
+				tree.IntersectTris(rays[i].start, rays[i].dir, 0, numTris, &isect);
+			else
+				tree.IntersectTrisScalar(rays[i].start, rays[i].dir, 0, numTris, &isect);
+		}
+		stats.ticks[version] += Profiler::Clock::getticks() - start;
+	}
+	stats.tests += Uint64(numRays) * numTris;
+	for (size_t i = 0; i < numRays; i++) {
+		if (results[0][i].triIdx != results[1][i].triIdx || memcmp(&results[0][i].dist, &results[1][i].dist, sizeof(float)) != 0)
+			++stats.mismatches;
+	}
+}
+
+static void PrintUsage()
+{
+	Output(
+		"usage: collisionbench [options] [model names...]\n"
+		"  -rays <n>      rays traced per model (default 100000)\n"
+		"  -contacts <n>  mesh contact queries per model (default 1000)\n"
+		"  -narrow <n>    rays tested against every triangle per model (default 1000)\n"
+		"  -seed <n>      seed for the rays and poses (default 1)\n"
+		"all models are used if none are named\n");
+}
+
+extern "C" int main(int argc, char **argv)
+{
+#ifdef PIONEER_PROFILER
+	Profiler::detect(argc, argv);
+#endif
+
+	int numRays = 100000;
+	int numContacts = 1000;
+	int numNarrow = 1000;
+	Uint32 seed = 1;
+	std::vector<std::string> modelNames;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string opt(argv[i]);
+		if (opt == "-rays" && i + 1 < argc)
+			numRays = std::max(0, atoi(argv[++i]));
+		else if (opt == "-contacts" && i + 1 < argc)
+			numContacts = std::max(0, atoi(argv[++i]));
+		else if (opt == "-narrow" && i + 1 < argc)
+			numNarrow = std::max(0, atoi(argv[++i]));
+		else if (opt == "-seed" && i + 1 < argc)
+			seed = strtoul(argv[++i], nullptr, 10);
+		else if (opt[0] != '-')
+			modelNames.push_back(opt);
+		else {
+			PrintUsage();
+			return (opt == "-help" || opt == "-h") ? 0 : 1;
+		}
+	}
+
+	// the models are loaded the way modelcompiler does it, with a dummy renderer
+	FileSystem::Init();
+	FileSystem::userFiles.MakeDirectory(""); // ensure the config directory exists
+	Log::GetLog()->SetLogFile("collisionbench.log");
+	SDL_Init(0);
+	ModManager::Init();
+
+	std::unique_ptr<GameConfig> config(new GameConfig);
+	Graphics::RendererDummy::RegisterRenderer();
+	Graphics::Settings videoSettings = {};
+	videoSettings.rendererType = Graphics::RENDERER_DUMMY;
+	videoSettings.width = config->Int("ScrWidth");
+	videoSettings.height = config->Int("ScrHeight");
+	videoSettings.hidden = true;
+	videoSettings.iconFile = OS::GetIconFilename();
+	videoSettings.title = "Collision Benchmark";
+	std::unique_ptr<Graphics::Renderer> renderer(Graphics::Init(videoSettings));
+
+	if (modelNames.empty()) {
+		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "models", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+			const FileSystem::FileInfo &info = files.Current();
+			if (info.IsFile() && ends_with_ci(info.GetPath(), ".model"))
+				modelNames.push_back(info.GetName().substr(0, info.GetName().size() - 6));
+		}
+	}
+
+	Output("\n%-24s %8s %-8s %7s %5s %8s %9s %10s %8s %10s %8s\n", "model", "tris", "method", "nodes", "depth",
+		"cost", "build ms", "Mrays/s", "hits", "queries/s", "contacts");
+
+	QueryStats totals[NUM_METHODS];
+	NarrowStats narrow;
+	int result = 0;
+	for (const std::string &name : modelNames) {
+		std::unique_ptr<SceneGraph::Model> model;
+		try {
+			// build from the source, so the trees aren't loaded from an .sgm
+			SceneGraph::Loader ld(renderer.get(), false, false);
+			model.reset(ld.LoadModel(name));
+		} catch (...) {
+			Output("%-24s failed to load\n", name.c_str());
+			continue;
+		}
+		const GeomTree *source = model->GetCollisionMesh()->GetGeomTree();
+		if (!source || source->GetNumTris() == 0)
+			continue;
+
+		Random rng(seed);
+		std::vector<Ray> rays;
+		std::vector<Pose> poses;
+		MakeRays(rng, *source, numRays, rays);
+		MakePoses(rng, *source, numContacts, poses);
+
+		Uint64 hits[NUM_METHODS];
+		for (int method = 0; method < NUM_METHODS; method++) {
+			QueryStats stats;
+			const Uint64 start = Profiler::Clock::getticks();
+			GeomTree tree(source->GetNumVertices(), source->GetNumTris(), source->GetVertices(),
+				source->GetIndices(), source->GetTriFlags(), BVHTree::SplitMethod(method));
+			stats.buildTicks = Profiler::Clock::getticks() - start;
+
+			RunQueries(tree, rays, poses, stats);
+			hits[method] = stats.hits;
+			if (method == BVHTree::SPLIT_SAH)
+				RunNarrowphase(tree, rays, numNarrow, narrow);
+
+			const BVHTree *triTree = tree.GetTriTree();
+			const double rayMs = std::max(Profiler::Clock::ms(stats.rayTicks), 1e-6);
+			const double contactMs = std::max(Profiler::Clock::ms(stats.contactTicks), 1e-6);
+			Output("%-24s %8d %-8s %7u %5d %8.2f %9.2f %10.3f %8llu %10.0f %8llu\n", name.c_str(), tree.GetNumTris(),
+				s_methodNames[method], unsigned(triTree->GetNumNodes()), triTree->GetDepth(), triTree->GetCost(),
+				Profiler::Clock::ms(stats.buildTicks), numRays / (rayMs * 1000.0), (unsigned long long)stats.hits,
+				numContacts / (contactMs / 1000.0), (unsigned long long)stats.contacts);
+
+			QueryStats &total = totals[method];
+			total.buildTicks += stats.buildTicks;
+			total.rayTicks += stats.rayTicks;
+			total.contactTicks += stats.contactTicks;
+			total.hits += stats.hits;
+			total.contacts += stats.contacts;
+		}
+
+		if (hits[0] != hits[1]) {
+			Output("%-24s ray hits differ between split methods!\n", name.c_str());
+			result = 1;
+		}
+	}
+
+	Output("\n%-8s %12s %12s %12s\n", "method", "build ms", "ray ms", "contact ms");
+	for (int method = 0; method < NUM_METHODS; method++) {
+		const QueryStats &total = totals[method];
+		Output("%-8s %12.2f %12.2f %12.2f\n", s_methodNames[method], Profiler::Clock::ms(total.buildTicks),
+			Profiler::Clock::ms(total.rayTicks), Profiler::Clock::ms(total.contactTicks));
+	}
+
+	Output("\n%-8s %12s %12s\n", "narrow", "ms", "Mtests/s");
+	for (int version = 0; version < 2; version++) {
+		const double ms = std::max(Profiler::Clock::ms(narrow.ticks[version]), 1e-6);
+		Output("%-8s %12.2f %12.2f\n", version == 0 ? "simd" : "scalar", ms, narrow.tests / (ms * 1000.0));
+	}
+	if (narrow.mismatches) {
+		Output("%llu narrowphase results differ between the SIMD and scalar versions!\n", (unsigned long long)narrow.mismatches);
+		result = 1;
+	}
+
+	Graphics::Uninit();
+	renderer.reset();
+	SDL_Quit();
+	FileSystem::Uninit();
+
+	return result;
+}
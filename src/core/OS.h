@@ -8,6 +8,7 @@
  * raising a message dialog
  */
 
+#include <cstddef>
 #include <string>
 
 namespace OS {
@@ -24,6 +25,9 @@ namespace OS {
 	// http://stackoverflow.com/questions/150355/programmatically-find-the-number-of-cores-on-a-machine
 	uint32_t GetNumCores();
 
+	// the most memory the process has had resident so far, in bytes. 0 if unknown
+	size_t GetPeakMemoryUsage();
+
 	// return a string describing the operating system that the game is running on, useful!
 	const std::string GetOSInfoString();
 
@@ -490,6 +490,7 @@ void FactionsDatabase::PostInit()
 	assert(m_initialized);
 	assert(m_galaxy->IsInitialized());
 	SetHomeSectors();
+	m_spatial_index.Build(m_factions);
 
 #ifdef DUMP_FACTIONS // useful for dumping the factions from an autogenerated script
 	for (size_t i = 0; i < m_factions.size(); i++)
@@ -535,7 +536,6 @@ void FactionsDatabase::AddFaction(Faction *faction)
 		}
 		m_missingFactionsMap.erase(it);
 	}
-	m_spatial_index.Add(faction);
 
 	if (faction->hasHomeworld) m_homesystems.insert(faction->homeworld.SystemOnly());
 	faction->idx = m_factions.size() - 1;
@@ -580,17 +580,8 @@ const Faction *FactionsDatabase::GetNearestClaimant(const Sector::System *sys) c
 	}
 
 	// if it didn't, or it wasn't a custom StarStystem, then we go ahead and assign it a faction allegiance like normal below...
-	const Faction *result = &m_no_faction;
-	double closestFactionDist = HUGE_VAL;
-	ConstFactionList &candidates = m_spatial_index.CandidateFactions(sys);
-
-	for (ConstFactionIterator it = candidates.begin(); it != candidates.end(); ++it) {
-		if ((*it)->IsClaimed(sys->GetPath()))
-			return *it; // this is a very specific claim, no further checks for distance from another factions homeworld is needed.
-		if ((*it)->IsCloserAndContains(closestFactionDist, sys))
-			result = *it;
-	}
-	return result;
+	const Faction *result = m_spatial_index.NearestClaimant(sys);
+	return result ? result : &m_no_faction;
 }
 
 bool FactionsDatabase::IsHomeSystem(const SystemPath &sysPath) const
@@ -613,52 +604,6 @@ bool Faction::IsClaimed(SystemPath path) const
 	return false;
 }
 
-/*	Answer whether the faction both contains the sysPath, and has a homeworld
-	closer than the passed distance.
-
-	if it is, then the passed distance will also be updated to be the distance
-	from the factions homeworld to the sysPath.
-*/
-bool Faction::IsCloserAndContains(double &closestFactionDist, const Sector::System *sys) const
-{
-	PROFILE_SCOPED()
-	/*	Treat factions without homeworlds as if they are of effectively infinite radius,
-		so every world is potentially within their borders, but also treat them as if
-		they had a homeworld that was infinitely far away, so every other faction has
-		a better claim.
-	*/
-	float distance = HUGE_VAL;
-	bool inside = true;
-
-	/*	Factions that have a homeworld... */
-	if (hasHomeworld) {
-		/* ...automatically gain the allegiance of worlds within the same sector... */
-		if (sys->InSameSector(homeworld)) {
-			distance = 0;
-		}
-
-		/* ...otherwise we need to calculate whether the world is inside the
-		   the faction border, and how far away it is. */
-		else {
-			RefCountedPtr<const Sector> homeSec = GetHomeSector();
-			const Sector::System *homeSys = &homeSec->m_systems[homeworld.systemIndex];
-			distance = Sector::System::DistanceBetween(homeSys, sys);
-			inside = distance < Radius();
-		}
-	}
-
-	/*	if the faction contains the world, and its homeworld is closer, then this faction
-		wins, and we update the closestFactionDist */
-	if (inside && (distance <= closestFactionDist)) {
-		closestFactionDist = distance;
-		return true;
-
-		/* otherwise this isn't the faction we were looking for */
-	} else {
-		return false;
-	}
-}
-
 Color Faction::AdjustedColour(fixed population, bool inRange) const
 {
 	PROFILE_SCOPED()
@@ -786,94 +731,165 @@ Faction::Faction(Galaxy *galaxy) :
 
 // ------ Factions Spatial Indexing ------
 
-void FactionsDatabase::Octsapling::Add(const Faction *faction)
+static const Uint32 FACTION_INDEX_LEAF_SIZE = 4;
+
+void FactionsDatabase::SpatialIndex::Clear()
+{
+	m_spheres.clear();
+	m_nodes.clear();
+	m_unbounded.clear();
+	m_claims.clear();
+}
+
+void FactionsDatabase::SpatialIndex::Build(const std::vector<Faction *> &factions)
 {
 	PROFILE_SCOPED()
-	/*  The general principle here is to put the faction in every octbox cell that a system
-	    that is a member of that faction could be in. This should let us cut the number
-		of factions that have to be checked by GetNearestFaction, by eliminating right off
-		all the those Factions that aren't in the same cell.
+	/*  Every faction with a homeworld is represented by its sphere of influence
+		around the homeworld, widened to cover the whole home sector as systems in
+		the homeworld's sector always belong to it. Factions without a homeworld are
+		effectively of infinite radius and are kept aside, as are the explicit
+		claims, which win regardless of distance.
 
-		As I'm just going for the quick performance win, I'm being very sloppy and
-		treating a Faction as if it was a cube rather than a sphere. I'm also not even
-		attempting to work out real faction boundaries for this.
+		This happens once at galaxy initialisation so isn't performance critical.
+	*/
+	Clear();
+
+	for (const Faction *faction : factions) {
+		for (const SystemPath &claim : faction->m_ownedsystemlist)
+			m_claims.emplace(claim, faction); // keeps the lowest index claimant
+
+		RefCountedPtr<const Sector> sec;
+		if (faction->hasHomeworld)
+			sec = faction->GetHomeSector();
+		if (!sec || faction->homeworld.systemIndex >= sec->m_systems.size()) {
+			if (faction->hasHomeworld)
+				Output("Warning: faction %s has an invalid homeworld, it will be treated as having none\n", faction->name.c_str());
+			m_unbounded.push_back(faction);
+			continue;
+		}
 
-		Obviously this all could be improved even without this Octsapling growing into
-		a full Octree.
+		const Sector::System &home = sec->m_systems[faction->homeworld.systemIndex];
+		m_spheres.push_back({ faction, home.GetPosition(), home.sx, home.sy, home.sz, faction->Radius() });
+	}
 
-		This part happens at faction generation time so shouldn't be too performance
-		critical
-	*/
-	RefCountedPtr<const Sector> sec = faction->GetHomeSector();
+	if (!m_spheres.empty()) {
+		m_nodes.reserve(2 * m_spheres.size() / FACTION_INDEX_LEAF_SIZE + 1);
+		BuildNode(0, m_spheres.size());
+	}
+}
 
-	/* only factions with homeworlds that are available at faction generation time can
-	   be added to specific cells...
-	*/
-	if (faction->hasHomeworld && (faction->homeworld.systemIndex < sec->m_systems.size())) {
-		/* calculate potential indexes for the octbox cells the faction needs to go into
-		*/
-		Sector::System sys = sec->m_systems[faction->homeworld.systemIndex];
+Uint32 FactionsDatabase::SpatialIndex::BuildNode(Uint32 first, Uint32 count)
+{
+	const Uint32 nodeIdx = m_nodes.size();
+	m_nodes.emplace_back();
 
-		int xmin = BoxIndex(Sint32(sys.GetFullPosition().x - float((faction->Radius()))));
-		int xmax = BoxIndex(Sint32(sys.GetFullPosition().x + float((faction->Radius()))));
-		int ymin = BoxIndex(Sint32(sys.GetFullPosition().y - float((faction->Radius()))));
-		int ymax = BoxIndex(Sint32(sys.GetFullPosition().y + float((faction->Radius()))));
-		int zmin = BoxIndex(Sint32(sys.GetFullPosition().z - float((faction->Radius()))));
-		int zmax = BoxIndex(Sint32(sys.GetFullPosition().z + float((faction->Radius()))));
+	Aabb bounds, centres;
+	for (Uint32 i = first; i < first + count; i++) {
+		const Sphere &s = m_spheres[i];
+		const vector3d sectorMin = double(Sector::SIZE) * vector3d(s.sx, s.sy, s.sz);
+		const vector3d centre = sectorMin + vector3d(s.homePos);
+		// pad by a light year so float rounding in the distance tests can't fall outside
+		const double extent = std::max(s.radius, 0.0) + 1.0;
+		bounds.Update(centre - vector3d(extent));
+		bounds.Update(centre + vector3d(extent));
+		bounds.Update(sectorMin - vector3d(1.0));
+		bounds.Update(sectorMin + vector3d(Sector::SIZE + 1.0));
+		centres.Update(centre);
+	}
+	m_nodes[nodeIdx].bounds = bounds;
 
-		/* put the faction in all the octbox cells needed in a hideously inexact way that
-		   will generate duplicates in each cell in many cases
-		*/
-		octbox[xmin][ymin][zmin].push_back(faction); // 0,0,0
-		octbox[xmax][ymin][zmin].push_back(faction); // 1,0,0
-		octbox[xmax][ymax][zmin].push_back(faction); // 1,1,0
-		octbox[xmax][ymax][zmax].push_back(faction); // 1,1,1
+	if (count <= FACTION_INDEX_LEAF_SIZE) {
+		m_nodes[nodeIdx].first = first;
+		m_nodes[nodeIdx].count = count;
+		return nodeIdx;
+	}
 
-		octbox[xmin][ymax][zmin].push_back(faction); // 0,1,0
-		octbox[xmin][ymax][zmax].push_back(faction); // 0,1,1
-		octbox[xmin][ymin][zmax].push_back(faction); // 0,0,1
-		octbox[xmax][ymin][zmax].push_back(faction); // 1,0,1
+	// median split along the longest axis of the sphere centres
+	const vector3d size = centres.max - centres.min;
+	const int axis = (size.x > size.y) ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	const Uint32 half = count / 2;
+	std::nth_element(m_spheres.begin() + first, m_spheres.begin() + first + half, m_spheres.begin() + first + count,
+		[axis](const Sphere &a, const Sphere &b) {
+			const Sint32 sa[3] = { a.sx, a.sy, a.sz };
+			const Sint32 sb[3] = { b.sx, b.sy, b.sz };
+			const double ca = double(Sector::SIZE) * sa[axis] + a.homePos[axis];
+			const double cb = double(Sector::SIZE) * sb[axis] + b.homePos[axis];
+			return ca < cb;
+		});
+
+	BuildNode(first, half);
+	const Uint32 right = BuildNode(first + half, count - half);
+	m_nodes[nodeIdx].right = right;
+	m_nodes[nodeIdx].count = 0;
+	return nodeIdx;
+}
+
+/*	Answer the faction a system belongs to, or nullptr for none.
+
+	An explicit claim on the system or its sector always wins (the lowest index
+	claimant if there are several). Otherwise the faction with the closest
+	homeworld whose sphere of influence contains the system wins, with ties going
+	to the highest faction index. Factions without a homeworld are treated as being
+	of infinite radius but infinitely far away, so every other faction has a better
+	claim.
+*/
+const Faction *FactionsDatabase::SpatialIndex::NearestClaimant(const Sector::System *sys) const
+{
+	PROFILE_SCOPED()
+	const Faction *result = nullptr;
+
+	if (!m_claims.empty()) {
+		const SystemPath path = sys->GetPath();
+		auto it = m_claims.find(path);
+		if (it != m_claims.end())
+			result = it->second;
+		it = m_claims.find(SystemPath(path.sectorX, path.sectorY, path.sectorZ, -99));
+		if (it != m_claims.end() && (!result || it->second->idx < result->idx))
+			result = it->second;
+		if (result)
+			return result;
+	}
 
-		/* prune any duplicates from the octbox cells making things slightly saner
-		*/
-		PruneDuplicates(0, 0, 0);
-		PruneDuplicates(1, 0, 0);
-		PruneDuplicates(1, 1, 0);
-		PruneDuplicates(1, 1, 1);
+	if (!m_unbounded.empty())
+		result = m_unbounded.back();
 
-		PruneDuplicates(0, 1, 0);
-		PruneDuplicates(0, 1, 1);
-		PruneDuplicates(0, 0, 1);
-		PruneDuplicates(1, 0, 1);
+	if (m_nodes.empty())
+		return result;
 
-	} else {
-		/* ...other factions, such as ones with no homeworlds, and more annoyingly ones
-	   whose homeworlds don't exist yet because they're custom systems have to go in
-	   *every* octbox cell
-	*/
-		octbox[0][0][0].push_back(faction);
-		octbox[1][0][0].push_back(faction);
-		octbox[1][1][0].push_back(faction);
-		octbox[1][1][1].push_back(faction);
-
-		octbox[0][1][0].push_back(faction);
-		octbox[0][1][1].push_back(faction);
-		octbox[0][0][1].push_back(faction);
-		octbox[1][0][1].push_back(faction);
-	}
-}
+	const vector3d pos(sys->GetFullPosition());
+	float closestDist = HUGE_VAL;
 
-void FactionsDatabase::Octsapling::PruneDuplicates(const int bx, const int by, const int bz)
-{
-	octbox[bx][by][bz].erase(std::unique(octbox[bx][by][bz].begin(), octbox[bx][by][bz].end()), octbox[bx][by][bz].end());
-}
+	Uint32 stack[64];
+	Uint32 stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize) {
+		const Node &node = m_nodes[stack[--stackSize]];
+		if (!node.bounds.IsIn(pos))
+			continue;
 
-const std::vector<const Faction *> &FactionsDatabase::Octsapling::CandidateFactions(const Sector::System *sys) const
-{
-	PROFILE_SCOPED()
-	/* answer the factions that we've put in the same octobox cell as the one the
-	   system would go in. This part happens every time we do GetNearest faction
-	   so *is* performance criticale.e
-	*/
-	return octbox[BoxIndex(sys->sx)][BoxIndex(sys->sy)][BoxIndex(sys->sz)];
+		if (node.count == 0) {
+			assert(stackSize + 2 <= COUNTOF(stack));
+			stack[stackSize++] = node.right;
+			stack[stackSize++] = Uint32(&node - m_nodes.data()) + 1;
+			continue;
+		}
+
+		for (Uint32 i = node.first; i < node.first + node.count; i++) {
+			const Sphere &s = m_spheres[i];
+			float distance = 0.0f;
+			// same calculation as Sector::System::DistanceBetween, so results match exactly
+			if (s.sx != sys->sx || s.sy != sys->sy || s.sz != sys->sz) {
+				vector3f dv = s.homePos - sys->GetPosition();
+				dv += Sector::SIZE * vector3f(float(s.sx - sys->sx), float(s.sy - sys->sy), float(s.sz - sys->sz));
+				distance = dv.Length();
+				if (!(distance < s.radius))
+					continue;
+			}
+			if (distance < closestDist || (distance == closestDist && s.faction->idx > result->idx)) {
+				closestDist = distance;
+				result = s.faction;
+			}
+		}
+	}
+	return result;
 }
@@ -4,6 +4,7 @@
 #ifndef _FACTIONS_H
 #define _FACTIONS_H
 
+#include "Aabb.h"
 #include "DeleteEmitter.h"
 #include "Polit.h"
 #include "fixed.h"
@@ -76,14 +77,8 @@ private:
 
 	Galaxy *const m_galaxy;							  // galaxy we are part of
 	mutable RefCountedPtr<const Sector> m_homesector; // cache of home sector to use in distance calculations
-	bool IsCloserAndContains(double &closestFactionDist, const Sector::System *sys) const;
 };
 
-/* One day it might grow up to become a full tree, on the  other hand it might be
-   cut down before it's full growth to be replaced by
-   a proper spatial data structure.
-*/
-
 class FactionsDatabase {
 public:
 	FactionsDatabase(Galaxy *galaxy, const std::string &factionDir) :
@@ -112,15 +107,41 @@ public:
 	bool MayAssignFactions() const;
 
 private:
-	class Octsapling {
+	/* Bounding volume hierarchy over the faction influence spheres.
+
+	   It is built once the galaxy has been initialised (the homeworld sectors have
+	   to exist) and is never modified afterwards, so it can be queried concurrently
+	   from sector generation running on worker threads.
+	*/
+	class SpatialIndex {
 	public:
-		void Add(const Faction *faction);
-		const std::vector<const Faction *> &CandidateFactions(const Sector::System *sys) const;
+		void Build(const std::vector<Faction *> &factions);
+		void Clear();
+		const Faction *NearestClaimant(const Sector::System *sys) const;
 
 	private:
-		std::vector<const Faction *> octbox[2][2][2];
-		static int BoxIndex(Sint32 sectorIndex) { return sectorIndex < 0 ? 0 : 1; };
-		void PruneDuplicates(const int bx, const int by, const int bz);
+		struct Sphere {
+			const Faction *faction;
+			vector3f homePos; // position of the homeworld within its sector
+			Sint32 sx, sy, sz; // homeworld sector
+			double radius;
+		};
+
+		// nodes are stored depth first, so the left child of a node always
+		// directly follows it and only the right child needs an index
+		struct Node {
+			Aabb bounds;
+			Uint32 right;
+			Uint32 first; // first sphere, for leaves
+			Uint32 count; // number of spheres, zero for inner nodes
+		};
+
+		Uint32 BuildNode(Uint32 first, Uint32 count);
+
+		std::vector<Sphere> m_spheres;
+		std::vector<Node> m_nodes;
+		std::vector<const Faction *> m_unbounded; // factions without a (valid) homeworld, in index order
+		std::map<SystemPath, const Faction *> m_claims; // lowest index faction claiming a system or sector
 	};
 
 	typedef std::vector<Faction *> FactionList;
@@ -140,7 +161,7 @@ private:
 	FactionList m_factions;
 	FactionMap m_factions_byName;
 	HomeSystemSet m_homesystems;
-	Octsapling m_spatial_index;
+	SpatialIndex m_spatial_index;
 	bool m_may_assign_factions;
 	bool m_initialized = false;
 	MissingFactionsMap m_missingFactionsMap;
@@ -175,9 +175,13 @@ RefCountedPtr<Sector> GalaxyGenerator::GenerateSector(RefCountedPtr<Galaxy> gala
 	Random rng(_init, 4);
 	SectorConfig config;
 	RefCountedPtr<Sector> sector(new Sector(galaxy, path, cache));
-	for (SectorGeneratorStage *secgen : m_sectorStage)
-		if (!secgen->Apply(rng, galaxy, sector, &config))
+	for (SectorGeneratorStage *secgen : m_sectorStage) {
+		if (m_stageObserver) m_stageObserver->OnStageBegin(secgen);
+		const bool carryOn = secgen->Apply(rng, galaxy, sector, &config);
+		if (m_stageObserver) m_stageObserver->OnStageEnd(secgen);
+		if (!carryOn)
 			break;
+	}
 	return sector;
 }
 
@@ -192,8 +196,12 @@ RefCountedPtr<StarSystem> GalaxyGenerator::GenerateStarSystem(RefCountedPtr<Gala
 	Random rng(_init, 6);
 	StarSystemConfig config;
 	RefCountedPtr<StarSystem::GeneratorAPI> system(new StarSystem::GeneratorAPI(path, galaxy, cache, rng));
-	for (StarSystemGeneratorStage *sysgen : m_starSystemStage)
-		if (!sysgen->Apply(rng, galaxy, system, &config))
+	for (StarSystemGeneratorStage *sysgen : m_starSystemStage) {
+		if (m_stageObserver) m_stageObserver->OnStageBegin(sysgen);
+		const bool carryOn = sysgen->Apply(rng, galaxy, system, &config);
+		if (m_stageObserver) m_stageObserver->OnStageEnd(sysgen);
+		if (!carryOn)
 			break;
+	}
 	return system;
 }
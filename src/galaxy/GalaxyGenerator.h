@@ -11,6 +11,7 @@
 #include <list>
 #include <string>
 
+class GalaxyGeneratorStage;
 class SectorGeneratorStage;
 class StarSystemGeneratorStage;
 
@@ -64,10 +65,24 @@ public:
 			isCustomOnly(false) {}
 	};
 
+	// Told about every stage applied, on the thread doing the generation.
+	// Used to profile the individual stages, see galaxybench.
+	class StageObserver {
+	public:
+		virtual ~StageObserver() {}
+		virtual void OnStageBegin(const GalaxyGeneratorStage *stage) = 0;
+		virtual void OnStageEnd(const GalaxyGeneratorStage *stage) = 0;
+	};
+	void SetStageObserver(StageObserver *observer) { m_stageObserver = observer; }
+
+	const std::list<SectorGeneratorStage *> &GetSectorStages() const { return m_sectorStage; }
+	const std::list<StarSystemGeneratorStage *> &GetStarSystemStages() const { return m_starSystemStage; }
+
 private:
 	GalaxyGenerator(const std::string &name, Version version = LAST_VERSION) :
 		m_name(name),
-		m_version(version) {}
+		m_version(version),
+		m_stageObserver(nullptr) {}
 
 	virtual RefCountedPtr<Sector> GenerateSector(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, SectorCache *cache);
 	virtual RefCountedPtr<StarSystem> GenerateStarSystem(RefCountedPtr<Galaxy> galaxy, const SystemPath &path, StarSystemCache *cache);
@@ -77,6 +92,7 @@ private:
 
 	std::list<SectorGeneratorStage *> m_sectorStage;
 	std::list<StarSystemGeneratorStage *> m_starSystemStage;
+	StageObserver *m_stageObserver;
 
 	static RefCountedPtr<Galaxy> s_galaxy;
 	static std::string s_defaultGenerator;
@@ -99,6 +115,8 @@ class GalaxyGeneratorStage {
 public:
 	virtual ~GalaxyGeneratorStage() {}
 
+	virtual const char *GetName() const = 0;
+
 	virtual void ToJson(Json &jsonObj, RefCountedPtr<Galaxy> galaxy) {}
 	virtual void FromJson(const Json &jsonObj, RefCountedPtr<Galaxy> galaxy) {}
 
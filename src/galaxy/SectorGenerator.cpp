@@ -545,7 +545,8 @@ void SectorPersistenceGenerator::FromJson(const Json &jsonObj, RefCountedPtr<Gal
 	// It used to be stored by a general System-information container type called PersistSystemData<>.
 
 	try {
-		Json dictArray = jsonObj["dict"].get<Json::array_t>();
+		const Json &dictArray = jsonObj["dict"];
+		if (!dictArray.is_array()) throw SavedGameCorruptException();
 		for (unsigned int arrayIndex = 0; arrayIndex < dictArray.size(); ++arrayIndex) {
 			const Json &dictArrayEl = dictArray[arrayIndex];
 			SystemPath path = SystemPath::FromJson(dictArrayEl);
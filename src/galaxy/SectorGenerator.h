@@ -14,6 +14,7 @@ class SectorCustomSystemsGenerator : public SectorGeneratorStage {
 public:
 	SectorCustomSystemsGenerator(int customOnlyRadius) :
 		m_customOnlyRadius(customOnlyRadius) {}
+	virtual const char *GetName() const { return "SectorCustomSystemsGenerator"; }
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<Sector> sector, GalaxyGenerator::SectorConfig *config);
 
 private:
@@ -22,6 +23,7 @@ private:
 
 class SectorRandomSystemsGenerator : public SectorGeneratorStage {
 public:
+	virtual const char *GetName() const { return "SectorRandomSystemsGenerator"; }
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<Sector> sector, GalaxyGenerator::SectorConfig *config);
 
 private:
@@ -32,6 +34,7 @@ class SectorPersistenceGenerator : public SectorGeneratorStage {
 public:
 	SectorPersistenceGenerator(GalaxyGenerator::Version version) :
 		m_version(version) {}
+	virtual const char *GetName() const { return "SectorPersistenceGenerator"; }
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<Sector> sector, GalaxyGenerator::SectorConfig *config);
 	virtual void FromJson(const Json &jsonObj, RefCountedPtr<Galaxy> galaxy);
 	virtual void ToJson(Json &jsonObj, RefCountedPtr<Galaxy> galaxy);
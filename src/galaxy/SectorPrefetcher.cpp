@@ -0,0 +1,238 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "galaxy/SectorPrefetcher.h"
+
+#include "galaxy/Galaxy.h"
+#include "galaxy/Sector.h"
+#include "galaxy/StarSystem.h"
+#include "utils.h"
+#include <algorithm>
+#include <set>
+
+//#define DEBUG_CACHE
+
+// used to define a cube centred on your current location
+static const int sectorRadius = 5;
+// how many upcoming route hops to prefetch around
+static const unsigned MAX_ROUTE_HOPS = 8;
+// how strongly sectors ahead of the player are preferred over those behind
+static const float TRAVEL_BIAS = 0.5f;
+// how many prefetches a path's last use is remembered for
+static const Uint32 LAST_USED_EPOCHS = 64;
+
+// rough memory footprint of cached objects, used to apply the budget
+static size_t EstimateSize(const Sector &sec)
+{
+	return sizeof(Sector) + sec.m_systems.capacity() * sizeof(Sector::System);
+}
+
+static size_t EstimateSize(const StarSystem &sys)
+{
+	return sizeof(StarSystem) + sys.GetNumBodies() * sizeof(SystemBody);
+}
+
+// every hinted path gets a last used entry, cached or not, so drop the old
+// ones or the maps grow with every sector the player has been near
+template <typename Map>
+static void PruneLastUsed(Map &lastUsed, Uint32 epoch)
+{
+	for (auto it = lastUsed.begin(); it != lastUsed.end();) {
+		if (epoch - it->second > LAST_USED_EPOCHS)
+			it = lastUsed.erase(it);
+		else
+			++it;
+	}
+}
+
+template <typename Map>
+static Uint32 GetLastUsed(const Map &lastUsed, const SystemPath &path)
+{
+	auto it = lastUsed.find(path);
+	return it != lastUsed.end() ? it->second : 0;
+}
+
+SectorPrefetcher::SectorPrefetcher(RefCountedPtr<Galaxy> galaxy, size_t memoryBudget) :
+	m_galaxy(galaxy),
+	m_sectorCache(galaxy->NewSectorSlaveCache()),
+	m_starSystemCache(galaxy->NewStarSystemSlaveCache()),
+	m_memoryBudget(memoryBudget),
+	m_epoch(0)
+{
+}
+
+void SectorPrefetcher::Prefetch(const Hints &hints)
+{
+	PROFILE_SCOPED()
+	m_hints = hints;
+	++m_epoch;
+
+	const SystemPath &here = m_hints.here;
+	std::set<SystemPath, SystemPath::LessSectorOnly> seen;
+	m_sectors.clear();
+	auto want = [&](const SystemPath &path) {
+		const SystemPath sec = path.SectorOnly();
+		if (seen.insert(sec).second)
+			m_sectors.push_back(sec);
+	};
+	auto wantAround = [&](const SystemPath &path) {
+		want(path);
+		for (int x = -1; x <= 1; x++)
+			for (int y = -1; y <= 1; y++)
+				for (int z = -1; z <= 1; z++)
+					want(SystemPath(path.sectorX + x, path.sectorY + y, path.sectorZ + z));
+	};
+
+	// the current system, where we're going and the next few route hops come first
+	want(here);
+	if (m_hints.target.HasValidSystem())
+		wantAround(m_hints.target);
+	auto hop = m_hints.route.begin();
+	for (auto it = m_hints.route.begin(); it != m_hints.route.end(); ++it) {
+		if (it->HasValidSystem() && here.HasValidSystem() && it->IsSameSystem(here)) {
+			hop = it + 1;
+			break;
+		}
+	}
+	for (unsigned n = 0; hop != m_hints.route.end() && n < MAX_ROUTE_HOPS; ++hop, ++n)
+		wantAround(*hop);
+
+	// then the cube around us, nearest first, preferring the direction of travel
+	vector3f travel(0.0f);
+	if (m_hints.previous.HasValidSystem() && !m_hints.previous.IsSameSector(here)) {
+		travel = vector3f(here.sectorX - m_hints.previous.sectorX, here.sectorY - m_hints.previous.sectorY, here.sectorZ - m_hints.previous.sectorZ);
+		travel = travel.Normalized();
+	}
+	std::vector<std::pair<float, SystemPath>> cube;
+	cube.reserve((2 * sectorRadius + 1) * (2 * sectorRadius + 1) * (2 * sectorRadius + 1));
+	for (int x = -sectorRadius; x <= sectorRadius; x++) {
+		for (int y = -sectorRadius; y <= sectorRadius; y++) {
+			for (int z = -sectorRadius; z <= sectorRadius; z++) {
+				const vector3f offset(x, y, z);
+				const float score = offset.Length() - TRAVEL_BIAS * offset.Dot(travel);
+				cube.emplace_back(score, SystemPath(here.sectorX + x, here.sectorY + y, here.sectorZ + z));
+			}
+		}
+	}
+	std::stable_sort(cube.begin(), cube.end(),
+		[](const std::pair<float, SystemPath> &a, const std::pair<float, SystemPath> &b) { return a.first < b.first; });
+	for (const auto &c : cube)
+		want(c.second);
+
+	// only request what isn't already cached, keeping the priority order
+	SectorCache::PathVector missing;
+	for (const SystemPath &sec : m_sectors) {
+		m_sectorLastUsed[sec] = m_epoch;
+		if (!m_sectorCache->GetIfCached(sec))
+			missing.push_back(sec);
+	}
+
+#ifdef DEBUG_CACHE
+	Output("SectorPrefetcher: " SIZET_FMT " sectors wanted, " SIZET_FMT " missing\n", m_sectors.size(), missing.size());
+#endif
+
+	// the callback always works on the latest prefetch set, so it doesn't
+	// matter if it belongs to a fill that was ordered before this one
+	m_sectorCache->FillCache(missing, [this]() { FillStarSystems(); });
+}
+
+void SectorPrefetcher::FillStarSystems()
+{
+	PROFILE_SCOPED()
+	const SystemPath &here = m_hints.here;
+
+	StarSystemCache::PathVector paths;
+	auto want = [&](const SystemPath &path) {
+		m_systemLastUsed[path] = m_epoch;
+		if (!m_starSystemCache->GetIfCached(path))
+			paths.push_back(path);
+	};
+
+	if (here.HasValidSystem())
+		want(here.SystemOnly());
+	if (m_hints.target.HasValidSystem())
+		want(m_hints.target.SystemOnly());
+	for (const SystemPath &hop : m_hints.route)
+		if (hop.HasValidSystem())
+			want(hop.SystemOnly());
+
+	// every system in the cube around us, in the same order as the sectors
+	for (const SystemPath &path : m_sectors) {
+		if (std::abs(path.sectorX - here.sectorX) > sectorRadius ||
+			std::abs(path.sectorY - here.sectorY) > sectorRadius ||
+			std::abs(path.sectorZ - here.sectorZ) > sectorRadius)
+			continue;
+		RefCountedPtr<Sector> sec(m_sectorCache->GetIfCached(path));
+		if (!sec)
+			continue; // still being generated, we'll be called again when it's done
+		for (const Sector::System &ss : sec->m_systems)
+			want(SystemPath(ss.sx, ss.sy, ss.sz, ss.idx));
+	}
+	m_starSystemCache->FillCache(paths);
+
+	Trim();
+}
+
+void SectorPrefetcher::Trim()
+{
+	PROFILE_SCOPED()
+	PruneLastUsed(m_sectorLastUsed, m_epoch);
+	PruneLastUsed(m_systemLastUsed, m_epoch);
+
+	// anything not used by the current prefetch set is a candidate for eviction
+	struct Candidate {
+		Uint32 lastUsed;
+		size_t size;
+		SystemPath path;
+		bool isSector;
+	};
+	std::vector<Candidate> candidates;
+	size_t total = 0;
+
+	for (auto it = m_sectorCache->Begin(); it != m_sectorCache->End(); ++it) {
+		const size_t size = EstimateSize(*it->second);
+		total += size;
+		const Uint32 lastUsed = GetLastUsed(m_sectorLastUsed, it->first);
+		if (lastUsed != m_epoch)
+			candidates.push_back({ lastUsed, size, it->first, true });
+	}
+	for (auto it = m_starSystemCache->Begin(); it != m_starSystemCache->End(); ++it) {
+		const size_t size = EstimateSize(*it->second);
+		total += size;
+		const Uint32 lastUsed = GetLastUsed(m_systemLastUsed, it->first);
+		if (lastUsed != m_epoch)
+			candidates.push_back({ lastUsed, size, it->first, false });
+	}
+
+	if (total <= m_memoryBudget)
+		return;
+
+	// oldest first, star systems before the sectors they came from
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+		if (a.lastUsed != b.lastUsed) return a.lastUsed < b.lastUsed;
+		return !a.isSector && b.isSector;
+	});
+
+#ifdef DEBUG_CACHE
+	unsigned removed = 0;
+#endif
+	for (const Candidate &c : candidates) {
+		if (total <= m_memoryBudget)
+			break;
+		if (c.isSector) {
+			m_sectorCache->Erase(c.path);
+			m_sectorLastUsed.erase(c.path);
+		} else {
+			m_starSystemCache->Erase(c.path);
+			m_systemLastUsed.erase(c.path);
+		}
+		total -= c.size;
+#ifdef DEBUG_CACHE
+		++removed;
+#endif
+	}
+
+#ifdef DEBUG_CACHE
+	Output("SectorPrefetcher: evicted %u entries, " SIZET_FMT " bytes retained\n", removed, total);
+#endif
+}
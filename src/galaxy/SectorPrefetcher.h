@@ -0,0 +1,55 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef SECTORPREFETCHER_H
+#define SECTORPREFETCHER_H
+
+#include "RefCounted.h"
+#include "galaxy/GalaxyCache.h"
+#include "galaxy/SystemPath.h"
+#include <map>
+#include <vector>
+
+class Galaxy;
+
+// Keeps the sectors and star systems around the player cached, filling the
+// caches in order of how likely they are to be needed next (the current
+// system, the hyperspace target and the upcoming route hops, then the space
+// around the player biased towards the direction of travel).
+// Entries that fall out of the prefetch set aren't dropped straight away but
+// are retained, least recently used first out, while the estimated size of
+// the caches stays under the memory budget.
+class SectorPrefetcher {
+public:
+	struct Hints {
+		SystemPath here;				// current system, or hyperspace destination
+		SystemPath previous;			// system we came from, if any
+		SystemPath target;				// hyperspace target, if any
+		std::vector<SystemPath> route; // plotted route, if any
+	};
+
+	SectorPrefetcher(RefCountedPtr<Galaxy> galaxy, size_t memoryBudget);
+
+	void Prefetch(const Hints &hints);
+	const Hints &GetHints() const { return m_hints; }
+
+	RefCountedPtr<SectorCache::Slave> GetSectorCache() { return m_sectorCache; }
+	RefCountedPtr<StarSystemCache::Slave> GetStarSystemCache() { return m_starSystemCache; }
+
+private:
+	void FillStarSystems();
+	void Trim();
+
+	RefCountedPtr<Galaxy> m_galaxy;
+	RefCountedPtr<SectorCache::Slave> m_sectorCache;
+	RefCountedPtr<StarSystemCache::Slave> m_starSystemCache;
+	size_t m_memoryBudget;
+
+	Hints m_hints;
+	std::vector<SystemPath> m_sectors; // current prefetch set, highest priority first
+	Uint32 m_epoch;					   // incremented on every Prefetch()
+	std::map<SystemPath, Uint32, SystemPath::LessSectorOnly> m_sectorLastUsed;
+	std::map<SystemPath, Uint32, SystemPath::LessSystemOnly> m_systemLastUsed;
+};
+
+#endif
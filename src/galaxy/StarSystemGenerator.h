@@ -9,6 +9,7 @@
 
 class StarSystemFromSectorGenerator : public StarSystemGeneratorStage {
 public:
+	virtual const char *GetName() const { return "StarSystemFromSectorGenerator"; }
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, GalaxyGenerator::StarSystemConfig *config);
 };
 
@@ -29,6 +30,7 @@ protected:
 
 class StarSystemCustomGenerator : public StarSystemLegacyGeneratorBase {
 public:
+	virtual const char *GetName() const { return "StarSystemCustomGenerator"; }
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, GalaxyGenerator::StarSystemConfig *config);
 
 private:
@@ -37,6 +39,7 @@ private:
 
 class StarSystemRandomGenerator : public StarSystemLegacyGeneratorBase {
 public:
+	virtual const char *GetName() const { return "StarSystemRandomGenerator"; }
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, GalaxyGenerator::StarSystemConfig *config);
 
 private:
@@ -53,6 +56,7 @@ private:
 
 class PopulateStarSystemGenerator : public StarSystemLegacyGeneratorBase {
 public:
+	virtual const char *GetName() const { return "PopulateStarSystemGenerator"; }
 	virtual bool Apply(Random &rng, RefCountedPtr<Galaxy> galaxy, RefCountedPtr<StarSystem::GeneratorAPI> system, GalaxyGenerator::StarSystemConfig *config);
 
 private:
@@ -0,0 +1,115 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "galaxy/SystemQuery.h"
+
+#include "galaxy/Galaxy.h"
+#include "galaxy/Sector.h"
+#include "galaxy/StarSystem.h"
+#include "profiler/Profiler.h"
+#include <algorithm>
+
+SystemQuery::SystemQuery(RefCountedPtr<Galaxy> galaxy, const SystemPath &centre, float radius) :
+	m_galaxy(galaxy),
+	m_centre(centre.SystemOnly()),
+	m_radius(radius),
+	m_sort(SORT_NONE),
+	m_limit(0)
+{
+	assert(m_centre.HasValidSystem());
+}
+
+std::vector<SystemPath> SystemQuery::GetSectorPaths() const
+{
+	std::vector<SystemPath> paths;
+	const int diff = int(ceil(m_radius / Sector::SIZE));
+	for (int x = m_centre.sectorX - diff; x <= m_centre.sectorX + diff; x++)
+		for (int y = m_centre.sectorY - diff; y <= m_centre.sectorY + diff; y++)
+			for (int z = m_centre.sectorZ - diff; z <= m_centre.sectorZ + diff; z++)
+				paths.push_back(SystemPath(x, y, z));
+	return paths;
+}
+
+const std::vector<SystemQuery::Result> &SystemQuery::Run()
+{
+	PROFILE_SCOPED()
+	m_results.clear();
+
+	RefCountedPtr<const Sector> centreSec = m_galaxy->GetSector(m_centre);
+	if (m_centre.systemIndex >= centreSec->m_systems.size())
+		return m_results;
+	const Sector::System *centre = &centreSec->m_systems[m_centre.systemIndex];
+	const vector3f centrePos = centre->GetFullPosition();
+
+	// with no sort order every match is final, so we can stop at the limit
+	const bool stopAtLimit = m_limit && m_sort == SORT_NONE;
+	const bool needsPopulation = m_filter.hasMinPopulation || m_filter.hasMaxPopulation || m_sort == SORT_POPULATION;
+
+	for (const SystemPath &secPath : GetSectorPaths()) {
+		// skip sectors whose nearest point is out of range without generating them
+		const vector3f secMin = Sector::SIZE * vector3f(float(secPath.sectorX), float(secPath.sectorY), float(secPath.sectorZ));
+		const vector3f nearest(
+			Clamp(centrePos.x, secMin.x, secMin.x + Sector::SIZE),
+			Clamp(centrePos.y, secMin.y, secMin.y + Sector::SIZE),
+			Clamp(centrePos.z, secMin.z, secMin.z + Sector::SIZE));
+		if ((nearest - centrePos).Length() > m_radius)
+			continue;
+
+		RefCountedPtr<const Sector> sec = m_galaxy->GetSector(secPath);
+		for (const Sector::System &ss : sec->m_systems) {
+			if (!m_filter.includeCentre && ss.IsSameSystem(m_centre))
+				continue;
+
+			const float distance = Sector::System::DistanceBetween(centre, &ss);
+			if (distance > m_radius)
+				continue;
+
+			if (m_filter.explored >= 0 && ss.IsExplored() != (m_filter.explored > 0))
+				continue;
+			if (m_filter.faction && ss.GetFaction() != m_filter.faction)
+				continue;
+
+			// the rest may need the system itself
+			const SystemPath path = ss.GetPath();
+			RefCountedPtr<StarSystem> sys;
+			fixed population = ss.GetPopulation();
+			if (needsPopulation && population < 0) {
+				sys = m_galaxy->GetStarSystem(path);
+				population = sys->GetTotalPop();
+			}
+			if (m_filter.hasMinPopulation && population < m_filter.minPopulation)
+				continue;
+			if (m_filter.hasMaxPopulation && population > m_filter.maxPopulation)
+				continue;
+
+			if (m_filter.hasStations) {
+				if (!sys)
+					sys = m_galaxy->GetStarSystem(path);
+				if (!sys->HasSpaceStations())
+					continue;
+			}
+
+			m_results.push_back({ path, distance, population });
+			if (stopAtLimit && m_results.size() >= m_limit)
+				return m_results;
+		}
+	}
+
+	switch (m_sort) {
+	case SORT_DISTANCE:
+		std::stable_sort(m_results.begin(), m_results.end(),
+			[](const Result &a, const Result &b) { return a.distance < b.distance; });
+		break;
+	case SORT_POPULATION:
+		std::stable_sort(m_results.begin(), m_results.end(),
+			[](const Result &a, const Result &b) { return a.population > b.population; });
+		break;
+	case SORT_NONE:
+		break;
+	}
+
+	if (m_limit && m_results.size() > m_limit)
+		m_results.resize(m_limit);
+
+	return m_results;
+}
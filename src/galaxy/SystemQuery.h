@@ -0,0 +1,75 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SYSTEMQUERY_H
+#define _SYSTEMQUERY_H
+
+#include "RefCounted.h"
+#include "fixed.h"
+#include "galaxy/SystemPath.h"
+#include <vector>
+
+class Faction;
+class Galaxy;
+
+// Finds the systems within a radius of a system that match a filter, working
+// directly on the sector data so no per-candidate objects have to be created.
+// Cheap tests (distance, population, faction, exploration) are done first and
+// the star system is only generated for the tests that need it.
+class SystemQuery {
+public:
+	enum SortKey {
+		SORT_NONE,		 // in the order the sectors are visited
+		SORT_DISTANCE,	 // nearest first
+		SORT_POPULATION, // most populous first
+	};
+
+	struct Filter {
+		Filter() :
+			minPopulation(-1),
+			maxPopulation(-1),
+			hasMinPopulation(false),
+			hasMaxPopulation(false),
+			explored(-1),
+			faction(nullptr),
+			hasStations(false),
+			includeCentre(false) {}
+
+		fixed minPopulation, maxPopulation;
+		bool hasMinPopulation, hasMaxPopulation;
+		int explored; // -1 for either, 0 unexplored only, 1 explored only
+		const Faction *faction;
+		bool hasStations;
+		bool includeCentre;
+	};
+
+	struct Result {
+		SystemPath path;
+		float distance; // ly
+		fixed population;
+	};
+
+	SystemQuery(RefCountedPtr<Galaxy> galaxy, const SystemPath &centre, float radius);
+
+	void SetFilter(const Filter &filter) { m_filter = filter; }
+	void SetSort(SortKey sort) { m_sort = sort; }
+	// 0 for no limit
+	void SetLimit(size_t limit) { m_limit = limit; }
+
+	const std::vector<Result> &Run();
+	const std::vector<Result> &GetResults() const { return m_results; }
+
+	// the sectors the query needs, so they can be cached ahead of time
+	std::vector<SystemPath> GetSectorPaths() const;
+
+private:
+	RefCountedPtr<Galaxy> m_galaxy;
+	SystemPath m_centre;
+	float m_radius;
+	Filter m_filter;
+	SortKey m_sort;
+	size_t m_limit;
+	std::vector<Result> m_results;
+};
+
+#endif
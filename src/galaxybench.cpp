@@ -0,0 +1,548 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// Standalone benchmark for the galaxy generator. Generates a cube of sectors
+// and the star systems in them, timing each generator stage separately, and
+// prints checksums of the output so changes to the generator can be checked
+// for determinism.
+
+#include "buildopts.h"
+#include "core/Log.h"
+#include "libs.h"
+#include "utils.h"
+
+#include "CRC32.h"
+#include "EnumStrings.h"
+#include "FileSystem.h"
+#include "GameConfig.h"
+#include "JobQueue.h"
+#include "Lang.h"
+#include "Pi.h"
+#include "ShipType.h"
+#include "galaxy/Economy.h"
+#include "galaxy/Factions.h"
+#include "galaxy/Galaxy.h"
+#include "galaxy/GalaxyGenerator.h"
+#include "galaxy/Sector.h"
+#include "galaxy/StarSystem.h"
+#include "lua/Lua.h"
+#include "profiler/Profiler.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+
+// ********************************************************************************
+// allocation counting
+// ********************************************************************************
+
+namespace {
+	struct AllocCounters {
+		Uint64 count;
+		Uint64 bytes;
+		Uint64 freed;
+	};
+	thread_local AllocCounters s_alloc = { 0, 0, 0 };
+
+	// every block carries its size in front, keeping the default alignment
+	const size_t ALLOC_HEADER = alignof(std::max_align_t);
+
+	void *CountedAlloc(size_t size)
+	{
+		char *p = static_cast<char *>(malloc(size + ALLOC_HEADER));
+		if (!p)
+			throw std::bad_alloc();
+		*reinterpret_cast<size_t *>(p) = size;
+		++s_alloc.count;
+		s_alloc.bytes += size;
+		return p + ALLOC_HEADER;
+	}
+
+	void CountedFree(void *ptr)
+	{
+		if (!ptr)
+			return;
+		char *p = static_cast<char *>(ptr) - ALLOC_HEADER;
+		s_alloc.freed += *reinterpret_cast<size_t *>(p);
+		free(p);
+	}
+} // namespace
+
+void *operator new(size_t size) { return CountedAlloc(size); }
+void *operator new[](size_t size) { return CountedAlloc(size); }
+void operator delete(void *ptr) noexcept { CountedFree(ptr); }
+void operator delete[](void *ptr) noexcept { CountedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { CountedFree(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { CountedFree(ptr); }
+
+// ********************************************************************************
+// per-stage statistics
+// ********************************************************************************
+
+struct StageStats {
+	StageStats() :
+		calls(0),
+		ticks(0),
+		allocs(0),
+		bytes(0),
+		retained(0) {}
+
+	std::atomic<Uint64> calls;
+	std::atomic<Uint64> ticks;
+	std::atomic<Uint64> allocs;
+	std::atomic<Uint64> bytes;
+	std::atomic<Sint64> retained;
+};
+
+class StageProfiler : public GalaxyGenerator::StageObserver {
+public:
+	StageProfiler(const GalaxyGenerator *generator)
+	{
+		for (const GalaxyGeneratorStage *stage : generator->GetSectorStages())
+			m_order.push_back(stage);
+		for (const GalaxyGeneratorStage *stage : generator->GetStarSystemStages())
+			m_order.push_back(stage);
+		m_stats.reset(new StageStats[m_order.size()]);
+		for (size_t i = 0; i < m_order.size(); i++)
+			m_index[m_order[i]] = i;
+	}
+
+	virtual void OnStageBegin(const GalaxyGeneratorStage *stage) override
+	{
+		s_begin = s_alloc;
+		s_beginTicks = Profiler::Clock::getticks();
+	}
+
+	virtual void OnStageEnd(const GalaxyGeneratorStage *stage) override
+	{
+		const Uint64 ticks = Profiler::Clock::getticks() - s_beginTicks;
+		StageStats &stats = m_stats[m_index.at(stage)];
+		++stats.calls;
+		stats.ticks += ticks;
+		stats.allocs += s_alloc.count - s_begin.count;
+		stats.bytes += s_alloc.bytes - s_begin.bytes;
+		stats.retained += Sint64(s_alloc.bytes - s_begin.bytes) - Sint64(s_alloc.freed - s_begin.freed);
+	}
+
+	void Print(const char *title, size_t first, size_t count) const
+	{
+		Output("\n%-32s %8s %12s %12s %12s %14s\n", title, "calls", "total ms", "avg us", "allocs/call", "retained/call");
+		for (size_t i = first; i < first + count; i++) {
+			const StageStats &stats = m_stats[i];
+			const Uint64 calls = std::max<Uint64>(stats.calls, 1);
+			const double ms = Profiler::Clock::ms(stats.ticks);
+			Output("%-32s %8llu %12.2f %12.2f %12.1f %14.1f\n", m_order[i]->GetName(),
+				(unsigned long long)stats.calls, ms, 1000.0 * ms / calls,
+				double(stats.allocs) / calls, double(stats.retained) / calls);
+		}
+	}
+
+	size_t GetNumStages() const { return m_order.size(); }
+
+private:
+	std::vector<const GalaxyGeneratorStage *> m_order;
+	std::map<const GalaxyGeneratorStage *, size_t> m_index; // read only while generating
+	std::unique_ptr<StageStats[]> m_stats;
+
+	// stages don't nest, so one slot per thread is enough
+	static thread_local AllocCounters s_begin;
+	static thread_local Uint64 s_beginTicks;
+};
+
+thread_local AllocCounters StageProfiler::s_begin;
+thread_local Uint64 StageProfiler::s_beginTicks;
+
+// ********************************************************************************
+// checksums
+// ********************************************************************************
+
+template <typename T>
+static void AddValue(CRC32 &crc, const T &value)
+{
+	crc.AddData(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+static void AddString(CRC32 &crc, const std::string &s)
+{
+	crc.AddData(s.data(), s.size());
+	AddValue(crc, Uint32(s.size()));
+}
+
+static Uint32 SectorChecksum(const Sector &sec)
+{
+	CRC32 crc;
+	for (const Sector::System &ss : sec.m_systems) {
+		AddString(crc, ss.GetName());
+		AddValue(crc, ss.GetPosition());
+		AddValue(crc, ss.GetNumStars());
+		for (unsigned i = 0; i < ss.GetNumStars(); i++)
+			AddValue(crc, Uint32(ss.GetStarType(i)));
+		AddValue(crc, ss.GetSeed());
+		AddValue(crc, ss.GetCustomSystem() != nullptr);
+		AddValue(crc, Uint32(ss.GetExplored()));
+		AddValue(crc, ss.GetFaction()->idx);
+	}
+	return crc.GetChecksum();
+}
+
+static Uint32 StarSystemChecksum(const StarSystem &sys)
+{
+	CRC32 crc;
+	AddString(crc, sys.GetName());
+	AddValue(crc, sys.GetTotalPop().v);
+	AddValue(crc, Uint32(sys.GetSysPolit().govType));
+	AddValue(crc, sys.GetNumSpaceStations());
+	for (const RefCountedPtr<SystemBody> &body : sys.GetBodies()) {
+		AddString(crc, body->GetName());
+		AddValue(crc, Uint32(body->GetType()));
+		AddValue(crc, body->GetSeed());
+		AddValue(crc, body->GetMassAsFixed().v);
+		AddValue(crc, body->GetRadiusAsFixed().v);
+		AddValue(crc, body->GetSemiMajorAxisAsFixed().v);
+		AddValue(crc, body->GetEccentricityAsFixed().v);
+		AddValue(crc, body->GetPopulationAsFixed().v);
+	}
+	return crc.GetChecksum();
+}
+
+// ********************************************************************************
+// generation
+// ********************************************************************************
+
+struct ObjectStats {
+	ObjectStats() :
+		objects(0),
+		retained(0),
+		ticks(0) {}
+
+	Uint64 objects;
+	Sint64 retained;
+	Uint64 ticks;
+};
+
+class SectorJob : public Job {
+public:
+	SectorJob(RefCountedPtr<Galaxy> galaxy, std::vector<SystemPath> &&paths, std::vector<RefCountedPtr<Sector>> &out, ObjectStats &stats, size_t outOffset) :
+		m_galaxy(galaxy),
+		m_generator(galaxy->GetGenerator()),
+		m_paths(std::move(paths)),
+		m_out(out),
+		m_stats(stats),
+		m_outOffset(outOffset),
+		m_retained(0) {}
+
+	virtual void OnRun() override // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
+	{
+		const AllocCounters begin = s_alloc;
+		m_sectors.reserve(m_paths.size());
+		for (const SystemPath &path : m_paths)
+			m_sectors.push_back(m_generator->Generate<Sector, SectorCache>(m_galaxy, path, nullptr));
+		m_retained = Sint64(s_alloc.bytes - begin.bytes) - Sint64(s_alloc.freed - begin.freed);
+	}
+
+	virtual void OnFinish() override // runs in primary thread of the context
+	{
+		for (size_t i = 0; i < m_sectors.size(); i++)
+			m_out[m_outOffset + i] = m_sectors[i];
+		m_stats.objects += m_sectors.size();
+		m_stats.retained += m_retained;
+	}
+
+private:
+	RefCountedPtr<Galaxy> m_galaxy;
+	RefCountedPtr<GalaxyGenerator> m_generator;
+	std::vector<SystemPath> m_paths;
+	std::vector<RefCountedPtr<Sector>> m_sectors;
+	std::vector<RefCountedPtr<Sector>> &m_out;
+	ObjectStats &m_stats;
+	size_t m_outOffset;
+	Sint64 m_retained;
+};
+
+static const size_t SECTORS_PER_JOB = 16;
+
+static void GenerateSectors(RefCountedPtr<Galaxy> galaxy, const std::vector<SystemPath> &paths, Uint32 numThreads,
+	std::vector<RefCountedPtr<Sector>> &sectors, ObjectStats &stats)
+{
+	PROFILE_SCOPED()
+	sectors.assign(paths.size(), RefCountedPtr<Sector>());
+	const Uint64 start = Profiler::Clock::getticks();
+
+	if (numThreads <= 1) {
+		RefCountedPtr<GalaxyGenerator> generator = galaxy->GetGenerator();
+		const AllocCounters begin = s_alloc;
+		for (size_t i = 0; i < paths.size(); i++)
+			sectors[i] = generator->Generate<Sector, SectorCache>(galaxy, paths[i], nullptr);
+		stats.objects += paths.size();
+		stats.retained += Sint64(s_alloc.bytes - begin.bytes) - Sint64(s_alloc.freed - begin.freed);
+	} else {
+		AsyncJobQueue queue(numThreads);
+		JobSet jobs(&queue);
+		for (size_t first = 0; first < paths.size(); first += SECTORS_PER_JOB) {
+			const size_t last = std::min(first + SECTORS_PER_JOB, paths.size());
+			std::vector<SystemPath> chunk(paths.begin() + first, paths.begin() + last);
+			jobs.Order(new SectorJob(galaxy, std::move(chunk), sectors, stats, first));
+		}
+		while (!jobs.IsEmpty()) {
+			if (!queue.FinishJobs())
+				SDL_Delay(1);
+		}
+	}
+
+	stats.ticks += Profiler::Clock::getticks() - start;
+}
+
+// star systems are generated on the main thread, the same as the game does,
+// as naming the bodies calls into the Lua state
+static void GenerateStarSystems(RefCountedPtr<Galaxy> galaxy, const std::vector<SystemPath> &paths,
+	std::vector<RefCountedPtr<StarSystem>> &systems, ObjectStats &stats)
+{
+	PROFILE_SCOPED()
+	RefCountedPtr<GalaxyGenerator> generator = galaxy->GetGenerator();
+	systems.reserve(paths.size());
+	const Uint64 start = Profiler::Clock::getticks();
+	const AllocCounters begin = s_alloc;
+	for (const SystemPath &path : paths)
+		systems.push_back(generator->Generate<StarSystem, StarSystemCache>(galaxy, path, nullptr));
+	stats.objects += paths.size();
+	stats.retained += Sint64(s_alloc.bytes - begin.bytes) - Sint64(s_alloc.freed - begin.freed);
+	stats.ticks += Profiler::Clock::getticks() - start;
+}
+
+// ********************************************************************************
+// faction lookup
+// ********************************************************************************
+
+// the lookup the faction spatial index replaced: every faction is a candidate,
+// in index order. a claim wins outright, otherwise the closest homeworld
+// containing the system, with later factions winning ties
+static const Faction *ReferenceClaimant(FactionsDatabase *factions, const Sector::System *sys)
+{
+	if (sys->GetCustomSystem() && sys->GetCustomSystem()->faction)
+		return sys->GetCustomSystem()->faction;
+
+	const Faction *result = nullptr;
+	double closestDist = HUGE_VAL;
+	for (Uint32 i = 0; i < factions->GetNumFactions(); i++) {
+		const Faction *faction = factions->GetFaction(i);
+		if (faction->IsClaimed(sys->GetPath()))
+			return faction;
+
+		float distance = HUGE_VAL;
+		bool inside = true;
+		if (faction->hasHomeworld) {
+			if (sys->InSameSector(faction->homeworld)) {
+				distance = 0;
+			} else {
+				RefCountedPtr<const Sector> homeSec = faction->GetHomeSector();
+				const Sector::System *homeSys = &homeSec->m_systems[faction->homeworld.systemIndex];
+				distance = Sector::System::DistanceBetween(homeSys, sys);
+				inside = distance < faction->Radius();
+			}
+		}
+		if (inside && distance <= closestDist) {
+			closestDist = distance;
+			result = faction;
+		}
+	}
+	return result;
+}
+
+// looks the faction of every system up both ways, returns the number of
+// systems they disagree on
+static Uint32 CompareFactionLookups(RefCountedPtr<Galaxy> galaxy, const std::vector<RefCountedPtr<const Sector>> &sectors)
+{
+	PROFILE_SCOPED()
+	FactionsDatabase *factions = galaxy->GetFactions();
+
+	std::vector<const Sector::System *> systems;
+	for (const RefCountedPtr<const Sector> &sec : sectors)
+		for (const Sector::System &ss : sec->m_systems)
+			systems.push_back(&ss);
+
+	std::vector<const Faction *> indexed(systems.size()), reference(systems.size());
+	Uint64 start = Profiler::Clock::getticks();
+	for (size_t i = 0; i < systems.size(); i++)
+		indexed[i] = factions->GetNearestClaimant(systems[i]);
+	const Uint64 indexedTicks = Profiler::Clock::getticks() - start;
+
+	start = Profiler::Clock::getticks();
+	for (size_t i = 0; i < systems.size(); i++)
+		reference[i] = ReferenceClaimant(factions, systems[i]);
+	const Uint64 referenceTicks = Profiler::Clock::getticks() - start;
+
+	Uint32 mismatches = 0;
+	for (size_t i = 0; i < systems.size(); i++) {
+		// no faction comes back as the database's placeholder or as nullptr
+		const Uint32 expectedIdx = reference[i] ? reference[i]->idx : Faction::BAD_FACTION_IDX;
+		if (indexed[i]->idx != expectedIdx) {
+			const SystemPath path = systems[i]->GetPath();
+			Output("Faction mismatch in (%d,%d,%d) system %d: index says %s, reference says %s\n",
+				path.sectorX, path.sectorY, path.sectorZ, path.systemIndex, indexed[i]->name.c_str(),
+				reference[i] ? reference[i]->name.c_str() : "none");
+			mismatches++;
+		}
+	}
+
+	Output("\n%-32s %8s %12s %12s\n", "Faction lookup", "systems", "total ms", "avg us");
+	Output("%-32s %8u %12.2f %12.3f\n", "spatial index", unsigned(systems.size()), Profiler::Clock::ms(indexedTicks),
+		1000.0 * Profiler::Clock::ms(indexedTicks) / std::max<size_t>(systems.size(), 1));
+	Output("%-32s %8u %12.2f %12.3f\n", "all factions", unsigned(systems.size()), Profiler::Clock::ms(referenceTicks),
+		1000.0 * Profiler::Clock::ms(referenceTicks) / std::max<size_t>(systems.size(), 1));
+	return mismatches;
+}
+
+// ********************************************************************************
+// main
+// ********************************************************************************
+
+static void PrintUsage()
+{
+	Output(
+		"usage: galaxybench [options]\n"
+		"  -radius <n>         radius of the cube of sectors to generate (default 3)\n"
+		"  -centre <x> <y> <z> sector at the centre of the cube (default 0 0 0)\n"
+		"  -threads <n>        threads used to generate sectors (default 1)\n"
+		"  -systems <n>        maximum number of star systems to generate, 0 for none (default all)\n"
+		"  -expect <sec> <sys> expected sector and star system checksums, in hex\n");
+}
+
+extern "C" int main(int argc, char **argv)
+{
+#ifdef PIONEER_PROFILER
+	Profiler::detect(argc, argv);
+#endif
+
+	int radius = 3;
+	int centre[3] = { 0, 0, 0 };
+	Uint32 numThreads = 1;
+	long maxSystems = -1;
+	bool checkExpected = false;
+	Uint32 expected[2] = { 0, 0 };
+
+	for (int i = 1; i < argc; i++) {
+		const std::string opt(argv[i]);
+		if (opt == "-radius" && i + 1 < argc)
+			radius = std::max(0, atoi(argv[++i]));
+		else if (opt == "-centre" && i + 3 < argc) {
+			for (int j = 0; j < 3; j++)
+				centre[j] = atoi(argv[++i]);
+		} else if (opt == "-threads" && i + 1 < argc)
+			numThreads = std::max(1, atoi(argv[++i]));
+		else if (opt == "-systems" && i + 1 < argc)
+			maxSystems = std::max(0L, atol(argv[++i]));
+		else if (opt == "-expect" && i + 2 < argc) {
+			expected[0] = strtoul(argv[++i], nullptr, 16);
+			expected[1] = strtoul(argv[++i], nullptr, 16);
+			checkExpected = true;
+		} else {
+			PrintUsage();
+			return (opt == "-help" || opt == "-h") ? 0 : 1;
+		}
+	}
+
+	// the generator needs the same environment as it has in the game
+	FileSystem::Init();
+	FileSystem::userFiles.MakeDirectory(""); // ensure the config directory exists
+	Log::GetLog()->SetLogFile("galaxybench.log");
+	SDL_Init(0);
+
+	Pi::config = new GameConfig;
+	Lang::Resource res(Lang::GetResource("core", Pi::config->String("Lang")));
+	Lang::MakeCore(res);
+	EnumStrings::Init();
+	GalacticEconomy::Init();
+	ShipType::Init();
+	Lua::Init();
+	Lua::InitModules();
+
+	if (Pi::config->HasEntry("GalaxyGenerator"))
+		GalaxyGenerator::Init(Pi::config->String("GalaxyGenerator"),
+			Pi::config->Int("GalaxyGeneratorVersion", GalaxyGenerator::LAST_VERSION));
+	else
+		GalaxyGenerator::Init();
+	RefCountedPtr<Galaxy> galaxy = GalaxyGenerator::Create();
+	RefCountedPtr<GalaxyGenerator> generator = galaxy->GetGenerator();
+
+	std::vector<SystemPath> sectorPaths;
+	for (int x = centre[0] - radius; x <= centre[0] + radius; x++)
+		for (int y = centre[1] - radius; y <= centre[1] + radius; y++)
+			for (int z = centre[2] - radius; z <= centre[2] + radius; z++)
+				sectorPaths.push_back(SystemPath(x, y, z));
+
+	Output("\nGenerating %u sectors around (%d,%d,%d) with %u thread(s)\n", unsigned(sectorPaths.size()), centre[0], centre[1], centre[2], numThreads);
+
+	StageProfiler profiler(generator.Get());
+	generator->SetStageObserver(&profiler);
+
+	ObjectStats sectorStats;
+	std::vector<RefCountedPtr<Sector>> sectors;
+	GenerateSectors(galaxy, sectorPaths, numThreads, sectors, sectorStats);
+
+	// the star system stages look their sector up in the galaxy's cache, fill it
+	// without profiling so it doesn't count against them
+	generator->SetStageObserver(nullptr);
+	std::vector<RefCountedPtr<const Sector>> cachedSectors;
+	std::vector<SystemPath> systemPaths;
+	for (const SystemPath &path : sectorPaths) {
+		cachedSectors.push_back(galaxy->GetSector(path));
+		for (const Sector::System &ss : cachedSectors.back()->m_systems) {
+			if (maxSystems >= 0 && systemPaths.size() >= size_t(maxSystems))
+				break;
+			systemPaths.push_back(ss.GetPath());
+		}
+	}
+	generator->SetStageObserver(&profiler);
+
+	Output("Generating %u star systems\n", unsigned(systemPaths.size()));
+	ObjectStats systemStats;
+	std::vector<RefCountedPtr<StarSystem>> systems;
+	GenerateStarSystems(galaxy, systemPaths, systems, systemStats);
+
+	generator->SetStageObserver(nullptr);
+
+	const size_t numSectorStages = generator->GetSectorStages().size();
+	profiler.Print("Sector stages", 0, numSectorStages);
+	profiler.Print("StarSystem stages", numSectorStages, profiler.GetNumStages() - numSectorStages);
+
+	Output("\n%-32s %8s %12s %14s\n", "Totals", "objects", "total ms", "retained/obj");
+	Output("%-32s %8llu %12.2f %14.1f\n", "Sector", (unsigned long long)sectorStats.objects,
+		Profiler::Clock::ms(sectorStats.ticks), double(sectorStats.retained) / std::max<Uint64>(sectorStats.objects, 1));
+	Output("%-32s %8llu %12.2f %14.1f\n", "StarSystem", (unsigned long long)systemStats.objects,
+		Profiler::Clock::ms(systemStats.ticks), double(systemStats.retained) / std::max<Uint64>(systemStats.objects, 1));
+
+	const Uint32 factionMismatches = CompareFactionLookups(galaxy, cachedSectors);
+
+	// checksums are combined in path order, so they don't depend on the threading
+	CRC32 sectorCrc, systemCrc;
+	for (const RefCountedPtr<Sector> &sec : sectors)
+		AddValue(sectorCrc, SectorChecksum(*sec));
+	for (const RefCountedPtr<StarSystem> &sys : systems)
+		AddValue(systemCrc, StarSystemChecksum(*sys));
+	Output("\nChecksums: sectors %08x, star systems %08x\n", sectorCrc.GetChecksum(), systemCrc.GetChecksum());
+
+	int result = 0;
+	if (checkExpected && (sectorCrc.GetChecksum() != expected[0] || systemCrc.GetChecksum() != expected[1])) {
+		Output("Checksum mismatch! expected sectors %08x, star systems %08x\n", expected[0], expected[1]);
+		result = 1;
+	}
+	if (factionMismatches) {
+		Output("Faction lookup disagrees with the reference for %u systems!\n", factionMismatches);
+		result = 1;
+	}
+
+	systems.clear();
+	sectors.clear();
+	cachedSectors.clear();
+	galaxy.Reset();
+	generator.Reset();
+	GalaxyGenerator::Uninit();
+	Lua::UninitModules();
+	Lua::Uninit();
+	delete Pi::config;
+	SDL_Quit();
+
+	return result;
+}
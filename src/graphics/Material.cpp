@@ -33,6 +33,7 @@ namespace Graphics {
 		usePatterns(false),
 		vertexColors(false),
 		instanced(false),
+		instanceColors(false),
 		textures(0),
 		dirLights(0),
 		quality(0),
@@ -53,6 +54,7 @@ namespace Graphics {
 			a.usePatterns == b.usePatterns &&
 			a.vertexColors == b.vertexColors &&
 			a.instanced == b.instanced &&
+			a.instanceColors == b.instanceColors &&
 			a.textures == b.textures &&
 			a.dirLights == b.dirLights &&
 			a.quality == b.quality &&
@@ -67,6 +67,7 @@ namespace Graphics {
 		bool usePatterns; //pattern/color system
 		bool vertexColors;
 		bool instanced;
+		bool instanceColors; //instanced pattern colors come from the InstanceBuffer
 		Sint32 textures; //texture count
 		Uint32 dirLights; //set by RendererOGL if lighting == true
 		Uint32 quality; // see: Graphics::MaterialQuality
@@ -0,0 +1,276 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "RenderQueue.h"
+
+#include "Renderer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Graphics {
+
+	// sort key layout, from the top bit down:
+	//   solid:       pass | program | material | textures | lights | depth
+	//   transparent: pass | inverted depth | program | material
+	static const int KEY_PASS_SHIFT = 62;
+	static const Uint64 KEY_PROGRAM_MASK = 0xfff;
+	static const Uint64 KEY_MATERIAL_MASK = 0xfff;
+	static const Uint64 KEY_TEXTURES_MASK = 0xff;
+	static const Uint64 KEY_LIGHTS_MASK = 0x3f;
+	static const Uint64 KEY_DEPTH_MASK = 0xffffff;
+
+	// distance along the view axis. a positive float's bits sort like an
+	// unsigned integer, the top ones are precise enough for ordering
+	static Uint64 DepthBits(const matrix4x4f &trans)
+	{
+		const float depth = std::max(0.0f, -trans[14]);
+		Uint32 bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		return (bits >> 7) & KEY_DEPTH_MASK;
+	}
+
+	static Uint64 TextureBits(const Texture *const *textures)
+	{
+		uintptr_t hash = 0;
+		for (int i = 0; i < 7; i++)
+			hash = hash * 31 + (reinterpret_cast<uintptr_t>(textures[i]) >> 4);
+		return (hash ^ (hash >> 8) ^ (hash >> 16)) & KEY_TEXTURES_MASK;
+	}
+
+	void RenderQueue::MaterialParams::Get(const Material *mat)
+	{
+		textures[0] = mat->texture0;
+		textures[1] = mat->texture1;
+		textures[2] = mat->texture2;
+		textures[3] = mat->texture3;
+		textures[4] = mat->texture4;
+		textures[5] = mat->texture5;
+		textures[6] = mat->texture6;
+		heatGradient = mat->heatGradient;
+		diffuse = mat->diffuse;
+		specular = mat->specular;
+		emissive = mat->emissive;
+		shininess = mat->shininess;
+		specialParameter0 = mat->specialParameter0;
+	}
+
+	void RenderQueue::MaterialParams::Set(Material *mat) const
+	{
+		mat->texture0 = textures[0];
+		mat->texture1 = textures[1];
+		mat->texture2 = textures[2];
+		mat->texture3 = textures[3];
+		mat->texture4 = textures[4];
+		mat->texture5 = textures[5];
+		mat->texture6 = textures[6];
+		mat->heatGradient = heatGradient;
+		mat->diffuse = diffuse;
+		mat->specular = specular;
+		mat->emissive = emissive;
+		mat->shininess = shininess;
+		mat->specialParameter0 = specialParameter0;
+	}
+
+	bool RenderQueue::MaterialParams::operator==(const MaterialParams &other) const
+	{
+		for (int i = 0; i < 7; i++)
+			if (textures[i] != other.textures[i])
+				return false;
+		return heatGradient == other.heatGradient && diffuse == other.diffuse && specular == other.specular &&
+			emissive == other.emissive && shininess == other.shininess && specialParameter0 == other.specialParameter0;
+	}
+
+	RenderQueue::RenderQueue() :
+		m_pass(PASS_SOLID),
+		m_transform(matrix4x4f::Identity()),
+		m_lightsChanged(true)
+	{
+		m_lights.numLights = 0;
+		m_lights.ambient = Color::BLACK;
+	}
+
+	void RenderQueue::SetLights(Uint32 numLights, const Light *lights)
+	{
+		assert(numLights <= TOTAL_NUM_LIGHTS);
+		m_lights.numLights = numLights;
+		for (Uint32 i = 0; i < numLights; i++)
+			m_lights.lights[i] = lights[i];
+		m_lightsChanged = true;
+	}
+
+	void RenderQueue::SetAmbientColor(const Color &c)
+	{
+		m_lights.ambient = c;
+		m_lightsChanged = true;
+	}
+
+	void RenderQueue::DrawBuffer(VertexBuffer *vb, RenderState *state, Material *mat, PrimitiveType type)
+	{
+		Record(vb, nullptr, state, mat, nullptr, type);
+	}
+
+	void RenderQueue::DrawBufferIndexed(VertexBuffer *vb, IndexBuffer *ib, RenderState *state, Material *mat, PrimitiveType type)
+	{
+		Record(vb, ib, state, mat, nullptr, type);
+	}
+
+	void RenderQueue::DrawBufferInstanced(VertexBuffer *vb, RenderState *state, Material *mat, InstanceBuffer *instb, PrimitiveType type)
+	{
+		Record(vb, nullptr, state, mat, instb, type);
+	}
+
+	void RenderQueue::DrawBufferIndexedInstanced(VertexBuffer *vb, IndexBuffer *ib, RenderState *state, Material *mat, InstanceBuffer *instb, PrimitiveType type)
+	{
+		Record(vb, ib, state, mat, instb, type);
+	}
+
+	void RenderQueue::Record(VertexBuffer *vb, IndexBuffer *ib, RenderState *state, Material *mat, InstanceBuffer *instb, PrimitiveType type)
+	{
+		if (m_lightsChanged) {
+			m_lightSets.push_back(m_lights);
+			m_lightsChanged = false;
+		}
+
+		m_commands.emplace_back();
+		Command &cmd = m_commands.back();
+		cmd.transform = m_transform;
+		cmd.params.Get(mat);
+		cmd.vb = vb;
+		cmd.ib = ib;
+		cmd.instb = instb;
+		cmd.state = state;
+		cmd.material = mat;
+		cmd.type = type;
+		cmd.lightSet = static_cast<Uint32>(m_lightSets.size() - 1);
+		cmd.pass = m_pass;
+		cmd.program = GetProgramId(mat->GetDescriptor());
+
+		m_materialIds.emplace(mat, static_cast<Uint32>(m_materialIds.size()));
+	}
+
+	Uint32 RenderQueue::GetProgramId(const MaterialDescriptor &desc)
+	{
+		// there are only ever a few dozen of these in a frame
+		for (size_t i = 0; i < m_programs.size(); i++)
+			if (m_programs[i] == desc)
+				return static_cast<Uint32>(i);
+		m_programs.push_back(desc);
+		return static_cast<Uint32>(m_programs.size() - 1);
+	}
+
+	void RenderQueue::Append(const RenderQueue &other)
+	{
+		PROFILE_SCOPED()
+		const Uint32 lightSetBase = static_cast<Uint32>(m_lightSets.size());
+		m_lightSets.insert(m_lightSets.end(), other.m_lightSets.begin(), other.m_lightSets.end());
+		// the next draw recorded here may not use the other queue's lights
+		m_lightsChanged = true;
+
+		m_commands.reserve(m_commands.size() + other.m_commands.size());
+		for (const Command &otherCmd : other.m_commands) {
+			m_commands.push_back(otherCmd);
+			Command &cmd = m_commands.back();
+			cmd.lightSet += lightSetBase;
+			cmd.program = GetProgramId(other.m_programs[otherCmd.program]);
+			m_materialIds.emplace(cmd.material, static_cast<Uint32>(m_materialIds.size()));
+		}
+	}
+
+	Uint64 RenderQueue::MakeKey(const Command &cmd) const
+	{
+		const Uint64 program = cmd.program & KEY_PROGRAM_MASK;
+		const Uint64 material = m_materialIds.find(cmd.material)->second & KEY_MATERIAL_MASK;
+		const Uint64 depth = DepthBits(cmd.transform);
+
+		Uint64 key = Uint64(cmd.pass) << KEY_PASS_SHIFT;
+		if (cmd.pass == PASS_SOLID) {
+			key |= program << 50;
+			key |= material << 38;
+			key |= TextureBits(cmd.params.textures) << 30;
+			key |= (Uint64(cmd.lightSet) & KEY_LIGHTS_MASK) << 24;
+			key |= depth;
+		} else {
+			// blending needs the furthest first, state changes come second
+			key |= (KEY_DEPTH_MASK - depth) << 24;
+			key |= program << 12;
+			key |= material;
+		}
+		return key;
+	}
+
+	void RenderQueue::Sort()
+	{
+		PROFILE_SCOPED()
+		m_order.clear();
+		m_order.reserve(m_commands.size());
+		for (size_t i = 0; i < m_commands.size(); i++)
+			m_order.push_back({ MakeKey(m_commands[i]), static_cast<Uint32>(i) });
+		std::sort(m_order.begin(), m_order.end());
+	}
+
+	void RenderQueue::Submit(Renderer *r)
+	{
+		PROFILE_SCOPED()
+		if (m_commands.empty())
+			return;
+
+		if (m_order.size() != m_commands.size()) {
+			// not sorted, or recorded to since
+			m_order.clear();
+			for (size_t i = 0; i < m_commands.size(); i++)
+				m_order.push_back({ 0, static_cast<Uint32>(i) });
+		}
+
+		const matrix4x4f oldTransform = r->GetTransform();
+		const Color oldAmbient = r->GetAmbientColor();
+		Light oldLights[TOTAL_NUM_LIGHTS];
+		const Uint32 numOldLights = r->GetNumLights();
+		for (Uint32 i = 0; i < numOldLights; i++)
+			oldLights[i] = r->GetLight(i);
+
+		const Command *prev = nullptr;
+		for (const SortKey &sortKey : m_order) {
+			const Command &cmd = m_commands[sortKey.index];
+
+			if (!prev || prev->lightSet != cmd.lightSet) {
+				// a set without lights still has to replace the previous one
+				const LightSet &lights = m_lightSets[cmd.lightSet];
+				r->SetLights(lights.numLights, lights.lights);
+				r->SetAmbientColor(lights.ambient);
+			}
+			if (!prev || memcmp(&prev->transform, &cmd.transform, sizeof(matrix4x4f)) != 0)
+				r->SetTransform(cmd.transform);
+			// the material's fields may have been changed by another draw of
+			// it, or since the recording
+			if (!prev || prev->material != cmd.material || !(prev->params == cmd.params))
+				cmd.params.Set(cmd.material);
+
+			if (cmd.instb) {
+				if (cmd.ib)
+					r->DrawBufferIndexedInstanced(cmd.vb, cmd.ib, cmd.state, cmd.material, cmd.instb, cmd.type);
+				else
+					r->DrawBufferInstanced(cmd.vb, cmd.state, cmd.material, cmd.instb, cmd.type);
+			} else if (cmd.ib) {
+				r->DrawBufferIndexed(cmd.vb, cmd.ib, cmd.state, cmd.material, cmd.type);
+			} else {
+				r->DrawBuffer(cmd.vb, cmd.state, cmd.material, cmd.type);
+			}
+			prev = &cmd;
+		}
+
+		r->SetLights(numOldLights, oldLights);
+		r->SetAmbientColor(oldAmbient);
+		r->SetTransform(oldTransform);
+	}
+
+	void RenderQueue::Clear()
+	{
+		m_commands.clear();
+		m_lightSets.clear();
+		m_order.clear();
+		m_programs.clear();
+		m_materialIds.clear();
+		m_lightsChanged = true;
+	}
+
+} // namespace Graphics
@@ -0,0 +1,133 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _RENDERQUEUE_H
+#define _RENDERQUEUE_H
+
+#include "Color.h"
+#include "Light.h"
+#include "Material.h"
+#include "Types.h"
+#include "matrix4x4.h"
+#include <unordered_map>
+#include <vector>
+
+namespace Graphics {
+
+	class IndexBuffer;
+	class InstanceBuffer;
+	class RenderState;
+	class Renderer;
+	class Texture;
+	class VertexBuffer;
+
+	/*
+ * RenderQueue records draw calls instead of making them, then sorts them
+ * and submits them to a renderer in one go. Solid draws are grouped by
+ * program, material, textures and lights and go front to back, transparent
+ * ones go back to front. Submit only changes the transform, lights and
+ * material parameters when they differ from the previous draw.
+ *
+ * Recording doesn't touch the renderer, so each thread can fill its own
+ * queue and the render thread appends them together before submitting.
+ * Everything a command points to must stay alive and unchanged until
+ * then, buffers included. Draws from VertexArrays aren't recorded: they
+ * go through the renderer's reused dynamic buffers.
+ */
+	class RenderQueue {
+	public:
+		enum Pass {
+			PASS_SOLID = 0,
+			PASS_TRANSPARENT = 1
+		};
+
+		RenderQueue();
+
+		// state the following draws are recorded with
+		void SetPass(Pass pass) { m_pass = pass; }
+		void SetTransform(const matrix4x4f &m) { m_transform = m; }
+		void SetLights(Uint32 numLights, const Light *lights);
+		void SetAmbientColor(const Color &c);
+
+		void DrawBuffer(VertexBuffer *vb, RenderState *state, Material *mat, PrimitiveType type = TRIANGLES);
+		void DrawBufferIndexed(VertexBuffer *vb, IndexBuffer *ib, RenderState *state, Material *mat, PrimitiveType type = TRIANGLES);
+		void DrawBufferInstanced(VertexBuffer *vb, RenderState *state, Material *mat, InstanceBuffer *instb, PrimitiveType type = TRIANGLES);
+		void DrawBufferIndexedInstanced(VertexBuffer *vb, IndexBuffer *ib, RenderState *state, Material *mat, InstanceBuffer *instb, PrimitiveType type = TRIANGLES);
+
+		// adds the commands of another queue, eg. one filled on a worker
+		void Append(const RenderQueue &other);
+
+		void Sort();
+		// replays the commands in sorted order, or recorded order if Sort
+		// wasn't called. the renderer's lights and transform are restored after
+		void Submit(Renderer *r);
+		void Clear();
+
+		size_t GetNumCommands() const { return m_commands.size(); }
+		bool IsEmpty() const { return m_commands.empty(); }
+
+	private:
+		// the parameters a material is drawn with. materials are shared and
+		// changed between draws, so they are taken when the draw is recorded
+		struct MaterialParams {
+			Texture *textures[7];
+			Texture *heatGradient;
+			Color diffuse;
+			Color specular;
+			Color emissive;
+			int shininess;
+			void *specialParameter0;
+
+			void Get(const Material *mat);
+			void Set(Material *mat) const;
+			bool operator==(const MaterialParams &other) const;
+		};
+
+		struct LightSet {
+			Uint32 numLights;
+			Light lights[TOTAL_NUM_LIGHTS];
+			Color ambient;
+		};
+
+		struct Command {
+			matrix4x4f transform;
+			MaterialParams params;
+			VertexBuffer *vb;
+			IndexBuffer *ib;
+			InstanceBuffer *instb;
+			RenderState *state;
+			Material *material;
+			PrimitiveType type;
+			Uint32 lightSet;
+			Uint32 pass;
+			Uint32 program;
+		};
+
+		// sorting the keys is a lot cheaper than moving the commands
+		struct SortKey {
+			Uint64 key;
+			Uint32 index;
+
+			bool operator<(const SortKey &other) const { return key < other.key || (key == other.key && index < other.index); }
+		};
+
+		void Record(VertexBuffer *vb, IndexBuffer *ib, RenderState *state, Material *mat, InstanceBuffer *instb, PrimitiveType type);
+		Uint32 GetProgramId(const MaterialDescriptor &desc);
+		Uint64 MakeKey(const Command &cmd) const;
+
+		Pass m_pass;
+		matrix4x4f m_transform;
+		LightSet m_lights;
+		bool m_lightsChanged;
+
+		std::vector<Command> m_commands;
+		std::vector<LightSet> m_lightSets;
+		std::vector<SortKey> m_order;
+		// materials of one descriptor use the same program
+		std::vector<MaterialDescriptor> m_programs;
+		std::unordered_map<const Material *, Uint32> m_materialIds;
+	};
+
+} // namespace Graphics
+
+#endif
@@ -132,12 +132,20 @@ namespace Graphics {
 		BufferUsage m_usage;
 	};
 
+	// Per instance pattern colors, laid out like SceneGraph::ColorMap:
+	// primary, secondary and trim. colors[0].a is 1 for smooth patterns
+	struct InstanceColors {
+		Color4f colors[3];
+	};
+
 	// Instance buffer
 	class InstanceBuffer : public Mappable {
 	public:
 		InstanceBuffer(Uint32 size, BufferUsage);
 		virtual ~InstanceBuffer();
 		virtual matrix4x4f *Map(BufferMapMode) = 0;
+		// colors for the first count instances, nullptr to draw without
+		virtual void SetColors(const InstanceColors *colors, Uint32 count) = 0;
 
 		Uint32 GetInstanceCount() const { return m_instanceCount; }
 		void SetInstanceCount(const Uint32);
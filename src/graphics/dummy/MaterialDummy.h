@@ -17,6 +17,7 @@ namespace Graphics {
 		class Material : public Graphics::Material {
 		public:
 			Material() {}
+			explicit Material(const MaterialDescriptor &d) { m_descriptor = d; }
 			// Create an appropriate program for this material.
 			virtual Program *CreateProgram(const MaterialDescriptor &) { return nullptr; }
 			// bind textures, set uniforms
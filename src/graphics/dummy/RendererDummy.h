@@ -12,6 +12,8 @@
 #include "graphics/dummy/RenderTargetDummy.h"
 #include "graphics/dummy/TextureDummy.h"
 #include "graphics/dummy/VertexBufferDummy.h"
+#include <algorithm>
+#include <vector>
 
 namespace Graphics {
 
@@ -21,9 +23,29 @@ namespace Graphics {
 
 		RendererDummy() :
 			Renderer(0, 0, 0),
-			m_identity(matrix4x4f::Identity())
+			m_identity(matrix4x4f::Identity()),
+			m_transform(matrix4x4f::Identity()),
+			m_numLights(0),
+			m_recordDrawCalls(false)
 		{}
 
+		// what a draw from a buffer was made with, for tools checking what
+		// gets submitted. only kept while enabled
+		struct DrawCall {
+			Material *material;
+			Color diffuse; // the material's, at the time of the draw
+			matrix4x4f transform;
+			Uint32 numLights;
+			Color ambient;
+			bool instanced;
+		};
+		void SetRecordDrawCalls(bool record)
+		{
+			m_recordDrawCalls = record;
+			m_drawCalls.clear();
+		}
+		const std::vector<DrawCall> &GetDrawCalls() const { return m_drawCalls; }
+
 		virtual const char *GetName() const override final { return "Dummy"; }
 		virtual RendererType GetRendererType() const override final { return RENDERER_DUMMY; }
 		virtual bool SupportsInstancing() override final { return false; }
@@ -47,8 +69,12 @@ namespace Graphics {
 		virtual bool SetViewport(Viewport v) override final { return true; }
 		virtual Viewport GetViewport() const override final { return {}; }
 
-		virtual bool SetTransform(const matrix4x4f &m) override final { return true; }
-		virtual matrix4x4f GetTransform() const override final { return matrix4x4f::Identity(); }
+		virtual bool SetTransform(const matrix4x4f &m) override final
+		{
+			m_transform = m;
+			return true;
+		}
+		virtual matrix4x4f GetTransform() const override final { return m_transform; }
 		virtual bool SetPerspectiveProjection(float fov, float aspect, float near_, float far_) override final { return true; }
 		virtual bool SetOrthographicProjection(float xmin, float xmax, float ymin, float ymax, float zmin, float zmax) override final { return true; }
 		virtual bool SetProjection(const matrix4x4f &m) override final { return true; }
@@ -56,21 +82,31 @@ namespace Graphics {
 
 		virtual bool SetWireFrameMode(bool enabled) override final { return true; }
 
-		virtual bool SetLights(Uint32 numlights, const Light *l) override final { return true; }
-		virtual Uint32 GetNumLights() const override final { return 1; }
-		virtual bool SetAmbientColor(const Color &c) override final { return true; }
+		virtual bool SetLights(Uint32 numlights, const Light *l) override final
+		{
+			m_numLights = std::min(numlights, TOTAL_NUM_LIGHTS);
+			for (Uint32 i = 0; i < m_numLights; i++)
+				m_lights[i] = l[i];
+			return true;
+		}
+		virtual Uint32 GetNumLights() const override final { return m_numLights; }
+		virtual bool SetAmbientColor(const Color &c) override final
+		{
+			m_ambient = c;
+			return true;
+		}
 
 		virtual bool SetScissor(bool enabled, const vector2f &pos = vector2f(0.0f), const vector2f &size = vector2f(0.0f)) override final { return true; }
 
 		virtual bool DrawTriangles(const VertexArray *vertices, RenderState *state, Material *material, PrimitiveType type = TRIANGLES) override final { return true; }
 		virtual bool DrawPointSprites(const Uint32 count, const vector3f *positions, RenderState *rs, Material *material, float size) override final { return true; }
 		virtual bool DrawPointSprites(const Uint32 count, const vector3f *positions, const vector2f *offsets, const float *sizes, RenderState *rs, Material *material) override final { return true; }
-		virtual bool DrawBuffer(VertexBuffer *, RenderState *, Material *, PrimitiveType) override final { return true; }
-		virtual bool DrawBufferIndexed(VertexBuffer *, IndexBuffer *, RenderState *, Material *, PrimitiveType) override final { return true; }
-		virtual bool DrawBufferInstanced(VertexBuffer *, RenderState *, Material *, InstanceBuffer *, PrimitiveType type = TRIANGLES) override final { return true; }
-		virtual bool DrawBufferIndexedInstanced(VertexBuffer *, IndexBuffer *, RenderState *, Material *, InstanceBuffer *, PrimitiveType = TRIANGLES) override final { return true; }
+		virtual bool DrawBuffer(VertexBuffer *, RenderState *, Material *m, PrimitiveType) override final { return RecordDrawCall(m, false); }
+		virtual bool DrawBufferIndexed(VertexBuffer *, IndexBuffer *, RenderState *, Material *m, PrimitiveType) override final { return RecordDrawCall(m, false); }
+		virtual bool DrawBufferInstanced(VertexBuffer *, RenderState *, Material *m, InstanceBuffer *, PrimitiveType type = TRIANGLES) override final { return RecordDrawCall(m, true); }
+		virtual bool DrawBufferIndexedInstanced(VertexBuffer *, IndexBuffer *, RenderState *, Material *m, InstanceBuffer *, PrimitiveType = TRIANGLES) override final { return RecordDrawCall(m, true); }
 
-		virtual Material *CreateMaterial(const MaterialDescriptor &d) override final { return new Graphics::Dummy::Material(); }
+		virtual Material *CreateMaterial(const MaterialDescriptor &d) override final { return new Graphics::Dummy::Material(d); }
 		virtual Texture *CreateTexture(const TextureDescriptor &d) override final { return new Graphics::TextureDummy(d); }
 		virtual RenderState *CreateRenderState(const RenderStateDesc &d) override final { return new Graphics::Dummy::RenderState(d); }
 		virtual RenderTarget *CreateRenderTarget(const RenderTargetDesc &d) override final { return new Graphics::Dummy::RenderTarget(d); }
@@ -85,7 +121,18 @@ namespace Graphics {
 		virtual void PopState() override final {}
 
 	private:
+		bool RecordDrawCall(Material *m, bool instanced)
+		{
+			if (m_recordDrawCalls)
+				m_drawCalls.push_back({ m, m->diffuse, m_transform, m_numLights, m_ambient, instanced });
+			return true;
+		}
+
 		const matrix4x4f m_identity;
+		matrix4x4f m_transform;
+		Uint32 m_numLights;
+		bool m_recordDrawCalls;
+		std::vector<DrawCall> m_drawCalls;
 	};
 
 } // namespace Graphics
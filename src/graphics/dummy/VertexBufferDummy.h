@@ -63,6 +63,7 @@ namespace Graphics {
 			virtual ~InstanceBuffer(){};
 			virtual matrix4x4f *Map(BufferMapMode) override final { return m_data.get(); }
 			virtual void Unmap() override final {}
+			virtual void SetColors(const InstanceColors *, Uint32) override final {}
 
 			Uint32 GetSize() const { return m_size; }
 			BufferUsage GetUsage() const { return m_usage; }
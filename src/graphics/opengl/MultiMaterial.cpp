@@ -45,6 +45,8 @@ namespace Graphics {
 				ss << "#define HEAT_COLOURING\n";
 			if (desc.instanced)
 				ss << "#define USE_INSTANCING\n";
+			if (desc.instanced && desc.instanceColors)
+				ss << "#define INSTANCE_COLORS\n";
 
 			m_name = "multi";
 			m_defines = ss.str();
@@ -465,7 +465,9 @@ namespace Graphics {
 
 		// ------------------------------------------------------------
 		InstanceBuffer::InstanceBuffer(Uint32 size, BufferUsage hint) :
-			Graphics::InstanceBuffer(size, hint)
+			Graphics::InstanceBuffer(size, hint),
+			m_colorBuffer(0),
+			m_numColors(0)
 		{
 			assert(size > 0);
 
@@ -484,6 +486,8 @@ namespace Graphics {
 		InstanceBuffer::~InstanceBuffer()
 		{
 			glDeleteBuffers(1, &m_buffer);
+			if (m_colorBuffer)
+				glDeleteBuffers(1, &m_colorBuffer);
 		}
 
 		matrix4x4f *InstanceBuffer::Map(BufferMapMode mode)
@@ -522,6 +526,24 @@ namespace Graphics {
 			m_written = true;
 		}
 
+		void InstanceBuffer::SetColors(const InstanceColors *colors, Uint32 count)
+		{
+			assert(count <= m_size);
+			m_numColors = colors ? count : 0;
+			if (!m_numColors)
+				return;
+
+			if (!m_colorBuffer) {
+				glGenBuffers(1, &m_colorBuffer);
+				glBindBuffer(GL_ARRAY_BUFFER, m_colorBuffer);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceColors) * m_size, 0, GL_DYNAMIC_DRAW);
+			} else {
+				glBindBuffer(GL_ARRAY_BUFFER, m_colorBuffer);
+			}
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceColors) * m_numColors, colors);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+
 		void InstanceBuffer::Bind()
 		{
 			assert(m_written);
@@ -542,6 +564,21 @@ namespace Graphics {
 			glVertexAttribDivisor(INSTOFFS_MAT1, 1);
 			glVertexAttribDivisor(INSTOFFS_MAT2, 1);
 			glVertexAttribDivisor(INSTOFFS_MAT3, 1);
+
+			if (m_numColors) {
+				glBindBuffer(GL_ARRAY_BUFFER, m_colorBuffer);
+				const GLsizei stride = sizeof(InstanceColors);
+				glEnableVertexAttribArray(INSTOFFS_COLOR0);
+				glVertexAttribPointer(INSTOFFS_COLOR0, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid *>(0));
+				glEnableVertexAttribArray(INSTOFFS_COLOR1);
+				glVertexAttribPointer(INSTOFFS_COLOR1, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid *>(sizeVec4));
+				glEnableVertexAttribArray(INSTOFFS_COLOR2);
+				glVertexAttribPointer(INSTOFFS_COLOR2, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid *>(2 * sizeVec4));
+
+				glVertexAttribDivisor(INSTOFFS_COLOR0, 1);
+				glVertexAttribDivisor(INSTOFFS_COLOR1, 1);
+				glVertexAttribDivisor(INSTOFFS_COLOR2, 1);
+			}
 		}
 
 		void InstanceBuffer::Release()
@@ -551,6 +588,11 @@ namespace Graphics {
 			glDisableVertexAttribArray(INSTOFFS_MAT1);
 			glDisableVertexAttribArray(INSTOFFS_MAT2);
 			glDisableVertexAttribArray(INSTOFFS_MAT3);
+			if (m_numColors) {
+				glDisableVertexAttribArray(INSTOFFS_COLOR0);
+				glDisableVertexAttribArray(INSTOFFS_COLOR1);
+				glDisableVertexAttribArray(INSTOFFS_COLOR2);
+			}
 
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
 		}
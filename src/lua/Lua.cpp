@@ -28,6 +28,7 @@
 #include "LuaVector2.h"
 
 #include "Body.h"
+#include "GameConfig.h"
 #include "SectorView.h"
 #include "Ship.h"
 #include "SpaceStation.h"
@@ -46,7 +47,17 @@ namespace Lua {
 
 	void Init()
 	{
-		manager = new LuaManager();
+		manager = new LuaManager(Pi::config->Int("LuaPooledAllocator", 1) != 0);
+
+		LuaManager::GCSettings gc;
+		gc.generational = Pi::config->String("LuaGCMode") == "generational";
+		gc.pause = Pi::config->Int("LuaGCPause", gc.pause);
+		gc.stepMul = Pi::config->Int("LuaGCStepMul", gc.stepMul);
+		gc.stepKB = Pi::config->Int("LuaGCStepKB", gc.stepKB);
+		// LuaGCFrameBudgetMs is applied by Pi::App, which steps the collector
+		// every frame. other users of Lua::Init leave it to collect as it goes
+		manager->SetGCSettings(gc);
+
 		InitMath();
 	}
 
@@ -99,6 +110,7 @@ namespace Lua {
 		LuaConstants::Register(Lua::manager->GetLuaState());
 		LuaLang::Register();
 		LuaEngine::Register();
+		LuaEvent::Register();
 		LuaEconomy::Register();
 		LuaInput::Register();
 		LuaFileSystem::Register();
@@ -270,6 +270,9 @@ static luaL_Reg l_color_meta[] = {
 const char LuaColor::LibName[] = "Color";
 const char LuaColor::TypeName[] = "Color";
 
+// the metatable is also kept at this key, so it doesn't need looking up by name
+static const char s_metatableKey = 0;
+
 void LuaColor::Register(lua_State *L)
 {
 	LUA_DEBUG_START(L);
@@ -288,7 +291,7 @@ void LuaColor::Register(lua_State *L)
 	// hide the metatable to thwart crazy exploits
 	lua_pushboolean(L, 0);
 	lua_setfield(L, -2, "__metatable");
-	lua_pop(L, 1);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &s_metatableKey);
 
 	LUA_DEBUG_END(L, 0);
 }
@@ -296,16 +299,16 @@ void LuaColor::Register(lua_State *L)
 Color4ub *LuaColor::PushNewToLua(lua_State *L)
 {
 	Color4ub *ptr = static_cast<Color4ub *>(lua_newuserdata(L, sizeof(Color4ub)));
-	luaL_setmetatable(L, LuaColor::TypeName);
+	pi_lua_setmetatable_key(L, &s_metatableKey);
 	return ptr;
 }
 
 const Color4ub *LuaColor::GetFromLua(lua_State *L, int idx)
 {
-	return static_cast<Color4ub *>(luaL_testudata(L, idx, LuaColor::TypeName));
+	return static_cast<Color4ub *>(pi_lua_testudata_key(L, idx, &s_metatableKey));
 }
 
 Color4ub *LuaColor::CheckFromLua(lua_State *L, int idx)
 {
-	return static_cast<Color4ub *>(luaL_checkudata(L, idx, LuaColor::TypeName));
+	return static_cast<Color4ub *>(pi_lua_checkudata_key(L, idx, &s_metatableKey, LuaColor::TypeName));
 }
@@ -17,6 +17,7 @@
 #include "LuaUtils.h"
 #include "LuaVector.h"
 #include "LuaVector2.h"
+#include "ModelCache.h"
 #include "Pi.h"
 #include "Player.h"
 #include "Random.h"
@@ -949,6 +950,34 @@ static int l_engine_get_model(lua_State *l)
 	return 1;
 }
 
+/*
+ * Function: PreloadModel
+ *
+ * Start loading a model in the background, so that it is ready by the time
+ * a ship or station using it appears. Does nothing if the model is loaded
+ * already.
+ *
+ * > Engine.PreloadModel(name)
+ *
+ * Parameters:
+ *
+ *   name - the name of the model, as used in ship and station definitions
+ *
+ * Availability:
+ *
+ *   2021
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_engine_preload_model(lua_State *l)
+{
+	const std::string name(luaL_checkstring(l, 1));
+	Pi::modelCache->RequestModel(name);
+	return 0;
+}
+
 static int l_get_can_browse_user_folders(lua_State *l)
 {
 	lua_pushboolean(l, OS::SupportsFolderBrowser());
@@ -1036,6 +1065,7 @@ void LuaEngine::Register()
 		{ "OpenBrowseUserFolder", l_browse_user_folders },
 
 		{ "GetModel", l_engine_get_model },
+		{ "PreloadModel", l_engine_preload_model },
 
 		{ "IsIntroZooming", l_engine_is_intro_zooming },
 		{ "GetIntroCurrentModelName", l_engine_get_intro_current_model_name },
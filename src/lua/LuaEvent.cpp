@@ -6,64 +6,318 @@
 #include "LuaObject.h"
 #include "LuaUtils.h"
 #include "libs.h"
+#include "profiler/Profiler.h"
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
+/*
+ * Events are queued in C++ for both C++ and Lua senders. Their arguments are
+ * kept in a registry table, in the order they were queued, and the handlers
+ * for each event type are kept in a registry table of arrays indexed by the
+ * event type id. Registering or deregistering a handler replaces the array,
+ * so handlers can safely change while the events are being dispatched.
+ */
 
 namespace LuaEvent {
 
-	static bool _get_method_onto_stack(lua_State *l, const char *method)
+	typedef Uint32 EventId;
+
+	struct EventType {
+		EventType(const std::string &_name) :
+			name(_name),
+			handlers(0),
+			queued(0),
+			dropped(0),
+			dispatched(0),
+			ticks(0),
+			debugTimer(false) {}
+
+		std::string name;
+		unsigned handlers;
+		Uint64 queued;
+		Uint64 dropped;
+		Uint64 dispatched;
+		Uint64 ticks;
+		bool debugTimer;
+	};
+
+	struct QueuedEvent {
+		EventId type;
+		Uint32 firstArg;
+		int numArgs;
+	};
+
+	// a deque doesn't move its elements, so the names can be used as keys
+	static std::deque<EventType> s_types;
+	static std::unordered_map<std::string_view, EventId> s_typeIds;
+
+	static std::deque<QueuedEvent> s_pending;
+	static Uint32 s_nextArg = 1;
+	static int s_emitDepth = 0;
+
+	static int s_handlersRef = LUA_NOREF;
+	static int s_argsRef = LUA_NOREF;
+
+	static EventId GetEventId(std::string_view name)
 	{
-		LUA_DEBUG_START(l);
+		auto it = s_typeIds.find(name);
+		if (it != s_typeIds.end())
+			return it->second;
 
-		int top = lua_gettop(l);
+		const EventId id = s_types.size();
+		s_types.emplace_back(std::string(name));
+		s_typeIds.emplace(s_types.back().name, id);
+		return id;
+	}
+
+	// moves the top numArgs values on the stack into the argument table
+	static void QueueFromStack(lua_State *l, EventId type, int numArgs)
+	{
+		lua_rawgeti(l, LUA_REGISTRYINDEX, s_argsRef);
+		lua_insert(l, -numArgs - 1);
+		const int args = lua_gettop(l) - numArgs;
+		for (int i = numArgs; i > 0; i--)
+			lua_rawseti(l, args, s_nextArg + i - 1);
+		lua_pop(l, 1);
 
-		if (!pi_lua_import(l, "Event"))
-			return false;
+		s_pending.push_back({ type, s_nextArg, numArgs });
+		s_nextArg += numArgs;
+	}
 
-		lua_getfield(l, -1, method);
-		if (!lua_isfunction(l, -1)) {
-			lua_pop(l, 2);
-			LUA_DEBUG_END(l, 0);
-			return false;
+	static void CallHandler(lua_State *l, EventType &type, int numArgs)
+	{
+		if (!type.debugTimer) {
+			pi_lua_protected_call(l, numArgs, 0);
+			return;
 		}
 
-		lua_insert(l, top + 1);
-		lua_settop(l, top + 1);
+		lua_Debug ar;
+		lua_pushvalue(l, -numArgs - 1);
+		lua_getinfo(l, ">S", &ar);
 
-		LUA_DEBUG_END(l, 1);
+		const Uint64 start = Profiler::Clock::getticks();
+		pi_lua_protected_call(l, numArgs, 0);
+		const double ms = Profiler::Clock::ms(Profiler::Clock::getticks() - start);
 
-		return true;
+		Output("DEBUG: %s %.3fms %s:%d\n", type.name.c_str(), ms, ar.source, ar.linedefined);
 	}
 
 	void Clear()
 	{
+		s_pending.clear();
+		s_nextArg = 1;
+		if (s_argsRef == LUA_NOREF)
+			return;
+
+		lua_State *l = Lua::manager->GetLuaState();
+		lua_newtable(l);
+		lua_rawseti(l, LUA_REGISTRYINDEX, s_argsRef);
+	}
+
+	void Emit()
+	{
+		PROFILE_SCOPED()
+		if (s_pending.empty())
+			return;
+
 		lua_State *l = Lua::manager->GetLuaState();
 
 		LUA_DEBUG_START(l);
-		if (!_get_method_onto_stack(l, "_Clear")) return;
-		pi_lua_protected_call(l, 0, 0);
+		++s_emitDepth;
+
+		lua_rawgeti(l, LUA_REGISTRYINDEX, s_handlersRef);
+		const int handlers = lua_gettop(l);
+
+		// handlers can queue more events, they are dispatched in the same pass
+		while (!s_pending.empty()) {
+			const QueuedEvent ev = s_pending.front();
+			s_pending.pop_front();
+			EventType &type = s_types[ev.type];
+
+			// the argument table is replaced if a handler clears the queue
+			lua_rawgeti(l, LUA_REGISTRYINDEX, s_argsRef);
+			const int args = lua_gettop(l);
+
+			lua_rawgeti(l, handlers, ev.type);
+			if (lua_istable(l, -1)) {
+				const int callbacks = lua_gettop(l);
+				const int numCallbacks = lua_rawlen(l, callbacks);
+				const Uint64 start = Profiler::Clock::getticks();
+				for (int i = 1; i <= numCallbacks; i++) {
+					lua_rawgeti(l, callbacks, i);
+					for (int a = 0; a < ev.numArgs; a++)
+						lua_rawgeti(l, args, ev.firstArg + a);
+					CallHandler(l, type, ev.numArgs);
+				}
+				type.ticks += Profiler::Clock::getticks() - start;
+				++type.dispatched;
+			}
+			lua_pop(l, 1);
+
+			for (int a = 0; a < ev.numArgs; a++) {
+				lua_pushnil(l);
+				lua_rawseti(l, args, ev.firstArg + a);
+			}
+			lua_pop(l, 1);
+		}
+		lua_pop(l, 1);
+
+		if (--s_emitDepth == 0)
+			s_nextArg = 1;
+
 		LUA_DEBUG_END(l, 0);
 	}
 
-	void Emit()
+	void QueueInternal(const char *event, const ArgsBase &args)
 	{
+		const EventId id = GetEventId(event);
+		EventType &type = s_types[id];
+		++type.queued;
+		if (!type.handlers) {
+			++type.dropped;
+			return;
+		}
+
 		lua_State *l = Lua::manager->GetLuaState();
 
 		LUA_DEBUG_START(l);
-		if (!_get_method_onto_stack(l, "_Emit")) return;
-		pi_lua_protected_call(l, 0, 0);
+		const int top = lua_gettop(l);
+		args.PrepareStack(l);
+		QueueFromStack(l, id, lua_gettop(l) - top);
 		LUA_DEBUG_END(l, 0);
 	}
 
-	void QueueInternal(const char *event, const ArgsBase &args)
+	std::vector<EventStats> GetStats()
+	{
+		std::vector<EventStats> stats;
+		stats.reserve(s_types.size());
+		for (const EventType &type : s_types)
+			stats.push_back({ type.name, type.handlers, type.queued, type.dropped, type.dispatched, type.ticks });
+		return stats;
+	}
+
+	void ResetStats()
+	{
+		for (EventType &type : s_types) {
+			type.queued = 0;
+			type.dropped = 0;
+			type.dispatched = 0;
+			type.ticks = 0;
+		}
+	}
+
+	static int l_eventqueue_queue(lua_State *l)
+	{
+		size_t len;
+		const char *name = luaL_checklstring(l, 1, &len);
+		const EventId id = GetEventId(std::string_view(name, len));
+		EventType &type = s_types[id];
+		++type.queued;
+		if (!type.handlers) {
+			++type.dropped;
+			return 0;
+		}
+
+		QueueFromStack(l, id, lua_gettop(l) - 1);
+		return 0;
+	}
+
+	static int l_eventqueue_register(lua_State *l)
+	{
+		size_t len;
+		const char *name = luaL_checklstring(l, 1, &len);
+		luaL_checktype(l, 2, LUA_TFUNCTION);
+		const EventId id = GetEventId(std::string_view(name, len));
+
+		lua_rawgeti(l, LUA_REGISTRYINDEX, s_handlersRef);
+		lua_rawgeti(l, -1, id);
+		const int numCallbacks = lua_istable(l, -1) ? lua_rawlen(l, -1) : 0;
+		lua_createtable(l, numCallbacks + 1, 0);
+		for (int i = 1; i <= numCallbacks; i++) {
+			lua_rawgeti(l, -2, i);
+			if (lua_rawequal(l, -1, 2)) {
+				lua_pop(l, 4); // already registered
+				return 0;
+			}
+			lua_rawseti(l, -2, i);
+		}
+		lua_pushvalue(l, 2);
+		lua_rawseti(l, -2, numCallbacks + 1);
+		lua_rawseti(l, -3, id);
+		lua_pop(l, 2);
+
+		s_types[id].handlers = numCallbacks + 1;
+		return 0;
+	}
+
+	static int l_eventqueue_deregister(lua_State *l)
+	{
+		size_t len;
+		const char *name = luaL_checklstring(l, 1, &len);
+		const EventId id = GetEventId(std::string_view(name, len));
+
+		lua_rawgeti(l, LUA_REGISTRYINDEX, s_handlersRef);
+		lua_rawgeti(l, -1, id);
+		const int numCallbacks = lua_istable(l, -1) ? lua_rawlen(l, -1) : 0;
+		lua_createtable(l, numCallbacks, 0);
+		int kept = 0;
+		for (int i = 1; i <= numCallbacks; i++) {
+			lua_rawgeti(l, -2, i);
+			if (lua_rawequal(l, -1, 2))
+				lua_pop(l, 1);
+			else
+				lua_rawseti(l, -2, ++kept);
+		}
+		if (kept == numCallbacks) {
+			lua_pop(l, 3); // wasn't registered
+			return 0;
+		}
+		lua_rawseti(l, -3, id);
+		lua_pop(l, 2);
+
+		s_types[id].handlers = kept;
+		return 0;
+	}
+
+	static int l_eventqueue_debug_timer(lua_State *l)
+	{
+		size_t len;
+		const char *name = luaL_checklstring(l, 1, &len);
+		s_types[GetEventId(std::string_view(name, len))].debugTimer = lua_toboolean(l, 2);
+		return 0;
+	}
+
+	// the native side of the Event module, only used by Event.lua
+	void Register()
 	{
 		lua_State *l = Lua::manager->GetLuaState();
 
 		LUA_DEBUG_START(l);
-		if (!_get_method_onto_stack(l, "Queue")) return;
 
-		int top = lua_gettop(l);
-		lua_pushstring(l, event);
-		args.PrepareStack(l);
-		pi_lua_protected_call(l, lua_gettop(l) - top, 0);
+		// handlers and queued events belong to the Lua state
+		s_pending.clear();
+		s_nextArg = 1;
+		for (EventType &type : s_types)
+			type.handlers = 0;
+
+		lua_newtable(l);
+		s_handlersRef = luaL_ref(l, LUA_REGISTRYINDEX);
+		lua_newtable(l);
+		s_argsRef = luaL_ref(l, LUA_REGISTRYINDEX);
+
+		static const luaL_Reg l_methods[] = {
+			{ "Queue", l_eventqueue_queue },
+			{ "Register", l_eventqueue_register },
+			{ "Deregister", l_eventqueue_deregister },
+			{ "DebugTimer", l_eventqueue_debug_timer },
+			{ 0, 0 }
+		};
+
+		lua_getfield(l, LUA_REGISTRYINDEX, "CoreImports");
+		LuaObjectBase::CreateObject(l_methods, 0, 0);
+		lua_setfield(l, -2, "EventQueue");
+		lua_pop(l, 1);
 
 		LUA_DEBUG_END(l, 0);
 	}
@@ -9,6 +9,8 @@
 #include "LuaObject.h"
 #include "LuaPushPull.h"
 #include "Pi.h"
+#include <string>
+#include <vector>
 
 namespace LuaEvent {
 
@@ -80,9 +82,26 @@ namespace LuaEvent {
 		}
 	};
 
+	// counters for a single event type, for the performance overlay
+	struct EventStats {
+		std::string name;
+		unsigned handlers;
+		Uint64 queued;
+		Uint64 dropped; // queued while nothing was listening
+		Uint64 dispatched;
+		Uint64 ticks; // time spent in the handlers
+	};
+
+	void Register();
+
 	void Clear();
 	void Emit();
 
+	std::vector<EventStats> GetStats();
+	void ResetStats();
+
+	// events are only pushed to Lua if a handler is registered for them,
+	// otherwise they're counted and dropped straight away
 	void QueueInternal(const char *event, const ArgsBase &args);
 
 	template <typename... TArgs>
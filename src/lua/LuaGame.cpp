@@ -12,6 +12,7 @@
 #include "LuaUtils.h"
 #include "Pi.h"
 #include "Player.h"
+#include "SaveGameWriter.h"
 #include "SectorView.h"
 #include "Space.h"
 #include "StringF.h"
@@ -232,6 +233,10 @@ static int l_game_can_load_game(lua_State *l)
  *
  *   path - the full path to the saved file (so it can be displayed)
  *
+ * The game state is captured immediately but the file is compressed and
+ * written in the background. The <Event.onGameSaved> event is triggered
+ * when that is complete; use <GetSaveStatus> to poll it instead.
+ *
  * Availability:
  *
  *   June 2013
@@ -266,6 +271,39 @@ static int l_game_save_game(lua_State *l)
 	}
 }
 
+/*
+ * Function: GetSaveStatus
+ *
+ * Report on the progress of the most recent save.
+ *
+ * > state, filename = Game.GetSaveStatus()
+ *
+ * Return:
+ *
+ *   state - one of "idle" (nothing saved yet), "writing", "done" or "failed"
+ *
+ *   filename - the name the game was saved under, or nil if idle
+ *
+ * Availability:
+ *
+ *   2021
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_game_get_save_status(lua_State *l)
+{
+	static const char *stateNames[] = { "idle", "writing", "done", "failed" };
+	const SaveGameWriter::Status status = SaveGameWriter::GetStatus();
+	lua_pushstring(l, stateNames[status.state]);
+	if (status.state == SaveGameWriter::STATE_IDLE)
+		lua_pushnil(l);
+	else
+		lua_pushlstring(l, status.filename.c_str(), status.filename.size());
+	return 2;
+}
+
 /*
  * Function: EndGame
  *
@@ -658,6 +696,7 @@ void LuaGame::Register()
 		{ "LoadGame", l_game_load_game },
 		{ "CanLoadGame", l_game_can_load_game },
 		{ "SaveGame", l_game_save_game },
+		{ "GetSaveStatus", l_game_get_save_status },
 		{ "EndGame", l_game_end_game },
 		{ "InHyperspace", l_game_in_hyperspace },
 		{ "SaveGameStats", l_game_savegame_stats },
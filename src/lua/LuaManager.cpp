@@ -3,19 +3,33 @@
 
 #include "LuaManager.h"
 #include "FileSystem.h"
+#include "profiler/Profiler.h"
+#include <SDL_timer.h>
 #include <cstdlib>
 
 bool instantiated = false;
 
-LuaManager::LuaManager() :
-	m_lua(0)
+LuaManager::LuaManager(bool pooledAllocator) :
+	m_lua(0),
+	m_pool(pooledAllocator ? new LuaPoolAllocator() : nullptr),
+	m_gcInCycle(false),
+	m_gcThreshold(0),
+	m_allocCount(0),
+	m_allocBytes(0),
+	m_statAllocs(m_stats.GetOrCreateCounter("Lua allocations")),
+	m_statAllocKB(m_stats.GetOrCreateCounter("Lua allocated KB")),
+	m_statMemoryKB(m_stats.GetOrCreateCounter("Lua memory KB", false)),
+	m_statPoolKB(m_stats.GetOrCreateCounter("Lua pool reserved KB", false)),
+	m_statGCSteps(m_stats.GetOrCreateCounter("Lua GC steps")),
+	m_statGCMicroseconds(m_stats.GetOrCreateCounter("Lua GC microseconds")),
+	m_statGCCycles(m_stats.GetOrCreateCounter("Lua GC cycles", false))
 {
 	if (instantiated) {
 		Output("Can't instantiate more than one LuaManager");
 		abort();
 	}
 
-	m_lua = luaL_newstate();
+	m_lua = lua_newstate(&LuaManager::Allocate, this);
 	pi_lua_open_standard_base(m_lua);
 	lua_atpanic(m_lua, pi_lua_panic);
 
@@ -28,6 +42,7 @@ LuaManager::LuaManager() :
 
 LuaManager::~LuaManager()
 {
+	m_profiler.Stop(m_lua);
 	lua_close(m_lua);
 
 	instantiated = false;
@@ -43,4 +58,85 @@ size_t LuaManager::GetMemoryUsage() const
 void LuaManager::CollectGarbage()
 {
 	lua_gc(m_lua, LUA_GCCOLLECT, 0);
+	m_gcInCycle = false;
+	m_gcThreshold = GetMemoryUsage() * m_gcSettings.pause / 100;
+}
+
+void LuaManager::SetGCSettings(const GCSettings &settings)
+{
+	m_gcSettings = settings;
+
+	lua_gc(m_lua, settings.generational ? LUA_GCGEN : LUA_GCINC, 0);
+	lua_gc(m_lua, LUA_GCSETPAUSE, settings.pause);
+	lua_gc(m_lua, LUA_GCSETSTEPMUL, settings.stepMul);
+
+	// the generational collector decides for itself when to do its minor collections
+	if (settings.frameBudgetMs > 0.0f && !settings.generational) {
+		lua_gc(m_lua, LUA_GCSTOP, 0);
+		m_gcInCycle = false;
+		m_gcThreshold = GetMemoryUsage() * settings.pause / 100;
+	} else {
+		lua_gc(m_lua, LUA_GCRESTART, 0);
+	}
+}
+
+void LuaManager::StepGarbageCollector()
+{
+	PROFILE_SCOPED()
+	Uint32 steps = 0;
+	const Uint64 start = SDL_GetPerformanceCounter();
+
+	if (m_gcSettings.frameBudgetMs > 0.0f && !m_gcSettings.generational) {
+		const size_t memory = GetMemoryUsage();
+		if (!m_gcInCycle && memory >= m_gcThreshold)
+			m_gcInCycle = true;
+
+		if (m_gcInCycle) {
+			const Uint64 budget = Uint64(double(m_gcSettings.frameBudgetMs) * 1e-3 * SDL_GetPerformanceFrequency());
+			// don't let the budget hold back the collector while memory runs away
+			const bool overdue = memory > 2 * m_gcThreshold;
+			do {
+				++steps;
+				if (lua_gc(m_lua, LUA_GCSTEP, m_gcSettings.stepKB)) {
+					m_gcInCycle = false;
+					m_gcThreshold = GetMemoryUsage() * m_gcSettings.pause / 100;
+					m_stats.CounterAdd(m_statGCCycles);
+					break;
+				}
+			} while (overdue || SDL_GetPerformanceCounter() - start < budget);
+		}
+	}
+
+	const Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+	m_stats.CounterSet(m_statGCSteps, steps);
+	m_stats.CounterSet(m_statGCMicroseconds, Uint32(elapsed * 1000000 / SDL_GetPerformanceFrequency()));
+	m_stats.CounterSet(m_statAllocs, m_allocCount);
+	m_stats.CounterSet(m_statAllocKB, Uint32(m_allocBytes / 1024));
+	m_stats.CounterSet(m_statMemoryKB, Uint32(GetMemoryUsage() / 1024));
+	m_stats.CounterSet(m_statPoolKB, m_pool ? Uint32(m_pool->GetReservedBytes() / 1024) : 0);
+	m_stats.FlushFrame();
+	m_allocCount = 0;
+	m_allocBytes = 0;
+}
+
+void *LuaManager::Allocate(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	LuaManager *manager = static_cast<LuaManager *>(ud);
+	// osize is the type of object being allocated when ptr is null
+	const size_t oldSize = ptr ? osize : 0;
+	if (nsize > oldSize) {
+		++manager->m_allocCount;
+		manager->m_allocBytes += nsize - oldSize;
+		if (manager->m_profiler.IsRunning())
+			manager->m_profiler.OnAlloc(nsize - oldSize);
+	}
+
+	if (manager->m_pool)
+		return manager->m_pool->Reallocate(ptr, oldSize, nsize);
+
+	if (nsize == 0) {
+		free(ptr);
+		return nullptr;
+	}
+	return realloc(ptr, nsize);
 }
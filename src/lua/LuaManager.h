@@ -4,22 +4,71 @@
 #ifndef _LUAMANAGER_H
 #define _LUAMANAGER_H
 
+#include "LuaPoolAllocator.h"
+#include "LuaProfiler.h"
 #include "LuaUtils.h"
+#include "PerfStats.h"
+#include <memory>
 
 class LuaManager {
 public:
-	LuaManager();
+	struct GCSettings {
+		GCSettings() :
+			generational(false),
+			pause(200),
+			stepMul(200),
+			stepKB(16),
+			frameBudgetMs(0.0f) {}
+
+		bool generational;
+		int pause; // percent of the memory in use after a cycle to wait for before starting the next
+		int stepMul; // percent, how much work each step does relative to allocation
+		int stepKB; // size of the steps taken by StepGarbageCollector
+		// when non-zero the incremental collector only runs from StepGarbageCollector
+		float frameBudgetMs;
+	};
+
+	explicit LuaManager(bool pooledAllocator = true);
 	~LuaManager();
 
 	lua_State *GetLuaState() { return m_lua; }
 	size_t GetMemoryUsage() const;
 	void CollectGarbage();
 
+	void SetGCSettings(const GCSettings &settings);
+	const GCSettings &GetGCSettings() const { return m_gcSettings; }
+	// once per frame, ideally while waiting for the GPU. also updates the stats
+	void StepGarbageCollector();
+
+	LuaProfiler &GetProfiler() { return m_profiler; }
+	const Perf::Stats &GetStats() const { return m_stats; }
+
 private:
+	static void *Allocate(void *ud, void *ptr, size_t osize, size_t nsize);
+
 	LuaManager(const LuaManager &);
 	LuaManager &operator=(const LuaManager &) = delete;
 
 	lua_State *m_lua;
+	std::unique_ptr<LuaPoolAllocator> m_pool;
+	LuaProfiler m_profiler;
+
+	GCSettings m_gcSettings;
+	bool m_gcInCycle;
+	size_t m_gcThreshold; // memory in use that starts the next budgeted cycle
+
+	// this frame, plain counters as the allocator is very hot
+	Uint32 m_allocCount;
+	size_t m_allocBytes;
+
+	Perf::Stats m_stats;
+	Perf::Stats::CounterRef m_statAllocs;
+	Perf::Stats::CounterRef m_statAllocKB;
+	Perf::Stats::CounterRef m_statMemoryKB;
+	Perf::Stats::CounterRef m_statPoolKB;
+	Perf::Stats::CounterRef m_statGCSteps;
+	Perf::Stats::CounterRef m_statGCMicroseconds;
+	Perf::Stats::CounterRef m_statGCCycles;
 };
 
 #endif
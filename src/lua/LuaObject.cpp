@@ -564,6 +564,80 @@ void LuaObjectBase::Register(LuaObjectBase *lo)
 	LUA_DEBUG_END(l, 0);
 }
 
+// registry key of the table of {metatable, constructor} pairs for copied
+// types, indexed by their type name pointer
+static const char s_copyTypesKey = 0;
+
+void LuaObjectBase::RegisterCopy(LuaObjectBase *lo)
+{
+	assert(lo->GetObject());
+
+	// promoted and propertied types need the full treatment
+	if (promotions.find(lo->m_type) != promotions.end() || dynamic_cast<PropertiedObject *>(lo->GetObject())) {
+		Register(lo);
+		return;
+	}
+
+	lua_State *l = Lua::manager->GetLuaState();
+
+	LUA_DEBUG_START(l); // lo userdata
+
+	lua_rawgetp(l, LUA_REGISTRYINDEX, &s_copyTypesKey);
+	if (!lua_istable(l, -1)) {
+		lua_pop(l, 1);
+		lua_newtable(l);
+		lua_pushvalue(l, -1);
+		lua_rawsetp(l, LUA_REGISTRYINDEX, &s_copyTypesKey);
+	}
+	// lo userdata, copy types
+
+	lua_rawgetp(l, -1, lo->m_type); // lo userdata, copy types, type entry
+	if (lua_istable(l, -1)) {
+		lua_rawgeti(l, -1, 1);
+		lua_setmetatable(l, -4);
+		lua_rawgeti(l, -1, 2); // lo userdata, copy types, type entry, cons
+		lua_replace(l, -3);
+		lua_pop(l, 1); // lo userdata, cons
+	} else {
+		lua_pop(l, 1);
+		lua_createtable(l, 2, 0); // lo userdata, copy types, type entry
+
+		LuaMetaTypeBase::GetMetatableFromName(l, lo->m_type);
+		lua_pushvalue(l, -1);
+		lua_setmetatable(l, -5); // the constructor search needs the metatable
+		lua_pushvalue(l, -1);
+		lua_rawseti(l, -3, 1); // lo userdata, copy types, type entry, lo metatable
+
+		lua_getfield(l, -1, "__index");
+		lua_pushvalue(l, -5);
+		lua_pushstring(l, "Constructor");
+		pi_lua_protected_call(l, 2, 1);
+		if (lua_isnil(l, -1)) {
+			lua_pop(l, 1);
+			lua_getfield(l, -1, "__index");
+			lua_pushvalue(l, -5);
+			lua_pushstring(l, "__init");
+			pi_lua_protected_call(l, 2, 1);
+		}
+		lua_replace(l, -2); // lo userdata, copy types, type entry, cons
+
+		lua_pushvalue(l, -1);
+		lua_rawseti(l, -3, 2);
+		lua_insert(l, -3); // lo userdata, cons, copy types, type entry
+		lua_rawsetp(l, -2, lo->m_type);
+		lua_pop(l, 1); // lo userdata, cons
+	}
+
+	if (lua_isfunction(l, -1)) {
+		lua_pushvalue(l, -2);
+		lua_call(l, 1, 0);
+	} else {
+		lua_pop(l, 1);
+	}
+
+	LUA_DEBUG_END(l, 0);
+}
+
 void LuaObjectBase::Deregister(LuaObjectBase *lo)
 {
 	LuaWrappable *o = lo->GetObject();
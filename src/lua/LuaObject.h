@@ -153,6 +153,11 @@ protected:
 	// the stack
 	static void Register(LuaObjectBase *lo);
 
+	// same as Register for a wrapper around a copy, which nothing else can
+	// hold a pointer to. the metatable and constructor are only looked up the
+	// first time a type is pushed, and the copy isn't added to the registry
+	static void RegisterCopy(LuaObjectBase *lo);
+
 	// remove the object->wrapper from the registry. checks to make sure the
 	// the mapping matches first, to protect against memory being reused
 	static void Deregister(LuaObjectBase *lo);
@@ -337,28 +342,19 @@ private:
 template <typename T>
 class LuaCopyObject : public LuaObject<T> {
 public:
-	LuaCopyObject(const T &o)
-	{
-		lua_State *l = Lua::manager->GetLuaState();
-		m_object = new (LuaObjectBase::Allocate(sizeof(T))) T(o);
-		m_ref = LuaRef(l, -1);
-		lua_pop(l, 1);
-	}
-
-	~LuaCopyObject()
+	// the copy lives inside the wrapper, so it takes a single userdata
+	LuaCopyObject(const T &o) :
+		m_object(o)
 	{
-		m_object->~T();
-		m_object = 0;
 	}
 
 	LuaWrappable *GetObject() const
 	{
-		return m_object;
+		return &m_object;
 	}
 
 private:
-	T *m_object;
-	LuaRef m_ref;
+	mutable T m_object;
 };
 
 // wrapper for a "lua-owned" object.
@@ -404,7 +400,7 @@ inline void LuaObject<T>::PushToLua(RefCounted *o)
 template <typename T>
 inline void LuaObject<T>::PushToLua(const T &o)
 {
-	Register(new (LuaObjectBase::Allocate(sizeof(LuaCopyObject<T>))) LuaCopyObject<T>(o));
+	RegisterCopy(new (LuaObjectBase::Allocate(sizeof(LuaCopyObject<T>))) LuaCopyObject<T>(o));
 }
 
 template <typename T>
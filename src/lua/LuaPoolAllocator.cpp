@@ -0,0 +1,86 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaPoolAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+LuaPoolAllocator::LuaPoolAllocator() :
+	m_next(nullptr),
+	m_end(nullptr)
+{
+	std::fill(m_free, m_free + NUM_CLASSES, nullptr);
+}
+
+LuaPoolAllocator::~LuaPoolAllocator()
+{
+	for (char *chunk : m_chunks)
+		free(chunk);
+}
+
+void *LuaPoolAllocator::Allocate(size_t size)
+{
+	const size_t c = ClassOf(size);
+	if (FreeBlock *block = m_free[c]) {
+		m_free[c] = block->next;
+		return block;
+	}
+
+	const size_t blockSize = (c + 1) * GRANULARITY;
+	if (size_t(m_end - m_next) < blockSize) {
+		// the rest of the old chunk is too small for this class, it's wasted
+		char *chunk = static_cast<char *>(malloc(CHUNK_SIZE));
+		if (!chunk)
+			return nullptr;
+		m_chunks.push_back(chunk);
+		m_next = chunk;
+		m_end = chunk + CHUNK_SIZE;
+	}
+	void *block = m_next;
+	m_next += blockSize;
+	return block;
+}
+
+void LuaPoolAllocator::Free(void *ptr, size_t size)
+{
+	FreeBlock *block = static_cast<FreeBlock *>(ptr);
+	const size_t c = ClassOf(size);
+	block->next = m_free[c];
+	m_free[c] = block;
+}
+
+void *LuaPoolAllocator::Reallocate(void *ptr, size_t oldSize, size_t newSize)
+{
+	if (!ptr)
+		oldSize = 0;
+	const bool pooledOld = ptr && oldSize <= MAX_POOLED_SIZE;
+	const bool pooledNew = newSize <= MAX_POOLED_SIZE;
+
+	if (newSize == 0) {
+		if (pooledOld)
+			Free(ptr, oldSize);
+		else
+			free(ptr);
+		return nullptr;
+	}
+
+	if (pooledOld && pooledNew && ClassOf(oldSize) == ClassOf(newSize))
+		return ptr;
+	if (!pooledOld && !pooledNew)
+		return realloc(ptr, newSize);
+
+	// moving between the pools, or between a pool and the heap
+	void *block = pooledNew ? Allocate(newSize) : malloc(newSize);
+	if (!block)
+		return nullptr; // Lua keeps the old block
+	if (ptr) {
+		memcpy(block, ptr, std::min(oldSize, newSize));
+		if (pooledOld)
+			Free(ptr, oldSize);
+		else
+			free(ptr);
+	}
+	return block;
+}
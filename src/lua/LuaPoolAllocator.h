@@ -0,0 +1,54 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUAPOOLALLOCATOR_H
+#define _LUAPOOLALLOCATOR_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+	Most of what Lua allocates is small and short lived: strings, tables,
+	closures and the userdata for every vector, path or colour pushed from C++.
+	Blocks up to MAX_POOLED_SIZE are carved out of large chunks and kept on a
+	free list per size class when Lua frees them, bigger ones go to malloc.
+
+	Lua always tells the allocator the size of the block it is freeing or
+	resizing, so the blocks don't need a header. Not thread safe, like the Lua
+	state it belongs to.
+*/
+class LuaPoolAllocator {
+public:
+	static const size_t GRANULARITY = 16;
+	static const size_t MAX_POOLED_SIZE = 256;
+	static const size_t CHUNK_SIZE = 64 * 1024;
+
+	LuaPoolAllocator();
+	~LuaPoolAllocator();
+
+	// lua_Alloc semantics: ptr may be null, newSize 0 frees
+	void *Reallocate(void *ptr, size_t oldSize, size_t newSize);
+
+	size_t GetReservedBytes() const { return m_chunks.size() * CHUNK_SIZE; }
+
+private:
+	LuaPoolAllocator(const LuaPoolAllocator &) = delete;
+	LuaPoolAllocator &operator=(const LuaPoolAllocator &) = delete;
+
+	struct FreeBlock {
+		FreeBlock *next;
+	};
+
+	static const size_t NUM_CLASSES = MAX_POOLED_SIZE / GRANULARITY;
+	static size_t ClassOf(size_t size) { return (size - 1) / GRANULARITY; }
+
+	void *Allocate(size_t size);
+	void Free(void *ptr, size_t size);
+
+	FreeBlock *m_free[NUM_CLASSES];
+	std::vector<char *> m_chunks;
+	char *m_next; // unused space in the newest chunk
+	char *m_end;
+};
+
+#endif /* _LUAPOOLALLOCATOR_H */
@@ -0,0 +1,233 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaProfiler.h"
+
+#include "FileSystem.h"
+#include "profiler/Profiler.h"
+#include "utils.h"
+#include <algorithm>
+#include <ctime>
+#include <map>
+
+// hooks don't get any user data, only one profiler can run at a time
+static LuaProfiler *s_running = nullptr;
+
+static std::string GetModuleName(std::string_view source)
+{
+	// strip the trust marker and the '@' of file chunks
+	if (source.substr(0, 4) == "[T] ")
+		source.remove_prefix(4);
+	if (source.empty() || source[0] != '@')
+		return std::string(source.substr(0, source.find('\n')));
+	source.remove_prefix(1);
+
+	// modules/<name>, pigui/<dir>/<name>, otherwise the first directory
+	size_t depth = 1;
+	if (source.substr(0, 8) == "modules/")
+		depth = 2;
+	else if (source.substr(0, 6) == "pigui/")
+		depth = 3;
+
+	size_t end = 0;
+	for (size_t i = 0; i < depth; i++) {
+		const size_t slash = source.find('/', end);
+		if (slash == std::string_view::npos) {
+			end = source.size();
+			break;
+		}
+		end = slash + 1;
+	}
+	std::string_view module = source.substr(0, end);
+	if (!module.empty() && module.back() == '/')
+		module.remove_suffix(1);
+	else if (module.size() > 4 && module.substr(module.size() - 4) == ".lua")
+		module.remove_suffix(4);
+	return std::string(module);
+}
+
+LuaProfiler::LuaProfiler() :
+	m_running(false),
+	m_currentStack(nullptr)
+{
+	Reset();
+}
+
+void LuaProfiler::Start(lua_State *l)
+{
+	if (m_running)
+		return;
+	assert(!s_running);
+
+	s_running = this;
+	m_running = true;
+	// coroutines created from now on inherit the hook
+	lua_sethook(l, &LuaProfiler::Hook, LUA_MASKCALL | LUA_MASKRET, 0);
+}
+
+void LuaProfiler::Stop(lua_State *l)
+{
+	if (!m_running)
+		return;
+
+	lua_sethook(l, nullptr, 0, 0);
+	m_running = false;
+	s_running = nullptr;
+	// whatever was running when we stopped won't return through the hook
+	m_stacks.clear();
+	m_currentStack = nullptr;
+}
+
+void LuaProfiler::Reset()
+{
+	// the call stacks only refer to ids, so they can stay
+	for (Function &fn : m_functions) {
+		fn.calls = 0;
+		fn.selfTicks = 0;
+		fn.totalTicks = 0;
+		fn.bytes = 0;
+	}
+	if (m_functions.empty())
+		m_functions.emplace_back("[engine]", "[engine]");
+}
+
+void LuaProfiler::Hook(lua_State *l, lua_Debug *ar)
+{
+	if (!s_running)
+		return;
+	switch (ar->event) {
+	case LUA_HOOKCALL: s_running->OnCall(l, ar, false); break;
+	case LUA_HOOKTAILCALL: s_running->OnCall(l, ar, true); break;
+	case LUA_HOOKRET: s_running->OnReturn(l); break;
+	default: break;
+	}
+}
+
+Uint32 LuaProfiler::GetFunctionId(const char *source, int line)
+{
+	auto src = m_functionIds.find(std::string_view(source));
+	if (src == m_functionIds.end()) {
+		m_sources.emplace_back(new std::string(source));
+		src = m_functionIds.emplace(*m_sources.back(), std::unordered_map<int, Uint32>()).first;
+	}
+
+	auto fn = src->second.find(line);
+	if (fn != src->second.end())
+		return fn->second;
+
+	const Uint32 id = m_functions.size();
+	m_functions.emplace_back(std::string(src->first) + ":" + std::to_string(line), GetModuleName(src->first));
+	src->second.emplace(line, id);
+	return id;
+}
+
+void LuaProfiler::OnCall(lua_State *l, lua_Debug *ar, bool isTail)
+{
+	std::vector<Frame> &stack = m_stacks[l];
+	m_currentStack = &stack;
+
+	lua_getinfo(l, "S", ar);
+	Frame frame;
+	frame.isC = ar->what[0] == 'C';
+	frame.isTail = isTail;
+	frame.children = 0;
+	if (frame.isC) {
+		// C functions are part of their caller
+		frame.function = stack.empty() ? 0 : stack.back().function;
+	} else {
+		frame.function = GetFunctionId(ar->source, ar->linedefined);
+		++m_functions[frame.function].calls;
+	}
+	frame.start = Profiler::Clock::getticks();
+	stack.push_back(frame);
+}
+
+void LuaProfiler::OnReturn(lua_State *l)
+{
+	const Uint64 now = Profiler::Clock::getticks();
+	std::vector<Frame> &stack = m_stacks[l];
+	m_currentStack = &stack;
+
+	// a tail call replaced the frame below it, which returns with it
+	bool isTail = true;
+	while (isTail && !stack.empty()) {
+		const Frame frame = stack.back();
+		stack.pop_back();
+		isTail = frame.isTail;
+
+		const Uint64 total = now - frame.start;
+		if (frame.isC) {
+			if (!stack.empty())
+				stack.back().children += frame.children;
+		} else {
+			Function &fn = m_functions[frame.function];
+			fn.selfTicks += total - std::min(total, frame.children);
+			fn.totalTicks += total;
+			if (!stack.empty())
+				stack.back().children += total;
+		}
+	}
+}
+
+std::vector<LuaProfiler::FunctionStats> LuaProfiler::GetFunctionStats() const
+{
+	std::vector<FunctionStats> stats;
+	for (const Function &fn : m_functions) {
+		if (fn.calls || fn.bytes)
+			stats.push_back({ fn.name, fn.module, fn.calls, fn.selfTicks, fn.totalTicks, fn.bytes });
+	}
+	std::sort(stats.begin(), stats.end(), [](const FunctionStats &a, const FunctionStats &b) {
+		return a.selfTicks > b.selfTicks;
+	});
+	return stats;
+}
+
+std::vector<LuaProfiler::ModuleStats> LuaProfiler::GetModuleStats() const
+{
+	std::map<std::string, ModuleStats> modules;
+	for (const Function &fn : m_functions) {
+		if (!fn.calls && !fn.bytes)
+			continue;
+		auto it = modules.find(fn.module);
+		if (it == modules.end())
+			it = modules.emplace(fn.module, ModuleStats{ fn.module, 0, 0, 0 }).first;
+		it->second.calls += fn.calls;
+		it->second.selfTicks += fn.selfTicks;
+		it->second.bytes += fn.bytes;
+	}
+
+	std::vector<ModuleStats> stats;
+	stats.reserve(modules.size());
+	for (auto &it : modules)
+		stats.push_back(it.second);
+	std::sort(stats.begin(), stats.end(), [](const ModuleStats &a, const ModuleStats &b) {
+		return a.selfTicks > b.selfTicks;
+	});
+	return stats;
+}
+
+bool LuaProfiler::Dump(std::string &filename) const
+{
+	char timestamp[32];
+	const time_t now = time(nullptr);
+	strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", localtime(&now));
+
+	FileSystem::userFiles.MakeDirectory("profiler");
+	filename = FileSystem::JoinPathBelow("profiler", std::string("lua-") + timestamp + ".txt");
+	FILE *f = FileSystem::userFiles.OpenWriteStream(filename, FileSystem::FileSourceFS::WRITE_TEXT);
+	if (!f)
+		return false;
+
+	fprintf(f, "%-40s %10s %12s %12s\n", "module", "calls", "self ms", "KB allocated");
+	for (const ModuleStats &m : GetModuleStats())
+		fprintf(f, "%-40s %10llu %12.3f %12.1f\n", m.name.c_str(), static_cast<unsigned long long>(m.calls),
+			Profiler::Clock::ms(m.selfTicks), m.bytes / 1024.0);
+
+	fprintf(f, "\n%-60s %10s %12s %12s %12s\n", "function", "calls", "self ms", "total ms", "KB allocated");
+	for (const FunctionStats &fn : GetFunctionStats())
+		fprintf(f, "%-60s %10llu %12.3f %12.3f %12.1f\n", fn.name.c_str(), static_cast<unsigned long long>(fn.calls),
+			Profiler::Clock::ms(fn.selfTicks), Profiler::Clock::ms(fn.totalTicks), fn.bytes / 1024.0);
+
+	fclose(f);
+	return true;
+}
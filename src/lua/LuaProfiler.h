@@ -0,0 +1,105 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUAPROFILER_H
+#define _LUAPROFILER_H
+
+#include <SDL_stdinc.h>
+#include <lua.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+	An opt-in profiler for Lua code. While it's running, call and return hooks
+	keep a shadow call stack for each Lua thread, so wall time can be attributed
+	to the Lua function that spent it, and the LuaManager allocator reports the
+	bytes it hands out, which are attributed to the function on top of that
+	stack. Time spent in C functions counts towards the Lua function that
+	called them.
+
+	Functions are grouped by module: the top level directories of
+	data/modules and data/pigui, and the first directory for everything else.
+*/
+class LuaProfiler {
+public:
+	struct FunctionStats {
+		std::string name; // source:line
+		std::string module;
+		Uint64 calls;
+		Uint64 selfTicks;
+		Uint64 totalTicks; // including the functions it called
+		Uint64 bytes;
+	};
+
+	struct ModuleStats {
+		std::string name;
+		Uint64 calls;
+		Uint64 selfTicks;
+		Uint64 bytes;
+	};
+
+	LuaProfiler();
+
+	void Start(lua_State *l);
+	void Stop(lua_State *l);
+	bool IsRunning() const { return m_running; }
+	void Reset();
+
+	// called by the allocator, must not touch the Lua state
+	void OnAlloc(size_t bytes)
+	{
+		const std::vector<Frame> *stack = m_currentStack;
+		m_functions[stack && !stack->empty() ? stack->back().function : 0].bytes += bytes;
+	}
+
+	// both sorted by self time, most expensive first
+	std::vector<FunctionStats> GetFunctionStats() const;
+	std::vector<ModuleStats> GetModuleStats() const;
+
+	// writes a report to the profiler directory in the user files
+	bool Dump(std::string &filename) const;
+
+private:
+	struct Frame {
+		Uint32 function;
+		Uint64 start;
+		Uint64 children;
+		bool isC;
+		bool isTail;
+	};
+
+	struct Function {
+		Function(const std::string &_name, const std::string &_module) :
+			name(_name),
+			module(_module),
+			calls(0),
+			selfTicks(0),
+			totalTicks(0),
+			bytes(0) {}
+
+		std::string name;
+		std::string module;
+		Uint64 calls;
+		Uint64 selfTicks;
+		Uint64 totalTicks;
+		Uint64 bytes;
+	};
+
+	static void Hook(lua_State *l, lua_Debug *ar);
+	void OnCall(lua_State *l, lua_Debug *ar, bool isTail);
+	void OnReturn(lua_State *l);
+	Uint32 GetFunctionId(const char *source, int line);
+
+	bool m_running;
+	std::vector<Function> m_functions; // 0 is everything outside of Lua functions
+	// source -> line -> function, the source keys point into m_sources
+	std::unordered_map<std::string_view, std::unordered_map<int, Uint32>> m_functionIds;
+	std::vector<std::unique_ptr<std::string>> m_sources;
+	std::unordered_map<lua_State *, std::vector<Frame>> m_stacks;
+	std::vector<Frame> *m_currentStack;
+};
+
+#endif /* _LUAPROFILER_H */
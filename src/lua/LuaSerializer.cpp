@@ -5,6 +5,16 @@
 #include "GameSaveError.h"
 #include "JsonUtils.h"
 #include "LuaObject.h"
+#include "base64/base64.hpp"
+#include <SDL_endian.h>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+
+//#define DEBUG_PICKLE_BENCH
 
 // every module can save one object. that will usually be a table.  we call
 // each serializer in turn and capture its return value we build a table like
@@ -591,6 +601,534 @@ void LuaSerializer::unpickle_json(lua_State *l, const Json &value)
 	LUA_DEBUG_END(l, 1);
 }
 
+// binary pickle format. this is what saved games use, the text and Json
+// pickles above are kept so older data can still be read (and LuaRef uses Json)
+//
+//   "LPK" then a version byte
+//   string table - Uint32 section length, Uint32 count, then each string as
+//                  a Uint32 length followed by its bytes
+//   values       - Uint32 section length, then a single pickled value
+//
+// each value begins with a type byte, numbers are little endian
+//   z        - nil
+//   T/F      - boolean true/false
+//   i        - number with an integral value, Sint32
+//   f        - any other number, double
+//   s        - string. Uint32 index into the string table
+//   t        - table. Sint64 id, then key/value pairs, then n
+//   r        - reference to a previously-seen table. Sint64 id
+//   o        - object. Uint32 string index of the class name, then one value
+//   u        - userdata. Uint32 length, then the LuaObject::Serialize data
+//
+// table ids are the same ones the Json pickle uses, so tables can be shared
+// with LuaRefs saved elsewhere in the game. each distinct string is written
+// once, and unpickling pushes strings straight out of the buffer.
+
+static const char BINARY_PICKLE_MAGIC[3] = { 'L', 'P', 'K' };
+static const char BINARY_PICKLE_VERSION = 1;
+
+struct LuaSerializer::BinaryWriter {
+	BinaryWriter() { payload.reserve(256 * 1024); }
+
+	void Byte(char c) { payload.push_back(c); }
+	void U32(Uint32 v)
+	{
+		v = SDL_SwapLE32(v);
+		payload.append(reinterpret_cast<const char *>(&v), sizeof(v));
+	}
+	void I64(Sint64 v)
+	{
+		const Uint64 u = SDL_SwapLE64(Uint64(v));
+		payload.append(reinterpret_cast<const char *>(&u), sizeof(u));
+	}
+	void F64(double d)
+	{
+		Uint64 u;
+		memcpy(&u, &d, sizeof(u));
+		u = SDL_SwapLE64(u);
+		payload.append(reinterpret_cast<const char *>(&u), sizeof(u));
+	}
+
+	Uint32 StringIndex(const char *str, size_t len)
+	{
+		auto it = stringIndex.find(std::string_view(str, len));
+		if (it != stringIndex.end())
+			return it->second;
+		// the Lua string may be collected before we're done, so keep a copy
+		strings.emplace_back(str, len);
+		const Uint32 idx = strings.size() - 1;
+		stringIndex.emplace(strings.back(), idx);
+		return idx;
+	}
+
+	std::string GetData() const
+	{
+		size_t tableSize = sizeof(Uint32);
+		for (const std::string &str : strings)
+			tableSize += sizeof(Uint32) + str.size();
+
+		std::string out;
+		out.reserve(sizeof(BINARY_PICKLE_MAGIC) + 1 + 2 * sizeof(Uint32) + tableSize + payload.size());
+		out.append(BINARY_PICKLE_MAGIC, sizeof(BINARY_PICKLE_MAGIC));
+		out.push_back(BINARY_PICKLE_VERSION);
+		auto appendU32 = [&out](Uint32 v) {
+			v = SDL_SwapLE32(v);
+			out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+		};
+		appendU32(tableSize);
+		appendU32(strings.size());
+		for (const std::string &str : strings) {
+			appendU32(str.size());
+			out.append(str);
+		}
+		appendU32(payload.size());
+		out.append(payload);
+		return out;
+	}
+
+	std::string payload;
+	std::deque<std::string> strings; // a deque, so the index keys never move
+	std::unordered_map<std::string_view, Uint32> stringIndex;
+	std::string key; // path to the value being pickled, for error messages
+};
+
+struct LuaSerializer::BinaryReader {
+	explicit BinaryReader(const std::string &data) :
+		pos(data.data()),
+		end(data.data() + data.size())
+	{
+		Need(sizeof(BINARY_PICKLE_MAGIC) + 1);
+		if (memcmp(pos, BINARY_PICKLE_MAGIC, sizeof(BINARY_PICKLE_MAGIC)) != 0 || pos[sizeof(BINARY_PICKLE_MAGIC)] != BINARY_PICKLE_VERSION)
+			throw SavedGameCorruptException();
+		pos += sizeof(BINARY_PICKLE_MAGIC) + 1;
+
+		const Uint32 tableSize = U32();
+		Need(tableSize);
+		const char *valuesStart = pos + tableSize;
+		const Uint32 count = U32();
+		if (count > tableSize / sizeof(Uint32))
+			throw SavedGameCorruptException();
+		strings.reserve(count);
+		for (Uint32 i = 0; i < count; i++) {
+			const Uint32 len = U32();
+			Need(len);
+			strings.emplace_back(pos, len);
+			pos += len;
+		}
+		if (pos != valuesStart)
+			throw SavedGameCorruptException();
+
+		if (U32() != Uint32(end - pos))
+			throw SavedGameCorruptException();
+	}
+
+	void Need(size_t n) const
+	{
+		if (size_t(end - pos) < n)
+			throw SavedGameCorruptException();
+	}
+	char Peek() const
+	{
+		Need(1);
+		return *pos;
+	}
+	char Byte()
+	{
+		Need(1);
+		return *pos++;
+	}
+	Uint32 U32()
+	{
+		Uint32 v;
+		Need(sizeof(v));
+		memcpy(&v, pos, sizeof(v));
+		pos += sizeof(v);
+		return SDL_SwapLE32(v);
+	}
+	Sint64 I64()
+	{
+		Uint64 v;
+		Need(sizeof(v));
+		memcpy(&v, pos, sizeof(v));
+		pos += sizeof(v);
+		return Sint64(SDL_SwapLE64(v));
+	}
+	double F64()
+	{
+		Uint64 v;
+		Need(sizeof(v));
+		memcpy(&v, pos, sizeof(v));
+		pos += sizeof(v);
+		v = SDL_SwapLE64(v);
+		double d;
+		memcpy(&d, &v, sizeof(d));
+		return d;
+	}
+	const std::string_view &String()
+	{
+		const Uint32 idx = U32();
+		if (idx >= strings.size())
+			throw SavedGameCorruptException();
+		return strings[idx];
+	}
+
+	const char *pos;
+	const char *end;
+	std::vector<std::string_view> strings; // point into the data
+};
+
+std::string LuaSerializer::pickle_binary(lua_State *l, int idx)
+{
+	PROFILE_SCOPED()
+	BinaryWriter out;
+	pickle_binary(l, idx, out);
+	return out.GetData();
+}
+
+void LuaSerializer::pickle_binary(lua_State *l, int to_serialize, BinaryWriter &out)
+{
+	LUA_DEBUG_START(l);
+
+	// tables are pickled recursively, so we can run out of Lua stack space if we're not careful
+	// start by ensuring we have enough (this grows the stack if necessary)
+	// (20 is somewhat arbitrary)
+	if (!lua_checkstack(l, 20))
+		luaL_error(l, "The Lua stack couldn't be extended (out of memory?)");
+
+	to_serialize = lua_absindex(l, to_serialize);
+	int idx = to_serialize;
+
+	if (lua_getmetatable(l, idx)) {
+		lua_getfield(l, -1, "class");
+		if (lua_isnil(l, -1))
+			lua_pop(l, 2);
+
+		else {
+			size_t len;
+			const char *cl = lua_tolstring(l, -1, &len);
+
+			lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerClasses");
+
+			lua_getfield(l, -1, cl);
+			if (lua_isnil(l, -1))
+				luaL_error(l, "No Serialize method found for class '%s'\n", cl);
+
+			lua_getfield(l, -1, "Serialize");
+			if (lua_isnil(l, -1))
+				luaL_error(l, "No Serialize method found for class '%s'\n", cl);
+
+			lua_pushvalue(l, idx);
+			pi_lua_protected_call(l, 1, 1);
+
+			idx = lua_gettop(l);
+
+			if (lua_isnil(l, idx)) {
+				out.Byte('z');
+				lua_pop(l, 5);
+				LUA_DEBUG_END(l, 0);
+				return;
+			}
+
+			out.Byte('o');
+			out.U32(out.StringIndex(cl, len));
+		}
+	}
+
+	switch (lua_type(l, idx)) {
+	case LUA_TNIL:
+		out.Byte('z');
+		break;
+
+	case LUA_TNUMBER: {
+		const double n = lua_tonumber(l, idx);
+		if (n >= double(SDL_MIN_SINT32) && n <= double(SDL_MAX_SINT32) && n == double(Sint32(n)) && !(n == 0.0 && std::signbit(n))) {
+			out.Byte('i');
+			out.U32(Uint32(Sint32(n)));
+		} else {
+			out.Byte('f');
+			out.F64(n);
+		}
+		break;
+	}
+
+	case LUA_TBOOLEAN:
+		out.Byte(lua_toboolean(l, idx) ? 'T' : 'F');
+		break;
+
+	case LUA_TSTRING: {
+		size_t len;
+		const char *str = lua_tolstring(l, idx, &len);
+		out.Byte('s');
+		out.U32(out.StringIndex(str, len));
+		break;
+	}
+
+	case LUA_TTABLE: {
+		const lua_Integer ptr = lua_Integer(lua_topointer(l, to_serialize));
+		lua_pushinteger(l, ptr); // ptr
+
+		lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs"); // ptr reftable
+		lua_pushvalue(l, -2); // ptr reftable ptr
+		lua_rawget(l, -2); // ptr reftable ???
+
+		if (!lua_isnil(l, -1)) {
+			out.Byte('r');
+			out.I64(ptr);
+			lua_pop(l, 3); // [empty]
+		} else {
+			out.Byte('t');
+			out.I64(ptr);
+
+			lua_pushvalue(l, -3); // ptr reftable nil ptr
+			lua_pushvalue(l, to_serialize); // ptr reftable nil ptr table
+			lua_rawset(l, -4); // ptr reftable nil
+			lua_pop(l, 3); // [empty]
+
+			lua_pushvalue(l, idx);
+			lua_pushnil(l);
+			while (lua_next(l, -2)) {
+				// extend the key path in place rather than building a new string per field
+				const size_t keyLen = out.key.size();
+				out.key += '.';
+				if (lua_type(l, -2) == LUA_TSTRING) {
+					size_t len;
+					const char *k = lua_tolstring(l, -2, &len);
+					out.key.append(k, len);
+				} else if (lua_type(l, -2) == LUA_TNUMBER) {
+					char buf[32];
+					snprintf(buf, sizeof(buf), "%g", lua_tonumber(l, -2));
+					out.key += buf;
+				} else {
+					out.key += '<';
+					out.key += lua_typename(l, lua_type(l, -2));
+					out.key += '>';
+				}
+
+				pickle_binary(l, -2, out);
+				pickle_binary(l, -1, out);
+				out.key.resize(keyLen);
+				lua_pop(l, 1);
+			}
+			lua_pop(l, 1);
+			out.Byte('n');
+		}
+
+		break;
+	}
+
+	case LUA_TUSERDATA: {
+		LuaObjectBase *lo = static_cast<LuaObjectBase *>(lua_touserdata(l, idx));
+		void *o = lo->GetObject();
+		if (!o)
+			Error("Lua serializer '%s' tried to serialize an invalid '%s' object", out.key.c_str(), lo->GetType());
+
+		const std::string data = lo->Serialize();
+		out.Byte('u');
+		out.U32(data.size());
+		out.payload.append(data);
+		break;
+	}
+
+	default:
+		Error("Lua serializer '%s' tried to serialize %s value", out.key.c_str(), lua_typename(l, lua_type(l, idx)));
+		break;
+	}
+
+	if (idx != to_serialize) // It means we called a transformation function on the data, so we clean it up.
+		lua_pop(l, 5);
+
+	LUA_DEBUG_END(l, 0);
+}
+
+void LuaSerializer::unpickle_binary(lua_State *l, const std::string &data)
+{
+	PROFILE_SCOPED()
+	BinaryReader in(data);
+	unpickle_binary(l, in);
+	if (in.pos != in.end) {
+		lua_pop(l, 1);
+		throw SavedGameCorruptException();
+	}
+}
+
+void LuaSerializer::unpickle_binary(lua_State *l, BinaryReader &in)
+{
+	LUA_DEBUG_START(l);
+
+	// tables are also unpickled recursively, so we can run out of Lua stack space if we're not careful
+	// start by ensuring we have enough (this grows the stack if necessary)
+	// (20 is somewhat arbitrary)
+	if (!lua_checkstack(l, 20))
+		luaL_error(l, "The Lua stack couldn't be extended (not enough memory?)");
+
+	switch (in.Byte()) {
+	case 'z':
+		lua_pushnil(l);
+		break;
+
+	case 'T':
+		lua_pushboolean(l, 1);
+		break;
+
+	case 'F':
+		lua_pushboolean(l, 0);
+		break;
+
+	case 'i':
+		lua_pushnumber(l, Sint32(in.U32()));
+		break;
+
+	case 'f':
+		lua_pushnumber(l, in.F64());
+		break;
+
+	case 's': {
+		const std::string_view &str = in.String();
+		lua_pushlstring(l, str.data(), str.size());
+		break;
+	}
+
+	case 't': {
+		const lua_Integer ptr = in.I64();
+		lua_newtable(l);
+
+		lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs"); // [t] [refs]
+		lua_pushinteger(l, ptr); // [t] [refs] [key]
+		lua_pushvalue(l, -3); // [t] [refs] [key] [t]
+		lua_rawset(l, -3); // [t] [refs]
+		lua_pop(l, 1); // [t]
+
+		while (in.Peek() != 'n') {
+			unpickle_binary(l, in);
+			unpickle_binary(l, in);
+			// an object whose serializer returned nil can't be a key
+			if (lua_isnil(l, -2))
+				lua_pop(l, 2);
+			else
+				lua_rawset(l, -3);
+		}
+		in.Byte();
+		break;
+	}
+
+	case 'r': {
+		const lua_Integer ptr = in.I64();
+		lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs"); // [refs]
+		lua_pushinteger(l, ptr); // [refs] [key]
+		lua_rawget(l, -2); // [refs] [out]
+		lua_remove(l, -2); // [out]
+
+		if (lua_isnil(l, -1)) {
+			lua_pop(l, 1);
+			throw SavedGameCorruptException();
+		}
+		break;
+	}
+
+	case 'u': {
+		const Uint32 len = in.U32();
+		in.Need(len);
+		const char *next;
+		if (!LuaObjectBase::Deserialize(in.pos, &next))
+			throw SavedGameCorruptException();
+		if (next != in.pos + len) {
+			lua_pop(l, 1);
+			throw SavedGameCorruptException();
+		}
+		in.pos = next;
+		break;
+	}
+
+	case 'o': {
+		const std::string_view &cl = in.String();
+
+		// If it is a reference, don't run the unserializer. It has either
+		// already been run, or the data is still building (cyclic
+		// references will do that to you.)
+		const bool isRef = in.Peek() == 'r';
+		unpickle_binary(l, in);
+		if (isRef)
+			break;
+
+		// get PiSerializerClasses[typename]
+		lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerClasses");
+		lua_pushlstring(l, cl.data(), cl.size());
+		lua_gettable(l, -2);
+		lua_remove(l, -2);
+
+		if (lua_isnil(l, -1)) {
+			lua_pop(l, 1);
+			break;
+		}
+
+		lua_getfield(l, -1, "Unserialize"); // [t] [klass] [klass.Unserialize]
+		if (lua_isnil(l, -1)) {
+			lua_pushlstring(l, cl.data(), cl.size());
+			luaL_error(l, "No Unserialize method found for class '%s'\n", lua_tostring(l, -1));
+		}
+
+		lua_insert(l, -3); // [klass.Unserialize] [t] [klass]
+		lua_pop(l, 1); // [klass.Unserialize] [t]
+
+		pi_lua_protected_call(l, 1, 1);
+		break;
+	}
+
+	default:
+		throw SavedGameCorruptException();
+	}
+
+	LUA_DEBUG_END(l, 1);
+}
+
+#ifdef DEBUG_PICKLE_BENCH
+// times each pickle format on the real save data. table ids are shared across
+// the whole save, so every run starts with empty refs and the real ones are put
+// back afterwards. note unpickling runs the classes' Unserialize functions.
+void LuaSerializer::BenchmarkPickle(lua_State *l, int savetable)
+{
+	LUA_DEBUG_START(l);
+	savetable = lua_absindex(l, savetable);
+
+	lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+	const int savedRefs = luaL_ref(l, LUA_REGISTRYINDEX);
+	auto resetRefs = [l]() {
+		lua_newtable(l);
+		lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+	};
+	auto time = [l, &resetRefs](const std::function<void()> &fn) {
+		resetRefs();
+		const int top = lua_gettop(l);
+		const Uint64 start = Profiler::Clock::getticks();
+		try {
+			fn();
+		} catch (SavedGameCorruptException &) {
+			Output("Lua pickle benchmark: unpickling failed\n");
+			lua_settop(l, top);
+		}
+		return Profiler::Clock::ms(Profiler::Clock::getticks() - start);
+	};
+
+	std::string text, binary;
+	std::vector<uint8_t> cbor;
+	const double textSave = time([&]() { pickle(l, savetable, text); });
+	const double jsonSave = time([&]() { Json json; pickle_json(l, savetable, json); cbor = Json::to_cbor(json); });
+	const double binarySave = time([&]() { binary = pickle_binary(l, savetable); });
+	const double textLoad = time([&]() { unpickle(l, text.c_str()); lua_pop(l, 1); });
+	const double jsonLoad = time([&]() { unpickle_json(l, Json::from_cbor(cbor)); lua_pop(l, 1); });
+	const double binaryLoad = time([&]() { unpickle_binary(l, binary); lua_pop(l, 1); });
+
+	lua_rawgeti(l, LUA_REGISTRYINDEX, savedRefs);
+	lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+	luaL_unref(l, LUA_REGISTRYINDEX, savedRefs);
+
+	Output("Lua pickle (save/load ms, bytes): text %.2f/%.2f " SIZET_FMT ", json+cbor %.2f/%.2f " SIZET_FMT ", binary %.2f/%.2f " SIZET_FMT "\n",
+		textSave, textLoad, text.size(), jsonSave, jsonLoad, cbor.size(), binarySave, binaryLoad, binary.size());
+
+	LUA_DEBUG_END(l, 0);
+}
+#endif
+
 void LuaSerializer::InitTableRefs()
 {
 	lua_State *l = Lua::manager->GetLuaState();
@@ -650,9 +1188,13 @@ void LuaSerializer::ToJson(Json &jsonObj)
 
 	lua_pop(l, 1);
 
-	Json pickled;
-	pickle_json(l, savetable, pickled);
-	jsonObj["lua_modules_json"] = pickled;
+#ifdef DEBUG_PICKLE_BENCH
+	BenchmarkPickle(l, savetable);
+#endif
+
+	std::string pickled;
+	Base64::Encode(pickle_binary(l, savetable), &pickled);
+	jsonObj["lua_modules_bin"] = std::move(pickled);
 
 	lua_pop(l, 1);
 
@@ -666,7 +1208,13 @@ void LuaSerializer::FromJson(const Json &jsonObj)
 
 	LUA_DEBUG_START(l);
 
-	if (jsonObj.count("lua_modules_json")) {
+	if (jsonObj.count("lua_modules_bin")) {
+		const Json &value = jsonObj["lua_modules_bin"];
+		std::string pickled;
+		if (!value.is_string() || !Base64::Decode(value.get_ref<const std::string &>(), &pickled))
+			throw SavedGameCorruptException();
+		unpickle_binary(l, pickled);
+	} else if (jsonObj.count("lua_modules_json")) {
 		const Json &value = jsonObj["lua_modules_json"];
 		if (!value.is_object()) {
 			throw SavedGameCorruptException();
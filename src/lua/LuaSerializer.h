@@ -30,6 +30,17 @@ private:
 
 	static void pickle_json(lua_State *l, int idx, Json &out, const std::string &key = "");
 	static void unpickle_json(lua_State *l, const Json &value);
+
+	// compact binary pickle, see LuaSerializer.cpp
+	struct BinaryWriter;
+	struct BinaryReader;
+	static std::string pickle_binary(lua_State *l, int idx);
+	static void unpickle_binary(lua_State *l, const std::string &data);
+	static void pickle_binary(lua_State *l, int idx, BinaryWriter &out);
+	static void unpickle_binary(lua_State *l, BinaryReader &in);
+
+	// compares the formats on the data being saved, only built with DEBUG_PICKLE_BENCH
+	static void BenchmarkPickle(lua_State *l, int savetable);
 };
 
 #endif
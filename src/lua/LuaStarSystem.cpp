@@ -7,6 +7,7 @@
 #include "GameSaveError.h"
 #include "LuaConstants.h"
 #include "LuaObject.h"
+#include "LuaSystemQuery.h"
 #include "LuaTable.h"
 #include "LuaUtils.h"
 #include "Pi.h"
@@ -292,6 +293,49 @@ static int l_starsystem_get_nearby_systems(lua_State *l)
 	return 1;
 }
 
+/*
+ * Method: FindSystems
+ *
+ * Find the systems near this one that match some criteria, without creating
+ * a <StarSystem> for every candidate like <GetNearbySystems> does.
+ *
+ * > paths, distances = system:FindSystems(range, filter)
+ *
+ * Parameters:
+ *
+ *   range - distance from this system to search, in light years
+ *
+ *   filter - an optional table of criteria, all of which must be met:
+ *
+ *     minPopulation - the minimum population, in billions
+ *     maxPopulation - the maximum population, in billions
+ *     explored - true for explored systems only, false for unexplored only
+ *     faction - a <Faction> or faction name the system must belong to
+ *     hasStations - true for systems with at least one space station only
+ *     includeSelf - true to include this system if it matches
+ *     sort - "distance" (nearest first) or "population" (most populous first)
+ *     limit - the maximum number of systems to return
+ *
+ * Return:
+ *
+ *   paths - an array of <SystemPaths> of the matching systems
+ *
+ *   distances - an array of the distances to each of them, in light years
+ *
+ * Availability:
+ *
+ *   2021
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_starsystem_find_systems(lua_State *l)
+{
+	const StarSystem *s = LuaObject<StarSystem>::CheckFromLua(1);
+	return LuaSystemQuery::FindSystems(l, s->GetPath());
+}
+
 static int l_starsystem_get_stars(lua_State *l)
 {
 	const StarSystem *s = LuaObject<StarSystem>::CheckFromLua(1);
@@ -696,6 +740,7 @@ void LuaObject<StarSystem>::RegisterClass()
 		{ "IsCommodityLegal", l_starsystem_is_commodity_legal },
 
 		{ "GetNearbySystems", l_starsystem_get_nearby_systems },
+		{ "FindSystems", l_starsystem_find_systems },
 
 		{ "DistanceTo", l_starsystem_distance_to },
 
@@ -3,6 +3,7 @@
 
 #include "Game.h"
 #include "LuaObject.h"
+#include "LuaSystemQuery.h"
 #include "LuaUtils.h"
 #include "Json.h"
 #include "Pi.h"
@@ -11,6 +12,7 @@
 #include "galaxy/Sector.h"
 #include "galaxy/StarSystem.h"
 #include "galaxy/SystemPath.h"
+#include <algorithm>
 
 /*
  * Class: SystemPath
@@ -34,11 +36,49 @@
  * same system without reference to their body indexes, use <IsSameSystem>.
  */
 
+// the most recently pushed paths, indexed by a hash of the path, so that
+// pushing the same path over and over (as the UI does every frame) doesn't
+// have to build a blob string to find it. the userdata are held by a registry
+// table at the same index
+static const size_t PATH_CACHE_SIZE = 256;
+static SystemPath s_pathCacheKeys[PATH_CACHE_SIZE];
+static bool s_pathCacheUsed[PATH_CACHE_SIZE];
+static const char s_pathCacheKey = 0;
+
+static size_t PathCacheSlot(const SystemPath &o)
+{
+	Uint32 h = Uint32(o.sectorX) * 73856093u;
+	h ^= Uint32(o.sectorY) * 19349663u;
+	h ^= Uint32(o.sectorZ) * 83492791u;
+	h ^= o.systemIndex * 2654435761u;
+	h ^= o.bodyIndex * 40503u;
+	return (h ^ (h >> 16)) & (PATH_CACHE_SIZE - 1);
+}
+
 template <>
 void LuaObject<SystemPath>::PushToLua(const SystemPath &o)
 {
 	lua_State *l = Lua::manager->GetLuaState();
 
+	// the cache table is gone if the Lua state was replaced
+	lua_rawgetp(l, LUA_REGISTRYINDEX, &s_pathCacheKey);
+	if (!lua_istable(l, -1)) {
+		lua_pop(l, 1);
+		lua_createtable(l, PATH_CACHE_SIZE, 0);
+		lua_pushvalue(l, -1);
+		lua_rawsetp(l, LUA_REGISTRYINDEX, &s_pathCacheKey);
+		std::fill(s_pathCacheUsed, s_pathCacheUsed + PATH_CACHE_SIZE, false);
+	}
+
+	// stack: [PathCache]
+
+	const size_t slot = PathCacheSlot(o);
+	if (s_pathCacheUsed[slot] && s_pathCacheKeys[slot] == o) {
+		lua_rawgeti(l, -1, slot + 1); // [PathCache value]
+		lua_replace(l, -2); // [value]
+		return;
+	}
+
 	// get the system path object cache
 	if (!luaL_getsubtable(l, LUA_REGISTRYINDEX, "SystemPaths")) {
 		lua_createtable(l, 0, 1);
@@ -47,32 +87,39 @@ void LuaObject<SystemPath>::PushToLua(const SystemPath &o)
 		lua_setmetatable(l, -2);
 	}
 
-	// stack: [SystemPaths]
+	// stack: [PathCache SystemPaths]
 
 	// push the system path as a blob to use as a key to look up the actual SystemPath object
 	char key_blob[SystemPath::SizeAsBlob];
 	o.SerializeToBlob(key_blob);
 
-	lua_pushlstring(l, key_blob, sizeof(key_blob)); // [SystemPaths key]
-	lua_pushvalue(l, -1); // [SystemPaths key key]
-	lua_rawget(l, -3); // [SystemPaths key value/nil]
+	lua_pushlstring(l, key_blob, sizeof(key_blob)); // [PathCache SystemPaths key]
+	lua_pushvalue(l, -1); // [PathCache SystemPaths key key]
+	lua_rawget(l, -3); // [PathCache SystemPaths key value/nil]
 	if (lua_isnil(l, -1)) {
-		// [SystemPaths key nil]
+		// [PathCache SystemPaths key nil]
 		lua_pop(l, 1);
 
 		// push a new Lua SystemPath object
-		Register(new (LuaObjectBase::Allocate(sizeof(LuaCopyObject<SystemPath>))) LuaCopyObject<SystemPath>(o));
+		RegisterCopy(new (LuaObjectBase::Allocate(sizeof(LuaCopyObject<SystemPath>))) LuaCopyObject<SystemPath>(o));
 
 		// store it in the SystemPaths cache, but keep a copy on the stack
-		lua_pushvalue(l, -1); // [SystemPaths  key  value  value]
-		lua_insert(l, -4); // [value SystemPaths key value]
-		lua_rawset(l, -3); // [value SystemPaths]
-		lua_pop(l, 1); // [value]
+		lua_pushvalue(l, -1); // [PathCache SystemPaths key value value]
+		lua_insert(l, -4); // [PathCache value SystemPaths key value]
+		lua_rawset(l, -3); // [PathCache value SystemPaths]
+		lua_pop(l, 1); // [PathCache value]
 	} else {
-		// [SystemPaths key value]
-		lua_insert(l, -3); // [value SystemPaths key]
-		lua_pop(l, 2); // [value]
+		// [PathCache SystemPaths key value]
+		lua_insert(l, -3); // [PathCache value SystemPaths key]
+		lua_pop(l, 2); // [PathCache value]
 	}
+
+	// replace whatever was in the slot
+	lua_pushvalue(l, -1); // [PathCache value value]
+	lua_rawseti(l, -3, slot + 1); // [PathCache value]
+	lua_replace(l, -2); // [value]
+	s_pathCacheKeys[slot] = o;
+	s_pathCacheUsed[slot] = true;
 }
 
 /*
@@ -320,6 +367,54 @@ static int l_sbodypath_distance_to(lua_State *l)
 	return 1;
 }
 
+/*
+ * Method: FindSystems
+ *
+ * Find the systems near this one that match some criteria. The search is
+ * done natively on the galaxy data, so it is much cheaper than visiting the
+ * systems from Lua.
+ *
+ * > paths, distances = path:FindSystems(range, filter)
+ *
+ * Example:
+ *
+ * > local paths = Game.system.path:FindSystems(20, { hasStations = true, sort = "distance", limit = 10 })
+ *
+ * Parameters:
+ *
+ *   range - distance from this system to search, in light years
+ *
+ *   filter - an optional table of criteria, all of which must be met:
+ *
+ *     minPopulation - the minimum population, in billions
+ *     maxPopulation - the maximum population, in billions
+ *     explored - true for explored systems only, false for unexplored only
+ *     faction - a <Faction> or faction name the system must belong to
+ *     hasStations - true for systems with at least one space station only
+ *     includeSelf - true to include this system if it matches
+ *     sort - "distance" (nearest first) or "population" (most populous first)
+ *     limit - the maximum number of systems to return
+ *
+ * Return:
+ *
+ *   paths - an array of <SystemPaths> of the matching systems
+ *
+ *   distances - an array of the distances to each of them, in light years
+ *
+ * Availability:
+ *
+ *   2021
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_sbodypath_find_systems(lua_State *l)
+{
+	const SystemPath *path = LuaObject<SystemPath>::CheckFromLua(1);
+	return LuaSystemQuery::FindSystems(l, *path);
+}
+
 /*
  * Method: GetStarSystem
  *
@@ -672,6 +767,7 @@ void LuaObject<SystemPath>::RegisterClass()
 		{ "SectorOnly", l_sbodypath_sector_only },
 
 		{ "DistanceTo", l_sbodypath_distance_to },
+		{ "FindSystems", l_sbodypath_find_systems },
 
 		{ "GetStarSystem", l_sbodypath_get_star_system },
 		{ "GetSystemBody", l_sbodypath_get_system_body },
@@ -0,0 +1,86 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaSystemQuery.h"
+#include "Game.h"
+#include "LuaObject.h"
+#include "LuaUtils.h"
+#include "Pi.h"
+#include "galaxy/Factions.h"
+#include "galaxy/Galaxy.h"
+#include "galaxy/SystemQuery.h"
+
+static SystemQuery::SortKey parse_sort_key(lua_State *l, const char *sort)
+{
+	if (!strcmp(sort, "distance"))
+		return SystemQuery::SORT_DISTANCE;
+	if (!strcmp(sort, "population"))
+		return SystemQuery::SORT_POPULATION;
+	luaL_error(l, "unknown sort key '%s'", sort);
+	return SystemQuery::SORT_NONE;
+}
+
+int LuaSystemQuery::FindSystems(lua_State *l, const SystemPath &centre)
+{
+	PROFILE_SCOPED()
+	LUA_DEBUG_START(l);
+
+	if (!Pi::game)
+		return luaL_error(l, "FindSystems() requires a game");
+	if (!centre.HasValidSystem())
+		return luaL_error(l, "FindSystems() self argument does not refer to a system");
+
+	const double radius = luaL_checknumber(l, 2);
+	RefCountedPtr<Galaxy> galaxy = Pi::game->GetGalaxy();
+	SystemQuery query(galaxy, centre, radius);
+
+	SystemQuery::Filter filter;
+	if (!lua_isnoneornil(l, 3)) {
+		luaL_checktype(l, 3, LUA_TTABLE);
+
+		lua_getfield(l, 3, "minPopulation");
+		if (!lua_isnil(l, -1)) {
+			filter.minPopulation = fixed::FromDouble(luaL_checknumber(l, -1));
+			filter.hasMinPopulation = true;
+		}
+		lua_getfield(l, 3, "maxPopulation");
+		if (!lua_isnil(l, -1)) {
+			filter.maxPopulation = fixed::FromDouble(luaL_checknumber(l, -1));
+			filter.hasMaxPopulation = true;
+		}
+		lua_getfield(l, 3, "explored");
+		if (!lua_isnil(l, -1))
+			filter.explored = lua_toboolean(l, -1) ? 1 : 0;
+		lua_getfield(l, 3, "faction");
+		if (lua_type(l, -1) == LUA_TSTRING)
+			filter.faction = galaxy->GetFactions()->GetFaction(lua_tostring(l, -1)); // unknown names match independent systems
+		else if (!lua_isnil(l, -1))
+			filter.faction = LuaObject<Faction>::CheckFromLua(-1);
+		lua_getfield(l, 3, "hasStations");
+		filter.hasStations = lua_toboolean(l, -1);
+		lua_getfield(l, 3, "includeSelf");
+		filter.includeCentre = lua_toboolean(l, -1);
+		lua_getfield(l, 3, "sort");
+		if (!lua_isnil(l, -1))
+			query.SetSort(parse_sort_key(l, luaL_checkstring(l, -1)));
+		lua_getfield(l, 3, "limit");
+		if (!lua_isnil(l, -1))
+			query.SetLimit(std::max(0, int(luaL_checkinteger(l, -1))));
+		lua_pop(l, 8);
+	}
+	query.SetFilter(filter);
+
+	const std::vector<SystemQuery::Result> &results = query.Run();
+
+	lua_createtable(l, results.size(), 0);
+	lua_createtable(l, results.size(), 0);
+	for (size_t i = 0; i < results.size(); i++) {
+		LuaObject<SystemPath>::PushToLua(results[i].path);
+		lua_rawseti(l, -3, i + 1);
+		lua_pushnumber(l, results[i].distance);
+		lua_rawseti(l, -2, i + 1);
+	}
+
+	LUA_DEBUG_END(l, 2);
+	return 2;
+}
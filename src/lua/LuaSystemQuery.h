@@ -0,0 +1,17 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUASYSTEMQUERY_H
+#define _LUASYSTEMQUERY_H
+
+#include <lua.hpp>
+
+class SystemPath;
+
+namespace LuaSystemQuery {
+	// shared implementation of SystemPath:FindSystems and StarSystem:FindSystems,
+	// takes the radius and optional filter table at stack positions 2 and 3
+	int FindSystems(lua_State *l, const SystemPath &centre);
+}
+
+#endif
@@ -7,6 +7,13 @@
 #include "LuaObject.h"
 #include "LuaUtils.h"
 #include "Pi.h"
+#include <algorithm>
+
+LuaTimer::LuaTimer() :
+	m_nextOrder(0),
+	m_generation(0)
+{
+}
 
 void LuaTimer::RemoveAll()
 {
@@ -14,55 +21,71 @@ void LuaTimer::RemoveAll()
 
 	lua_pushnil(l);
 	lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
+
+	m_timers.clear();
+	++m_generation;
+}
+
+void LuaTimer::Insert(lua_State *l, double at, double every)
+{
+	LUA_DEBUG_START(l);
+
+	lua_getfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
+	if (lua_isnil(l, -1)) {
+		lua_pop(l, 1);
+		lua_newtable(l);
+		lua_pushvalue(l, -1);
+		lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
+	}
+	lua_insert(l, -2);
+	const int ref = luaL_ref(l, -2);
+	lua_pop(l, 1);
+
+	m_timers.push_back({ at, every, m_nextOrder++, ref });
+	std::push_heap(m_timers.begin(), m_timers.end(), RunsLater());
+
+	LUA_DEBUG_END(l, -1);
 }
 
 void LuaTimer::Tick()
 {
+	PROFILE_SCOPED()
 	assert(Pi::game);
+
+	const double now = Pi::game->GetTime();
+	if (m_timers.empty() || m_timers.front().at > now)
+		return;
+
 	lua_State *l = Lua::manager->GetLuaState();
 
 	LUA_DEBUG_START(l);
 
 	lua_getfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
-	if (lua_isnil(l, -1)) {
-		lua_pop(l, 1);
-		LUA_DEBUG_END(l, 0);
-		return;
-	}
 	assert(lua_istable(l, -1));
 
-	double now = Pi::game->GetTime();
-
-	lua_pushnil(l);
-	while (lua_next(l, -2)) {
-		assert(lua_istable(l, -1));
+	const Uint32 generation = m_generation;
+	while (!m_timers.empty() && m_timers.front().at <= now) {
+		std::pop_heap(m_timers.begin(), m_timers.end(), RunsLater());
+		Timer timer = m_timers.back();
+		m_timers.pop_back();
 
-		lua_getfield(l, -1, "at");
-		double at = lua_tonumber(l, -1);
+		lua_rawgeti(l, -1, timer.ref);
+		pi_lua_protected_call(l, 0, 1);
+		const bool cancel = lua_toboolean(l, -1);
 		lua_pop(l, 1);
 
-		if (at <= now) {
-			lua_getfield(l, -1, "callback");
-			pi_lua_protected_call(l, 0, 1);
-			bool cancel = lua_toboolean(l, -1);
-			lua_pop(l, 1);
-
-			lua_getfield(l, -1, "every");
-			if (lua_isnil(l, -1) || cancel) {
-				lua_pop(l, 1);
-
-				lua_pushvalue(l, -2);
-				lua_pushnil(l);
-				lua_settable(l, -5);
-			} else {
-				double every = lua_tonumber(l, -1);
-				lua_pop(l, 1);
-
-				pi_lua_settable(l, "at", Pi::game->GetTime() + every);
-			}
+		// the callback removed every timer, including this one
+		if (generation != m_generation)
+			break;
+
+		if (timer.every <= 0.0 || cancel) {
+			luaL_unref(l, -1, timer.ref);
+		} else {
+			timer.at = Pi::game->GetTime() + timer.every;
+			timer.order = m_nextOrder++;
+			m_timers.push_back(timer);
+			std::push_heap(m_timers.begin(), m_timers.end(), RunsLater());
 		}
-
-		lua_pop(l, 1);
 	}
 	lua_pop(l, 1);
 
@@ -105,28 +128,6 @@ void LuaTimer::Tick()
  * underlying object exists before trying to use it.
  */
 
-static void _finish_timer_create(lua_State *l)
-{
-	lua_pushstring(l, "callback");
-	lua_pushvalue(l, 3);
-	lua_settable(l, -3);
-
-	lua_getfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
-	if (lua_isnil(l, -1)) {
-		lua_pop(l, 1);
-		lua_newtable(l);
-		lua_pushvalue(l, -1);
-		lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
-	}
-
-	lua_insert(l, -2);
-	lua_pushinteger(l, lua_rawlen(l, -2) + 1);
-	lua_insert(l, -2);
-	lua_settable(l, -3);
-
-	lua_pop(l, 1);
-}
-
 /*
  * Method: CallAt
  *
@@ -173,10 +174,8 @@ static int l_timer_call_at(lua_State *l)
 
 	LUA_DEBUG_START(l);
 
-	lua_newtable(l);
-	pi_lua_settable(l, "at", at);
-
-	_finish_timer_create(l);
+	lua_pushvalue(l, 3);
+	Pi::luaTimer->Insert(l, at, 0.0);
 
 	LUA_DEBUG_END(l, 0);
 
@@ -238,11 +237,8 @@ static int l_timer_call_every(lua_State *l)
 
 	LUA_DEBUG_START(l);
 
-	lua_newtable(l);
-	pi_lua_settable(l, "every", every);
-	pi_lua_settable(l, "at", Pi::game->GetTime() + every);
-
-	_finish_timer_create(l);
+	lua_pushvalue(l, 3);
+	Pi::luaTimer->Insert(l, Pi::game->GetTime() + every, every);
 
 	LUA_DEBUG_END(l, 0);
 
@@ -6,11 +6,38 @@
 
 #include "DeleteEmitter.h"
 #include "LuaManager.h"
+#include <vector>
 
+// The pending timers are kept in a min-heap ordered by the time they are due,
+// so a tick only looks at the timers that have to run. The Lua functions are
+// referenced from the PiTimerCallbacks registry table.
 class LuaTimer : public DeleteEmitter {
 public:
+	LuaTimer();
+
 	void Tick();
 	void RemoveAll();
+
+	// takes the function on the top of the stack. every is 0 for one-shot timers
+	void Insert(lua_State *l, double at, double every);
+
+private:
+	struct Timer {
+		double at;
+		double every;
+		Uint64 order; // timers due at the same time run in the order they were set
+		int ref;
+	};
+	struct RunsLater {
+		bool operator()(const Timer &a, const Timer &b) const
+		{
+			return a.at > b.at || (a.at == b.at && a.order > b.order);
+		}
+	};
+
+	std::vector<Timer> m_timers;
+	Uint64 m_nextOrder;
+	Uint32 m_generation; // bumped by RemoveAll
 };
 
 #endif
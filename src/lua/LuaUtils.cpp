@@ -243,3 +243,31 @@ void pi_lua_readonly_table_original(lua_State *l, int index)
 {
 	lua_getuservalue(l, index);
 }
+
+void pi_lua_setmetatable_key(lua_State *l, const void *key)
+{
+	lua_rawgetp(l, LUA_REGISTRYINDEX, key);
+	lua_setmetatable(l, -2);
+}
+
+void *pi_lua_testudata_key(lua_State *l, int index, const void *key)
+{
+	void *p = lua_touserdata(l, index);
+	if (!p || !lua_getmetatable(l, index))
+		return nullptr;
+	lua_rawgetp(l, LUA_REGISTRYINDEX, key);
+	if (!lua_rawequal(l, -1, -2))
+		p = nullptr;
+	lua_pop(l, 2);
+	return p;
+}
+
+void *pi_lua_checkudata_key(lua_State *l, int index, const void *key, const char *typeName)
+{
+	void *p = pi_lua_testudata_key(l, index, key);
+	if (!p) {
+		// let the library produce the usual error message
+		return luaL_checkudata(l, index, typeName);
+	}
+	return p;
+}
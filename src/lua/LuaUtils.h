@@ -68,6 +68,13 @@ void pi_lua_readonly_table_proxy(lua_State *l, int index);
 // pushes the underlying (read-write) table pointed to by the proxy at <index>
 void pi_lua_readonly_table_original(lua_State *l, int index);
 
+// like luaL_setmetatable/luaL_testudata/luaL_checkudata, for a metatable that
+// is also stored in the registry at a light userdata key, which is a lot
+// cheaper to look up than its name
+void pi_lua_setmetatable_key(lua_State *l, const void *key);
+void *pi_lua_testudata_key(lua_State *l, int index, const void *key);
+void *pi_lua_checkudata_key(lua_State *l, int index, const void *key, const char *typeName);
+
 bool pi_lua_import(lua_State *l, const std::string &importName, bool popImported = false);
 void pi_lua_import_recursive(lua_State *L, const std::string &importName);
 
@@ -263,6 +263,9 @@ static luaL_Reg l_vector_meta[] = {
 const char LuaVector::LibName[] = "Vector3";
 const char LuaVector::TypeName[] = "Vector3";
 
+// the metatable is also kept at this key, so it doesn't need looking up by name
+static const char s_metatableKey = 0;
+
 void LuaVector::Register(lua_State *L)
 {
 	LUA_DEBUG_START(L);
@@ -281,7 +284,7 @@ void LuaVector::Register(lua_State *L)
 	// hide the metatable to thwart crazy exploits
 	lua_pushboolean(L, 0);
 	lua_setfield(L, -2, "__metatable");
-	lua_pop(L, 1);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &s_metatableKey);
 
 	LUA_DEBUG_END(L, 0);
 }
@@ -289,16 +292,16 @@ void LuaVector::Register(lua_State *L)
 vector3d *LuaVector::PushNewToLua(lua_State *L)
 {
 	vector3d *ptr = static_cast<vector3d *>(lua_newuserdata(L, sizeof(vector3d)));
-	luaL_setmetatable(L, LuaVector::TypeName);
+	pi_lua_setmetatable_key(L, &s_metatableKey);
 	return ptr;
 }
 
 const vector3d *LuaVector::GetFromLua(lua_State *L, int idx)
 {
-	return static_cast<vector3d *>(luaL_testudata(L, idx, LuaVector::TypeName));
+	return static_cast<vector3d *>(pi_lua_testudata_key(L, idx, &s_metatableKey));
 }
 
 vector3d *LuaVector::CheckFromLua(lua_State *L, int idx)
 {
-	return static_cast<vector3d *>(luaL_checkudata(L, idx, LuaVector::TypeName));
+	return static_cast<vector3d *>(pi_lua_checkudata_key(L, idx, &s_metatableKey, LuaVector::TypeName));
 }
@@ -269,6 +269,9 @@ static luaL_Reg l_vector_meta[] = {
 const char LuaVector2::LibName[] = "Vector2";
 const char LuaVector2::TypeName[] = "Vector2";
 
+// the metatable is also kept at this key, so it doesn't need looking up by name
+static const char s_metatableKey = 0;
+
 void LuaVector2::Register(lua_State *L)
 {
 	LUA_DEBUG_START(L);
@@ -287,7 +290,7 @@ void LuaVector2::Register(lua_State *L)
 	// hide the metatable to thwart crazy exploits
 	lua_pushboolean(L, 0);
 	lua_setfield(L, -2, "__metatable");
-	lua_pop(L, 1);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &s_metatableKey);
 
 	LUA_DEBUG_END(L, 0);
 }
@@ -295,16 +298,16 @@ void LuaVector2::Register(lua_State *L)
 vector2d *LuaVector2::PushNewToLua(lua_State *L)
 {
 	vector2d *ptr = static_cast<vector2d *>(lua_newuserdata(L, sizeof(vector2d)));
-	luaL_setmetatable(L, LuaVector2::TypeName);
+	pi_lua_setmetatable_key(L, &s_metatableKey);
 	return ptr;
 }
 
 const vector2d *LuaVector2::GetFromLua(lua_State *L, int idx)
 {
-	return static_cast<vector2d *>(luaL_testudata(L, idx, LuaVector2::TypeName));
+	return static_cast<vector2d *>(pi_lua_testudata_key(L, idx, &s_metatableKey));
 }
 
 vector2d *LuaVector2::CheckFromLua(lua_State *L, int idx)
 {
-	return static_cast<vector2d *>(luaL_checkudata(L, idx, LuaVector2::TypeName));
+	return static_cast<vector2d *>(pi_lua_checkudata_key(L, idx, &s_metatableKey, LuaVector2::TypeName));
 }
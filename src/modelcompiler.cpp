@@ -28,6 +28,7 @@
 #include "scenegraph/BinaryConverter.h"
 #include "scenegraph/DumpVisitor.h"
 #include "scenegraph/FindNodeVisitor.h"
+#include <set>
 #include <sstream>
 
 std::unique_ptr<GameConfig> s_config;
@@ -146,12 +147,54 @@ void RunCompiler(const std::string &modelName, const std::string &filepath, cons
 	Output("Compiling \"%s\" took: %lf\n", modelName.c_str(), timer.millicycles());
 }
 
+// loads every model the way the game does, .sgm first, and keeps them all
+// loaded. for comparing load time and memory use between model formats
+void RunLoadTest()
+{
+	PROFILE_SCOPED()
+	std::set<std::string> names;
+	for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "models", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+		const FileSystem::FileInfo &info = files.Current();
+		if (!info.IsFile())
+			continue;
+		const std::string &name = info.GetName();
+		if (ends_with_ci(name, ".model"))
+			names.insert(name.substr(0, name.size() - 6));
+		else if (ends_with_ci(name, ".sgm"))
+			names.insert(name.substr(0, name.size() - 4));
+	}
+
+	const size_t startMemory = OS::GetPeakMemoryUsage();
+	std::vector<std::unique_ptr<SceneGraph::Model>> models;
+	Profiler::Clock total;
+	total.Start();
+	for (const std::string &name : names) {
+		Profiler::Clock timer;
+		timer.Start();
+		try {
+			SceneGraph::Loader ld(s_renderer.get());
+			models.emplace_back(ld.LoadModel(name));
+		} catch (...) {
+			Output("%s: failed to load\n", name.c_str());
+			continue;
+		}
+		timer.Stop();
+		Output("%s: %.2fms\n", name.c_str(), timer.milliseconds());
+	}
+	total.Stop();
+
+	const size_t peakMemory = OS::GetPeakMemoryUsage();
+	Output("loaded " SIZET_FMT " of " SIZET_FMT " models in %.1fms\n", models.size(), names.size(), total.milliseconds());
+	Output("peak resident memory: %.1fMB (%.1fMB before loading)\n", peakMemory / (1024.0 * 1024.0), startMemory / (1024.0 * 1024.0));
+}
+
 // ********************************************************************************
 // functions
 // ********************************************************************************
 enum RunMode {
 	MODE_MODELCOMPILER = 0,
 	MODE_MODELBATCHEXPORT,
+	MODE_LOADTEST,
 	MODE_VERSION,
 	MODE_USAGE,
 	MODE_USAGE_ERROR
@@ -186,6 +229,11 @@ extern "C" int main(int argc, char **argv)
 			goto start;
 		}
 
+		if (modeopt == "load" || modeopt == "l") {
+			mode = MODE_LOADTEST;
+			goto start;
+		}
+
 		if (modeopt == "version" || modeopt == "v") {
 			mode = MODE_VERSION;
 			goto start;
@@ -299,6 +347,12 @@ start:
 		break;
 	}
 
+	case MODE_LOADTEST: {
+		SetupRenderer();
+		RunLoadTest();
+		break;
+	}
+
 	case MODE_VERSION: {
 		std::string version(PIONEER_VERSION);
 		if (strlen(PIONEER_EXTRAVERSION)) version += " (" PIONEER_EXTRAVERSION ")";
@@ -318,6 +372,7 @@ start:
 			"    -compile inplace  [-c ... inplace]  model compiler\n"
 			"    -batch            [-b]              batch mode output into users home/Pioneer directory\n"
 			"    -batch inplace    [-b inplace]      batch mode output into the source folder\n"
+			"    -load             [-l]              load all models, report the time and peak memory\n"
 			"    -version          [-v]              show version\n"
 			"    -help             [-h,-?]           this help\n");
 		break;
@@ -22,8 +22,7 @@ namespace PiGui {
 			unsigned int pattern = 0;
 			if (lua_gettop(l) > 3 && !lua_isnoneornil(l, 4))
 				pattern = luaL_checkinteger(l, 4) - 1; // Lua counts from 1
-			SceneGraph::Model *model = Pi::FindModel(name);
-			obj->SetModel(model, *skin, pattern);
+			obj->SetModel(name, *skin, pattern);
 
 			return 0;
 		}
@@ -2,6 +2,7 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "pigui/ModelSpinner.h"
+#include "ModelCache.h"
 #include "Pi.h"
 #include "PiGui.h"
 #include "graphics/RenderTarget.h"
@@ -12,6 +13,7 @@
 using namespace PiGui;
 
 ModelSpinner::ModelSpinner() :
+	m_pendingPattern(0),
 	m_pauseTime(.0f),
 	m_rot(vector2f(DEG2RAD(-15.0), DEG2RAD(180.0)))
 {
@@ -45,6 +47,41 @@ void ModelSpinner::SetModel(SceneGraph::Model *model, const SceneGraph::ModelSki
 	skin.Apply(m_model.get());
 	m_model->SetPattern(pattern);
 	m_shields.reset(new Shields(model));
+	m_pendingModel.clear();
+}
+
+void ModelSpinner::SetModel(const std::string &name, const SceneGraph::ModelSkin &skin, unsigned int pattern)
+{
+	m_skin = skin;
+	m_pendingModel = name;
+	m_pendingPattern = pattern;
+	m_model.reset();
+	m_shields.reset();
+	UpdatePendingModel();
+}
+
+void ModelSpinner::UpdatePendingModel()
+{
+	SceneGraph::Model *model;
+	try {
+		model = Pi::modelCache->GetModelIfReady(m_pendingModel);
+	} catch (const ModelCache::ModelNotFoundException &) {
+		// shows the error model
+		model = Pi::FindModel(m_pendingModel);
+	}
+
+	if (model) {
+		SetModel(model, m_skin, m_pendingPattern);
+		return;
+	}
+
+	if (!m_model) {
+		SceneGraph::Model *placeholder = Pi::modelCache->GetPlaceholder(m_pendingModel);
+		if (placeholder) {
+			m_model.reset(placeholder->MakeInstance());
+			m_model->SetDebugFlags(SceneGraph::Model::DEBUG_BBOX);
+		}
+	}
 }
 
 void ModelSpinner::Render()
@@ -63,6 +100,13 @@ void ModelSpinner::Render()
 	r->SetClearColor(Color(0, 0, 0, 0));
 	r->ClearScreen();
 
+	if (!m_pendingModel.empty())
+		UpdatePendingModel();
+	if (!m_model) {
+		r->SetRenderTarget(0);
+		return;
+	}
+
 	const float fov = 45.f;
 	r->SetPerspectiveProjection(fov, m_size.x / m_size.y, 1.f, 10000.f);
 	r->SetTransform(matrix4x4f::Identity());
@@ -32,6 +32,10 @@ namespace PiGui {
 		// Set the ship we should be looking at.
 		void SetModel(SceneGraph::Model *model, const SceneGraph::ModelSkin &skin, unsigned int pattern);
 
+		// Set the ship by name. It's loaded in the background, and its
+		// bounding box is shown once that is known.
+		void SetModel(const std::string &name, const SceneGraph::ModelSkin &skin, unsigned int pattern);
+
 		// Called to draw the model to the render target.
 		void Render();
 
@@ -59,6 +63,11 @@ namespace PiGui {
 
 		void CreateRenderTarget();
 		ImTextureID GetTextureID();
+		void UpdatePendingModel();
+
+		// the model being loaded, with the pattern to show it in
+		std::string m_pendingModel;
+		unsigned int m_pendingPattern;
 
 		// The size of the render target.
 		vector2f m_size;
@@ -12,6 +12,7 @@
 #include "graphics/Stats.h"
 #include "graphics/Texture.h"
 #include "lua/Lua.h"
+#include "lua/LuaEvent.h"
 #include "lua/LuaManager.h"
 #include "scenegraph/Model.h"
 #include "text/TextureFont.h"
@@ -216,6 +217,24 @@ void PerfInfo::DrawPerfWindow()
 				ImGui::EndTabItem();
 			}
 
+			if (ImGui::BeginTabItem("Lua Events")) {
+				DrawLuaEventStats();
+				ImGui::EndTabItem();
+			}
+
+			if (ImGui::BeginTabItem("Lua GC")) {
+				const LuaManager::GCSettings &gc = ::Lua::manager->GetGCSettings();
+				ImGui::Text("%s collector, pause %d%%, step multiplier %d%%, frame budget %.2f ms",
+					gc.generational ? "Generational" : "Incremental", gc.pause, gc.stepMul, gc.frameBudgetMs);
+				DrawStatList(::Lua::manager->GetStats().GetFrameStats());
+				ImGui::EndTabItem();
+			}
+
+			if (ImGui::BeginTabItem("Lua Profiler")) {
+				DrawLuaProfiler();
+				ImGui::EndTabItem();
+			}
+
 			if (false && ImGui::BeginTabItem("Input")) {
 				DrawInputDebug();
 				ImGui::EndTabItem();
@@ -425,6 +444,135 @@ void PerfInfo::DrawImGuiStats()
 	}
 }
 
+void PerfInfo::DrawLuaEventStats()
+{
+	std::vector<LuaEvent::EventStats> stats = LuaEvent::GetStats();
+	std::sort(stats.begin(), stats.end(), [](const LuaEvent::EventStats &a, const LuaEvent::EventStats &b) {
+		return a.ticks > b.ticks;
+	});
+
+	if (ImGui::Button("Reset Counters"))
+		LuaEvent::ResetStats();
+
+	ImGui::BeginChild("LuaEvents");
+	ImGui::Columns(6);
+	ImGui::TextUnformatted("Event");
+	ImGui::NextColumn();
+	ImGui::TextUnformatted("Handlers");
+	ImGui::NextColumn();
+	ImGui::TextUnformatted("Queued");
+	ImGui::NextColumn();
+	ImGui::TextUnformatted("Dropped");
+	ImGui::NextColumn();
+	ImGui::TextUnformatted("Dispatched");
+	ImGui::NextColumn();
+	ImGui::TextUnformatted("Time (ms)");
+	ImGui::NextColumn();
+	ImGui::Separator();
+	for (const LuaEvent::EventStats &ev : stats) {
+		if (!ev.queued)
+			continue;
+		ImGui::TextUnformatted(ev.name.c_str());
+		ImGui::NextColumn();
+		ImGui::Text("%u", ev.handlers);
+		ImGui::NextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(ev.queued));
+		ImGui::NextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(ev.dropped));
+		ImGui::NextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(ev.dispatched));
+		ImGui::NextColumn();
+		ImGui::Text("%.3f", Profiler::Clock::ms(ev.ticks));
+		ImGui::NextColumn();
+	}
+	ImGui::Columns();
+	ImGui::EndChild();
+}
+
+void PerfInfo::DrawLuaProfiler()
+{
+	LuaProfiler &profiler = ::Lua::manager->GetProfiler();
+	lua_State *l = ::Lua::manager->GetLuaState();
+
+	if (ImGui::Button(profiler.IsRunning() ? "Stop" : "Start")) {
+		if (profiler.IsRunning())
+			profiler.Stop(l);
+		else
+			profiler.Start(l);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Reset"))
+		profiler.Reset();
+	ImGui::SameLine();
+	if (ImGui::Button("Dump to File")) {
+		std::string filename;
+		if (profiler.Dump(filename))
+			Output("Lua profile written to %s\n", filename.c_str());
+		else
+			Output("Could not write Lua profile to %s\n", filename.c_str());
+	}
+
+	const std::vector<LuaProfiler::ModuleStats> modules = profiler.GetModuleStats();
+	const std::vector<LuaProfiler::FunctionStats> functions = profiler.GetFunctionStats();
+
+	ImGui::BeginChild("LuaProfiler");
+	if (ImGui::CollapsingHeader("Modules", ImGuiTreeNodeFlags_DefaultOpen)) {
+		ImGui::Columns(4, "LuaProfilerModules");
+		ImGui::TextUnformatted("Module");
+		ImGui::NextColumn();
+		ImGui::TextUnformatted("Calls");
+		ImGui::NextColumn();
+		ImGui::TextUnformatted("Self (ms)");
+		ImGui::NextColumn();
+		ImGui::TextUnformatted("Allocated (KB)");
+		ImGui::NextColumn();
+		ImGui::Separator();
+		for (const LuaProfiler::ModuleStats &m : modules) {
+			ImGui::TextUnformatted(m.name.c_str());
+			ImGui::NextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(m.calls));
+			ImGui::NextColumn();
+			ImGui::Text("%.3f", Profiler::Clock::ms(m.selfTicks));
+			ImGui::NextColumn();
+			ImGui::Text("%.1f", m.bytes / 1024.0);
+			ImGui::NextColumn();
+		}
+		ImGui::Columns();
+	}
+
+	if (ImGui::CollapsingHeader("Functions", ImGuiTreeNodeFlags_DefaultOpen)) {
+		// the full list is in the file dump
+		const size_t MAX_FUNCTIONS = 100;
+		ImGui::Columns(5, "LuaProfilerFunctions");
+		ImGui::TextUnformatted("Function");
+		ImGui::NextColumn();
+		ImGui::TextUnformatted("Calls");
+		ImGui::NextColumn();
+		ImGui::TextUnformatted("Self (ms)");
+		ImGui::NextColumn();
+		ImGui::TextUnformatted("Total (ms)");
+		ImGui::NextColumn();
+		ImGui::TextUnformatted("Allocated (KB)");
+		ImGui::NextColumn();
+		ImGui::Separator();
+		for (size_t i = 0; i < std::min(functions.size(), MAX_FUNCTIONS); i++) {
+			const LuaProfiler::FunctionStats &fn = functions[i];
+			ImGui::TextUnformatted(fn.name.c_str());
+			ImGui::NextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(fn.calls));
+			ImGui::NextColumn();
+			ImGui::Text("%.3f", Profiler::Clock::ms(fn.selfTicks));
+			ImGui::NextColumn();
+			ImGui::Text("%.3f", Profiler::Clock::ms(fn.totalTicks));
+			ImGui::NextColumn();
+			ImGui::Text("%.1f", fn.bytes / 1024.0);
+			ImGui::NextColumn();
+		}
+		ImGui::Columns();
+	}
+	ImGui::EndChild();
+}
+
 void PerfInfo::DrawStatList(const Perf::Stats::FrameInfo &fi)
 {
 	ImGui::BeginChild("FrameInfo");
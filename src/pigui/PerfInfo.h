@@ -39,6 +39,8 @@ namespace PiGui {
 		void DrawRendererStats();
 		void DrawWorldViewStats();
 		void DrawImGuiStats();
+		void DrawLuaEventStats();
+		void DrawLuaProfiler();
 		void DrawInputDebug();
 		void DrawStatList(const Perf::Stats::FrameInfo &fi);
 
@@ -6,6 +6,8 @@
 #include "libs.h"
 #include "utils.h"
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -189,6 +191,40 @@ namespace FileSystem {
 		return RefCountedPtr<FileData>(0);
 	}
 
+	class FileDataMapped : public FileData {
+	public:
+		FileDataMapped(const FileInfo &info, size_t size, char *data) :
+			FileData(info, size, data) {}
+		virtual ~FileDataMapped() { munmap(m_data, m_size); }
+	};
+
+	RefCountedPtr<FileData> FileSourceFS::MapFile(const std::string &path)
+	{
+		const std::string fullpath = JoinPathBelow(GetRoot(), path);
+		Time::DateTime mtime;
+
+		FileInfo::FileType ty = stat_path(fullpath.c_str(), mtime);
+		if (ty != FileInfo::FT_FILE)
+			return RefCountedPtr<FileData>(0);
+
+		const int fd = open(fullpath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return RefCountedPtr<FileData>(0);
+
+		struct stat st;
+		void *data = MAP_FAILED;
+		// empty files can't be mapped
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+			data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// the mapping keeps its own reference to the file
+		close(fd);
+
+		if (data == MAP_FAILED)
+			return ReadFile(path);
+
+		return RefCountedPtr<FileData>(new FileDataMapped(MakeFileInfo(path, ty, mtime), st.st_size, static_cast<char *>(data)));
+	}
+
 	bool FileSourceFS::ReadDirectory(const std::string &dirpath, std::vector<FileInfo> &output)
 	{
 		const std::string fulldirpath = JoinPathBelow(GetRoot(), dirpath);
@@ -269,4 +305,17 @@ namespace FileSystem {
 		const std::string fullpath = JoinPathBelow(GetRoot(), path);
 		return fopen(fullpath.c_str(), (flags & WRITE_TEXT) ? "w" : "wb");
 	}
+
+	bool FileSourceFS::RenameFile(const std::string &from, const std::string &to)
+	{
+		const std::string fullfrom = JoinPathBelow(GetRoot(), from);
+		const std::string fullto = JoinPathBelow(GetRoot(), to);
+		return rename(fullfrom.c_str(), fullto.c_str()) == 0;
+	}
+
+	bool FileSourceFS::RemoveFile(const std::string &path)
+	{
+		const std::string fullpath = JoinPathBelow(GetRoot(), path);
+		return remove(fullpath.c_str()) == 0;
+	}
 } // namespace FileSystem
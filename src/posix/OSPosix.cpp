@@ -8,6 +8,7 @@
 
 #include <SDL.h>
 #include <fenv.h>
+#include <sys/resource.h>
 #include <sys/time.h>
 #if defined(__APPLE__)
 #include <sys/param.h>
@@ -81,6 +82,18 @@ namespace OS {
 #endif
 	}
 
+	size_t GetPeakMemoryUsage()
+	{
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#if defined(__APPLE__)
+		return size_t(usage.ru_maxrss); // bytes
+#else
+		return size_t(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+	}
+
 	const std::string GetOSInfoString()
 	{
 		int z;
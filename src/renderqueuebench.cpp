@@ -0,0 +1,250 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// Standalone check and benchmark for the render queue. Records draws,
+// sorts them and replays them on the dummy renderer, which keeps the draws
+// it is given: they must come out in the expected order, with the
+// transform, lights and material parameters they were recorded with, and
+// the renderer's own state must be restored afterwards. Then times
+// recording, sorting and submitting a frame's worth of draws.
+
+#include "libs.h"
+
+#include "graphics/RenderQueue.h"
+#include "graphics/RenderState.h"
+#include "graphics/VertexBuffer.h"
+#include "graphics/dummy/RendererDummy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace Graphics;
+
+struct Expected {
+	const Material *material;
+	float depth;
+	Color diffuse;
+	Uint32 numLights;
+	Color ambient;
+};
+
+static matrix4x4f At(float depth)
+{
+	return matrix4x4f::Translation(0.0f, 0.0f, -depth);
+}
+
+static int s_failures = 0;
+
+static void Fail(const char *test, size_t draw, const char *what)
+{
+	printf("%s: draw " SIZET_FMT ": %s\n", test, draw, what);
+	++s_failures;
+}
+
+// submits the queue to a renderer in a known state, then checks the draws
+// against the expected ones and that the state is back as it was
+static void Replay(const char *test, RendererDummy &r, RenderQueue &queue, const std::vector<Expected> &expected)
+{
+	const matrix4x4f transform = At(-1.0f);
+	const Light light(Light::LIGHT_DIRECTIONAL, vector3f(0.0f, 1.0f, 0.0f), Color::WHITE, Color::WHITE);
+	const Color ambient(10, 20, 30, 255);
+	r.SetTransform(transform);
+	r.SetLights(1, &light);
+	r.SetAmbientColor(ambient);
+
+	r.SetRecordDrawCalls(true);
+	queue.Submit(&r);
+	const std::vector<RendererDummy::DrawCall> draws = r.GetDrawCalls();
+	r.SetRecordDrawCalls(false);
+
+	if (draws.size() != expected.size()) {
+		printf("%s: " SIZET_FMT " draws submitted, expected " SIZET_FMT "\n", test, draws.size(), expected.size());
+		++s_failures;
+	}
+	for (size_t i = 0; i < std::min(draws.size(), expected.size()); i++) {
+		const RendererDummy::DrawCall &draw = draws[i];
+		const Expected &exp = expected[i];
+		const matrix4x4f expTransform = At(exp.depth);
+		if (draw.material != exp.material || memcmp(&draw.transform, &expTransform, sizeof(matrix4x4f)) != 0)
+			Fail(test, i, "out of order");
+		if (!(draw.diffuse == exp.diffuse))
+			Fail(test, i, "wrong material parameters");
+		if (draw.numLights != exp.numLights)
+			Fail(test, i, "wrong number of lights");
+		if (!(draw.ambient == exp.ambient))
+			Fail(test, i, "wrong ambient colour");
+	}
+
+	const matrix4x4f after = r.GetTransform();
+	if (memcmp(&after, &transform, sizeof(matrix4x4f)) != 0)
+		Fail(test, draws.size(), "transform not restored");
+	if (r.GetNumLights() != 1 || !(r.GetLight(0).GetDiffuse() == light.GetDiffuse()))
+		Fail(test, draws.size(), "lights not restored");
+	if (!(r.GetAmbientColor() == ambient))
+		Fail(test, draws.size(), "ambient colour not restored");
+
+	printf("%-24s " SIZET_FMT " draws\n", test, draws.size());
+	queue.Clear();
+}
+
+int main(int argc, char **argv)
+{
+	int numDraws = 5000;
+	int frames = 200;
+	if (argc > 1)
+		numDraws = std::max(1, atoi(argv[1]));
+	if (argc > 2)
+		frames = std::max(1, atoi(argv[2]));
+
+	RendererDummy r;
+
+	VertexBufferDesc vbd;
+	vbd.attrib[0].semantic = ATTRIB_POSITION;
+	vbd.attrib[0].format = ATTRIB_FORMAT_FLOAT3;
+	vbd.numVertices = 3;
+	vbd.usage = BUFFER_USAGE_STATIC;
+	RefCountedPtr<VertexBuffer> vb(r.CreateVertexBuffer(vbd));
+
+	RenderStateDesc rsd;
+	std::unique_ptr<RenderState> solid(r.CreateRenderState(rsd));
+	rsd.blendMode = BLEND_ALPHA;
+	rsd.depthWrite = false;
+	std::unique_ptr<RenderState> blended(r.CreateRenderState(rsd));
+
+	MaterialDescriptor desc;
+	RefCountedPtr<Material> m0(r.CreateMaterial(desc));
+	RefCountedPtr<Material> m1(r.CreateMaterial(desc));
+	RefCountedPtr<Material> m2(r.CreateMaterial(desc));
+	desc.lighting = true;
+	RefCountedPtr<Material> lit(r.CreateMaterial(desc));
+
+	const Light sun(Light::LIGHT_DIRECTIONAL, vector3f(1.0f, 0.0f, 0.0f), Color::YELLOW, Color::WHITE);
+	const Light lamps[2] = {
+		Light(Light::LIGHT_POINT, vector3f(0.0f, 0.0f, 5.0f), Color::RED, Color::WHITE),
+		Light(Light::LIGHT_POINT, vector3f(0.0f, 5.0f, 0.0f), Color::BLUE, Color::WHITE),
+	};
+	const Color gray(40, 40, 40, 255);
+	const Color dark(5, 5, 5, 255);
+
+	RenderQueue queue;
+
+	// solid draws grouped by material, nearest first, then the transparent
+	// ones furthest first
+	queue.SetLights(1, &sun);
+	queue.SetAmbientColor(gray);
+	queue.SetPass(RenderQueue::PASS_SOLID);
+	queue.SetTransform(At(10.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), m0.Get());
+	queue.SetTransform(At(5.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), m1.Get());
+	queue.SetTransform(At(2.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), m0.Get());
+	queue.SetPass(RenderQueue::PASS_TRANSPARENT);
+	queue.SetTransform(At(3.0f));
+	queue.DrawBuffer(vb.Get(), blended.get(), m2.Get());
+	queue.SetTransform(At(20.0f));
+	queue.DrawBuffer(vb.Get(), blended.get(), m2.Get());
+	queue.Sort();
+	Replay("sorted", r, queue, {
+		{ m0.Get(), 2.0f, m0->diffuse, 1, gray },
+		{ m0.Get(), 10.0f, m0->diffuse, 1, gray },
+		{ m1.Get(), 5.0f, m1->diffuse, 1, gray },
+		{ m2.Get(), 20.0f, m2->diffuse, 1, gray },
+		{ m2.Get(), 3.0f, m2->diffuse, 1, gray },
+	});
+
+	// without Sort the draws are replayed as recorded
+	queue.SetLights(1, &sun);
+	queue.SetAmbientColor(gray);
+	queue.SetPass(RenderQueue::PASS_SOLID);
+	queue.SetTransform(At(10.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), m1.Get());
+	queue.SetTransform(At(5.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), m0.Get());
+	Replay("recorded order", r, queue, {
+		{ m1.Get(), 10.0f, m1->diffuse, 1, gray },
+		{ m0.Get(), 5.0f, m0->diffuse, 1, gray },
+	});
+
+	// a shared material changed between draws is drawn with what it had
+	// when each draw was recorded
+	queue.SetLights(1, &sun);
+	queue.SetAmbientColor(gray);
+	queue.SetPass(RenderQueue::PASS_SOLID);
+	m0->diffuse = Color::RED;
+	queue.SetTransform(At(8.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), m0.Get());
+	m0->diffuse = Color::BLUE;
+	queue.SetTransform(At(4.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), m0.Get());
+	m0->diffuse = Color::WHITE;
+	queue.Sort();
+	Replay("material parameters", r, queue, {
+		{ m0.Get(), 4.0f, Color::BLUE, 1, gray },
+		{ m0.Get(), 8.0f, Color::RED, 1, gray },
+	});
+
+	// each draw gets its own lights, none included
+	queue.SetPass(RenderQueue::PASS_SOLID);
+	queue.SetLights(2, lamps);
+	queue.SetAmbientColor(gray);
+	queue.SetTransform(At(1.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), lit.Get());
+	queue.SetLights(0, nullptr);
+	queue.SetAmbientColor(dark);
+	queue.SetTransform(At(2.0f));
+	queue.DrawBuffer(vb.Get(), solid.get(), lit.Get());
+	Replay("lights", r, queue, {
+		{ lit.Get(), 1.0f, lit->diffuse, 2, gray },
+		{ lit.Get(), 2.0f, lit->diffuse, 0, dark },
+	});
+
+	// timing: a frame of draws over a few dozen materials and light sets
+	std::vector<RefCountedPtr<Material>> materials;
+	for (int i = 0; i < 48; i++)
+		materials.emplace_back(r.CreateMaterial(desc));
+	std::vector<float> depths(numDraws);
+	for (float &depth : depths)
+		depth = 1.0f + float(rand() % 100000) * 0.1f;
+
+	double recordNs = 0.0, sortNs = 0.0, submitNs = 0.0;
+	for (int f = 0; f < frames; f++) {
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < numDraws; i++) {
+			if (i % 64 == 0) {
+				queue.SetLights(1 + (i / 64) % 2, lamps);
+				queue.SetPass(i % 8 == 0 ? RenderQueue::PASS_TRANSPARENT : RenderQueue::PASS_SOLID);
+			}
+			queue.SetTransform(At(depths[i]));
+			queue.DrawBuffer(vb.Get(), solid.get(), materials[i % materials.size()].Get());
+		}
+		const auto recorded = std::chrono::steady_clock::now();
+		queue.Sort();
+		const auto sorted = std::chrono::steady_clock::now();
+		queue.Submit(&r);
+		const auto submitted = std::chrono::steady_clock::now();
+		queue.Clear();
+
+		recordNs += std::chrono::duration<double, std::nano>(recorded - start).count();
+		sortNs += std::chrono::duration<double, std::nano>(sorted - recorded).count();
+		submitNs += std::chrono::duration<double, std::nano>(submitted - sorted).count();
+	}
+
+	const double draws = double(numDraws) * frames;
+	printf("\n%d draws, %d frames\n", numDraws, frames);
+	printf("%-8s %12s %12s\n", "stage", "ns/draw", "ms/frame");
+	printf("%-8s %12.1f %12.3f\n", "record", recordNs / draws, recordNs / frames * 1e-6);
+	printf("%-8s %12.1f %12.3f\n", "sort", sortNs / draws, sortNs / frames * 1e-6);
+	printf("%-8s %12.1f %12.3f\n", "submit", submitNs / draws, submitNs / frames * 1e-6);
+
+	if (s_failures) {
+		printf("\n%d render queue checks failed!\n", s_failures);
+		return 1;
+	}
+	return 0;
+}
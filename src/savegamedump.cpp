@@ -2,8 +2,13 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "FileSystem.h"
+#include "GameSaveError.h"
 #include "Json.h"
+#include "SaveGameFormat.h"
+#include "StateSerializer.h"
+#include "base64/base64.hpp"
 #include "core/GZipFormat.h"
+#include "core/LZ4Format.h"
 #include <SDL.h>
 
 extern "C" int main(int argc, char **argv)
@@ -33,31 +38,59 @@ extern "C" int main(int argc, char **argv)
 
 	const auto compressed_data = file->AsByteRange();
 	Json rootNode;
-	try {
-		std::string plain_data;
-		if (gzip::IsGZipFormat(reinterpret_cast<const uint8_t *>(compressed_data.begin), compressed_data.Size()))
-			plain_data = gzip::DecompressDeflateOrGZip(reinterpret_cast<const uint8_t *>(compressed_data.begin), compressed_data.Size());
-		else
-			plain_data = std::string(compressed_data.begin, compressed_data.Size());
-
+	if (SaveGameFormat::IsSectioned(compressed_data.begin, compressed_data.Size())) {
+		try {
+			rootNode = SaveGameFormat::Decode(compressed_data.begin, compressed_data.Size());
+		} catch (SavedGameCorruptException &) {
+			printf("Decoding saved game sections failed - saved game is corrupt.\n");
+			return 3;
+		}
+	} else {
 		try {
-			// Allow loading files in JSON format as well as CBOR
-			if (plain_data[0] == '{')
-				rootNode = Json::parse(plain_data);
+			std::string plain_data;
+			if (gzip::IsGZipFormat(reinterpret_cast<const uint8_t *>(compressed_data.begin), compressed_data.Size()))
+				plain_data = gzip::DecompressDeflateOrGZip(reinterpret_cast<const uint8_t *>(compressed_data.begin), compressed_data.Size());
+			else if (lz4::IsLZ4Format(compressed_data.begin, compressed_data.Size()))
+				plain_data = lz4::DecompressLZ4(std::string_view(compressed_data.begin, compressed_data.Size()));
 			else
-				rootNode = Json::from_cbor(plain_data);
-		} catch (Json::parse_error &e) {
-			printf("Saved game is not a valid JSON object: %s.\n", e.what());
-			return 2;
+				plain_data = std::string(compressed_data.begin, compressed_data.Size());
+
+			try {
+				// Allow loading files in JSON format as well as CBOR
+				if (plain_data[0] == '{')
+					rootNode = Json::parse(plain_data);
+				else
+					rootNode = Json::from_cbor(plain_data);
+			} catch (Json::parse_error &e) {
+				printf("Saved game is not a valid JSON object: %s.\n", e.what());
+				return 2;
+			}
+
+			if (!rootNode.is_object()) {
+				printf("Saved game's root is not a JSON object.\n");
+				return 2;
+			}
+		} catch (gzip::DecompressionFailedException) {
+			printf("Decompressing saved data failed - saved game is corrupt.\n");
+			return 3;
+		} catch (lz4::DecompressionFailedException &) {
+			printf("Decompressing saved data failed - saved game is corrupt.\n");
+			return 3;
 		}
+	}
 
-		if (!rootNode.is_object()) {
-			printf("Saved game's root is not a JSON object.\n");
+	// expand the binary state into Json too, so everything can be read
+	Json &spaceObj = rootNode["space"];
+	if (spaceObj.is_object() && spaceObj["state"].is_string()) {
+		std::string state;
+		try {
+			if (!Base64::Decode(spaceObj["state"].get<std::string>(), &state))
+				throw SavedGameCorruptException();
+			spaceObj["state"] = StateSerializer::ToJson(state);
+		} catch (SavedGameCorruptException &) {
+			printf("Saved game's binary state is corrupt.\n");
 			return 2;
 		}
-	} catch (gzip::DecompressionFailedException) {
-		printf("Decompressing saved data failed - saved game is corrupt.\n");
-		return 3;
 	}
 
 	auto outFile = FileSystem::userFiles.OpenWriteStream(outname);
@@ -13,10 +13,6 @@
 #include "scenegraph/Serializer.h"
 #include "utils.h"
 
-extern "C" {
-#include <miniz/miniz.h>
-}
-
 using namespace SceneGraph;
 
 // Attempt at version history:
@@ -27,22 +23,31 @@ using namespace SceneGraph;
 // 5:	normal mapping
 // 6:	32-bit indicies
 // 6.1:	rewrote serialization, use lz4 compression instead of INFLATE/DEFLATE. Still compatible.
-const Uint32 SGM_VERSION = 6;
+// 7:	store collision BVHs, collision arrays as blobs
+// 8:	flattened SAH collision BVHs
+// 9:	collision mesh ahead of the materials and nodes
+// 10:	uncompressed, aligned vertex and index blobs after LZ4 compressed metadata
+const Uint32 SGM_VERSION = 10;
 union SGM_STRING_VALUE {
 	char name[4];
 	Uint32 value;
 };
 const SGM_STRING_VALUE SGM_STRING_ID = { { 's', 'g', 'm', SGM_VERSION } };
+// the header is the id, the version, the size of the compressed metadata that
+// follows it, and the offset and size of the blobs. the metadata is the name,
+// collision mesh, clip radius, materials, nodes, animations and tags
+const Uint32 SGM_HEADER_SIZE = 5 * sizeof(Uint32);
 const std::string SGM_EXTENSION = ".sgm";
 const std::string SAVE_TARGET_DIR = "binarymodels";
 
 class SaveHelperVisitor : public NodeVisitor {
 public:
-	SaveHelperVisitor(Serializer::Writer *wr, Model *m)
+	SaveHelperVisitor(Serializer::Writer *wr, Serializer::Writer *blobWr, Model *m)
 	{
 		db.wr = wr;
 		db.rd = nullptr;
 		db.model = m;
+		db.blobWr = blobWr;
 	}
 
 	virtual void ApplyNode(Node &n) override
@@ -116,21 +121,19 @@ void BinaryConverter::Save(const std::string &filename, const std::string &savep
 	}
 
 	Serializer::Writer wr;
-
-	wr.Int32(SGM_STRING_ID.value);
-
-	wr.Int32(SGM_VERSION);
+	Serializer::Writer blobWr;
 
 	wr.String(m->GetName().c_str());
 
+	// everything up to here can be read without a renderer, see Prepare
+	m->GetCollisionMesh()->Save(wr);
+	wr.Float(m->GetDrawClipRadius());
+
 	SaveMaterials(wr, m);
 
-	SaveHelperVisitor sv(&wr, m);
+	SaveHelperVisitor sv(&wr, &blobWr, m);
 	m->GetRoot()->Accept(sv);
 
-	m->GetCollisionMesh()->Save(wr);
-	wr.Float(m->GetDrawClipRadius());
-
 	SaveAnimations(wr, m);
 
 	//save tags
@@ -138,14 +141,26 @@ void BinaryConverter::Save(const std::string &filename, const std::string &savep
 	for (unsigned int i = 0; i < m->GetNumTags(); i++)
 		wr.String(m->GetTagByIndex(i)->GetName().c_str());
 
-	// compress in memory, write to open file
-	size_t outSize = 0;
+	// compress the metadata in memory, write to open file. the blobs are
+	// stored as they are, so they can be copied to buffers from the mapped file
 	const std::string &data = wr.GetData();
+	const std::string &blobs = blobWr.GetData();
 	try {
-		std::string compressedData = lz4::CompressLZ4(data, 6);
-		outSize = compressedData.size();
-		Output("Compressed model (%s): %.2f KB -> %.2f KB\n", filename.c_str(), data.size() / 1024.f, outSize / 1024.f);
-		fwrite(compressedData.data(), outSize, 1, f);
+		const std::string compressedData = lz4::CompressLZ4(data, 6);
+		const size_t blobOffset = (SGM_HEADER_SIZE + compressedData.size() + NodeDatabase::BLOB_ALIGNMENT - 1) / NodeDatabase::BLOB_ALIGNMENT * NodeDatabase::BLOB_ALIGNMENT;
+		Output("Compressed model (%s): %.2f KB -> %.2f KB, %.2f KB of mesh data\n", filename.c_str(), data.size() / 1024.f, compressedData.size() / 1024.f, blobs.size() / 1024.f);
+
+		Serializer::Writer out;
+		out.Int32(SGM_STRING_ID.value);
+		out.Int32(SGM_VERSION);
+		out.Int32(compressedData.size());
+		out.Int32(blobOffset);
+		out.Int32(blobs.size());
+		out.AlignedBytes(ByteRange(compressedData.data(), compressedData.size()), 1);
+		out.AlignedBytes(ByteRange(blobs.data(), blobs.size()), NodeDatabase::BLOB_ALIGNMENT);
+		assert(out.GetData().size() == blobOffset + blobs.size());
+
+		fwrite(out.GetData().data(), out.GetData().size(), 1, f);
 		fclose(f);
 	} catch (std::runtime_error &e) {
 		Warning("Error saving SGM model: %s\n", e.what());
@@ -161,40 +176,41 @@ Model *BinaryConverter::Load(const std::string &filename)
 Model *BinaryConverter::Load(const std::string &name, RefCountedPtr<FileSystem::FileData> binfile)
 {
 	PROFILE_SCOPED()
-	Model *model(nullptr);
-	// decompress the loaded ByteRange in memory
-	const ByteRange bin = binfile->AsByteRange();
-	if (lz4::IsLZ4Format(bin.begin, bin.Size())) {
-		try {
-			std::string decompressedData = lz4::DecompressLZ4({ bin.begin, bin.Size() });
-			// Output("decompressed model file %s (%.2f KB) -> %.2f KB\n", name.c_str(), binfile->GetSize() / 1024.f, decompressedData.size() / 1024.f);
-			Serializer::Reader rd(ByteRange(decompressedData.data(), decompressedData.size()));
-			model = CreateModel(name, rd);
-		} catch (std::runtime_error &e) {
-			Warning("Error loading SGM model: %s\n", e.what());
-		}
-	} else {
-		void *pDecompressedData;
-		size_t outSize(0);
-		{
-			PROFILE_SCOPED_DESC("tinfl_decompress_mem_to_heap")
-			pDecompressedData = tinfl_decompress_mem_to_heap(&bin[0], bin.Size(), &outSize, 0);
-		}
-		// Output("decompressed model file %s (%.2f KB) -> %.2f KB\n", name.c_str(), binfile->GetSize() / 1024.f, outSize / 1024.f);
-		if (pDecompressedData) {
-			// now parse in-memory representation as new ByteRange.
-			Serializer::Reader rd(ByteRange(static_cast<char *>(pDecompressedData), outSize));
-			model = CreateModel(name, rd);
-			mz_free(pDecompressedData);
-		} else {
-			Error("BinaryConverter failed to load old-style SGM called: %s", name.c_str());
-		}
+	PreparedModel prepared;
+	if (!Prepare(name, binfile, prepared)) {
+		Warning("%s\n", prepared.error.c_str());
+		return nullptr;
 	}
-
-	return model;
+	return Load(prepared);
 }
 
 Model *BinaryConverter::Load(const std::string &shortname, const std::string &basepath)
+{
+	PROFILE_SCOPED()
+	PreparedModel prepared;
+	if (!Prepare(shortname, basepath, prepared)) {
+		Warning("%s\n", prepared.error.c_str());
+		return nullptr;
+	}
+	return Load(prepared);
+}
+
+Model *BinaryConverter::Load(const PreparedModel &prepared)
+{
+	PROFILE_SCOPED()
+	try {
+		Serializer::Reader rd(ByteRange(prepared.data.data(), prepared.data.size()));
+		rd.Seek(prepared.bodyOffset);
+		m_curPath = prepared.path;
+		m_blobs = prepared.blobs;
+		return CreateModel(prepared, rd);
+	} catch (std::runtime_error &e) {
+		Warning("Error loading SGM model: %s\n", e.what());
+		return nullptr;
+	}
+}
+
+bool BinaryConverter::Prepare(const std::string &shortname, const std::string &basepath, PreparedModel &out)
 {
 	PROFILE_SCOPED()
 	FileSystem::FileSource &fileSource = FileSystem::gameDataFiles;
@@ -208,42 +224,90 @@ Model *BinaryConverter::Load(const std::string &shortname, const std::string &ba
 			const std::string name = info.GetName();
 
 			if (shortname == name.substr(0, name.length() - SGM_EXTENSION.length())) {
-				//curPath is used to find textures, patterns,
-				//possibly other data files for this model.
-				//Strip trailing slash
-				m_curPath = info.GetDir();
-				if (m_curPath[m_curPath.length() - 1] == '/')
-					m_curPath = m_curPath.substr(0, m_curPath.length() - 1);
-
-				RefCountedPtr<FileSystem::FileData> binfile = info.Read();
-				if (binfile.Valid()) return Load(name, binfile);
+				RefCountedPtr<FileSystem::FileData> binfile = info.Map();
+				if (binfile.Valid()) return Prepare(name, binfile, out);
 			}
 		}
 	}
 
 	throw(LoadingError("File not found"));
-	return nullptr;
+	return false;
 }
 
-Model *BinaryConverter::CreateModel(const std::string &filename, Serializer::Reader &rd)
+bool BinaryConverter::Prepare(const std::string &name, RefCountedPtr<FileSystem::FileData> binfile, PreparedModel &out)
 {
 	PROFILE_SCOPED()
+	//curPath is used to find textures, patterns,
+	//possibly other data files for this model.
+	//Strip trailing slash
+	out.path = binfile->GetInfo().GetDir();
+	if (!out.path.empty() && out.path[out.path.length() - 1] == '/')
+		out.path = out.path.substr(0, out.path.length() - 1);
+
+	ByteRange metadata;
+	if (!ReadHeader(name, binfile->AsByteRange(), metadata, out))
+		return false;
+	// the blobs point into it
+	out.file = binfile;
+
+	// only the metadata is decompressed, the meshes stay in the file
+	try {
+		out.data = lz4::DecompressLZ4({ metadata.begin, metadata.Size() });
+		// Output("decompressed model file %s (%.2f KB) -> %.2f KB\n", name.c_str(), metadata.Size() / 1024.f, out.data.size() / 1024.f);
+
+		Serializer::Reader rd(ByteRange(out.data.data(), out.data.size()));
+		out.name = rd.String();
+		out.collMesh.Reset(new CollMesh());
+		out.collMesh->Load(rd);
+		out.drawClipRadius = rd.Float();
+		out.bodyOffset = rd.Pos();
+	} catch (std::runtime_error &e) {
+		out.error = stringf("Error loading SGM model: %0", e.what());
+		return false;
+	}
+	return true;
+}
+
+bool BinaryConverter::ReadHeader(const std::string &filename, const ByteRange &bin, ByteRange &metadata, PreparedModel &out)
+{
+	PROFILE_SCOPED()
+	if (bin.Size() < SGM_HEADER_SIZE) {
+		out.error = stringf("Error whilst loading %0\nSGM file is truncated\nSGM file will be ignored", filename);
+		return false;
+	}
+	Serializer::Reader rd(bin);
+
 	//verify signature
 	const Uint32 sig = rd.Int32();
 	if (sig != SGM_STRING_ID.value) { //'SGM#'
-		Warning("Error whilst loading %s\nSGM versioning (%u) did not match the supported SGM STRING ID (%u)\nSGM file will be ignored\n", filename.c_str(), sig, SGM_STRING_ID.value);
-		return nullptr;
+		out.error = stringf("Error whilst loading %0\nSGM versioning (%1) did not match the supported SGM STRING ID (%2)\nSGM file will be ignored", filename, sig, SGM_STRING_ID.value);
+		return false;
 	}
 
 	const Uint32 version = rd.Int32();
 	if (version != SGM_VERSION) {
-		Warning("Error whilst loading %s\nSGM versioning (%u) did not match the supported SGM_VERSION (%u)\nSGM file will be ignored\n", filename.c_str(), version, SGM_VERSION);
-		return nullptr;
+		out.error = stringf("Error whilst loading %0\nSGM versioning (%1) did not match the supported SGM_VERSION (%2)\nSGM file will be ignored", filename, version, SGM_VERSION);
+		return false;
 	}
 
-	const std::string modelName = rd.String();
+	const Uint32 metadataSize = rd.Int32();
+	const Uint32 blobOffset = rd.Int32();
+	const Uint32 blobSize = rd.Int32();
+	if (metadataSize > bin.Size() - SGM_HEADER_SIZE || blobOffset < SGM_HEADER_SIZE + metadataSize ||
+		blobOffset > bin.Size() || blobSize > bin.Size() - blobOffset || blobOffset % NodeDatabase::BLOB_ALIGNMENT) {
+		out.error = stringf("Error whilst loading %0\nSGM file is truncated\nSGM file will be ignored", filename);
+		return false;
+	}
+
+	metadata = ByteRange(bin.begin + SGM_HEADER_SIZE, metadataSize);
+	out.blobs = ByteRange(bin.begin + blobOffset, blobSize);
+	return true;
+}
 
-	m_model = new Model(m_renderer, modelName);
+Model *BinaryConverter::CreateModel(const PreparedModel &prepared, Serializer::Reader &rd)
+{
+	PROFILE_SCOPED()
+	m_model = new Model(m_renderer, prepared.name);
 
 	m_patternsUsed = false;
 	LoadMaterials(rd);
@@ -252,10 +316,8 @@ Model *BinaryConverter::CreateModel(const std::string &filename, Serializer::Rea
 	if (!root) throw LoadingError("Expected root");
 	m_model->m_root.Reset(root);
 
-	RefCountedPtr<CollMesh> collMesh(new CollMesh());
-	collMesh->Load(rd);
-	m_model->SetCollisionMesh(collMesh);
-	m_model->SetDrawClipRadius(rd.Float());
+	m_model->SetCollisionMesh(prepared.collMesh);
+	m_model->SetDrawClipRadius(prepared.drawClipRadius);
 
 	LoadAnimations(rd);
 
@@ -440,6 +502,7 @@ Node *BinaryConverter::LoadNode(Serializer::Reader &rd)
 	db.loader = this;
 	db.model = m_model;
 	db.rd = &rd;
+	db.blobs = m_blobs;
 
 	auto loadFuncIt = m_loaders.find(ntype);
 	if (loadFuncIt == m_loaders.end()) {
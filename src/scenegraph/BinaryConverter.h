@@ -31,19 +31,41 @@ namespace SceneGraph {
 
 	class BinaryConverter : public BaseLoader {
 	public:
+		// the part of loading a model that needs no renderer: mapping the
+		// file, decompressing the metadata, and the collision mesh
+		struct PreparedModel {
+			std::string name;
+			std::string path; // where textures and patterns are looked up
+			std::string data; // the decompressed metadata
+			size_t bodyOffset; // where the materials start
+			RefCountedPtr<FileSystem::FileData> file;
+			ByteRange blobs; // vertices and indices, in the file
+			RefCountedPtr<CollMesh> collMesh;
+			float drawClipRadius;
+			std::string error; // why Prepare failed, workers can't show warnings
+		};
+
 		BinaryConverter(Graphics::Renderer *);
 		void Save(const std::string &filename, Model *m);
 		void Save(const std::string &filename, const std::string &savepath, Model *m, const bool bInPlace);
 		Model *Load(const std::string &filename);
 		Model *Load(const std::string &filename, const std::string &path);
 		Model *Load(const std::string &filename, RefCountedPtr<FileSystem::FileData> binfile);
+		// creates the materials and buffers, on the main thread
+		Model *Load(const PreparedModel &);
+
+		// safe to call from a worker. false if the file is not a usable .sgm,
+		// throws LoadingError if there is none
+		static bool Prepare(const std::string &filename, const std::string &path, PreparedModel &out);
+		static bool Prepare(const std::string &filename, RefCountedPtr<FileSystem::FileData> binfile, PreparedModel &out);
 
 		//if you implement any new node types, you must also register a loader function
 		//before calling Load.
 		void RegisterLoader(const std::string &typeName, std::function<Node *(NodeDatabase &)>);
 
 	private:
-		Model *CreateModel(const std::string &filename, Serializer::Reader &);
+		static bool ReadHeader(const std::string &filename, const ByteRange &file, ByteRange &metadata, PreparedModel &out);
+		Model *CreateModel(const PreparedModel &, Serializer::Reader &);
 		void SaveMaterials(Serializer::Writer &, Model *m);
 		void LoadMaterials(Serializer::Reader &);
 		void SaveAnimations(Serializer::Writer &, Model *m);
@@ -55,6 +77,7 @@ namespace SceneGraph {
 		static Label3D *LoadLabel3D(NodeDatabase &);
 
 		bool m_patternsUsed;
+		ByteRange m_blobs;
 		std::map<std::string, std::function<Node *(NodeDatabase &)>> m_loaders;
 	};
 } // namespace SceneGraph
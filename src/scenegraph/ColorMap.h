@@ -22,6 +22,7 @@ namespace SceneGraph {
 		Graphics::Texture *GetTexture();
 		void Generate(Graphics::Renderer *r, const Color &a, const Color &b, const Color &c);
 		void SetSmooth(bool);
+		bool IsSmooth() const { return m_smooth; }
 
 	private:
 		void AddColor(int width, const Color &c, std::vector<Uint8> &out);
@@ -76,9 +76,15 @@ namespace SceneGraph {
 			for (Uint32 i = 0; i < count; i++) {
 				transform[i].reserve(tsize);
 			}
+			// and the colors that go with them
+			const std::vector<Graphics::InstanceColors> *colors = rd->instanceColors;
+			std::vector<std::vector<Graphics::InstanceColors>> instColors;
+			if (colors)
+				instColors.resize(count);
 
 			// seperate out the transformations
-			for (auto mt : trans) {
+			for (size_t t = 0; t < tsize; t++) {
+				const matrix4x4f &mt = trans[t];
 				//figure out approximate pixel size of object's bounding radius
 				//on screen and pick a child to render
 				const vector3f cameraPos(-mt[12], -mt[13], -mt[14]);
@@ -92,12 +98,17 @@ namespace SceneGraph {
 				}
 
 				transform[lod].push_back(mt);
+				if (colors)
+					instColors[lod].push_back((*colors)[t]);
 			}
 
 			// now render each of the buffers for each of the lods
+			RenderData lodrd = *rd;
 			for (Uint32 inst = 0; inst < transform.size(); inst++) {
 				if (!transform[inst].empty()) {
-					m_children[inst]->Render(transform[inst], rd);
+					if (colors)
+						lodrd.instanceColors = &instColors[inst];
+					m_children[inst]->Render(transform[inst], &lodrd);
 				}
 			}
 		}
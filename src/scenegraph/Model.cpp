@@ -14,6 +14,7 @@
 #include "graphics/Renderer.h"
 #include "graphics/TextureBuilder.h"
 #include "graphics/VertexArray.h"
+#include "graphics/VertexBuffer.h"
 #include "scenegraph/Animation.h"
 #include "scenegraph/Label3D.h"
 #include "scenegraph/MatrixTransform.h"
@@ -107,20 +108,7 @@ namespace SceneGraph {
 	void Model::Render(const matrix4x4f &trans, const RenderData *rd)
 	{
 		PROFILE_SCOPED()
-		//update color parameters (materials are shared by model instances)
-		if (m_curPattern) {
-			for (MaterialContainer::const_iterator it = m_materials.begin(); it != m_materials.end(); ++it) {
-				if ((*it).second->GetDescriptor().usePatterns) {
-					(*it).second->texture5 = m_colorMap.GetTexture();
-					(*it).second->texture4 = m_curPattern;
-				}
-			}
-		}
-
-		//update decals (materials and geometries are shared)
-		for (unsigned int i = 0; i < MAX_DECAL_MATERIALS; i++)
-			if (m_decalMaterials[i])
-				m_decalMaterials[i]->texture0 = m_curDecals[i];
+		ApplyInstanceMaterials();
 
 		//Override renderdata if this model is called from ModelNode
 		RenderData params = (rd != 0) ? (*rd) : m_renderData;
@@ -174,21 +162,7 @@ namespace SceneGraph {
 	void Model::Render(const std::vector<matrix4x4f> &trans, const RenderData *rd)
 	{
 		PROFILE_SCOPED();
-
-		//update color parameters (materials are shared by model instances)
-		if (m_curPattern) {
-			for (MaterialContainer::const_iterator it = m_materials.begin(); it != m_materials.end(); ++it) {
-				if ((*it).second->GetDescriptor().usePatterns) {
-					(*it).second->texture5 = m_colorMap.GetTexture();
-					(*it).second->texture4 = m_curPattern;
-				}
-			}
-		}
-
-		//update decals (materials and geometries are shared)
-		for (unsigned int i = 0; i < MAX_DECAL_MATERIALS; i++)
-			if (m_decalMaterials[i])
-				m_decalMaterials[i]->texture0 = m_curDecals[i];
+		ApplyInstanceMaterials();
 
 		//Override renderdata if this model is called from ModelNode
 		RenderData params = (rd != 0) ? (*rd) : m_renderData;
@@ -211,6 +185,87 @@ namespace SceneGraph {
 		}
 	}
 
+	void Model::RenderPass(const matrix4x4f &trans, unsigned int nodemask, Graphics::RenderQueue *queue)
+	{
+		PROFILE_SCOPED()
+		ApplyInstanceMaterials();
+
+		RenderData params = m_renderData;
+		params.boundingRadius = GetDrawClipRadius();
+		params.nodemask = nodemask;
+		params.queue = queue;
+
+		if (!queue)
+			m_renderer->SetTransform(trans);
+		m_root->Render(trans, &params);
+	}
+
+	void Model::RenderPass(const std::vector<matrix4x4f> &trans, unsigned int nodemask, const std::vector<Graphics::InstanceColors> *colors)
+	{
+		PROFILE_SCOPED()
+		ApplyInstanceMaterials();
+
+		RenderData params = m_renderData;
+		params.boundingRadius = GetDrawClipRadius();
+		params.nodemask = nodemask;
+		params.instanceColors = colors;
+
+		m_root->Render(trans, &params);
+	}
+
+	bool Model::CanRenderInstancedWith(const Model &other) const
+	{
+		// instances of one model share their materials and geometry
+		if (m_name != other.m_name || m_materials.empty() || m_materials.size() != other.m_materials.size() ||
+			m_materials[0].second != other.m_materials[0].second)
+			return false;
+
+		if (m_debugFlags || other.m_debugFlags)
+			return false;
+
+		// the materials can only take one pattern and set of decals per
+		// draw, the colors come with each instance
+		if (m_curPattern != other.m_curPattern)
+			return false;
+		for (unsigned int i = 0; i < MAX_DECAL_MATERIALS; i++)
+			if (m_curDecals[i] != other.m_curDecals[i])
+				return false;
+
+		// animated transforms are taken from the model that does the drawing
+		if (m_animations.size() != other.m_animations.size())
+			return false;
+		for (size_t i = 0; i < m_animations.size(); i++)
+			if (m_animations[i]->GetProgress() != other.m_animations[i]->GetProgress())
+				return false;
+
+		return true;
+	}
+
+	void Model::GetInstanceColors(Graphics::InstanceColors &out) const
+	{
+		for (unsigned int i = 0; i < 3; i++)
+			out.colors[i] = (i < m_colors.size()) ? m_colors[i].ToColor4f() : Color4f::WHITE;
+		out.colors[0].a = m_colorMap.IsSmooth() ? 1.f : 0.f;
+	}
+
+	void Model::ApplyInstanceMaterials()
+	{
+		//update color parameters (materials are shared by model instances)
+		if (m_curPattern) {
+			for (MaterialContainer::const_iterator it = m_materials.begin(); it != m_materials.end(); ++it) {
+				if ((*it).second->GetDescriptor().usePatterns) {
+					(*it).second->texture5 = m_colorMap.GetTexture();
+					(*it).second->texture4 = m_curPattern;
+				}
+			}
+		}
+
+		//update decals (materials and geometries are shared)
+		for (unsigned int i = 0; i < MAX_DECAL_MATERIALS; i++)
+			if (m_decalMaterials[i])
+				m_decalMaterials[i]->texture0 = m_curDecals[i];
+	}
+
 	void Model::CreateAabbVB()
 	{
 		PROFILE_SCOPED()
@@ -400,6 +455,7 @@ namespace SceneGraph {
 	void Model::SetColors(const std::vector<Color> &colors)
 	{
 		assert(colors.size() == 3); //primary, seconday, trim
+		m_colors = colors;
 		m_colorMap.Generate(GetRenderer(), colors.at(0), colors.at(1), colors.at(2));
 	}
 
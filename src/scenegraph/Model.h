@@ -71,8 +71,10 @@
 
 namespace Graphics {
 	class Renderer;
+	class RenderQueue;
 	class RenderState;
 	class VertexBuffer;
+	struct InstanceColors;
 } // namespace Graphics
 
 namespace SceneGraph {
@@ -109,6 +111,18 @@ namespace SceneGraph {
 
 		void Render(const matrix4x4f &trans, const RenderData *rd = 0);				 //ModelNode can override RD
 		void Render(const std::vector<matrix4x4f> &trans, const RenderData *rd = 0); //ModelNode can override RD
+		// draw only the nodes in nodemask (NODE_SOLID or NODE_TRANSPARENT), for
+		// when the other pass is drawn elsewhere. no debug drawing. with a
+		// queue, the geometry is recorded there to be drawn later
+		void RenderPass(const matrix4x4f &trans, unsigned int nodemask, Graphics::RenderQueue *queue = nullptr);
+		// colors, if given, are the pattern colors of each instance
+		void RenderPass(const std::vector<matrix4x4f> &trans, unsigned int nodemask, const std::vector<Graphics::InstanceColors> *colors = nullptr);
+		// true if both are instances of the same model that look the same
+		// apart from their colors, so either can draw the other's solid
+		// geometry in an instanced pass
+		bool CanRenderInstancedWith(const Model &other) const;
+		// the colors to draw this model with in another's instanced pass
+		void GetInstanceColors(Graphics::InstanceColors &out) const;
 
 		RefCountedPtr<CollMesh> CreateCollisionMesh();
 		RefCountedPtr<CollMesh> GetCollisionMesh() const { return m_collMesh; }
@@ -180,12 +194,16 @@ namespace SceneGraph {
 			DEBUG_DOCKING = 0x10
 		};
 		void SetDebugFlags(Uint32 flags);
+		Uint32 GetDebugFlags() const { return m_debugFlags; }
 
 	private:
 		Model(const Model &);
 
 		static const unsigned int MAX_DECAL_MATERIALS = 4;
+		void ApplyInstanceMaterials();
+
 		ColorMap m_colorMap;
+		std::vector<Color> m_colors;
 		float m_boundingRadius;
 		MaterialContainer m_materials; //materials are shared throughout the model graph
 		PatternContainer m_patterns;
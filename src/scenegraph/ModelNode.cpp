@@ -38,6 +38,8 @@ namespace SceneGraph {
 		//slight hack here
 		RenderData newrd = *rd;
 		newrd.nodemask |= MASK_IGNORE;
+		// the submodel has its own patterns, if any
+		newrd.instanceColors = nullptr;
 		m_model->Render(trans, &newrd);
 	}
 
@@ -6,13 +6,16 @@
 /*
  * Generic node for the model scenegraph
  */
+#include "ByteRange.h"
 #include "RefCounted.h"
 #include "graphics/Material.h"
 #include "libs.h"
 
 namespace Graphics {
 	class Renderer;
-}
+	class RenderQueue;
+	struct InstanceColors;
+} // namespace Graphics
 
 namespace Serializer {
 	class Reader;
@@ -49,11 +52,20 @@ namespace SceneGraph {
 		float boundingRadius; //updated by model and passed to submodels
 		unsigned int nodemask;
 
+		// if set, geometry records its draws here instead of drawing
+		Graphics::RenderQueue *queue;
+
+		// pattern colors of each instance, in the order of the transforms
+		// of an instanced render
+		const std::vector<Graphics::InstanceColors> *instanceColors;
+
 		RenderData() :
 			linthrust(),
 			angthrust(),
 			boundingRadius(0.f),
-			nodemask(NODE_SOLID) //draw solids
+			nodemask(NODE_SOLID), //draw solids
+			queue(nullptr),
+			instanceColors(nullptr)
 		{
 		}
 	};
@@ -61,12 +73,19 @@ namespace SceneGraph {
 	//Collection of stuff nodes need for serialization -
 	//makes maintaining function signatures easier
 	struct NodeDatabase {
+		// where blobs start in the file, and in memory
+		static const size_t BLOB_ALIGNMENT = 16;
+
 		Serializer::Writer *wr;
 		Serializer::Reader *rd;
 		//	Graphics::Renderer *renderer;
 		Model *model;
 		std::vector<std::pair<std::string, RefCountedPtr<Graphics::Material>>> *materials;
 		BaseLoader *loader;
+		// vertex and index data, kept apart from the compressed rest of the
+		// file so that it can be copied to buffers as it is
+		Serializer::Writer *blobWr;
+		ByteRange blobs;
 	};
 
 	class Node : public RefCounted {
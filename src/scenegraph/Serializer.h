@@ -85,6 +85,15 @@ namespace Serializer {
 				m_str.append(range.begin, range.Size());
 			}
 		}
+		// appends the bytes without a size, padded to start at a multiple of
+		// alignment. returns where they start
+		size_t AlignedBytes(ByteRange range, size_t alignment)
+		{
+			m_str.resize((m_str.size() + alignment - 1) / alignment * alignment, '\0');
+			const size_t offset = m_str.size();
+			m_str.append(range.begin, range.Size());
+			return offset;
+		}
 		void Byte(Uint8 x) { *this << x; }
 		void Bool(bool x) { *this << x; }
 		void Int16(Uint16 x) { *this << x; }
@@ -9,6 +9,7 @@
 #include "Serializer.h"
 #include "graphics/Graphics.h"
 #include "graphics/Material.h"
+#include "graphics/RenderQueue.h"
 #include "graphics/RenderState.h"
 #include "graphics/Renderer.h"
 #include "utils.h"
@@ -49,6 +50,15 @@ namespace SceneGraph {
 	{
 		PROFILE_SCOPED()
 		SDL_assert(m_renderState);
+		if (rd->queue) {
+			Graphics::RenderQueue *q = rd->queue;
+			q->SetPass((rd->nodemask & NODE_TRANSPARENT) ? Graphics::RenderQueue::PASS_TRANSPARENT : Graphics::RenderQueue::PASS_SOLID);
+			q->SetTransform(trans);
+			for (auto &it : m_meshes)
+				q->DrawBufferIndexed(it.vertexBuffer.Get(), it.indexBuffer.Get(), m_renderState, it.material.Get());
+			return;
+		}
+
 		Graphics::Renderer *r = GetRenderer();
 		r->SetTransform(trans);
 		for (auto &it : m_meshes)
@@ -57,6 +67,31 @@ namespace SceneGraph {
 		//DrawBoundingBox(m_boundingBox);
 	}
 
+	// Due to the shader needing to change we have to force the material to the instanced variant
+	static RefCountedPtr<Graphics::Material> CreateInstanceMaterial(Graphics::Renderer *r, const Graphics::Material *src, bool instanceColors)
+	{
+		Graphics::MaterialDescriptor mdesc = src->GetDescriptor();
+		mdesc.instanced = true;
+		mdesc.instanceColors = instanceColors;
+		// create the "new" material with the instanced description
+		RefCountedPtr<Graphics::Material> mat(r->CreateMaterial(mdesc));
+		// copy over all of the other details
+		mat->texture0 = src->texture0;
+		mat->texture1 = src->texture1;
+		mat->texture2 = src->texture2;
+		mat->texture3 = src->texture3;
+		mat->texture4 = src->texture4;
+		mat->texture5 = src->texture5;
+		mat->texture6 = src->texture6;
+		mat->heatGradient = src->heatGradient;
+		mat->diffuse = src->diffuse;
+		mat->specular = src->specular;
+		mat->emissive = src->emissive;
+		mat->shininess = src->shininess;
+		mat->specialParameter0 = src->specialParameter0;
+		return mat;
+	}
+
 	void StaticGeometry::Render(const std::vector<matrix4x4f> &trans, const RenderData *rd)
 	{
 		PROFILE_SCOPED()
@@ -82,45 +117,87 @@ namespace SceneGraph {
 			ib->SetInstanceCount(numTrans);
 		}
 
+		// each instance can have its own pattern colors
+		const std::vector<Graphics::InstanceColors> *colors = rd->instanceColors;
+		assert(!colors || colors->size() == numTrans);
+		if (colors)
+			ib->SetColors(colors->data(), numTrans);
+		else
+			ib->SetColors(nullptr, 0);
+
 		// we'll set the transformation within the vertex shader so identity the global one
 		r->SetTransform(matrix4x4f::Identity());
 
 		if (m_instanceMaterials.empty()) {
 			// process each mesh
-			for (auto &it : m_meshes) {
-				// Due to the shader needing to change we have to get the material and force it to the instanced variant
-				Graphics::MaterialDescriptor mdesc = it.material->GetDescriptor();
-				mdesc.instanced = true;
-				// create the "new" material with the instanced description
-				RefCountedPtr<Graphics::Material> mat(r->CreateMaterial(mdesc));
-				// copy over all of the other details
-				mat->texture0 = it.material->texture0;
-				mat->texture1 = it.material->texture1;
-				mat->texture2 = it.material->texture2;
-				mat->texture3 = it.material->texture3;
-				mat->texture4 = it.material->texture4;
-				mat->texture5 = it.material->texture5;
-				mat->texture6 = it.material->texture5;
-				mat->heatGradient = it.material->heatGradient;
-				mat->diffuse = it.material->diffuse;
-				mat->specular = it.material->specular;
-				mat->emissive = it.material->emissive;
-				mat->shininess = it.material->shininess;
-				mat->specialParameter0 = it.material->specialParameter0;
-				m_instanceMaterials.push_back(mat);
+			for (auto &it : m_meshes)
+				m_instanceMaterials.push_back(CreateInstanceMaterial(r, it.material.Get(), false));
+		}
+		if (colors && m_instanceColorMaterials.empty()) {
+			// only the patterned meshes need the colors
+			for (size_t i = 0; i < m_meshes.size(); i++) {
+				const Graphics::Material *mat = m_meshes[i].material.Get();
+				if (mat->GetDescriptor().usePatterns)
+					m_instanceColorMaterials.push_back(CreateInstanceMaterial(r, mat, true));
+				else
+					m_instanceColorMaterials.push_back(m_instanceMaterials[i]);
 			}
 		}
+		const auto &instanceMaterials = colors ? m_instanceColorMaterials : m_instanceMaterials;
 
 		// process each mesh
 		int i = 0;
 		for (auto &it : m_meshes) {
+			// patterns and decals are set on the shared material by the model
+			// drawing, pick up the current ones
+			Graphics::Material *mat = instanceMaterials[i].Get();
+			mat->texture0 = it.material->texture0;
+			mat->texture4 = it.material->texture4;
+			mat->texture5 = it.material->texture5;
 			// finally render using the instance material
-			r->DrawBufferIndexedInstanced(it.vertexBuffer.Get(), it.indexBuffer.Get(), m_renderState, m_instanceMaterials[i].Get(), m_instBuffer.Get());
+			r->DrawBufferIndexedInstanced(it.vertexBuffer.Get(), it.indexBuffer.Get(), m_renderState, mat, m_instBuffer.Get());
 			++i;
 		}
 	}
 
 	typedef std::vector<std::pair<std::string, RefCountedPtr<Graphics::Material>>> MaterialContainer;
+	// the layout meshes are stored in, and the buffers created with
+	static Graphics::VertexBufferDesc MeshBufferDesc(bool hasTangents, Uint32 numVertices)
+	{
+		Graphics::VertexBufferDesc vbDesc;
+		vbDesc.attrib[0].semantic = Graphics::ATTRIB_POSITION;
+		vbDesc.attrib[0].format = Graphics::ATTRIB_FORMAT_FLOAT3;
+		vbDesc.attrib[1].semantic = Graphics::ATTRIB_NORMAL;
+		vbDesc.attrib[1].format = Graphics::ATTRIB_FORMAT_FLOAT3;
+		vbDesc.attrib[2].semantic = Graphics::ATTRIB_UV0;
+		vbDesc.attrib[2].format = Graphics::ATTRIB_FORMAT_FLOAT2;
+		if (hasTangents) {
+			vbDesc.attrib[3].semantic = Graphics::ATTRIB_TANGENT;
+			vbDesc.attrib[3].format = Graphics::ATTRIB_FORMAT_FLOAT3;
+		}
+		for (Uint32 i = 0; i < Graphics::MAX_ATTRIBS && vbDesc.attrib[i].semantic != Graphics::ATTRIB_NONE; i++) {
+			vbDesc.attrib[i].offset = Graphics::VertexBufferDesc::CalculateOffset(vbDesc, vbDesc.attrib[i].semantic);
+			vbDesc.stride = vbDesc.attrib[i].offset + Graphics::VertexBufferDesc::GetAttribSize(vbDesc.attrib[i].format);
+		}
+		vbDesc.usage = Graphics::BUFFER_USAGE_STATIC;
+		vbDesc.numVertices = numVertices;
+		return vbDesc;
+	}
+
+	static void SaveBlob(NodeDatabase &db, const void *data, size_t size)
+	{
+		const ByteRange range(static_cast<const char *>(data), size);
+		db.wr->Int32(db.blobWr->AlignedBytes(range, NodeDatabase::BLOB_ALIGNMENT));
+	}
+
+	static ByteRange LoadBlob(NodeDatabase &db, size_t size)
+	{
+		const Uint32 offset = db.rd->Int32();
+		if (offset % NodeDatabase::BLOB_ALIGNMENT || offset > db.blobs.Size() || size > db.blobs.Size() - offset)
+			throw LoadingError("Mesh data out of range");
+		return ByteRange(db.blobs.begin + offset, size);
+	}
+
 	void StaticGeometry::Save(NodeDatabase &db)
 	{
 		PROFILE_SCOPED()
@@ -146,38 +223,29 @@ namespace SceneGraph {
 
 			const bool hasTangents = (attribCombo & Graphics::ATTRIB_TANGENT);
 
-			//save positions, normals and uvs interleaved (only known format now)
-			const Uint32 posOffset = vbDesc.GetOffset(Graphics::ATTRIB_POSITION);
-			const Uint32 nrmOffset = vbDesc.GetOffset(Graphics::ATTRIB_NORMAL);
-			const Uint32 uv0Offset = vbDesc.GetOffset(Graphics::ATTRIB_UV0);
-			const Uint32 tanOffset = hasTangents ? vbDesc.GetOffset(Graphics::ATTRIB_TANGENT) : 0;
-			const Uint32 stride = vbDesc.stride;
-			db.wr->Int32(vbDesc.numVertices);
-			Uint8 *vtxPtr = mesh.vertexBuffer->Map<Uint8>(Graphics::BUFFER_MAP_READ);
-			if (hasTangents) {
-				for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + posOffset));
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + nrmOffset));
-					db.wr->Float(reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset)->x);
-					db.wr->Float(reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset)->y);
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + tanOffset));
-				}
-			} else {
-				for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + posOffset));
-					db.wr->Vector3f(*reinterpret_cast<vector3f *>(vtxPtr + i * stride + nrmOffset));
-					db.wr->Float(reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset)->x);
-					db.wr->Float(reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset)->y);
-				}
+			//save positions, normals, uvs and tangents interleaved, the way Load
+			//creates the buffer, whatever layout this one has
+			const Graphics::VertexBufferDesc outDesc = MeshBufferDesc(hasTangents, vbDesc.numVertices);
+			const Graphics::VertexAttrib attribs[] = { Graphics::ATTRIB_POSITION, Graphics::ATTRIB_NORMAL, Graphics::ATTRIB_UV0, Graphics::ATTRIB_TANGENT };
+			const Uint32 attribSizes[] = { sizeof(vector3f), sizeof(vector3f), sizeof(vector2f), sizeof(vector3f) };
+			const Uint32 numAttribs = hasTangents ? 4 : 3;
+			std::vector<Uint8> vertices(outDesc.numVertices * outDesc.stride);
+			const Uint8 *vtxPtr = mesh.vertexBuffer->Map<Uint8>(Graphics::BUFFER_MAP_READ);
+			for (Uint32 a = 0; a < numAttribs; a++) {
+				const Uint32 inOffset = vbDesc.GetOffset(attribs[a]);
+				const Uint32 outOffset = outDesc.GetOffset(attribs[a]);
+				for (Uint32 i = 0; i < vbDesc.numVertices; i++)
+					memcpy(&vertices[i * outDesc.stride + outOffset], vtxPtr + i * vbDesc.stride + inOffset, attribSizes[a]);
 			}
 			mesh.vertexBuffer->Unmap();
+			db.wr->Int32(vbDesc.numVertices);
+			SaveBlob(db, vertices.data(), vertices.size());
 
 			//indices
 			const Uint32 *indexPtr = mesh.indexBuffer->Map(Graphics::BUFFER_MAP_READ);
 			const Uint32 numIndices = mesh.indexBuffer->GetSize();
 			db.wr->Int32(numIndices);
-			for (Uint32 i = 0; i < numIndices; i++)
-				db.wr->Int32(indexPtr[i]);
+			SaveBlob(db, indexPtr, numIndices * sizeof(Uint32));
 			mesh.indexBuffer->Unmap();
 		}
 	}
@@ -218,54 +286,22 @@ namespace SceneGraph {
 
 			const bool hasTangents = (vtxFormat & Graphics::ATTRIB_TANGENT);
 
-			//vertex buffer
-			Graphics::VertexBufferDesc vbDesc;
-			vbDesc.attrib[0].semantic = Graphics::ATTRIB_POSITION;
-			vbDesc.attrib[0].format = Graphics::ATTRIB_FORMAT_FLOAT3;
-			vbDesc.attrib[1].semantic = Graphics::ATTRIB_NORMAL;
-			vbDesc.attrib[1].format = Graphics::ATTRIB_FORMAT_FLOAT3;
-			vbDesc.attrib[2].semantic = Graphics::ATTRIB_UV0;
-			vbDesc.attrib[2].format = Graphics::ATTRIB_FORMAT_FLOAT2;
-			if (hasTangents) {
-				vbDesc.attrib[3].semantic = Graphics::ATTRIB_TANGENT;
-				vbDesc.attrib[3].format = Graphics::ATTRIB_FORMAT_FLOAT3;
-			}
-			vbDesc.usage = Graphics::BUFFER_USAGE_STATIC;
-			vbDesc.numVertices = db.rd->Int32();
+			//vertex buffer, the data is already in its layout
+			const Graphics::VertexBufferDesc vbDesc = MeshBufferDesc(hasTangents, db.rd->Int32());
+			const ByteRange vertices = LoadBlob(db, size_t(vbDesc.numVertices) * vbDesc.stride);
 
 			RefCountedPtr<Graphics::VertexBuffer> vtxBuffer(db.loader->GetRenderer()->CreateVertexBuffer(vbDesc));
-			const Uint32 posOffset = vtxBuffer->GetDesc().GetOffset(Graphics::ATTRIB_POSITION);
-			const Uint32 nrmOffset = vtxBuffer->GetDesc().GetOffset(Graphics::ATTRIB_NORMAL);
-			const Uint32 uv0Offset = vtxBuffer->GetDesc().GetOffset(Graphics::ATTRIB_UV0);
-			const Uint32 tanOffset = hasTangents ? vtxBuffer->GetDesc().GetOffset(Graphics::ATTRIB_TANGENT) : 0;
-			const Uint32 stride = vtxBuffer->GetDesc().stride;
+			assert(vtxBuffer->GetDesc().stride == vbDesc.stride);
 			Uint8 *vtxPtr = vtxBuffer->Map<Uint8>(BUFFER_MAP_WRITE);
-			if (hasTangents) {
-				for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + posOffset) = db.rd->Vector3f();
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + nrmOffset) = db.rd->Vector3f();
-					const float uvx = db.rd->Float();
-					const float uvy = db.rd->Float();
-					*reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset) = vector2f(uvx, uvy);
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + tanOffset) = db.rd->Vector3f();
-				}
-			} else {
-				for (Uint32 i = 0; i < vbDesc.numVertices; i++) {
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + posOffset) = db.rd->Vector3f();
-					*reinterpret_cast<vector3f *>(vtxPtr + i * stride + nrmOffset) = db.rd->Vector3f();
-					const float uvx = db.rd->Float();
-					const float uvy = db.rd->Float();
-					*reinterpret_cast<vector2f *>(vtxPtr + i * stride + uv0Offset) = vector2f(uvx, uvy);
-				}
-			}
+			memcpy(vtxPtr, vertices.begin, vertices.Size());
 			vtxBuffer->Unmap();
 
 			//index buffer
 			const Uint32 numIndices = db.rd->Int32();
+			const ByteRange indices = LoadBlob(db, size_t(numIndices) * sizeof(Uint32));
 			RefCountedPtr<Graphics::IndexBuffer> idxBuffer(db.loader->GetRenderer()->CreateIndexBuffer(numIndices, Graphics::BUFFER_USAGE_STATIC));
 			Uint32 *idxPtr = idxBuffer->Map(BUFFER_MAP_WRITE);
-			for (Uint32 i = 0; i < numIndices; i++)
-				idxPtr[i] = db.rd->Int32();
+			memcpy(idxPtr, indices.begin, indices.Size());
 			idxBuffer->Unmap();
 
 			sg->AddMesh(vtxBuffer, idxBuffer, material);
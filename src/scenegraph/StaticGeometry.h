@@ -50,6 +50,8 @@ namespace SceneGraph {
 		void DrawBoundingBox(const Aabb &bb);
 		std::vector<Mesh> m_meshes;
 		std::vector<RefCountedPtr<Graphics::Material>> m_instanceMaterials;
+		// as above, patterned ones taking their colors from the InstanceBuffer
+		std::vector<RefCountedPtr<Graphics::Material>> m_instanceColorMaterials;
 		Graphics::RenderState *m_renderState;
 		RefCountedPtr<Graphics::InstanceBuffer> m_instBuffer;
 	};
@@ -12,8 +12,11 @@
 #include "Player.h"
 #include "SDL_audio.h"
 #include "SDL_events.h"
+#include "SoundMixer.h"
 #include <SDL.h>
 #include <vorbis/vorbisfile.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
 #include <cstdio>
@@ -26,6 +29,12 @@ namespace Sound {
 	static const unsigned int BUF_SIZE = 4096;
 	static const unsigned int MAX_WAVSTREAMS = 10; //first two are for music
 	static const double STREAM_IF_LONGER_THAN = 10.0;
+	// decoded samples are dropped, least recently played first, above this
+	static const size_t DECODED_SAMPLES_BUDGET = 32 * 1024 * 1024;
+	// in Sint16s, about 1.5 seconds of 44.1kHz stereo
+	static const Uint32 STREAM_RING_SIZE = 1 << 17;
+	// how often the decoder thread tops up the streams, in ms
+	static const Uint32 DECODE_INTERVAL = 20;
 
 	static SDL_AudioDeviceID m_audioDevice = 0;
 
@@ -122,6 +131,212 @@ namespace Sound {
 		&OggFileDataStream::ov_callback_tell
 	};
 
+	/*
+	 * Long samples and music are decoded by the decoder thread into a ring
+	 * buffer, which the audio callback only copies from. There is one reader
+	 * and one writer, so the ring needs no lock.
+	 *
+	 * The decoder thread owns the decoders. Whoever stops a stream cancels it
+	 * and forgets about it, and the decoder thread deletes it later.
+	 */
+	class StreamDecoder {
+	public:
+		StreamDecoder(const std::string &path, Uint32 channels, bool repeat) :
+			m_path(path),
+			m_channels(channels),
+			m_open(false),
+			m_ring(STREAM_RING_SIZE),
+			m_readPos(0),
+			m_writePos(0),
+			m_repeat(repeat),
+			m_finished(false),
+			m_failed(false),
+			m_cancelled(false)
+		{}
+
+		~StreamDecoder()
+		{
+			if (m_open)
+				ov_clear(&m_oggv);
+		}
+
+		// decoder thread: fill the ring as far as possible
+		void Decode()
+		{
+			if (m_finished || m_failed)
+				return;
+			if (!m_open && !Open()) {
+				m_failed = true;
+				return;
+			}
+
+			bool rewound = false;
+			for (;;) {
+				const Uint32 write = m_writePos.load(std::memory_order_relaxed);
+				const Uint32 space = STREAM_RING_SIZE - (write - m_readPos.load(std::memory_order_acquire));
+				const Uint32 offset = write & (STREAM_RING_SIZE - 1);
+				const Uint32 wanted = std::min(space, STREAM_RING_SIZE - offset);
+				if (wanted < m_channels)
+					return;
+
+				int music_section;
+				const long amt = ov_read(&m_oggv, reinterpret_cast<char *>(&m_ring[offset]),
+					wanted * sizeof(Sint16), 0, 2, 1, &music_section);
+				if (amt == OV_HOLE)
+					continue;
+				if (amt < 0) {
+					Output("Vorbis could not decode '%s'\n", m_path.c_str());
+					m_failed = true;
+					return;
+				}
+				if (amt == 0) {
+					// end of the stream. don't loop forever over an empty one
+					if (m_repeat && !rewound) {
+						ov_pcm_seek(&m_oggv, 0);
+						rewound = true;
+						continue;
+					}
+					m_finished = true;
+					return;
+				}
+				rewound = false;
+				m_writePos.store(write + Uint32(amt / sizeof(Sint16)), std::memory_order_release);
+			}
+		}
+
+		// audio callback: copy up to n decoded values, in whole frames
+		int Read(Sint16 *out, int n)
+		{
+			const Uint32 read = m_readPos.load(std::memory_order_relaxed);
+			const Uint32 avail = m_writePos.load(std::memory_order_acquire) - read;
+			n = std::min<int>(n, avail);
+			n -= n % m_channels;
+
+			const Uint32 offset = read & (STREAM_RING_SIZE - 1);
+			const int first = std::min<int>(n, STREAM_RING_SIZE - offset);
+			memcpy(out, &m_ring[offset], first * sizeof(Sint16));
+			memcpy(out + first, &m_ring[0], (n - first) * sizeof(Sint16));
+
+			m_readPos.store(read + n, std::memory_order_release);
+			return n;
+		}
+
+		void SetRepeat(bool repeat) { m_repeat = repeat; }
+		// nothing more will come out of it
+		bool IsDone() const { return m_failed || (m_finished && m_writePos == m_readPos); }
+
+		void Cancel() { m_cancelled = true; }
+		bool IsCancelled() const { return m_cancelled; }
+
+	private:
+		bool Open()
+		{
+			RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(m_path);
+			if (!oggdata) {
+				Output("Could not open '%s'\n", m_path.c_str());
+				return false;
+			}
+			m_dataStream.Reset(oggdata);
+			if (ov_open_callbacks(&m_dataStream, &m_oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
+				Output("Vorbis could not understand '%s'\n", m_path.c_str());
+				return false;
+			}
+			m_open = true;
+			return true;
+		}
+
+		std::string m_path;
+		Uint32 m_channels;
+
+		OggFileDataStream m_dataStream;
+		OggVorbis_File m_oggv;
+		bool m_open;
+
+		std::vector<Sint16> m_ring;
+		std::atomic<Uint32> m_readPos;
+		std::atomic<Uint32> m_writePos;
+
+		std::atomic<bool> m_repeat;
+		std::atomic<bool> m_finished;
+		std::atomic<bool> m_failed;
+		std::atomic<bool> m_cancelled;
+	};
+
+	static SDL_Thread *s_decoderThread = nullptr;
+	static SDL_mutex *s_decoderLock = nullptr;
+	static SDL_cond *s_decoderCond = nullptr;
+	static bool s_decoderQuit = false;
+	static std::vector<StreamDecoder *> s_streams; // guarded by s_decoderLock
+
+	static int DecoderThread(void *)
+	{
+		std::vector<StreamDecoder *> streams;
+
+		SDL_LockMutex(s_decoderLock);
+		while (!s_decoderQuit) {
+			// decode without the lock, so starting a stream never waits for it
+			streams = s_streams;
+			SDL_UnlockMutex(s_decoderLock);
+			for (StreamDecoder *stream : streams) {
+				if (!stream->IsCancelled())
+					stream->Decode();
+			}
+			SDL_LockMutex(s_decoderLock);
+
+			auto cancelled = std::partition(s_streams.begin(), s_streams.end(),
+				[](const StreamDecoder *stream) { return !stream->IsCancelled(); });
+			for (auto it = cancelled; it != s_streams.end(); ++it)
+				delete *it;
+			s_streams.erase(cancelled, s_streams.end());
+
+			SDL_CondWaitTimeout(s_decoderCond, s_decoderLock, DECODE_INTERVAL);
+		}
+		SDL_UnlockMutex(s_decoderLock);
+		return 0;
+	}
+
+	static void StartDecoderThread()
+	{
+		if (s_decoderThread)
+			return;
+		s_decoderLock = SDL_CreateMutex();
+		s_decoderCond = SDL_CreateCond();
+		s_decoderQuit = false;
+		s_decoderThread = SDL_CreateThread(&DecoderThread, "SoundDecoder", nullptr);
+	}
+
+	static void StopDecoderThread()
+	{
+		if (!s_decoderThread)
+			return;
+		SDL_LockMutex(s_decoderLock);
+		s_decoderQuit = true;
+		SDL_CondSignal(s_decoderCond);
+		SDL_UnlockMutex(s_decoderLock);
+		SDL_WaitThread(s_decoderThread, nullptr);
+		s_decoderThread = nullptr;
+
+		for (StreamDecoder *stream : s_streams)
+			delete stream;
+		s_streams.clear();
+		SDL_DestroyCond(s_decoderCond);
+		SDL_DestroyMutex(s_decoderLock);
+		s_decoderCond = nullptr;
+		s_decoderLock = nullptr;
+	}
+
+	static StreamDecoder *StartStream(const Sample *sample, Op op)
+	{
+		if (!s_decoderThread)
+			return nullptr;
+		StreamDecoder *stream = new StreamDecoder(sample->path, sample->channels, op & OP_REPEAT);
+		SDL_LockMutex(s_decoderLock);
+		s_streams.push_back(stream);
+		SDL_CondSignal(s_decoderCond);
+		SDL_UnlockMutex(s_decoderLock);
+		return stream;
+	}
+
 	static float m_masterVol = 1.0f;
 	static float m_sfxVol = 1.0f;
 
@@ -177,8 +392,7 @@ namespace Sound {
 
 	struct SoundEvent {
 		const Sample *sample;
-		OggVorbis_File *oggv; // if sample->buf = 0 then stream this
-		OggFileDataStream ogg_data_stream;
+		StreamDecoder *stream; // if sample->streamed
 		Uint32 buf_pos;
 		float volume[2]; // left and right channels
 		eventid identifier;
@@ -187,19 +401,124 @@ namespace Sound {
 		float targetVolume[2];
 		float rateOfChange[2]; // per sample
 		bool ascend[2];
+
+		Mixer::Resampler resampler;
 	};
 
 	static std::map<std::string, Sample> sfx_samples;
 	struct SoundEvent wavstream[MAX_WAVSTREAMS];
 
+	static size_t s_decodedBytes = 0;
+	static Uint32 s_sampleUseCount = 0;
+
+	// reads the header and decodes the sample if it's short enough.
+	// returns false if it can't be played
+	static bool DecodeSample(Sample &sample)
+	{
+		PROFILE_SCOPED()
+		RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(sample.path);
+		if (!oggdata) {
+			Output("Could not read '%s'\n", sample.path.c_str());
+			return false;
+		}
+		OggFileDataStream datastream(oggdata);
+		oggdata.Reset();
+		OggVorbis_File oggv;
+		if (ov_open_callbacks(&datastream, &oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
+			Output("Vorbis could not understand '%s'\n", sample.path.c_str());
+			return false;
+		}
+
+		struct vorbis_info *info;
+		info = ov_info(&oggv, -1);
+		if ((info->rate <= 0) || (static_cast<unsigned int>(info->rate) > FREQ * Mixer::MAX_STEP)) {
+			Output("Vorbis file %s is %ldHz, more than %dHz. Bad!\n", sample.path.c_str(), info->rate, FREQ * Mixer::MAX_STEP);
+			ov_clear(&oggv);
+			return false;
+		}
+		if ((info->channels < 1) || (info->channels > 2)) {
+			Output("Vorbis file %s is not mono or stereo. Bad!\n", sample.path.c_str());
+			ov_clear(&oggv);
+			return false;
+		}
+
+		const Sint64 num_samples = ov_pcm_total(&oggv, -1);
+		// since samples are 16 bits we have:
+		sample.buf_len = num_samples * info->channels;
+		sample.channels = info->channels;
+		sample.rate = info->rate;
+		sample.probed = true;
+
+		// decode and store as raw sample if short enough
+		const float seconds = num_samples / float(info->rate);
+		sample.streamed = seconds >= STREAM_IF_LONGER_THAN;
+		if (!sample.streamed) {
+			sample.buf = new Uint16[sample.buf_len];
+			s_decodedBytes += sample.buf_len * sizeof(Uint16);
+
+			int i = 0;
+			for (;;) {
+				int music_section;
+				int amt = ov_read(&oggv, reinterpret_cast<char *>(sample.buf) + i,
+					2 * sample.buf_len - i, 0, 2, 1, &music_section);
+				if (amt <= 0) break;
+				i += amt;
+			}
+		}
+
+		ov_clear(&oggv);
+		return true;
+	}
+
+	// drops the least recently played decoded samples that aren't playing
+	// until the rest fit in the budget
+	static void EvictSamples(const Sample *keep)
+	{
+		if (s_decodedBytes <= DECODED_SAMPLES_BUDGET)
+			return;
+
+		SDL_LockAudioDevice(m_audioDevice);
+		while (s_decodedBytes > DECODED_SAMPLES_BUDGET) {
+			Sample *oldest = nullptr;
+			for (auto &it : sfx_samples) {
+				Sample &sample = it.second;
+				if (!sample.buf || &sample == keep || (oldest && oldest->lastUsed <= sample.lastUsed))
+					continue;
+				bool playing = false;
+				for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++)
+					playing = playing || wavstream[i].sample == &sample;
+				if (!playing)
+					oldest = &sample;
+			}
+			if (!oldest)
+				break;
+
+			delete[] oldest->buf;
+			oldest->buf = nullptr;
+			s_decodedBytes -= oldest->buf_len * sizeof(Uint16);
+		}
+		SDL_UnlockAudioDevice(m_audioDevice);
+	}
+
+	// call without holding the audio lock, decoding can take a while
 	static Sample *GetSample(const char *filename)
 	{
-		if (sfx_samples.find(filename) != sfx_samples.end()) {
-			return &sfx_samples[filename];
-		} else {
+		auto it = sfx_samples.find(filename);
+		if (it == sfx_samples.end()) {
 			//SilentWarning("Unknown sound sample: %s", filename);
 			return 0;
 		}
+
+		Sample &sample = it->second;
+		if (!sample.probed || (!sample.streamed && !sample.buf)) {
+			if (!DecodeSample(sample)) {
+				sfx_samples.erase(it); // don't try again
+				return 0;
+			}
+			EvictSamples(&sample);
+		}
+		sample.lastUsed = ++s_sampleUseCount;
+		return &sample;
 	}
 
 	static SoundEvent *GetEvent(eventid id)
@@ -227,12 +546,10 @@ namespace Sound {
 
 	static void DestroyEvent(SoundEvent *ev)
 	{
-		if (ev->oggv) {
-			// streaming ogg
-			ov_clear(ev->oggv);
-			delete ev->oggv;
-			ev->oggv = 0;
-			ev->ogg_data_stream.Reset();
+		if (ev->stream) {
+			// the decoder thread deletes it
+			ev->stream->Cancel();
+			ev->stream = nullptr;
 		}
 		ev->sample = nullptr;
 	}
@@ -243,6 +560,7 @@ namespace Sound {
 	static Uint32 identifier = 1;
 	eventid PlaySfx(const char *fx, const float volume_left, const float volume_right, const Op op)
 	{
+		const Sample *sample = GetSample(fx);
 		SDL_LockAudioDevice(m_audioDevice);
 		unsigned int idx;
 		Uint32 age;
@@ -262,8 +580,10 @@ namespace Sound {
 			}
 			DestroyEvent(&wavstream[idx]);
 		}
-		wavstream[idx].sample = GetSample(fx);
-		wavstream[idx].oggv = 0;
+		wavstream[idx].sample = sample;
+		wavstream[idx].stream = (sample && sample->streamed) ? StartStream(sample, op) : nullptr;
+		if (sample)
+			wavstream[idx].resampler.Reset(double(sample->rate) / FREQ);
 		wavstream[idx].buf_pos = 0;
 		wavstream[idx].volume[0] = volume_left * GetSfxVolume();
 		wavstream[idx].volume[1] = volume_right * GetSfxVolume();
@@ -283,11 +603,14 @@ namespace Sound {
 	{
 		const int idx = nextMusicStream;
 		nextMusicStream ^= 1;
+		const Sample *sample = GetSample(fx);
 		SDL_LockAudioDevice(m_audioDevice);
 		if (wavstream[idx].sample)
 			DestroyEvent(&wavstream[idx]);
-		wavstream[idx].sample = GetSample(fx);
-		wavstream[idx].oggv = nullptr;
+		wavstream[idx].sample = sample;
+		wavstream[idx].stream = (sample && sample->streamed) ? StartStream(sample, op) : nullptr;
+		if (sample)
+			wavstream[idx].resampler.Reset(double(sample->rate) / FREQ);
 		wavstream[idx].buf_pos = 0;
 		wavstream[idx].volume[0] = volume_left;
 		wavstream[idx].volume[1] = volume_right;
@@ -300,111 +623,79 @@ namespace Sound {
 		return identifier++;
 	}
 
-	/*
- * len is the number of floats to put in buffer, NOT full samples (a sample would be 2 floats since stereo)
- */
-	template <int T_channels, int T_upsample>
-	static void fill_audio_1stream(float *buffer, int len, int stream_num)
-	{
-		// inbuf will be smaller for mono and for 22050hz samples
-		Sint16 *inbuf = static_cast<Sint16 *>(alloca(len * T_channels / T_upsample));
-		// hm pity to put this here ^^ since not used by ev.sample->buf case
-		SoundEvent &ev = wavstream[stream_num];
-		int inbuf_pos = 0;
-		int pos = 0;
-		while ((pos < len) && ev.sample) {
-			if (ev.sample->buf) {
+	// copies the next frames of the event's sample to dst, starting over if
+	// it repeats. returns how many it got, fewer than count at the end of the
+	// sample or when the decoder thread is behind
+	static int FetchFrames(SoundEvent &ev, Sint16 *dst, int count, bool &ended)
+	{
+		const Sample *sample = ev.sample;
+		const Uint32 channels = sample->channels;
+		int got = 0;
+		while (got < count) {
+			/* Repeat or end? */
+			if (ev.buf_pos >= sample->buf_len) {
+				if (!(ev.op & OP_REPEAT)) {
+					ended = true;
+					break;
+				}
+				// the decoder thread has already looped a streamed sample
+				ev.buf_pos = 0;
+			}
+
+			const int wanted = std::min<int>(count - got, (sample->buf_len - ev.buf_pos) / channels);
+			int n;
+			if (!sample->streamed) {
 				// already decoded
-				inbuf = reinterpret_cast<Sint16 *>(ev.sample->buf);
-				inbuf_pos = ev.buf_pos;
+				memcpy(dst + got * channels, sample->buf + ev.buf_pos, wanted * channels * sizeof(Sint16));
+				n = wanted;
 			} else {
-				// stream ogg vorbis
-				// ogg vorbis streaming
-				if (!ev.oggv) {
-					// open file to start streaming
-					ev.oggv = new OggVorbis_File;
-					RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(ev.sample->path);
-					if (!oggdata) {
-						Output("Could not open '%s'", ev.sample->path.c_str());
-						ev.sample = nullptr;
-						return;
-					}
-					ev.ogg_data_stream.Reset(oggdata);
-					oggdata.Reset();
-					if (ov_open_callbacks(&ev.ogg_data_stream, ev.oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
-						Output("Vorbis could not understand '%s'", ev.sample->path.c_str());
-						ev.sample = nullptr;
-						return;
-					}
+				// never wait for the decoder thread
+				if (!ev.stream) {
+					ended = true;
+					break;
 				}
-				int i = 0;
-				// (len-pos) = num floats the destination buffer wants.
-				// if we are stereo then to fill this we need (len-pos)*2 bytes
-				// if we are mono we want (len-pos) bytes
-				int wanted_bytes = (len - pos) * T_channels / T_upsample;
-				for (;;) {
-					int music_section;
-					if (wanted_bytes == 0) break;
-					int amt = ov_read(ev.oggv, reinterpret_cast<char *>(inbuf) + i,
-						wanted_bytes, 0, 2, 1, &music_section);
-					i += amt;
-					wanted_bytes -= amt;
-					if (amt == 0) break;
+				ev.stream->SetRepeat(ev.op & OP_REPEAT);
+				n = ev.stream->Read(dst + got * channels, wanted * channels) / channels;
+				if (n == 0) {
+					ended = ev.stream->IsDone();
+					break;
 				}
 			}
+			got += n;
+			ev.buf_pos += n * channels;
+		}
+		return got;
+	}
 
-			while (pos < len) {
-				/* Volume animations */
-				for (int chan = 0; chan < 2; chan++) {
-					if (ev.ascend[chan]) {
-						ev.volume[chan] = std::min(ev.volume[chan] + ev.rateOfChange[chan], ev.targetVolume[chan]);
-					} else {
-						ev.volume[chan] = std::max(ev.volume[chan] - ev.rateOfChange[chan], ev.targetVolume[chan]);
-					}
-				}
+	// mixes frames of the event into the interleaved stereo buffer, a block
+	// at a time
+	static void MixEvent(float *buffer, int frames, SoundEvent &ev)
+	{
+		Sint16 src[Mixer::MAX_SOURCE_FRAMES * 2];
+		float left[Mixer::BLOCK_FRAMES], right[Mixer::BLOCK_FRAMES];
+		float volLeft[Mixer::BLOCK_FRAMES], volRight[Mixer::BLOCK_FRAMES];
 
-				float s0, s1;
-
-				if (T_channels == 1) {
-					s0 = float(inbuf[inbuf_pos++]);
-					s1 = ev.volume[1] * s0;
-					s0 = ev.volume[0] * s0;
-					ev.buf_pos += 1;
-				} else /* stereo */ {
-					s0 = ev.volume[0] * float(inbuf[inbuf_pos++]);
-					s1 = ev.volume[1] * float(inbuf[inbuf_pos++]);
-					ev.buf_pos += 2;
-				}
+		for (int done = 0; done < frames && ev.sample;) {
+			const int n = std::min(frames - done, Mixer::BLOCK_FRAMES);
+			const int channels = ev.sample->channels;
 
-				if (T_upsample == 1) {
-					buffer[pos] += s0;
-					buffer[pos + 1] += s1;
-					pos += 2;
-				} else {
-					buffer[pos] += s0;
-					buffer[pos + 1] += s1;
-					buffer[pos + 2] += s0;
-					buffer[pos + 3] += s1;
-					pos += 4;
-				}
+			// whatever is missing at the end of the sample, or when the
+			// decoder thread is behind, is silent
+			bool ended = false;
+			const int needed = ev.resampler.FramesNeeded(n);
+			const int got = FetchFrames(ev, src, needed, ended);
+			memset(src + got * channels, 0, (needed - got) * channels * sizeof(Sint16));
+			ev.resampler.Resample(src, channels, left, right, n);
 
-				/* Repeat or end? */
-				if (ev.buf_pos >= ev.sample->buf_len) {
-					ev.buf_pos = 0;
-					inbuf_pos = 0;
-					if (!(ev.op & OP_REPEAT)) {
-						DestroyEvent(&ev);
-						break;
-					}
-					if (ev.oggv) {
-						// streaming ogg
-						ov_pcm_seek(ev.oggv, 0);
-						// repeat outer loop to decode some
-						// more vorbis from the start of the stream
-						break;
-					}
-				}
-			}
+			/* Volume animations */
+			Mixer::RampBlock(ev.volume[0], ev.targetVolume[0], ev.rateOfChange[0], ev.ascend[0], volLeft, n);
+			Mixer::RampBlock(ev.volume[1], ev.targetVolume[1], ev.rateOfChange[1], ev.ascend[1], volRight, n);
+
+			Mixer::MixBlock(buffer + 2 * done, left, right, volLeft, volRight, n);
+			done += n;
+
+			if (ended)
+				DestroyEvent(&ev);
 		}
 	}
 
@@ -436,26 +727,11 @@ namespace Sound {
 				}
 			}
 
-			if (wavstream[i].sample->channels == 1) {
-				if (wavstream[i].sample->upsample == 1) {
-					fill_audio_1stream<1, 1>(tmpbuf, len_in_floats, i);
-				} else {
-					fill_audio_1stream<1, 2>(tmpbuf, len_in_floats, i);
-				}
-			} else {
-				if (wavstream[i].sample->upsample == 1) {
-					fill_audio_1stream<2, 1>(tmpbuf, len_in_floats, i);
-				} else {
-					fill_audio_1stream<2, 2>(tmpbuf, len_in_floats, i);
-				}
-			}
+			MixEvent(tmpbuf, len_in_floats / 2, wavstream[i]);
 		}
 
 		/* Convert float sample buffer to Sint16 samples the hardware likes */
-		for (int pos = 0; pos < len_in_floats; pos++) {
-			const float val = m_masterVol * tmpbuf[pos];
-			(reinterpret_cast<Sint16 *>(dsp_buf))[pos] = Sint16(Clamp(val, -32768.0f, 32767.0f));
-		}
+		Mixer::ConvertToS16(tmpbuf, reinterpret_cast<Sint16 *>(dsp_buf), len_in_floats, m_masterVol);
 	}
 
 	void DestroyAllEvents()
@@ -479,75 +755,61 @@ namespace Sound {
 		SDL_UnlockAudioDevice(m_audioDevice);
 	}
 
-	static void load_sound(const std::string &basename, const std::string &path, bool is_music)
+	// samples found by LoadSamples, waiting for Init to take them over
+	static std::map<std::string, Sample> s_loadedSamples;
+	static bool s_samplesLoaded = false;
+
+	static void index_sound(const std::string &basename, const std::string &path, bool is_music, std::map<std::string, Sample> &samples)
 	{
-		PROFILE_SCOPED()
 		if (!ends_with_ci(basename, ".ogg")) return;
 
+		// everything else is filled in when it's first played
 		Sample sample;
-		OggVorbis_File oggv;
-
-		RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(path);
-		if (!oggdata) {
-			Error("Could not read '%s'", path.c_str());
-		}
-		OggFileDataStream datastream(oggdata);
-		oggdata.Reset();
-		if (ov_open_callbacks(&datastream, &oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
-			Error("Vorbis could not understand '%s'", path.c_str());
-		}
-		struct vorbis_info *info;
-		info = ov_info(&oggv, -1);
-
-		if ((static_cast<unsigned int>(info->rate) != FREQ) && (static_cast<unsigned int>(info->rate) != (FREQ >> 1))) {
-			Error("Vorbis file %s is not %dHz or %dHz. Bad!", path.c_str(), FREQ, FREQ >> 1);
-		}
-		if ((info->channels < 1) || (info->channels > 2)) {
-			Error("Vorbis file %s is not mono or stereo. Bad!", path.c_str());
-		}
-
-		int resample_multiplier = ((info->rate == (FREQ >> 1)) ? 2 : 1);
-		const Sint64 num_samples = ov_pcm_total(&oggv, -1);
-		// since samples are 16 bits we have:
-
 		sample.buf = 0;
-		sample.buf_len = num_samples * info->channels;
-		sample.channels = info->channels;
-		sample.upsample = resample_multiplier;
+		sample.buf_len = 0;
+		sample.channels = 0;
+		sample.rate = FREQ;
 		sample.path = path;
-
-		const float seconds = num_samples / float(info->rate);
-		//Output("%f seconds\n", seconds);
-
-		// immediately decode and store as raw sample if short enough
-		if (seconds < STREAM_IF_LONGER_THAN) {
-			sample.buf = new Uint16[sample.buf_len];
-
-			int i = 0;
-			for (;;) {
-				int music_section;
-				int amt = ov_read(&oggv, reinterpret_cast<char *>(sample.buf) + i,
-					2 * sample.buf_len - i, 0, 2, 1, &music_section);
-				i += amt;
-				if (amt == 0) break;
-			}
-		}
+		sample.probed = false;
+		sample.streamed = false;
+		sample.lastUsed = 0;
 
 		if (is_music) {
 			sample.isMusic = true;
 			// music keyed by pathname minus (datapath)/music/ and extension
-			sfx_samples[path.substr(0, path.size() - 4)] = sample;
+			samples[path.substr(0, path.size() - 4)] = sample;
 		} else {
 			sample.isMusic = false;
 			// sfx keyed by basename minus the .ogg
-			sfx_samples[basename.substr(0, basename.size() - 4)] = sample;
+			samples[basename.substr(0, basename.size() - 4)] = sample;
 		}
-
-		ov_clear(&oggv);
 	}
 
 	std::vector<std::string> audioDeviceNames = {};
 
+	void LoadSamples()
+	{
+		PROFILE_SCOPED()
+		if (s_samplesLoaded)
+			return;
+
+		// load all the wretched effects
+		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "sounds", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+			const FileSystem::FileInfo &info = files.Current();
+			assert(info.IsFile());
+			index_sound(info.GetName(), info.GetPath(), false, s_loadedSamples);
+		}
+
+		//I'd rather do this in MusicPlayer and store in a different map too, this will do for now
+		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "music", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+			const FileSystem::FileInfo &info = files.Current();
+			assert(info.IsFile());
+			index_sound(info.GetName(), info.GetPath(), true, s_loadedSamples);
+		}
+
+		s_samplesLoaded = true;
+	}
+
 	bool Init(bool automaticallyOpenDevice)
 	{
 		PROFILE_SCOPED()
@@ -561,19 +823,15 @@ namespace Sound {
 			return false;
 		}
 
-		// load all the wretched effects
-		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "sounds", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
-			const FileSystem::FileInfo &info = files.Current();
-			assert(info.IsFile());
-			load_sound(info.GetName(), info.GetPath(), false);
+		if (sfx_samples.empty()) {
+			if (!s_samplesLoaded)
+				LoadSamples();
+			sfx_samples.swap(s_loadedSamples);
+			s_loadedSamples.clear();
+			s_samplesLoaded = false;
 		}
 
-		//I'd rather do this in MusicPlayer and store in a different map too, this will do for now
-		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "music", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
-			const FileSystem::FileInfo &info = files.Current();
-			assert(info.IsFile());
-			load_sound(info.GetName(), info.GetPath(), true);
-		}
+		StartDecoderThread();
 
 		UpdateAudioDevices();
 
@@ -637,11 +895,16 @@ namespace Sound {
 			return;
 
 		DestroyAllEvents();
-		std::map<std::string, Sample>::iterator i;
-		for (i = sfx_samples.begin(); i != sfx_samples.end(); ++i)
-			delete[](*i).second.buf;
 		SDL_CloseAudioDevice(m_audioDevice);
 		m_audioDevice = 0;
+		StopDecoderThread();
+
+		std::map<std::string, Sample>::iterator i;
+		for (i = sfx_samples.begin(); i != sfx_samples.end(); ++i) {
+			delete[](*i).second.buf;
+			(*i).second.buf = nullptr;
+		}
+		s_decodedBytes = 0;
 	}
 
 	void UpdateAudioDevices()
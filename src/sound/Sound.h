@@ -23,10 +23,16 @@ namespace Sound {
 		Uint16 *buf;
 		Uint32 buf_len;
 		Uint32 channels;
-		int upsample; // 1 = 44100, 2=22050
-		/* if buf is null, this will be path to an ogg we must stream */
+		Uint32 rate; // resampled to the output rate when mixed
+		/* if streamed, this will be path to an ogg we must stream */
 		std::string path;
 		bool isMusic;
+		// the header is read, and short samples decoded, the first time the
+		// sample is played. decoded samples that haven't been played for a
+		// while may be dropped again to keep within the memory budget
+		bool probed;
+		bool streamed;
+		Uint32 lastUsed;
 	};
 
 	class Event {
@@ -58,6 +64,9 @@ namespace Sound {
 	};
 	typedef Uint32 eventid;
 
+	// finds the sound effects and music. it doesn't touch the audio device,
+	// so it can run on a worker before Init, which does it itself otherwise
+	void LoadSamples();
 	bool Init(bool automaticallyOpenDevice = true);
 	bool InitDevice(std::string &name);
 	void Uninit();
@@ -0,0 +1,136 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SoundMixer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIXER_SSE2
+#endif
+
+namespace Sound {
+	namespace Mixer {
+
+		void Resampler::Reset(double step)
+		{
+			assert(step > 0.0 && step <= MAX_STEP);
+			m_step = step;
+			m_frac = 0.0;
+			// start from a silent frame, so the first block doesn't click
+			m_carry[0][0] = m_carry[0][1] = 0.0f;
+			m_numCarried = 1;
+		}
+
+		int Resampler::FramesNeeded(int outFrames) const
+		{
+			// the last output frame interpolates up to here...
+			const int last = int(m_frac + (outFrames - 1) * m_step) + 1;
+			// ...and the next block starts here
+			const int next = int(m_frac + outFrames * m_step);
+			return std::max(last, next) + 1 - m_numCarried;
+		}
+
+		void Resampler::Resample(const Sint16 *src, int channels, float *left, float *right, int outFrames)
+		{
+			float srcLeft[MAX_SOURCE_FRAMES + 2];
+			float srcRight[MAX_SOURCE_FRAMES + 2];
+
+			const int fetched = FramesNeeded(outFrames);
+			const int total = m_numCarried + fetched;
+			assert(total <= MAX_SOURCE_FRAMES + 2);
+
+			for (int i = 0; i < m_numCarried; i++) {
+				srcLeft[i] = m_carry[i][0];
+				srcRight[i] = m_carry[i][1];
+			}
+			if (channels == 1) {
+				for (int i = 0; i < fetched; i++)
+					srcLeft[m_numCarried + i] = srcRight[m_numCarried + i] = float(src[i]);
+			} else {
+				for (int i = 0; i < fetched; i++) {
+					srcLeft[m_numCarried + i] = float(src[2 * i]);
+					srcRight[m_numCarried + i] = float(src[2 * i + 1]);
+				}
+			}
+
+			if (m_step == 1.0 && m_frac == 0.0) {
+				// same rate, nothing to interpolate
+				std::copy(srcLeft, srcLeft + outFrames, left);
+				std::copy(srcRight, srcRight + outFrames, right);
+			} else {
+				for (int j = 0; j < outFrames; j++) {
+					const double pos = m_frac + j * m_step;
+					const int i = int(pos);
+					const float t = float(pos - i);
+					left[j] = srcLeft[i] + (srcLeft[i + 1] - srcLeft[i]) * t;
+					right[j] = srcRight[i] + (srcRight[i + 1] - srcRight[i]) * t;
+				}
+			}
+
+			const double end = m_frac + outFrames * m_step;
+			const int consumed = int(end);
+			m_frac = end - consumed;
+			m_numCarried = total - consumed;
+			assert(m_numCarried >= 1 && m_numCarried <= 2);
+			for (int i = 0; i < m_numCarried; i++) {
+				m_carry[i][0] = srcLeft[consumed + i];
+				m_carry[i][1] = srcRight[consumed + i];
+			}
+		}
+
+		void RampBlock(float &volume, float target, float rate, bool ascend, float *out, int frames)
+		{
+			const float start = volume;
+			if (ascend) {
+				for (int i = 0; i < frames; i++)
+					out[i] = std::min(start + (i + 1) * rate, target);
+			} else {
+				for (int i = 0; i < frames; i++)
+					out[i] = std::max(start - (i + 1) * rate, target);
+			}
+			if (frames > 0)
+				volume = out[frames - 1];
+		}
+
+		void MixBlock(float *out, const float *left, const float *right, const float *volLeft, const float *volRight, int frames)
+		{
+			int i = 0;
+#ifdef MIXER_SSE2
+			for (; i + 4 <= frames; i += 4) {
+				const __m128 l = _mm_mul_ps(_mm_loadu_ps(left + i), _mm_loadu_ps(volLeft + i));
+				const __m128 r = _mm_mul_ps(_mm_loadu_ps(right + i), _mm_loadu_ps(volRight + i));
+				float *o = out + 2 * i;
+				_mm_storeu_ps(o, _mm_add_ps(_mm_loadu_ps(o), _mm_unpacklo_ps(l, r)));
+				_mm_storeu_ps(o + 4, _mm_add_ps(_mm_loadu_ps(o + 4), _mm_unpackhi_ps(l, r)));
+			}
+#endif
+			for (; i < frames; i++) {
+				out[2 * i] += left[i] * volLeft[i];
+				out[2 * i + 1] += right[i] * volRight[i];
+			}
+		}
+
+		void ConvertToS16(const float *in, Sint16 *out, int count, float gain)
+		{
+			int i = 0;
+#ifdef MIXER_SSE2
+			// packs saturate, which does the clamping
+			const __m128 g = _mm_set1_ps(gain);
+			for (; i + 8 <= count; i += 8) {
+				const __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), g));
+				const __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), g));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(a, b));
+			}
+#endif
+			for (; i < count; i++) {
+				const float val = gain * in[i];
+				out[i] = Sint16(std::min(std::max(val, -32768.0f), 32767.0f));
+			}
+		}
+
+	} // namespace Mixer
+} // namespace Sound
@@ -0,0 +1,64 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SOUNDMIXER_H
+#define _SOUNDMIXER_H
+
+#include <SDL_stdinc.h>
+
+/*
+ * The building blocks of the mixer, working on blocks of frames rather than
+ * one value at a time. Voices are resampled to the output rate, scaled by a
+ * volume ramp and added into an interleaved stereo float buffer, which is
+ * converted to Sint16 at the end.
+ *
+ * Nothing here knows about the audio device, so it can be benchmarked on
+ * its own (see soundbench).
+ */
+namespace Sound {
+	namespace Mixer {
+
+		// output frames mixed at a time
+		static const int BLOCK_FRAMES = 64;
+		// sources up to this many times the output rate can be resampled
+		static const int MAX_STEP = 4;
+		// the most source frames a block needs
+		static const int MAX_SOURCE_FRAMES = BLOCK_FRAMES * MAX_STEP + 2;
+
+		// linear interpolating resampler for one voice
+		class Resampler {
+		public:
+			Resampler() { Reset(1.0); }
+
+			// step is the source rate over the output rate
+			void Reset(double step);
+
+			// how many new source frames Resample needs for outFrames
+			int FramesNeeded(int outFrames) const;
+
+			// src holds FramesNeeded(outFrames) frames of channels (1 or 2)
+			// values each. mono sources come out on both sides
+			void Resample(const Sint16 *src, int channels, float *left, float *right, int outFrames);
+
+		private:
+			double m_step;
+			double m_frac; // position between the first two frames
+			// frames fetched before but still needed
+			float m_carry[2][2];
+			int m_numCarried;
+		};
+
+		// per frame volumes moving towards target by rate each frame, the
+		// way the old mixer did it one frame at a time. updates volume
+		void RampBlock(float &volume, float target, float rate, bool ascend, float *out, int frames);
+
+		// out[2 * i] += left[i] * volLeft[i], and the same for the right
+		void MixBlock(float *out, const float *left, const float *right, const float *volLeft, const float *volRight, int frames);
+
+		// scales, clamps and converts count values
+		void ConvertToS16(const float *in, Sint16 *out, int count, float gain);
+
+	} // namespace Mixer
+} // namespace Sound
+
+#endif /* _SOUNDMIXER_H */
@@ -0,0 +1,125 @@
+// Copyright © 2008-2021 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// Standalone benchmark for the sound mixer. Mixes synthetic voices at the
+// sample rates and channel counts the game's sounds come in, the way the
+// audio callback does, and reports the cost per voice against the time the
+// callback has to fill its buffer.
+
+#include "sound/SoundMixer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Sound;
+
+static const int FREQ = 44100;
+// matches the buffer the game opens the audio device with
+static const int BUFFER_FRAMES = 4096;
+
+struct Voice {
+	std::vector<Sint16> data;
+	int channels;
+	int pos; // in frames
+	Mixer::Resampler resampler;
+	float volume[2];
+};
+
+static void MakeVoice(Voice &voice, int rate, int channels, int seconds)
+{
+	const int frames = rate * seconds;
+	voice.data.resize(frames * channels);
+	voice.channels = channels;
+	voice.pos = 0;
+	voice.resampler.Reset(double(rate) / FREQ);
+	voice.volume[0] = voice.volume[1] = 0.0f;
+	const double pitch = 110.0 + 55.0 * (rand() % 8);
+	for (int i = 0; i < frames; i++) {
+		const Sint16 v = Sint16(8000.0 * sin(2.0 * M_PI * pitch * i / rate));
+		for (int c = 0; c < channels; c++)
+			voice.data[i * channels + c] = v;
+	}
+}
+
+static void MixVoice(float *buffer, int frames, Voice &voice)
+{
+	Sint16 src[Mixer::MAX_SOURCE_FRAMES * 2];
+	float left[Mixer::BLOCK_FRAMES], right[Mixer::BLOCK_FRAMES];
+	float volLeft[Mixer::BLOCK_FRAMES], volRight[Mixer::BLOCK_FRAMES];
+	const int total = int(voice.data.size()) / voice.channels;
+
+	for (int done = 0; done < frames;) {
+		const int n = std::min(frames - done, Mixer::BLOCK_FRAMES);
+		const int needed = voice.resampler.FramesNeeded(n);
+		for (int got = 0; got < needed;) {
+			// loops, like OP_REPEAT
+			const int count = std::min(needed - got, total - voice.pos);
+			memcpy(src + got * voice.channels, &voice.data[voice.pos * voice.channels], count * voice.channels * sizeof(Sint16));
+			got += count;
+			voice.pos = (voice.pos + count) % total;
+		}
+		voice.resampler.Resample(src, voice.channels, left, right, n);
+		Mixer::RampBlock(voice.volume[0], 0.5f, 0.0001f, true, volLeft, n);
+		Mixer::RampBlock(voice.volume[1], 0.5f, 0.0001f, true, volRight, n);
+		Mixer::MixBlock(buffer + 2 * done, left, right, volLeft, volRight, n);
+		done += n;
+	}
+}
+
+static void RunCase(int rate, int channels, int numVoices, int seconds)
+{
+	std::vector<Voice> voices(numVoices);
+	for (Voice &voice : voices)
+		MakeVoice(voice, rate, channels, 2);
+
+	std::vector<float> mixbuf(BUFFER_FRAMES * 2);
+	std::vector<Sint16> out(BUFFER_FRAMES * 2);
+	const int buffers = seconds * FREQ / BUFFER_FRAMES;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (int b = 0; b < buffers; b++) {
+		std::fill(mixbuf.begin(), mixbuf.end(), 0.0f);
+		for (Voice &voice : voices)
+			MixVoice(mixbuf.data(), BUFFER_FRAMES, voice);
+		Mixer::ConvertToS16(mixbuf.data(), out.data(), BUFFER_FRAMES * 2, 1.0f);
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	const double audioSeconds = double(buffers) * BUFFER_FRAMES / FREQ;
+	const double nsPerVoiceSecond = ns / (numVoices * audioSeconds);
+	// share of the wall clock time the audio covers
+	const double budget = 100.0 * ns / (audioSeconds * 1e9);
+
+	// keep the output alive
+	int checksum = 0;
+	for (Sint16 v : out)
+		checksum += v;
+
+	printf("%6d Hz %s %3d voices %14.0f %10.3f%% %10d\n", rate, channels == 1 ? "mono  " : "stereo",
+		numVoices, nsPerVoiceSecond, budget, checksum);
+}
+
+int main(int argc, char **argv)
+{
+	int seconds = 60;
+	if (argc > 1)
+		seconds = std::max(1, atoi(argv[1]));
+
+	printf("mixing %d seconds of audio at %d Hz in buffers of %d frames\n\n", seconds, FREQ, BUFFER_FRAMES);
+	printf("%-27s %14s %11s %10s\n", "case", "ns/voice/s", "budget", "checksum");
+
+	const int rates[] = { 22050, 44100, 48000 };
+	const int voiceCounts[] = { 1, 10, 32 };
+	for (int rate : rates)
+		for (int channels = 1; channels <= 2; channels++)
+			for (int numVoices : voiceCounts)
+				RunCase(rate, channels, numVoices, seconds);
+
+	return 0;
+}
@@ -204,6 +204,42 @@ namespace FileSystem {
 		}
 	}
 
+	class FileDataMapped : public FileData {
+	public:
+		FileDataMapped(const FileInfo &info, size_t size, char *data) :
+			FileData(info, size, data) {}
+		virtual ~FileDataMapped() { UnmapViewOfFile(m_data); }
+	};
+
+	RefCountedPtr<FileData> FileSourceFS::MapFile(const std::string &path)
+	{
+		const std::string fullpath = JoinPathBelow(GetRoot(), path);
+		const std::wstring wfullpath = transcode_utf8_to_utf16(fullpath);
+		HANDLE filehandle = CreateFileW(wfullpath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (filehandle == INVALID_HANDLE_VALUE)
+			return RefCountedPtr<FileData>(0);
+
+		const Time::DateTime modtime = file_modtime_for_handle(filehandle);
+
+		LARGE_INTEGER large_size;
+		void *data = 0;
+		// empty files can't be mapped
+		if (GetFileSizeEx(filehandle, &large_size) && large_size.QuadPart > 0) {
+			HANDLE mapping = CreateFileMappingW(filehandle, 0, PAGE_READONLY, 0, 0, 0);
+			if (mapping) {
+				data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				// the view keeps its own references to the mapping and the file
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(filehandle);
+
+		if (!data)
+			return ReadFile(path);
+
+		return RefCountedPtr<FileData>(new FileDataMapped(MakeFileInfo(path, FileInfo::FT_FILE, modtime), size_t(large_size.QuadPart), static_cast<char *>(data)));
+	}
+
 	bool FileSourceFS::ReadDirectory(const std::string &dirpath, std::vector<FileInfo> &output)
 	{
 		size_t output_head_size = output.size();
@@ -290,4 +326,17 @@ namespace FileSystem {
 		const std::string fullpath = JoinPathBelow(GetRoot(), path);
 		return open_file_raw(fullpath, (flags & WRITE_TEXT) ? L"w" : L"wb");
 	}
+
+	bool FileSourceFS::RenameFile(const std::string &from, const std::string &to)
+	{
+		const std::wstring wfullfrom = transcode_utf8_to_utf16(JoinPathBelow(GetRoot(), from));
+		const std::wstring wfullto = transcode_utf8_to_utf16(JoinPathBelow(GetRoot(), to));
+		return MoveFileExW(wfullfrom.c_str(), wfullto.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	}
+
+	bool FileSourceFS::RemoveFile(const std::string &path)
+	{
+		const std::wstring wfullpath = transcode_utf8_to_utf16(JoinPathBelow(GetRoot(), path));
+		return DeleteFileW(wfullpath.c_str()) != 0;
+	}
 } // namespace FileSystem
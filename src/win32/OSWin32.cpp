@@ -18,6 +18,9 @@
 #include <windows.h>
 
 #include <shellapi.h>
+// GetProcessMemoryInfo from kernel32, no psapi.lib needed
+#define PSAPI_VERSION 2
+#include <psapi.h>
 
 extern "C" {
 // This is the quickest and easiest way to enable using the nVidia GPU on a Windows laptop with a dedicated nVidia GPU and Optimus tech.
@@ -110,6 +113,14 @@ namespace OS {
 		return sysinfo.dwNumberOfProcessors;
 	}
 
+	size_t GetPeakMemoryUsage()
+	{
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.PeakWorkingSetSize;
+	}
+
 	// get hardware information
 	const std::string GetHardwareInfo()
 	{